@@ -0,0 +1,53 @@
+#version 430
+
+// Variants as for mesh.vert
+
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 2) in vec3 vertexNormal;
+#ifdef HAS_VERTEX_COLOR
+layout (location = 1) in vec3 vertexColor;
+#endif
+#ifdef HAS_TEXTURE
+layout (location = 3) in vec2 vertexTexCoords;
+#endif
+
+// Index of the object being drawn; the baseInstance of its draw command (see
+// main/gpu_culling.hpp).
+layout (location = 4) in uint objectId;
+
+#include "frame_data.glsl"
+
+// Per object
+struct ObjectTransform
+{
+    mat4 model2World;
+    mat4 normalMatrix; // upper 3x3
+};
+
+layout (std430, row_major, binding = 4) readonly buffer ObjectTransforms
+{
+    ObjectTransform transforms[];
+};
+
+out vec3 fragNormal;
+#ifdef HAS_VERTEX_COLOR
+out vec3 fragColor;
+#endif
+#ifdef HAS_TEXTURE
+out vec2 fragTexCoords;
+#endif
+
+void main()
+{
+    ObjectTransform xform = transforms[objectId];
+
+    gl_Position = frame.viewProjection * (xform.model2World * vec4(vertexPosition, 1.0));
+    fragNormal = normalize(mat3(xform.normalMatrix) * vertexNormal);
+
+#ifdef HAS_VERTEX_COLOR
+    fragColor = vertexColor;
+#endif
+#ifdef HAS_TEXTURE
+    fragTexCoords = vertexTexCoords;
+#endif
+}
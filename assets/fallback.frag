@@ -0,0 +1,15 @@
+#version 430
+
+in vec3 fragNormal;
+
+layout (location=0) out vec3 fragOutput;
+
+#include "frame_data.glsl"
+
+void main()
+{
+    // Plain grey, lit like the rest of the scene
+    float lightFactor = max(0.0, dot(normalize(fragNormal), frame.lightDirection.xyz));
+    vec3 grey = vec3(0.5);
+    fragOutput = grey * (frame.ambientLight.rgb + lightFactor * frame.lightDiffuse.rgb);
+}
@@ -0,0 +1,22 @@
+#version 430
+
+// Stand-in for programs that are still being built, see
+// support/shader_builds.hpp. Accepts the inputs of default.vert and draws
+// untextured, uncolored geometry.
+
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 2) in vec3 vertexNormal;
+
+#include "frame_data.glsl"
+
+// Per draw
+layout (location = 0) uniform mat4 modelTransform;
+layout (location = 1) uniform mat3 normalTransform;
+
+out vec3 fragNormal;
+
+void main()
+{
+    gl_Position = frame.viewProjection * (modelTransform * vec4(vertexPosition, 1.0));
+    fragNormal = normalize(normalTransform * vertexNormal);
+}
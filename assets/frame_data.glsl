@@ -0,0 +1,8 @@
+// Per frame, see main/uniform_blocks.hpp
+layout (std140, row_major, binding = 0) uniform FrameData
+{
+    mat4 viewProjection;
+    vec4 lightDirection; // xyz
+    vec4 lightDiffuse;   // rgb
+    vec4 ambientLight;   // rgb
+} frame;
@@ -0,0 +1,14 @@
+#version 430
+
+in vec2 fragTexCoords;
+in vec4 fragColor;
+
+layout (location = 0) out vec4 fragOutput;
+
+// Glyph coverage in the red channel; solid quads sample a white texel
+layout (binding = 0) uniform sampler2D glyphAtlas;
+
+void main()
+{
+    fragOutput = vec4(fragColor.rgb, fragColor.a * texture(glyphAtlas, fragTexCoords).r);
+}
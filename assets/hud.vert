@@ -0,0 +1,20 @@
+#version 430
+
+// See main/hud.hpp
+layout (location = 0) in vec2 vertexPosition; // pixels, origin at the top left
+layout (location = 1) in vec2 vertexTexCoords;
+layout (location = 2) in vec4 vertexColor;
+
+layout (location = 0) uniform vec2 viewportSize; // pixels
+
+out vec2 fragTexCoords;
+out vec4 fragColor;
+
+void main()
+{
+    vec2 ndc = vertexPosition / viewportSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+
+    fragTexCoords = vertexTexCoords;
+    fragColor = vertexColor;
+}
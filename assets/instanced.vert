@@ -0,0 +1,47 @@
+#version 430
+
+// Variants as for mesh.vert; with HAS_VERTEX_COLOR, the vertex colors are
+// modulated by the instance colors. There are no texture coordinates.
+
+layout (location = 0) in vec3 vertexPos;
+layout (location = 2) in vec3 vertexNorm;
+#ifdef HAS_VERTEX_COLOR
+layout (location = 1) in vec3 vertexCol;
+#endif
+
+// Per instance, see main/instanced_mesh.hpp
+layout (location = 4) in vec4 instanceModelRow0;
+layout (location = 5) in vec4 instanceModelRow1;
+layout (location = 6) in vec4 instanceModelRow2;
+layout (location = 7) in vec4 instanceModelRow3;
+layout (location = 8) in vec3 instanceNormalRow0;
+layout (location = 9) in vec3 instanceNormalRow1;
+layout (location = 10) in vec3 instanceNormalRow2;
+#ifdef HAS_VERTEX_COLOR
+layout (location = 11) in vec3 instanceColor;
+#endif
+
+#include "frame_data.glsl"
+
+// Per draw, applied to all instances
+layout (location = 0) uniform mat4 modelTransform;
+layout (location = 1) uniform mat3 normTransform;
+
+out vec3 fragNormal;
+#ifdef HAS_VERTEX_COLOR
+out vec3 fragColor;
+#endif
+
+void main()
+{
+    // The instance matrices are stored by rows
+    mat4 instanceModel = transpose(mat4(instanceModelRow0, instanceModelRow1, instanceModelRow2, instanceModelRow3));
+    mat3 instanceNormal = transpose(mat3(instanceNormalRow0, instanceNormalRow1, instanceNormalRow2));
+
+    gl_Position = frame.viewProjection * (modelTransform * (instanceModel * vec4(vertexPos, 1.0)));
+    fragNormal = normalize(normTransform * (instanceNormal * vertexNorm));
+
+#ifdef HAS_VERTEX_COLOR
+    fragColor = vertexCol * instanceColor;
+#endif
+}
@@ -0,0 +1,6 @@
+// Per draw, see main/uniform_blocks.hpp
+layout (std140, binding = 1) uniform MaterialData
+{
+    vec4 diffuse; // rgb
+    vec4 ambient; // rgb
+} material;
@@ -0,0 +1,40 @@
+#version 430
+
+// Lit surface for mesh.vert, instanced.vert and culled.vert, with the same
+// variants. Without either feature, the surface has the material's color.
+
+in vec3 fragNormal;
+#ifdef HAS_VERTEX_COLOR
+in vec3 fragColor;
+#endif
+#ifdef HAS_TEXTURE
+in vec2 fragTexCoords;
+#endif
+
+layout (location = 0) out vec3 fragOutput;
+
+#include "frame_data.glsl"
+#include "material_data.glsl"
+
+#ifdef HAS_TEXTURE
+layout (binding = 0) uniform sampler2D textureSampler;
+#endif
+
+void main()
+{
+    vec3 normal = normalize(fragNormal);
+    float lightFactor = max(0.0, dot(normal, normalize(frame.lightDirection.xyz)));
+
+    vec3 ambient = frame.ambientLight.rgb * material.ambient.rgb;
+    vec3 diffuse = frame.lightDiffuse.rgb * material.diffuse.rgb;
+    vec3 color = ambient + lightFactor * diffuse;
+
+#ifdef HAS_VERTEX_COLOR
+    color *= fragColor;
+#endif
+#ifdef HAS_TEXTURE
+    color *= texture(textureSampler, fragTexCoords).rgb;
+#endif
+
+    fragOutput = color;
+}
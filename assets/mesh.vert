@@ -0,0 +1,41 @@
+#version 430
+
+// Meshes from the render queue. Variants (see support/shader_variants.hpp):
+//   HAS_TEXTURE       texture coordinates, for mesh.frag's texture
+//   HAS_VERTEX_COLOR  per-vertex colors
+
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 2) in vec3 vertexNormal;
+#ifdef HAS_VERTEX_COLOR
+layout (location = 1) in vec3 vertexColor;
+#endif
+#ifdef HAS_TEXTURE
+layout (location = 3) in vec2 vertexTexCoords;
+#endif
+
+#include "frame_data.glsl"
+
+// Per draw
+layout (location = 0) uniform mat4 modelTransform;
+layout (location = 1) uniform mat3 normalTransform;
+
+out vec3 fragNormal;
+#ifdef HAS_VERTEX_COLOR
+out vec3 fragColor;
+#endif
+#ifdef HAS_TEXTURE
+out vec2 fragTexCoords;
+#endif
+
+void main()
+{
+    gl_Position = frame.viewProjection * (modelTransform * vec4(vertexPosition, 1.0));
+    fragNormal = normalize(normalTransform * vertexNormal);
+
+#ifdef HAS_VERTEX_COLOR
+    fragColor = vertexColor;
+#endif
+#ifdef HAS_TEXTURE
+    fragTexCoords = vertexTexCoords;
+#endif
+}
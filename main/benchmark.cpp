@@ -0,0 +1,266 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr float kDegrees_ = 3.1415926f / 180.f;
+
+	struct FileDeleter_
+	{
+		~FileDeleter_()
+		{
+			if( file )
+				std::fclose( file );
+		}
+
+		std::FILE* file;
+	};
+
+	double percentile_( std::vector<double> const& aSorted, double aPercent )
+	{
+		auto const n = aSorted.size();
+		auto const rank = std::size_t(std::ceil( aPercent / 100.0 * double(n) ));
+		return aSorted[std::min( n, std::max( rank, std::size_t(1) ) ) - 1];
+	}
+
+	void write_string_( std::FILE* aOut, std::string const& aStr )
+	{
+		std::fputc( '"', aOut );
+		for( char c : aStr )
+		{
+			if( '"' == c || '\\' == c )
+				std::fprintf( aOut, "\\%c", c );
+			else if( static_cast<unsigned char>(c) < 0x20 )
+				std::fprintf( aOut, "\\u%04x", unsigned(c) );
+			else
+				std::fputc( c, aOut );
+		}
+		std::fputc( '"', aOut );
+	}
+
+	void write_stats_( std::FILE* aOut, char const* aName, SampleStats const& aStats, bool aLast = false )
+	{
+		std::fprintf( aOut, "\t\"%s\": { \"count\": %zu, \"mean\": %.4f, \"stddev\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			aName, aStats.count, aStats.mean, aStats.stddev, aStats.p50, aStats.p90, aStats.p99, aStats.max, aLast ? "" : "," );
+	}
+}
+
+float BenchmarkScript::duration() const noexcept
+{
+	float ret = 0.f;
+	if( !camera.empty() )
+		ret = std::max( ret, camera.back().time );
+	if( !events.empty() )
+		ret = std::max( ret, events.back().time );
+	return ret;
+}
+
+BenchmarkScript parse_benchmark_script( std::string const& aText, char const* aSourceName )
+{
+	BenchmarkScript ret;
+
+	std::size_t lineNumber = 0;
+	for( std::size_t begin = 0; begin < aText.size(); )
+	{
+		auto end = aText.find( '\n', begin );
+		if( std::string::npos == end )
+			end = aText.size();
+
+		std::string line = aText.substr( begin, end - begin );
+		begin = end + 1;
+		++lineNumber;
+
+		if( auto const comment = line.find( '#' ); std::string::npos != comment )
+			line.resize( comment );
+
+		char command[16] = {};
+		int consumed = 0;
+		if( 1 != std::sscanf( line.c_str(), " %15s%n", command, &consumed ) )
+			continue; // empty line
+
+		char const* args = line.c_str() + consumed;
+		char tail = 0;
+
+		if( 0 == std::strcmp( command, "camera" ) )
+		{
+			BenchmarkKeyframe key{};
+			if( 6 != std::sscanf( args, "%f %f %f %f %f %f %c", &key.time, &key.position.x, &key.position.y, &key.position.z, &key.yaw, &key.pitch, &tail ) )
+				throw Error( "%s:%zu: expected 'camera <time> <x> <y> <z> <yaw> <pitch>'", aSourceName, lineNumber );
+
+			key.yaw *= kDegrees_;
+			key.pitch *= kDegrees_;
+			ret.camera.emplace_back( key );
+		}
+		else if( 0 == std::strcmp( command, "launch" ) || 0 == std::strcmp( command, "reset" ) )
+		{
+			BenchmarkEvent event{};
+			event.action = 'l' == command[0] ? BenchmarkAction::launch : BenchmarkAction::reset;
+			if( 1 != std::sscanf( args, "%f %c", &event.time, &tail ) )
+				throw Error( "%s:%zu: expected '%s <time>'", aSourceName, lineNumber, command );
+
+			ret.events.emplace_back( event );
+		}
+		else
+			throw Error( "%s:%zu: unknown command '%s'", aSourceName, lineNumber, command );
+	}
+
+	if( ret.camera.empty() )
+		throw Error( "%s: no camera keyframes", aSourceName );
+
+	auto const byTime = [] (auto const& aA, auto const& aB) { return aA.time < aB.time; };
+	std::stable_sort( ret.camera.begin(), ret.camera.end(), byTime );
+	std::stable_sort( ret.events.begin(), ret.events.end(), byTime );
+
+	return ret;
+}
+
+BenchmarkScript load_benchmark_script( char const* aPath )
+{
+	assert( aPath );
+
+	std::FILE* fin = std::fopen( aPath, "rb" );
+	if( !fin )
+		throw Error( "load_benchmark_script(): Unable to open '%s' for reading", aPath );
+
+	FileDeleter_ fd{ fin };
+
+	std::string text;
+	char buffer[4096];
+	while( auto const count = std::fread( buffer, 1, sizeof(buffer), fin ) )
+		text.append( buffer, count );
+
+	if( std::ferror( fin ) )
+		throw Error( "load_benchmark_script(): Error while reading '%s'", aPath );
+
+	return parse_benchmark_script( text, aPath );
+}
+
+BenchmarkKeyframe benchmark_camera_at( BenchmarkScript const& aScript, float aTime ) noexcept
+{
+	auto const& keys = aScript.camera;
+	assert( !keys.empty() );
+
+	auto const next = std::upper_bound( keys.begin(), keys.end(), aTime, [] (float aT, BenchmarkKeyframe const& aKey) {
+		return aT < aKey.time;
+	} );
+
+	if( keys.begin() == next )
+		return keys.front();
+	if( keys.end() == next )
+		return keys.back();
+
+	auto const& a = *(next - 1);
+	auto const& b = *next;
+	float const t = (aTime - a.time) / (b.time - a.time);
+
+	BenchmarkKeyframe ret;
+	ret.time = aTime;
+	ret.position = a.position + t * (b.position - a.position);
+	ret.yaw = a.yaw + t * (b.yaw - a.yaw);
+	ret.pitch = a.pitch + t * (b.pitch - a.pitch);
+	return ret;
+}
+
+void benchmark_events_in( BenchmarkScript const& aScript, float aFrom, float aTo, std::vector<BenchmarkAction>& aOut )
+{
+	aOut.clear();
+	for( auto const& event : aScript.events )
+	{
+		if( event.time >= aFrom && event.time < aTo )
+			aOut.emplace_back( event.action );
+	}
+}
+
+SampleStats summarize_samples( std::vector<double> aSamples )
+{
+	SampleStats ret;
+	ret.count = aSamples.size();
+	if( aSamples.empty() )
+		return ret;
+
+	std::sort( aSamples.begin(), aSamples.end() );
+
+	double sum = 0.0;
+	for( double x : aSamples )
+		sum += x;
+
+	ret.mean = sum / double(aSamples.size());
+
+	double squares = 0.0;
+	for( double x : aSamples )
+		squares += (x - ret.mean) * (x - ret.mean);
+
+	ret.stddev = std::sqrt( squares / double(aSamples.size()) );
+	ret.p50 = percentile_( aSamples, 50.0 );
+	ret.p90 = percentile_( aSamples, 90.0 );
+	ret.p99 = percentile_( aSamples, 99.0 );
+	ret.max = aSamples.back();
+	return ret;
+}
+
+void write_benchmark_report( char const* aPath, BenchmarkInfo const& aInfo, std::vector<BenchmarkFrame> const& aFrames )
+{
+	assert( aPath );
+
+	std::vector<double> cpu, gpu, interval, latency, draws, drawCalls, particles;
+	for( auto const& frame : aFrames )
+	{
+		cpu.emplace_back( frame.cpuMilliseconds );
+		if( frame.gpuMilliseconds >= 0.0 )
+			gpu.emplace_back( frame.gpuMilliseconds );
+
+		interval.emplace_back( frame.intervalMilliseconds );
+		if( frame.latencyMilliseconds >= 0.0 )
+			latency.emplace_back( frame.latencyMilliseconds );
+
+		draws.emplace_back( double(frame.draws) );
+		drawCalls.emplace_back( double(frame.drawCalls) );
+		particles.emplace_back( double(frame.particles) );
+	}
+
+	std::FILE* fout = std::fopen( aPath, "wb" );
+	if( !fout )
+		throw Error( "write_benchmark_report(): Unable to open '%s' for writing", aPath );
+
+	FileDeleter_ fd{ fout };
+
+	std::fprintf( fout, "{\n" );
+	std::fprintf( fout, "\t\"script\": " );
+	write_string_( fout, aInfo.script );
+	std::fprintf( fout, ",\n\t\"renderer\": " );
+	write_string_( fout, aInfo.renderer );
+	std::fprintf( fout, ",\n\t\"version\": " );
+	write_string_( fout, aInfo.version );
+	std::fprintf( fout, ",\n" );
+	std::fprintf( fout, "\t\"width\": %d,\n\t\"height\": %d,\n", aInfo.width, aInfo.height );
+	std::fprintf( fout, "\t\"headless\": %s,\n", aInfo.headless ? "true" : "false" );
+	std::fprintf( fout, "\t\"warmup_frames\": %zu,\n", aInfo.warmupFrames );
+	std::fprintf( fout, "\t\"frames\": %zu,\n", aFrames.size() );
+	std::fprintf( fout, "\t\"frame_time_s\": %.6f,\n", double(aInfo.frameTime) );
+	std::fprintf( fout, "\t\"pacing\": " );
+	write_string_( fout, aInfo.pacing );
+	std::fprintf( fout, ",\n" );
+	if( aInfo.targetFps > 0.0 )
+		std::fprintf( fout, "\t\"target_fps\": %.3f,\n", aInfo.targetFps );
+
+	write_stats_( fout, "cpu_ms", summarize_samples( std::move(cpu) ) );
+	write_stats_( fout, "gpu_ms", summarize_samples( std::move(gpu) ) );
+	write_stats_( fout, "interval_ms", summarize_samples( std::move(interval) ) );
+	write_stats_( fout, "latency_ms", summarize_samples( std::move(latency) ) );
+	write_stats_( fout, "draws", summarize_samples( std::move(draws) ) );
+	write_stats_( fout, "draw_calls", summarize_samples( std::move(drawCalls) ) );
+	write_stats_( fout, "particles", summarize_samples( std::move(particles) ), true );
+
+	std::fprintf( fout, "}\n" );
+
+	if( std::ferror( fout ) )
+		throw Error( "write_benchmark_report(): Error while writing '%s'", aPath );
+}
@@ -0,0 +1,117 @@
+#ifndef BENCHMARK_HPP_E63B0D58_1F7A_4C29_8B4E_95D2A7C1F306
+#define BENCHMARK_HPP_E63B0D58_1F7A_4C29_8B4E_95D2A7C1F306
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+
+// Camera pose at a point of a benchmark timeline. The position is in world
+// space; yaw and pitch (radians) are the phi and theta of the interactive
+// camera.
+struct BenchmarkKeyframe
+{
+	float time; // seconds
+	Vec3f position;
+	float yaw, pitch;
+};
+
+enum class BenchmarkAction
+{
+	launch, // start the ship's launch
+	reset   // put the ship back on its pad
+};
+
+struct BenchmarkEvent
+{
+	float time;
+	BenchmarkAction action;
+};
+
+/** BenchmarkScript: camera path and ship commands for --benchmark
+ *
+ * A text file with one command per line; '#' starts a comment. Times are in
+ * seconds from the start of the measured frames, angles in degrees:
+ *
+ *   camera <time> <x> <y> <z> <yaw> <pitch>
+ *   launch <time>
+ *   reset <time>
+ *
+ * The camera moves linearly between its keyframes and holds the first and
+ * last pose outside of them. Both lists are sorted by time.
+ */
+struct BenchmarkScript
+{
+	std::vector<BenchmarkKeyframe> camera;
+	std::vector<BenchmarkEvent> events;
+
+	// Time of the last keyframe or event
+	float duration() const noexcept;
+};
+
+BenchmarkScript parse_benchmark_script( std::string const& aText, char const* aSourceName = "<script>" );
+BenchmarkScript load_benchmark_script( char const* aPath );
+
+// Camera at aTime. Requires at least one keyframe.
+BenchmarkKeyframe benchmark_camera_at( BenchmarkScript const&, float aTime ) noexcept;
+
+// Actions of the events in [aFrom, aTo), in order. aOut is cleared first.
+void benchmark_events_in( BenchmarkScript const&, float aFrom, float aTo, std::vector<BenchmarkAction>& aOut );
+
+
+// Summary of a series of per-frame samples. Percentiles use the nearest
+// rank method, such that each is one of the samples.
+struct SampleStats
+{
+	std::size_t count = 0;
+	double mean = 0.0;
+	double stddev = 0.0;
+	double p50 = 0.0, p90 = 0.0, p99 = 0.0;
+	double max = 0.0;
+};
+
+SampleStats summarize_samples( std::vector<double> aSamples );
+
+
+// Measurements of one frame. gpuMilliseconds and latencyMilliseconds are
+// negative if they could not be measured.
+struct BenchmarkFrame
+{
+	double cpuMilliseconds = 0.0; // one iteration of the main loop
+	double gpuMilliseconds = -1.0;
+
+	// Since the previous frame was presented, including any pacing wait
+	double intervalMilliseconds = 0.0;
+
+	// From sampling the frame's inputs until the GPU finished the frame
+	double latencyMilliseconds = -1.0;
+
+	std::size_t draws = 0; // submitted to the render queue
+	std::size_t drawCalls = 0; // GL draw calls, after merging
+	std::size_t particles = 0;
+};
+
+struct BenchmarkInfo
+{
+	std::string script;
+	std::string renderer; // GL_RENDERER
+	std::string version; // GL_VERSION
+
+	int width = 0, height = 0;
+	bool headless = false;
+
+	std::size_t warmupFrames = 0;
+	float frameTime = 0.f; // simulated seconds per frame
+
+	std::string pacing; // see frame_pacing_name()
+	double targetFps = 0.0; // fixed pacing only
+};
+
+// Writes a JSON report with the settings and the summarized series
+// "cpu_ms", "gpu_ms", "interval_ms", "latency_ms", "draws", "draw_calls"
+// and "particles". Throws Error if the file cannot be written.
+void write_benchmark_report( char const* aPath, BenchmarkInfo const&, std::vector<BenchmarkFrame> const& );
+
+#endif // BENCHMARK_HPP_E63B0D58_1F7A_4C29_8B4E_95D2A7C1F306
@@ -0,0 +1,366 @@
+#include "bvh.hpp"
+
+#include <limits>
+#include <iterator>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include "../support/profiler.hpp"
+
+namespace
+{
+	constexpr float kInf_ = std::numeric_limits<float>::infinity();
+
+	// Signed distance term of a plane; shared by all tests so that node and
+	// object tests round identically.
+	inline
+	float plane_( float aNx, float aNy, float aNz, float aD, float aX, float aY, float aZ ) noexcept
+	{
+		return aNx*aX + aNy*aY + aNz*aZ + aD;
+	}
+
+	constexpr Aabb kEmptyAabb_{ { kInf_, kInf_, kInf_ }, { -kInf_, -kInf_, -kInf_ } };
+
+	// Traversal stack entries: node index, with the top bit set if the node
+	// is known to be entirely inside the frustum.
+	constexpr std::uint32_t kInsideBit_ = 0x80000000u;
+}
+
+Aabb make_aabb( Vec3f const* aPoints, std::size_t aCount ) noexcept
+{
+	Aabb ret = kEmptyAabb_;
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		auto const& p = aPoints[i];
+		ret.min = Vec3f{ std::min( ret.min.x, p.x ), std::min( ret.min.y, p.y ), std::min( ret.min.z, p.z ) };
+		ret.max = Vec3f{ std::max( ret.max.x, p.x ), std::max( ret.max.y, p.y ), std::max( ret.max.z, p.z ) };
+	}
+	return ret;
+}
+
+Aabb transform_aabb( Aabb const& aBox, Mat44f const& aM ) noexcept
+{
+	// Arvo's method: per output axis, pick the smaller/larger of each
+	// column's contribution.
+	float const inMin[3] = { aBox.min.x, aBox.min.y, aBox.min.z };
+	float const inMax[3] = { aBox.max.x, aBox.max.y, aBox.max.z };
+
+	float outMin[3], outMax[3];
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		outMin[i] = outMax[i] = aM( i, 3 );
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			float const a = aM( i, j ) * inMin[j];
+			float const b = aM( i, j ) * inMax[j];
+			outMin[i] += std::min( a, b );
+			outMax[i] += std::max( a, b );
+		}
+	}
+
+	return Aabb{ { outMin[0], outMin[1], outMin[2] }, { outMax[0], outMax[1], outMax[2] } };
+}
+
+Aabb merge( Aabb const& aA, Aabb const& aB ) noexcept
+{
+	return Aabb{
+		{ std::min( aA.min.x, aB.min.x ), std::min( aA.min.y, aB.min.y ), std::min( aA.min.z, aB.min.z ) },
+		{ std::max( aA.max.x, aB.max.x ), std::max( aA.max.y, aB.max.y ), std::max( aA.max.z, aB.max.z ) }
+	};
+}
+
+Frustum make_frustum( Mat44f const& aM ) noexcept
+{
+	// Gribb & Hartmann: with clip = M * p, the planes are row 3 +/- rows
+	// 0, 1 and 2.
+	Frustum ret;
+	for( std::size_t i = 0; i < 6; ++i )
+	{
+		std::size_t const row = i / 2;
+		float const sign = (i % 2) ? -1.f : 1.f;
+
+		float const nx = aM( 3, 0 ) + sign * aM( row, 0 );
+		float const ny = aM( 3, 1 ) + sign * aM( row, 1 );
+		float const nz = aM( 3, 2 ) + sign * aM( row, 2 );
+		float const d = aM( 3, 3 ) + sign * aM( row, 3 );
+
+		float const len = std::sqrt( nx*nx + ny*ny + nz*nz );
+		float const inv = len > 0.f ? 1.f / len : 0.f;
+
+		ret.nx[i] = nx * inv;
+		ret.ny[i] = ny * inv;
+		ret.nz[i] = nz * inv;
+		ret.d[i] = d * inv;
+	}
+	return ret;
+}
+
+bool intersects( Frustum const& aF, Aabb const& aBox ) noexcept
+{
+	for( std::size_t p = 0; p < 6; ++p )
+	{
+		// Corner furthest along the plane normal
+		float const x = aF.nx[p] > 0.f ? aBox.max.x : aBox.min.x;
+		float const y = aF.ny[p] > 0.f ? aBox.max.y : aBox.min.y;
+		float const z = aF.nz[p] > 0.f ? aBox.max.z : aBox.min.z;
+
+		if( plane_( aF.nx[p], aF.ny[p], aF.nz[p], aF.d[p], x, y, z ) < 0.f )
+			return false;
+	}
+	return true;
+}
+
+void frustum_cull( Frustum const& aF, Aabb const* aBoxes, std::size_t aCount, std::vector<std::uint32_t>& aVisible )
+{
+	aVisible.clear();
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		if( intersects( aF, aBoxes[i] ) )
+			aVisible.emplace_back( std::uint32_t(i) );
+	}
+}
+
+
+void Bvh::build( Aabb const* aBoxes, std::size_t aCount )
+{
+	assert( aCount < kInsideBit_ );
+
+	mNodes.clear();
+	mObjects.resize( aCount );
+	mBoxes.resize( aCount );
+
+	std::vector<Vec3f> centers( aCount );
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		mObjects[i] = std::uint32_t(i);
+		centers[i] = 0.5f * (aBoxes[i].min + aBoxes[i].max);
+	}
+
+	if( 0 == aCount )
+		return;
+
+	// build_() permutes the objects; refit() then gathers the boxes in the
+	// same order and computes the node bounds.
+	build_( 0, std::uint32_t(aCount), centers );
+	refit( aBoxes );
+}
+
+void Bvh::refit( Aabb const* aBoxes )
+{
+	for( std::size_t i = 0; i < mObjects.size(); ++i )
+		mBoxes[i] = aBoxes[mObjects[i]];
+
+	// Children come after their parents, so a backwards pass sees each node
+	// after all of its children.
+	for( std::size_t n = mNodes.size(); n-- > 0; )
+	{
+		auto& node = mNodes[n];
+		for( std::size_t s = 0; s < 4; ++s )
+		{
+			Aabb box = kEmptyAabb_;
+			if( kInner_ == node.count[s] )
+				box = node_bounds_( mNodes[node.child[s]] );
+			else
+			{
+				for( std::uint32_t i = 0; i < node.count[s]; ++i )
+					box = merge( box, mBoxes[node.child[s] + i] );
+			}
+
+			set_slot_bounds_( node, s, box );
+		}
+	}
+}
+
+void Bvh::cull( Frustum const& aF, std::vector<std::uint32_t>& aVisible ) const
+{
+	PROFILE_SCOPE( "bvh cull" );
+
+	aVisible.clear();
+	if( mNodes.empty() )
+		return;
+
+	// Depth is about log4(objects/kBvhLeafSize) for median splits; each
+	// level pushes at most four entries.
+	std::uint32_t stack[256];
+	std::size_t top = 0;
+	stack[top++] = 0;
+
+	while( top )
+	{
+		auto const entry = stack[--top];
+		if( entry & kInsideBit_ )
+		{
+			append_subtree_( entry & ~kInsideBit_, aVisible );
+			continue;
+		}
+
+		auto const& node = mNodes[entry];
+
+		// Per child: outside any plane? Entirely inside all planes?
+		bool outside[4] = { false, false, false, false };
+		bool inside[4] = { true, true, true, true };
+		for( std::size_t p = 0; p < 6; ++p )
+		{
+			float const nx = aF.nx[p], ny = aF.ny[p], nz = aF.nz[p], d = aF.d[p];
+
+			// Furthest (p) and nearest (n) corners along the normal. The
+			// choice is the same for all four children.
+			float const* px = nx > 0.f ? node.maxX : node.minX;
+			float const* py = ny > 0.f ? node.maxY : node.minY;
+			float const* pz = nz > 0.f ? node.maxZ : node.minZ;
+			float const* qx = nx > 0.f ? node.minX : node.maxX;
+			float const* qy = ny > 0.f ? node.minY : node.maxY;
+			float const* qz = nz > 0.f ? node.minZ : node.maxZ;
+
+			for( std::size_t i = 0; i < 4; ++i )
+			{
+				outside[i] |= plane_( nx, ny, nz, d, px[i], py[i], pz[i] ) < 0.f;
+				inside[i] &= plane_( nx, ny, nz, d, qx[i], qy[i], qz[i] ) >= 0.f;
+			}
+		}
+
+		for( std::size_t s = 0; s < 4; ++s )
+		{
+			auto const count = node.count[s];
+			if( kEmpty_ == count || outside[s] )
+				continue;
+
+			if( kInner_ == count )
+			{
+				assert( top < std::size(stack) );
+				stack[top++] = node.child[s] | (inside[s] ? kInsideBit_ : 0u);
+			}
+			else
+			{
+				auto const first = node.child[s];
+				for( std::uint32_t i = 0; i < count; ++i )
+				{
+					if( inside[s] || intersects( aF, mBoxes[first+i] ) )
+						aVisible.emplace_back( mObjects[first+i] );
+				}
+			}
+		}
+	}
+}
+
+std::size_t Bvh::object_count() const noexcept
+{
+	return mObjects.size();
+}
+std::size_t Bvh::node_count() const noexcept
+{
+	return mNodes.size();
+}
+
+std::uint32_t Bvh::build_( std::uint32_t aBegin, std::uint32_t aEnd, std::vector<Vec3f> const& aCenters )
+{
+	auto const index = std::uint32_t(mNodes.size());
+	mNodes.emplace_back();
+
+	// Split the range into up to four groups, always halving the largest
+	// group that is too big for a leaf.
+	struct Group_ { std::uint32_t begin, end; };
+	Group_ groups[4] = { { aBegin, aEnd } };
+	std::size_t groupCount = 1;
+
+	while( groupCount < 4 )
+	{
+		std::size_t largest = 0;
+		for( std::size_t g = 1; g < groupCount; ++g )
+		{
+			if( groups[g].end - groups[g].begin > groups[largest].end - groups[largest].begin )
+				largest = g;
+		}
+
+		auto const [begin, end] = groups[largest];
+		if( end - begin <= kBvhLeafSize )
+			break;
+
+		// Largest axis of the centers
+		Vec3f lo = aCenters[mObjects[begin]], hi = lo;
+		for( auto i = begin+1; i < end; ++i )
+		{
+			auto const& c = aCenters[mObjects[i]];
+			lo = Vec3f{ std::min( lo.x, c.x ), std::min( lo.y, c.y ), std::min( lo.z, c.z ) };
+			hi = Vec3f{ std::max( hi.x, c.x ), std::max( hi.y, c.y ), std::max( hi.z, c.z ) };
+		}
+		auto const ext = hi - lo;
+		std::size_t const axis = (ext.x >= ext.y && ext.x >= ext.z) ? 0 : (ext.y >= ext.z ? 1 : 2);
+
+		auto const mid = begin + (end - begin) / 2;
+		std::nth_element( mObjects.begin() + begin, mObjects.begin() + mid, mObjects.begin() + end, [&] (std::uint32_t aA, std::uint32_t aB) {
+			return aCenters[aA][axis] < aCenters[aB][axis];
+		} );
+
+		groups[largest] = Group_{ begin, mid };
+		groups[groupCount++] = Group_{ mid, end };
+	}
+
+	for( std::size_t s = 0; s < 4; ++s )
+	{
+		// Note: mNodes may reallocate in build_(), so no references are held.
+		if( s >= groupCount )
+		{
+			mNodes[index].child[s] = 0;
+			mNodes[index].count[s] = kEmpty_;
+		}
+		else if( groups[s].end - groups[s].begin <= kBvhLeafSize )
+		{
+			mNodes[index].child[s] = groups[s].begin;
+			mNodes[index].count[s] = groups[s].end - groups[s].begin;
+		}
+		else
+		{
+			auto const child = build_( groups[s].begin, groups[s].end, aCenters );
+			mNodes[index].child[s] = child;
+			mNodes[index].count[s] = kInner_;
+		}
+
+		set_slot_bounds_( mNodes[index], s, kEmptyAabb_ );
+	}
+
+	return index;
+}
+
+void Bvh::set_slot_bounds_( Node_& aNode, std::size_t aSlot, Aabb const& aBox ) noexcept
+{
+	aNode.minX[aSlot] = aBox.min.x;
+	aNode.minY[aSlot] = aBox.min.y;
+	aNode.minZ[aSlot] = aBox.min.z;
+	aNode.maxX[aSlot] = aBox.max.x;
+	aNode.maxY[aSlot] = aBox.max.y;
+	aNode.maxZ[aSlot] = aBox.max.z;
+}
+
+Aabb Bvh::node_bounds_( Node_ const& aNode ) const noexcept
+{
+	Aabb ret = kEmptyAabb_;
+	for( std::size_t s = 0; s < 4; ++s )
+	{
+		if( kEmpty_ != aNode.count[s] )
+		{
+			ret = merge( ret, Aabb{
+				{ aNode.minX[s], aNode.minY[s], aNode.minZ[s] },
+				{ aNode.maxX[s], aNode.maxY[s], aNode.maxZ[s] }
+			} );
+		}
+	}
+	return ret;
+}
+
+void Bvh::append_subtree_( std::uint32_t aNode, std::vector<std::uint32_t>& aVisible ) const
+{
+	auto const& node = mNodes[aNode];
+	for( std::size_t s = 0; s < 4; ++s )
+	{
+		if( kInner_ == node.count[s] )
+			append_subtree_( node.child[s], aVisible );
+		else
+		{
+			for( std::uint32_t i = 0; i < node.count[s]; ++i )
+				aVisible.emplace_back( mObjects[node.child[s] + i] );
+		}
+	}
+}
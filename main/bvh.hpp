@@ -0,0 +1,109 @@
+#ifndef BVH_HPP_6A0D3E58_F1B2_4C97_8D64_2B9E05C7A1F3
+#define BVH_HPP_6A0D3E58_F1B2_4C97_8D64_2B9E05C7A1F3
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Axis-aligned bounding box
+struct Aabb
+{
+	Vec3f min;
+	Vec3f max;
+};
+
+// Bounds of aCount points. Returns an empty (inverted) box for no points.
+Aabb make_aabb( Vec3f const* aPoints, std::size_t aCount ) noexcept;
+
+// Bounds of aBox after transforming it with aM (affine)
+Aabb transform_aabb( Aabb const& aBox, Mat44f const& aM ) noexcept;
+
+Aabb merge( Aabb const&, Aabb const& ) noexcept;
+
+// View frustum as six planes (left, right, bottom, top, near, far), with the
+// normals pointing inwards: a point p is inside if n.p + d >= 0 for all of
+// them. Stored as structure of arrays.
+struct Frustum
+{
+	float nx[6], ny[6], nz[6], d[6];
+};
+
+// Extracts the frustum planes from a projection * view matrix (OpenGL clip
+// space conventions).
+Frustum make_frustum( Mat44f const& aProjCameraWorld ) noexcept;
+
+// Whether aBox is at least partially inside the frustum. Conservative: boxes
+// near a frustum corner may be reported as visible.
+bool intersects( Frustum const&, Aabb const& ) noexcept;
+
+// Reference culler: tests every box. Fills aVisible with the indices of the
+// boxes that intersect the frustum, in increasing order.
+void frustum_cull( Frustum const&, Aabb const* aBoxes, std::size_t aCount, std::vector<std::uint32_t>& aVisible );
+
+constexpr std::size_t kBvhLeafSize = 4;
+
+/** Bvh: bounding volume hierarchy over object bounds, for frustum culling
+ *
+ * A four-wide BVH: each node holds the bounds of up to four children as
+ * structure of arrays, so that a node's children are tested against a plane
+ * in one (auto-vectorized) loop. Leaves hold up to kBvhLeafSize objects.
+ *
+ * build() creates the tree by recursive median splits along the largest
+ * axis of the object centers. When objects move, refit() updates all bounds
+ * bottom up in a single pass without changing the tree, which is much
+ * cheaper than a rebuild but loosens the tree over time if objects move
+ * far. Rebuild occasionally in that case.
+ *
+ * cull() skips the plane tests for subtrees that are entirely inside the
+ * frustum. It reports exactly the objects that frustum_cull() reports, but
+ * in tree order.
+ */
+class Bvh final
+{
+	public:
+		Bvh() = default;
+
+	public:
+		void build( Aabb const* aBoxes, std::size_t aCount );
+
+		// aBoxes must have the same count (and meaning) as in build().
+		void refit( Aabb const* aBoxes );
+
+		// Replaces the contents of aVisible with the indices of the objects
+		// that intersect the frustum.
+		void cull( Frustum const&, std::vector<std::uint32_t>& aVisible ) const;
+
+		std::size_t object_count() const noexcept;
+		std::size_t node_count() const noexcept;
+
+	private:
+		// Slot states; other values are leaves with that many objects.
+		static constexpr std::uint32_t kEmpty_ = 0;
+		static constexpr std::uint32_t kInner_ = ~std::uint32_t(0);
+
+		struct Node_
+		{
+			float minX[4], minY[4], minZ[4];
+			float maxX[4], maxY[4], maxZ[4];
+
+			// Inner: node index. Leaf: first entry in mObjects/mBoxes.
+			std::uint32_t child[4];
+			std::uint32_t count[4];
+		};
+
+		std::uint32_t build_( std::uint32_t aBegin, std::uint32_t aEnd, std::vector<Vec3f> const& aCenters );
+		void set_slot_bounds_( Node_&, std::size_t aSlot, Aabb const& ) noexcept;
+		Aabb node_bounds_( Node_ const& ) const noexcept;
+		void append_subtree_( std::uint32_t aNode, std::vector<std::uint32_t>& ) const;
+
+	private:
+		std::vector<Node_> mNodes; // parents before children
+		std::vector<std::uint32_t> mObjects; // object index, in leaf order
+		std::vector<Aabb> mBoxes; // object bounds, in leaf order
+};
+
+#endif // BVH_HPP_6A0D3E58_F1B2_4C97_8D64_2B9E05C7A1F3
@@ -0,0 +1,143 @@
+#include "culling_validation.hpp"
+
+#include <string>
+#include <algorithm>
+#include <iterator>
+
+#include <cmath>
+
+#include "../vmlib/random.hpp"
+
+#include "../support/error.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kGroups_ = 3;
+
+	// Objects listed per mismatch, at most
+	constexpr std::size_t kListedObjects_ = 8;
+
+	constexpr float kPi_ = 3.1415926f;
+
+	// Objects in aA, but not in aB (both sorted), as "1, 5, 7 (and 3 more)"
+	std::string difference_( std::vector<std::uint32_t> const& aA, std::vector<std::uint32_t> const& aB )
+	{
+		std::vector<std::uint32_t> diff;
+		std::set_difference( aA.begin(), aA.end(), aB.begin(), aB.end(), std::back_inserter( diff ) );
+
+		if( diff.empty() )
+			return "none";
+
+		std::string ret;
+		for( std::size_t i = 0; i < diff.size() && i < kListedObjects_; ++i )
+			ret += (i ? ", " : "") + std::to_string( diff[i] );
+		if( diff.size() > kListedObjects_ )
+			ret += " (and " + std::to_string( diff.size() - kListedObjects_ ) + " more)";
+		return ret;
+	}
+}
+
+CullingValidator::CullingValidator( std::vector<Aabb> aSceneBounds, std::size_t aExtraBoxes, ShaderProgram const& aComputeProgram, std::uint64_t aSeed )
+	: mBounds( std::move(aSceneBounds) )
+	, mCuller( mBounds.size() + aExtraBoxes, kGroups_, aComputeProgram )
+	, mCheckedViews( 0 )
+{
+	Aabb scene = mBounds.empty() ? Aabb{ { -1.f, -1.f, -1.f }, { 1.f, 1.f, 1.f } } : mBounds[0];
+	for( auto const& box : mBounds )
+		scene = merge( scene, box );
+
+	// Boxes of up to 5% of the scene's size, anywhere in it
+	Xoshiro256Plus rng( aSeed );
+	Vec3f const extent = scene.max - scene.min;
+	float const maxHalf = 0.05f * 0.5f * std::max( { extent.x, extent.y, extent.z } );
+
+	for( std::size_t i = 0; i < aExtraBoxes; ++i )
+	{
+		Vec3f const center{
+			scene.min.x + extent.x * rng.uniform_float(),
+			scene.min.y + extent.y * rng.uniform_float(),
+			scene.min.z + extent.z * rng.uniform_float()
+		};
+		Vec3f const half{
+			maxHalf * rng.uniform_float(),
+			maxHalf * rng.uniform_float(),
+			maxHalf * rng.uniform_float()
+		};
+		mBounds.emplace_back( Aabb{ center - half, center + half } );
+	}
+
+	std::vector<GpuDrawObject> objects( mBounds.size() );
+	for( std::size_t i = 0; i < mBounds.size(); ++i )
+		objects[i] = GpuDrawObject{ mBounds[i], kIdentity44f, kIdentity33f, std::uint32_t(i % kGroups_), 0, 3, 0 };
+
+	mCuller.set_objects( objects.data(), objects.size() );
+	mBvh.build( mBounds.data(), mBounds.size() );
+}
+
+void CullingValidator::update_object( std::size_t aIndex, Aabb const& aBounds )
+{
+	mBounds.at( aIndex ) = aBounds;
+	mBvh.refit( mBounds.data() );
+	mCuller.update_object( aIndex, aBounds, kIdentity44f, kIdentity33f );
+}
+
+void CullingValidator::check( Mat44f const& aProjCameraWorld, char const* aView )
+{
+	mCuller.cull( aProjCameraWorld );
+	mCuller.read_back_visible( mGpuVisible );
+
+	auto const frustum = make_frustum( aProjCameraWorld );
+	frustum_cull( frustum, mBounds.data(), mBounds.size(), mCpuVisible );
+
+	mBvh.cull( frustum, mBvhVisible );
+	std::sort( mBvhVisible.begin(), mBvhVisible.end() );
+
+	if( mGpuVisible != mCpuVisible )
+	{
+		throw Error( "Culling validation failed for %s: %zu objects visible on the GPU, %zu with frustum_cull(); only on the GPU: %s; only on the CPU: %s",
+			aView, mGpuVisible.size(), mCpuVisible.size(),
+			difference_( mGpuVisible, mCpuVisible ).c_str(), difference_( mCpuVisible, mGpuVisible ).c_str() );
+	}
+
+	if( mBvhVisible != mCpuVisible )
+	{
+		throw Error( "Culling validation failed for %s: %zu objects visible with Bvh::cull(), %zu with frustum_cull(); only in the BVH: %s; only in frustum_cull(): %s",
+			aView, mBvhVisible.size(), mCpuVisible.size(),
+			difference_( mBvhVisible, mCpuVisible ).c_str(), difference_( mCpuVisible, mBvhVisible ).c_str() );
+	}
+
+	++mCheckedViews;
+}
+
+std::size_t CullingValidator::object_count() const noexcept
+{
+	return mBounds.size();
+}
+std::size_t CullingValidator::checked_views() const noexcept
+{
+	return mCheckedViews;
+}
+
+
+std::vector<Mat44f> make_validation_views( Aabb const& aScene, Mat44f const& aProjection, std::size_t aCount )
+{
+	Vec3f const center = 0.5f * (aScene.min + aScene.max);
+	float const radius = 0.5f * length( aScene.max - aScene.min );
+
+	std::vector<Mat44f> ret;
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		// Looking along (sin phi, 0, -cos phi), slightly up or down, from
+		// either close to the center or the scene's edge
+		float const phi = 2.f * kPi_ * float(i) / float(aCount);
+		float const theta = (i % 2) ? 0.3f : -0.1f;
+		float const distance = (i % 2) ? 0.9f * radius : 0.2f * radius;
+
+		Vec3f const forward{ std::sin( phi ), 0.f, -std::cos( phi ) };
+		Vec3f const position = center - distance * forward;
+
+		ret.emplace_back( aProjection * make_rotation_x( theta ) * make_rotation_y( phi ) * make_translation( -position ) );
+	}
+
+	return ret;
+}
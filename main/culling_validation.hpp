@@ -0,0 +1,68 @@
+#ifndef CULLING_VALIDATION_HPP_5B2E8C47_91D3_4A6F_B0E8_2D7C4F19A365
+#define CULLING_VALIDATION_HPP_5B2E8C47_91D3_4A6F_B0E8_2D7C4F19A365
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../vmlib/mat44.hpp"
+
+#include "bvh.hpp"
+#include "gpu_culling.hpp"
+
+class ShaderProgram;
+
+/** CullingValidator: cross-checks GpuCuller against the CPU cullers
+ *
+ * Holds its own GpuCuller over the scene's objects (aSceneBounds, whose
+ * indices are kept) followed by aExtraBoxes random boxes inside the scene
+ * bounds. The objects are spread over several draw groups, so that both the
+ * frustum test of assets/cull.comp and the packing of its per-group command
+ * ranges are exercised with many objects.
+ *
+ * check() culls one view on the GPU, reads the visible set back and compares
+ * it with frustum_cull() and with Bvh::cull() on the same bounds. It throws
+ * Error on any difference, naming the view and the objects concerned. The
+ * read back stalls, so this is for headless validation runs only (see
+ * --validate-culling).
+ *
+ * Requires a current OpenGL 4.3 context for all methods, including the
+ * constructor and destructor.
+ */
+class CullingValidator final
+{
+	public:
+		CullingValidator(
+			std::vector<Aabb> aSceneBounds,
+			std::size_t aExtraBoxes,
+			ShaderProgram const& aComputeProgram,
+			std::uint64_t aSeed = 0x5eed
+		);
+
+	public:
+		// Moves scene object aIndex
+		void update_object( std::size_t aIndex, Aabb const& aBounds );
+
+		// Throws Error if the visible sets differ. aView names the view in
+		// the message.
+		void check( Mat44f const& aProjCameraWorld, char const* aView );
+
+		std::size_t object_count() const noexcept;
+		std::size_t checked_views() const noexcept;
+
+	private:
+		std::vector<Aabb> mBounds;
+		Bvh mBvh;
+		GpuCuller mCuller;
+
+		std::vector<std::uint32_t> mGpuVisible, mCpuVisible, mBvhVisible;
+		std::size_t mCheckedViews;
+};
+
+// aCount views of aScene through aProjection (projection only), from
+// cameras around its center, alternately inside the scene and at its edge,
+// turned all the way around it. Meant for CullingValidator::check().
+std::vector<Mat44f> make_validation_views( Aabb const& aScene, Mat44f const& aProjection, std::size_t aCount );
+
+#endif // CULLING_VALIDATION_HPP_5B2E8C47_91D3_4A6F_B0E8_2D7C4F19A365
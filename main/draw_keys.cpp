@@ -0,0 +1,105 @@
+#include "draw_keys.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	constexpr unsigned kDepthShift_ = 0;
+	constexpr unsigned kTextureShift_ = kDepthShift_ + kDrawKeyDepthBits;
+	constexpr unsigned kMaterialShift_ = kTextureShift_ + kDrawKeyTextureBits;
+	constexpr unsigned kProgramShift_ = kMaterialShift_ + kDrawKeyMaterialBits;
+	constexpr unsigned kPassShift_ = kProgramShift_ + kDrawKeyProgramBits;
+
+	constexpr std::uint64_t mask_( unsigned aBits ) noexcept
+	{
+		return (std::uint64_t(1) << aBits) - 1;
+	}
+
+	constexpr unsigned kDigitBits_ = 8;
+	constexpr unsigned kDigits_ = 64 / kDigitBits_;
+	constexpr std::size_t kBuckets_ = std::size_t(1) << kDigitBits_;
+}
+
+std::uint64_t make_draw_key( unsigned aPass, unsigned aProgram, unsigned aMaterial, unsigned aTexture, float aDepth ) noexcept
+{
+	assert( aPass <= mask_( kDrawKeyPassBits ) );
+	assert( aProgram <= mask_( kDrawKeyProgramBits ) );
+	assert( aMaterial <= mask_( kDrawKeyMaterialBits ) );
+	assert( aTexture <= mask_( kDrawKeyTextureBits ) );
+
+	float const depth = std::clamp( aDepth, 0.f, 1.f );
+	auto const qdepth = std::uint64_t( depth * float(mask_( kDrawKeyDepthBits )) );
+
+	return (std::uint64_t(aPass) << kPassShift_)
+		| (std::uint64_t(aProgram) << kProgramShift_)
+		| (std::uint64_t(aMaterial) << kMaterialShift_)
+		| (std::uint64_t(aTexture) << kTextureShift_)
+		| (qdepth << kDepthShift_)
+	;
+}
+
+unsigned draw_key_pass( std::uint64_t aKey ) noexcept
+{
+	return unsigned((aKey >> kPassShift_) & mask_( kDrawKeyPassBits ));
+}
+unsigned draw_key_program( std::uint64_t aKey ) noexcept
+{
+	return unsigned((aKey >> kProgramShift_) & mask_( kDrawKeyProgramBits ));
+}
+unsigned draw_key_material( std::uint64_t aKey ) noexcept
+{
+	return unsigned((aKey >> kMaterialShift_) & mask_( kDrawKeyMaterialBits ));
+}
+unsigned draw_key_texture( std::uint64_t aKey ) noexcept
+{
+	return unsigned((aKey >> kTextureShift_) & mask_( kDrawKeyTextureBits ));
+}
+
+void radix_sort_draw_keys( std::vector<DrawKeyEntry>& aEntries, std::vector<DrawKeyEntry>& aScratch )
+{
+	auto const count = aEntries.size();
+	if( count < 2 )
+		return;
+
+	// Histograms for all digits in a single pass over the keys
+	std::size_t hist[kDigits_][kBuckets_] = {};
+	for( auto const& entry : aEntries )
+	{
+		for( unsigned d = 0; d < kDigits_; ++d )
+			++hist[d][(entry.key >> (d*kDigitBits_)) & (kBuckets_-1)];
+	}
+
+	aScratch.resize( count );
+
+	auto* src = &aEntries;
+	auto* dst = &aScratch;
+	for( unsigned d = 0; d < kDigits_; ++d )
+	{
+		auto& h = hist[d];
+
+		// All keys have the same digit? Then this pass would not change the
+		// order.
+		auto const first = (aEntries[0].key >> (d*kDigitBits_)) & (kBuckets_-1);
+		if( h[first] == count )
+			continue;
+
+		// Exclusive prefix sum -> start offset of each bucket
+		std::size_t sum = 0;
+		for( auto& bucket : h )
+		{
+			auto const n = bucket;
+			bucket = sum;
+			sum += n;
+		}
+
+		for( auto const& entry : *src )
+			(*dst)[h[(entry.key >> (d*kDigitBits_)) & (kBuckets_-1)]++] = entry;
+
+		std::swap( src, dst );
+	}
+
+	if( src != &aEntries )
+		aEntries.swap( aScratch );
+}
@@ -0,0 +1,53 @@
+#ifndef DRAW_KEYS_HPP_4F81B2C7_6E3A_4D05_9C1E_8B27F0D6A953
+#define DRAW_KEYS_HPP_4F81B2C7_6E3A_4D05_9C1E_8B27F0D6A953
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+/** Draw keys: 64-bit sort keys for the render queue
+ *
+ * Sorting draws by a single integer groups them by the state that is most
+ * expensive to change. From the most significant bit down, a key holds
+ *
+ *   pass     4 bits   render pass (e.g. opaque before transparent)
+ *   program 12 bits   shader program
+ *   material 12 bits  material (uniform values)
+ *   texture 12 bits   texture
+ *   depth   24 bits   quantized view depth in [0,1]
+ *
+ * Program, material and texture are small ids (not GL names), assigned by the
+ * render queue. Within a pass, draws with identical state end up next to each
+ * other, and are ordered front to back (for early-z). For back-to-front
+ * ordering, pass 1-depth.
+ */
+constexpr unsigned kDrawKeyPassBits = 4;
+constexpr unsigned kDrawKeyProgramBits = 12;
+constexpr unsigned kDrawKeyMaterialBits = 12;
+constexpr unsigned kDrawKeyTextureBits = 12;
+constexpr unsigned kDrawKeyDepthBits = 24;
+
+static_assert( kDrawKeyPassBits + kDrawKeyProgramBits + kDrawKeyMaterialBits + kDrawKeyTextureBits + kDrawKeyDepthBits == 64 );
+
+std::uint64_t make_draw_key( unsigned aPass, unsigned aProgram, unsigned aMaterial, unsigned aTexture, float aDepth ) noexcept;
+
+unsigned draw_key_pass( std::uint64_t ) noexcept;
+unsigned draw_key_program( std::uint64_t ) noexcept;
+unsigned draw_key_material( std::uint64_t ) noexcept;
+unsigned draw_key_texture( std::uint64_t ) noexcept;
+
+// Key with the index of the item it belongs to
+struct DrawKeyEntry
+{
+	std::uint64_t key;
+	std::uint32_t item;
+};
+
+// Sorts aEntries by key with a least-significant-digit radix sort (8 bits
+// per pass). The sort is stable. Passes where all keys share the same digit
+// are skipped, so keys that only differ in a few fields sort quickly.
+// aScratch is resized as needed; keep it around to avoid reallocation.
+void radix_sort_draw_keys( std::vector<DrawKeyEntry>& aEntries, std::vector<DrawKeyEntry>& aScratch );
+
+#endif // DRAW_KEYS_HPP_4F81B2C7_6E3A_4D05_9C1E_8B27F0D6A953
@@ -0,0 +1,153 @@
+#include "draw_list.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#include "../support/error.hpp"
+#include "../support/profiler.hpp"
+
+namespace
+{
+	bool same_( Vec3f aA, Vec3f aB ) noexcept
+	{
+		return aA.x == aB.x && aA.y == aB.y && aA.z == aB.z;
+	}
+	bool same_( RenderMaterial const& aA, RenderMaterial const& aB ) noexcept
+	{
+		return same_( aA.diffuse, aB.diffuse )
+			&& same_( aA.ambient, aB.ambient )
+		;
+	}
+	bool same_( RenderTransform const& aA, RenderTransform const& aB ) noexcept
+	{
+		return 0 == std::memcmp( aA.model2World.v, aB.model2World.v, sizeof(aA.model2World.v) )
+			&& 0 == std::memcmp( aA.normalMatrix.v, aB.normalMatrix.v, sizeof(aA.normalMatrix.v) )
+		;
+	}
+}
+
+DrawList::DrawList( std::size_t aMaxMaterials )
+	: mSorted( true )
+	, mMaxMaterials( aMaxMaterials )
+	, mFrame( 0 )
+{
+	assert( mMaxMaterials > 0 && mMaxMaterials <= (std::size_t(1) << kDrawKeyMaterialBits) );
+}
+
+std::uint32_t DrawList::add_material( RenderMaterial const& aMaterial )
+{
+	// There are only ever a handful of materials per frame, so a linear
+	// search is fine.
+	for( std::size_t i = 0; i < mMaterials.size(); ++i )
+	{
+		if( same_( mMaterials[i], aMaterial ) )
+			return std::uint32_t(i);
+	}
+
+	if( mMaterials.size() >= mMaxMaterials )
+		throw Error( "DrawList: more than %zu materials in a frame", mMaxMaterials );
+
+	mMaterials.emplace_back( aMaterial );
+	return std::uint32_t(mMaterials.size()-1);
+}
+
+std::uint32_t DrawList::add_transform( RenderTransform const& aTransform )
+{
+	if( !mTransforms.empty() && same_( mTransforms.back(), aTransform ) )
+		return std::uint32_t(mTransforms.size()-1);
+
+	mTransforms.emplace_back( aTransform );
+	return std::uint32_t(mTransforms.size()-1);
+}
+
+void DrawList::submit( DrawItem const& aItem, RenderPass aPass, float aDepth )
+{
+	assert( aItem.material < mMaterials.size() );
+	assert( aItem.transform < mTransforms.size() );
+
+	auto const program = compact_id_( mProgramIds, aItem.program, kDrawKeyProgramBits );
+	auto const texture = compact_id_( mTextureIds, aItem.texture, kDrawKeyTextureBits );
+
+	auto const key = make_draw_key( unsigned(aPass), program, aItem.material, texture, aDepth );
+
+	mKeys.emplace_back( DrawKeyEntry{ key, std::uint32_t(mItems.size()) } );
+	mItems.emplace_back( aItem );
+	mSorted = false;
+}
+
+void DrawList::sort()
+{
+	if( mSorted )
+		return;
+
+	PROFILE_SCOPE( "draw list sort" );
+	radix_sort_draw_keys( mKeys, mScratch );
+	mSorted = true;
+}
+bool DrawList::sorted() const noexcept
+{
+	return mSorted;
+}
+
+void DrawList::clear() noexcept
+{
+	mItems.clear();
+	mKeys.clear();
+	mMaterials.clear();
+	mTransforms.clear();
+	mSorted = true;
+	++mFrame;
+}
+
+std::size_t DrawList::size() const noexcept
+{
+	return mItems.size();
+}
+bool DrawList::empty() const noexcept
+{
+	return mItems.empty();
+}
+
+DrawItem const& DrawList::sorted_item( std::size_t aIndex ) const noexcept
+{
+	assert( mSorted && aIndex < mKeys.size() );
+	return mItems[mKeys[aIndex].item];
+}
+
+std::vector<RenderMaterial> const& DrawList::materials() const noexcept
+{
+	return mMaterials;
+}
+std::vector<RenderTransform> const& DrawList::transforms() const noexcept
+{
+	return mTransforms;
+}
+
+unsigned DrawList::compact_id_( std::vector<IdSlot_>& aIds, GLuint aName, unsigned aBits )
+{
+	auto const it = std::find_if( aIds.begin(), aIds.end(), [&] (IdSlot_ const& aSlot) { return aSlot.name == aName; } );
+	if( aIds.end() != it )
+	{
+		it->lastUsed = mFrame;
+		return unsigned(it - aIds.begin());
+	}
+
+	if( aIds.size() < (std::size_t(1) << aBits) )
+	{
+		aIds.emplace_back( IdSlot_{ aName, mFrame } );
+		return unsigned(aIds.size()-1);
+	}
+
+	// Full: reuse the least recently used id, unless all are in use by
+	// this frame's draws.
+	auto const lru = std::min_element( aIds.begin(), aIds.end(), [] (IdSlot_ const& aA, IdSlot_ const& aB) {
+		return aA.lastUsed < aB.lastUsed;
+	} );
+	if( lru->lastUsed == mFrame )
+		throw Error( "DrawList: out of draw key ids (%zu in use by this frame)", aIds.size() );
+
+	*lru = IdSlot_{ aName, mFrame };
+	return unsigned(lru - aIds.begin());
+}
@@ -0,0 +1,135 @@
+#ifndef DRAW_LIST_HPP_5A9E0C37_B214_4E68_8D3F_71C6A2E9B40D
+#define DRAW_LIST_HPP_5A9E0C37_B214_4E68_8D3F_71C6A2E9B40D
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat33.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "draw_keys.hpp"
+
+// Surface reflectances, shared by draws. Provided to the shaders through the
+// MaterialData uniform block (see uniform_blocks.hpp).
+struct RenderMaterial
+{
+	Vec3f diffuse;
+	Vec3f ambient;
+};
+
+// Per-draw transforms, uploaded to the uniform locations 0 (model to world)
+// and 1 (normal matrix). Camera and light are per-frame data in the
+// FrameData uniform block, which the caller binds.
+struct RenderTransform
+{
+	Mat44f model2World;
+	Mat33f normalMatrix;
+};
+
+struct DrawItem
+{
+	GLuint program;
+	GLuint vao;
+	GLuint texture; // bound to unit 0; 0 = none
+
+	std::uint32_t material;  // from DrawList::add_material()
+	std::uint32_t transform; // from DrawList::add_transform()
+
+	GLenum mode;
+	GLint first;
+	GLsizei count;
+	GLsizei instanceCount = 1; // > 1 draws with glDrawArraysInstanced()
+
+	// Indexed draws read count GL_UNSIGNED_INT indices from the VAO's element
+	// buffer, starting at index first, and add baseVertex to each (as for
+	// meshes in a GeometryHeap).
+	bool indexed = false;
+	GLint baseVertex = 0;
+};
+
+enum class RenderPass : unsigned
+{
+	opaque = 0,
+	transparent = 1
+};
+
+/** DrawList: the draws of one frame, ready for a RenderQueue
+ *
+ * Collects materials, transforms and draws, and sorts the draws by their
+ * 64-bit draw key (see draw_keys.hpp). Identical materials and consecutive
+ * identical transforms are merged when they are added, so draws that share
+ * them also share the upload.
+ *
+ * A DrawList makes no OpenGL calls. It can thus be built and sorted on any
+ * thread, while a RenderQueue on the GL thread executes a different list
+ * (see FramePipeline). A single list must not be used by several threads at
+ * once.
+ *
+ * clear() keeps the allocations and the GL name -> id tables of the draw
+ * keys, so that keys (and thus the draw order) are stable across frames.
+ * Names come and go, e.g., when shaders are reloaded. Once a table is full,
+ * a new name takes over the id of the least recently used one, so that only
+ * more distinct names than there are ids within a single frame are an
+ * error.
+ */
+class DrawList final
+{
+	public:
+		explicit DrawList( std::size_t aMaxMaterials = 256 );
+
+	public:
+		std::uint32_t add_material( RenderMaterial const& );
+		std::uint32_t add_transform( RenderTransform const& );
+
+		// aDepth is the view depth of the draw, normalized to [0,1].
+		void submit( DrawItem const&, RenderPass = RenderPass::opaque, float aDepth = 0.f );
+
+		// Sorts the draws by key; stable for equal keys. Submitting again
+		// undoes this.
+		void sort();
+		bool sorted() const noexcept;
+
+		void clear() noexcept;
+
+		std::size_t size() const noexcept;
+		bool empty() const noexcept;
+
+		// The aIndex-th draw in key order. Requires sorted().
+		DrawItem const& sorted_item( std::size_t aIndex ) const noexcept;
+
+		std::vector<RenderMaterial> const& materials() const noexcept;
+		std::vector<RenderTransform> const& transforms() const noexcept;
+
+	private:
+		struct IdSlot_
+		{
+			GLuint name;
+			std::uint64_t lastUsed; // mFrame
+		};
+
+		unsigned compact_id_( std::vector<IdSlot_>&, GLuint, unsigned aBits );
+
+	private:
+		std::vector<DrawItem> mItems;
+		std::vector<DrawKeyEntry> mKeys;
+		std::vector<DrawKeyEntry> mScratch;
+		bool mSorted;
+
+		std::vector<RenderMaterial> mMaterials;
+		std::size_t mMaxMaterials;
+
+		std::vector<RenderTransform> mTransforms;
+
+		// GL name -> small id (the slot index) for the draw keys.
+		// Persistent across frames.
+		std::vector<IdSlot_> mProgramIds;
+		std::vector<IdSlot_> mTextureIds;
+		std::uint64_t mFrame; // clear() calls
+};
+
+#endif // DRAW_LIST_HPP_5A9E0C37_B214_4E68_8D3F_71C6A2E9B40D
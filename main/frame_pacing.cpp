@@ -0,0 +1,116 @@
+#include "frame_pacing.hpp"
+
+#include <thread>
+
+#include <cassert>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	struct PacingName_
+	{
+		FramePacing pacing;
+		char const* name;
+	};
+
+	constexpr PacingName_ kPacingNames_[] = {
+		{ FramePacing::vsync, "vsync" },
+		{ FramePacing::uncapped, "uncapped" },
+		{ FramePacing::fixed, "fixed" },
+		{ FramePacing::lowLatency, "latency" }
+	};
+}
+
+char const* frame_pacing_name( FramePacing aPacing ) noexcept
+{
+	for( auto const& entry : kPacingNames_ )
+	{
+		if( entry.pacing == aPacing )
+			return entry.name;
+	}
+
+	assert( false );
+	return "?";
+}
+
+FramePacing parse_frame_pacing( char const* aName )
+{
+	assert( aName );
+	for( auto const& entry : kPacingNames_ )
+	{
+		if( 0 == std::strcmp( entry.name, aName ) )
+			return entry.pacing;
+	}
+
+	throw Error( "Unknown frame pacing '%s' (expected vsync, uncapped, fixed or latency)", aName );
+}
+
+bool frame_pacing_vsync( FramePacing aPacing ) noexcept
+{
+	return FramePacing::vsync == aPacing || FramePacing::lowLatency == aPacing;
+}
+
+FramePacing next_frame_pacing( FramePacing aPacing ) noexcept
+{
+	switch( aPacing )
+	{
+		case FramePacing::vsync: return FramePacing::uncapped;
+		case FramePacing::uncapped: return FramePacing::fixed;
+		case FramePacing::fixed: return FramePacing::lowLatency;
+		case FramePacing::lowLatency: return FramePacing::vsync;
+	}
+
+	return FramePacing::vsync;
+}
+
+
+FrameLimiter::FrameLimiter( double aFramesPerSecond, Clock::duration aSpinThreshold )
+	: mPeriod( std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / aFramesPerSecond ) ) )
+	, mSpinThreshold( aSpinThreshold )
+	, mStarted( false )
+{
+	assert( aFramesPerSecond > 0.0 );
+}
+
+FrameLimiter::Clock::duration FrameLimiter::wait()
+{
+	auto const begin = Clock::now();
+	if( !mStarted )
+	{
+		mDeadline = begin + mPeriod;
+		mStarted = true;
+		return Clock::duration::zero();
+	}
+
+	// Too late for this period (and then some): start over from here
+	if( begin >= mDeadline + mPeriod )
+	{
+		mDeadline = begin + mPeriod;
+		return Clock::duration::zero();
+	}
+
+	if( mDeadline - begin > mSpinThreshold )
+		std::this_thread::sleep_until( mDeadline - mSpinThreshold );
+
+	auto now = Clock::now();
+	while( now < mDeadline )
+	{
+		std::this_thread::yield();
+		now = Clock::now();
+	}
+
+	mDeadline += mPeriod;
+	return now - begin;
+}
+
+void FrameLimiter::reset() noexcept
+{
+	mStarted = false;
+}
+
+FrameLimiter::Clock::duration FrameLimiter::period() const noexcept
+{
+	return mPeriod;
+}
@@ -0,0 +1,70 @@
+#ifndef FRAME_PACING_HPP_AF4BC882_8DFB_49EE_8EA1_791C156B7304
+#define FRAME_PACING_HPP_AF4BC882_8DFB_49EE_8EA1_791C156B7304
+
+#include <chrono>
+
+// How the main loop paces its frames
+enum class FramePacing
+{
+	vsync, // swap interval 1; presentation blocks until the next refresh
+	uncapped, // swap interval 0 and no limiter; as fast as possible
+	fixed, // swap interval 0, FrameLimiter at a target rate
+	lowLatency // V-Sync, but inputs are sampled only once the GPU has
+	           // finished the previous frame, so that no frames queue up,
+	           // and the frame is built and submitted without lookahead
+};
+
+// "vsync", "uncapped", "fixed" and "latency"
+char const* frame_pacing_name( FramePacing ) noexcept;
+
+// Inverse of frame_pacing_name(). Throws Error on unknown names.
+FramePacing parse_frame_pacing( char const* aName );
+
+// Whether presentation waits for the display's refresh (swap interval 1)
+bool frame_pacing_vsync( FramePacing ) noexcept;
+
+// The mode after this one, in the order of the enum, for cycling at runtime
+FramePacing next_frame_pacing( FramePacing ) noexcept;
+
+
+/** FrameLimiter: caps the frame rate with a hybrid sleep-then-spin wait
+ *
+ * Sleeping alone overshoots the deadline by the scheduler's granularity,
+ * which can be a millisecond or more; spinning alone burns a core. wait()
+ * therefore sleeps until aSpinThreshold before the deadline and yields in a
+ * loop for the rest.
+ *
+ * Deadlines advance by exactly one period, so that an early or late frame
+ * does not shift the following ones and the average rate is exact. A frame
+ * that runs late by more than a whole period restarts the schedule from now,
+ * instead of letting the next frames catch up without waiting.
+ */
+class FrameLimiter final
+{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+	public:
+		explicit FrameLimiter( double aFramesPerSecond, Clock::duration aSpinThreshold = std::chrono::milliseconds(2) );
+
+	public:
+		// Waits until the end of the current frame period. The first call
+		// starts the schedule and returns immediately. Returns the time
+		// spent waiting.
+		Clock::duration wait();
+
+		// Restarts the schedule with the next wait(), e.g., after a change of
+		// pacing mode.
+		void reset() noexcept;
+
+		Clock::duration period() const noexcept;
+
+	private:
+		Clock::duration mPeriod;
+		Clock::duration mSpinThreshold;
+
+		Clock::time_point mDeadline;
+		bool mStarted;
+};
+
+#endif // FRAME_PACING_HPP_AF4BC882_8DFB_49EE_8EA1_791C156B7304
@@ -0,0 +1,199 @@
+#ifndef FRAME_PIPELINE_HPP_C4E17A93_2B06_4D8E_9F51_3A7D06B2E8C4
+#define FRAME_PIPELINE_HPP_C4E17A93_2B06_4D8E_9F51_3A7D06B2E8C4
+
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include <cassert>
+#include <cstdint>
+
+#include "../support/profiler.hpp"
+
+/** FramePipeline: build frame N+1 on a thread while frame N is submitted
+ *
+ * The per-frame work is split into a build stage (simulation readout,
+ * culling, draw list construction; no OpenGL) and a submit stage (uploads and
+ * draws). The build stage runs on the pipeline's own thread, the submit stage
+ * on the GL thread. Two frame slots are double-buffered between them: while
+ * the GL thread submits one, the build thread fills the other. Frame time
+ * thus approaches the longer of the two stages instead of their sum, at the
+ * cost of one frame of extra latency.
+ *
+ * The GL thread drives the pipeline:
+ *
+ *   next() = inputs;  kick();          // frame 0
+ *   loop:
+ *     next() = inputs;  kick();        // frame N+1 starts building
+ *     auto& frame = acquire();         // frame N, waits until built
+ *     submit( frame );
+ *     release();
+ *
+ * next() is the slot for the frame to be built next. The GL thread fills in
+ * the inputs of the frame (e.g., camera and input state) before kick(),
+ * which hands the slot to the build thread. acquire() waits for the oldest
+ * kicked frame, and release() makes its slot available to next() again.
+ * Frames are built and acquired in the order in which they were kicked.
+ *
+ * At most two frames may be in flight: kick() requires the slot from two
+ * frames back to have been released.
+ *
+ * The lookahead is optional. To submit a frame built from the inputs just
+ * sampled (e.g., for low-latency pacing), kick() only when nothing is
+ * in_flight(), and acquire() that frame right away; the GL thread then waits
+ * for its build. Frames kicked earlier are acquired first, so switching
+ * between the two modes needs no draining.
+ *
+ * An exception thrown by the build function is rethrown by the acquire()
+ * of that frame. Slots are reused, so a tFrame holding e.g. std::vector keeps
+ * its allocations.
+ */
+template< typename tFrame >
+class FramePipeline final
+{
+	public:
+		using BuildFn = std::function<void(tFrame&)>;
+
+	public:
+		explicit FramePipeline( BuildFn aBuild )
+			: mBuild( std::move(aBuild) )
+		{
+			mThread = std::thread( [this] { thread_main_(); } );
+		}
+
+		~FramePipeline()
+		{
+			{
+				std::unique_lock<std::mutex> lock( mMutex );
+				mQuit = true;
+			}
+			mWake.notify_all();
+			mThread.join();
+		}
+
+		FramePipeline( FramePipeline const& ) = delete;
+		FramePipeline& operator= (FramePipeline const&) = delete;
+
+	public:
+		tFrame& next() noexcept
+		{
+			assert( kFree_ == mState[mKicked % 2] );
+			return mSlots[mKicked % 2];
+		}
+
+		void kick()
+		{
+			{
+				std::unique_lock<std::mutex> lock( mMutex );
+				assert( kFree_ == mState[mKicked % 2] );
+				mState[mKicked % 2] = kQueued_;
+				++mKicked;
+			}
+			mWake.notify_all();
+		}
+
+		tFrame& acquire()
+		{
+			assert( mAcquired < mKicked );
+			auto const slot = mAcquired % 2;
+
+			PROFILE_SCOPE( "wait for frame build" );
+
+			std::unique_lock<std::mutex> lock( mMutex );
+			mDone.wait( lock, [&] { return kBuilt_ == mState[slot]; } );
+
+			if( mError[slot] )
+			{
+				auto error = std::exchange( mError[slot], nullptr );
+				mState[slot] = kFree_;
+				++mAcquired;
+				std::rethrow_exception( error );
+			}
+
+			mState[slot] = kAcquired_;
+			return mSlots[slot];
+		}
+
+		void release() noexcept
+		{
+			auto const slot = mAcquired % 2;
+
+			std::unique_lock<std::mutex> lock( mMutex );
+			assert( kAcquired_ == mState[slot] );
+			mState[slot] = kFree_;
+			++mAcquired;
+		}
+
+		// Number of frames kicked so far
+		std::uint64_t frames() const noexcept
+		{
+			return mKicked;
+		}
+
+		// Frames kicked, but not yet acquired
+		std::uint64_t in_flight() const noexcept
+		{
+			return mKicked - mAcquired;
+		}
+
+	private:
+		void thread_main_()
+		{
+			PROFILE_THREAD( "frame build" );
+
+			for( std::uint64_t frame = 0;; ++frame )
+			{
+				auto const slot = frame % 2;
+				{
+					std::unique_lock<std::mutex> lock( mMutex );
+					mWake.wait( lock, [&] { return mQuit || kQueued_ == mState[slot]; } );
+
+					// Finish queued frames before quitting, so that nothing
+					// is left half-built.
+					if( kQueued_ != mState[slot] )
+						return;
+				}
+
+				try
+				{
+					PROFILE_SCOPE( "build frame" );
+					mBuild( mSlots[slot] );
+				}
+				catch( ... )
+				{
+					mError[slot] = std::current_exception();
+				}
+
+				{
+					std::unique_lock<std::mutex> lock( mMutex );
+					mState[slot] = kBuilt_;
+				}
+				mDone.notify_all();
+			}
+		}
+
+	private:
+		enum State_ { kFree_, kQueued_, kBuilt_, kAcquired_ };
+
+		BuildFn mBuild;
+
+		tFrame mSlots[2];
+		State_ mState[2] = { kFree_, kFree_ }; // protected by mMutex
+		std::exception_ptr mError[2];
+
+		// GL thread only
+		std::uint64_t mKicked = 0;
+		std::uint64_t mAcquired = 0;
+
+		std::mutex mMutex;
+		std::condition_variable mWake; // a frame was queued, or quit
+		std::condition_variable mDone; // a frame was built
+		bool mQuit = false;
+
+		std::thread mThread;
+};
+
+#endif // FRAME_PIPELINE_HPP_C4E17A93_2B06_4D8E_9F51_3A7D06B2E8C4
@@ -0,0 +1,181 @@
+#include "geometry_heap.hpp"
+
+#include <vector>
+#include <unordered_map>
+
+#include <cassert>
+#include <cstring>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	constexpr GLuint kVertexBinding_ = 0;
+
+	template< typename tVertex >
+	struct VertexHash_
+	{
+		std::size_t operator() (tVertex const& aV) const noexcept
+		{
+			// FNV-1a over the bytes; vertices have no padding.
+			unsigned char bytes[sizeof(tVertex)];
+			std::memcpy( bytes, &aV, sizeof(tVertex) );
+
+			std::size_t h = 1469598103934665603ull;
+			for( auto b : bytes )
+				h = (h ^ b) * 1099511628211ull;
+			return h;
+		}
+	};
+
+	template< typename tVertex >
+	struct VertexEqual_
+	{
+		bool operator() (tVertex const& aA, tVertex const& aB) const noexcept
+		{
+			return 0 == std::memcmp( &aA, &aB, sizeof(tVertex) );
+		}
+	};
+}
+
+GeometryHeap::GeometryHeap( std::size_t aMaxVertices, std::size_t aMaxIndices )
+	: mVertexSpace( aMaxVertices )
+	, mIndexSpace( aMaxIndices )
+	, mVertexBuffer( 0 )
+	, mIndexBuffer( 0 )
+	, mVao( 0 )
+{
+	glGenBuffers( 1, &mVertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+	glBufferStorage( GL_ARRAY_BUFFER, aMaxVertices * sizeof(Vertex_), nullptr, GL_DYNAMIC_STORAGE_BIT );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	glGenVertexArrays( 1, &mVao );
+	glBindVertexArray( mVao );
+
+	glVertexAttribFormat( 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex_,position) );
+	glVertexAttribFormat( 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex_,color) );
+	glVertexAttribFormat( 2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex_,normal) );
+	glVertexAttribFormat( 3, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex_,texcoord) );
+	for( GLuint i = 0; i < 4; ++i )
+	{
+		glVertexAttribBinding( i, kVertexBinding_ );
+		glEnableVertexAttribArray( i );
+	}
+	glBindVertexBuffer( kVertexBinding_, mVertexBuffer, 0, sizeof(Vertex_) );
+
+	// The element buffer binding is VAO state.
+	glGenBuffers( 1, &mIndexBuffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer );
+	glBufferStorage( GL_ELEMENT_ARRAY_BUFFER, aMaxIndices * sizeof(std::uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+GeometryHeap::~GeometryHeap()
+{
+	glDeleteVertexArrays( 1, &mVao );
+	glDeleteBuffers( 1, &mIndexBuffer );
+	glDeleteBuffers( 1, &mVertexBuffer );
+}
+
+GeometryRange GeometryHeap::add( SimpleMeshData const& aMesh )
+{
+	auto const count = aMesh.positions.size();
+	assert( aMesh.colors.empty() || aMesh.colors.size() == count );
+	assert( aMesh.normals.empty() || aMesh.normals.size() == count );
+	assert( aMesh.textureCoords.empty() || aMesh.textureCoords.size() == count );
+
+	if( 0 == count )
+		return GeometryRange{ 0, 0, 0, 0 };
+
+	// Merge identical vertices
+	std::vector<Vertex_> vertices;
+	std::vector<std::uint32_t> indices;
+	std::unordered_map<Vertex_,std::uint32_t,VertexHash_<Vertex_>,VertexEqual_<Vertex_>> unique;
+
+	vertices.reserve( count );
+	indices.reserve( count );
+	unique.reserve( count );
+
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		Vertex_ v{};
+		auto const& p = aMesh.positions[i];
+		v.position[0] = p.x; v.position[1] = p.y; v.position[2] = p.z;
+		if( !aMesh.colors.empty() )
+		{
+			auto const& c = aMesh.colors[i];
+			v.color[0] = c.x; v.color[1] = c.y; v.color[2] = c.z;
+		}
+		if( !aMesh.normals.empty() )
+		{
+			auto const& n = aMesh.normals[i];
+			v.normal[0] = n.x; v.normal[1] = n.y; v.normal[2] = n.z;
+		}
+		if( !aMesh.textureCoords.empty() )
+		{
+			auto const& t = aMesh.textureCoords[i];
+			v.texcoord[0] = t.x; v.texcoord[1] = t.y;
+		}
+
+		auto const [it, inserted] = unique.emplace( v, std::uint32_t(vertices.size()) );
+		if( inserted )
+			vertices.emplace_back( v );
+		indices.emplace_back( it->second );
+	}
+
+	auto const firstVertex = mVertexSpace.allocate( vertices.size() );
+	if( RangeAllocator::kInvalid == firstVertex )
+		throw Error( "GeometryHeap: no room for %zu vertices (%zu free)", vertices.size(), mVertexSpace.free_space() );
+
+	auto const firstIndex = mIndexSpace.allocate( indices.size() );
+	if( RangeAllocator::kInvalid == firstIndex )
+	{
+		mVertexSpace.release( firstVertex, vertices.size() );
+		throw Error( "GeometryHeap: no room for %zu indices (%zu free)", indices.size(), mIndexSpace.free_space() );
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer );
+	glBufferSubData( GL_ARRAY_BUFFER, GLintptr(firstVertex * sizeof(Vertex_)), vertices.size() * sizeof(Vertex_), vertices.data() );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	// Not via GL_ELEMENT_ARRAY_BUFFER, which would change the bound VAO.
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mIndexBuffer );
+	glBufferSubData( GL_COPY_WRITE_BUFFER, GLintptr(firstIndex * sizeof(std::uint32_t)), indices.size() * sizeof(std::uint32_t), indices.data() );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	return GeometryRange{
+		std::uint32_t(firstVertex),
+		std::uint32_t(vertices.size()),
+		std::uint32_t(firstIndex),
+		std::uint32_t(indices.size())
+	};
+}
+
+void GeometryHeap::remove( GeometryRange const& aRange )
+{
+	if( 0 == aRange.indexCount )
+		return;
+
+	mVertexSpace.release( aRange.firstVertex, aRange.vertexCount );
+	mIndexSpace.release( aRange.firstIndex, aRange.indexCount );
+}
+
+GLuint GeometryHeap::vao() const noexcept
+{
+	return mVao;
+}
+
+std::size_t GeometryHeap::free_vertices() const noexcept
+{
+	return mVertexSpace.free_space();
+}
+std::size_t GeometryHeap::free_indices() const noexcept
+{
+	return mIndexSpace.free_space();
+}
@@ -0,0 +1,77 @@
+#ifndef GEOMETRY_HEAP_HPP_3B9E71D2_84C5_4F0A_B6D3_E25A07C91F48
+#define GEOMETRY_HEAP_HPP_3B9E71D2_84C5_4F0A_B6D3_E25A07C91F48
+
+#include <glad.h>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "simple_mesh.hpp"
+#include "range_allocator.hpp"
+
+// Location of a mesh in a GeometryHeap
+struct GeometryRange
+{
+	std::uint32_t firstVertex; // base vertex for indexed draws
+	std::uint32_t vertexCount;
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+};
+
+/** GeometryHeap: static meshes in shared vertex and index buffers
+ *
+ * All meshes live in one vertex buffer and one index buffer, sub-allocated
+ * with a RangeAllocator, and share a single VAO. Meshes in the heap can thus
+ * be drawn without VAO changes, and draws with otherwise identical state
+ * can be combined into a single glMultiDrawElementsIndirect() call (see
+ * RenderQueue).
+ *
+ * Vertices are interleaved with the attribute locations of create_vao():
+ * 0 position, 1 color, 2 normal, 3 texture coordinates. Missing attributes
+ * are zero. add() merges identical vertices and draws the mesh with 32-bit
+ * indices relative to firstVertex.
+ *
+ * Requires a current OpenGL 4.3 context for all methods, including the
+ * constructor and destructor.
+ */
+class GeometryHeap final
+{
+	public:
+		GeometryHeap( std::size_t aMaxVertices, std::size_t aMaxIndices );
+		~GeometryHeap();
+
+		GeometryHeap( GeometryHeap const& ) = delete;
+		GeometryHeap& operator= (GeometryHeap const&) = delete;
+
+	public:
+		// Uploads the triangles of a mesh. Throws if the heap is out of
+		// space.
+		GeometryRange add( SimpleMeshData const& );
+
+		// Frees the space of a mesh. Draws that are still in flight may keep
+		// reading it; the GL orders later uploads after them.
+		void remove( GeometryRange const& );
+
+		GLuint vao() const noexcept;
+
+		std::size_t free_vertices() const noexcept;
+		std::size_t free_indices() const noexcept;
+
+	private:
+		struct Vertex_
+		{
+			float position[3];
+			float color[3];
+			float normal[3];
+			float texcoord[2];
+		};
+
+		RangeAllocator mVertexSpace;
+		RangeAllocator mIndexSpace;
+
+		GLuint mVertexBuffer;
+		GLuint mIndexBuffer;
+		GLuint mVao;
+};
+
+#endif // GEOMETRY_HEAP_HPP_3B9E71D2_84C5_4F0A_B6D3_E25A07C91F48
@@ -0,0 +1,286 @@
+#include "gpu_culling.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/program.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	// Must match local_size_x in assets/cull.comp
+	constexpr GLuint kWorkGroupSize_ = 64;
+
+	// Binding points, see assets/cull.comp
+	constexpr GLuint kBindingObjects_ = 0;
+	constexpr GLuint kBindingCommands_ = 1;
+	constexpr GLuint kBindingCounts_ = 2;
+	constexpr GLuint kBindingGroups_ = 3;
+
+	// Vertex buffer binding index for the object ids in attached VAOs
+	constexpr GLuint kObjectIdBinding_ = 4;
+
+	// Layout of the indirect command consumed by glMultiDrawElementsIndirect()
+	struct DrawElementsIndirectCommand_
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	void clear_buffer_( GLuint aBuffer, std::size_t aBytes )
+	{
+		if( 0 == aBytes )
+			return;
+
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, aBuffer );
+		glClearBufferSubData( GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, GLsizeiptr(aBytes), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr );
+	}
+}
+
+GpuCuller::GpuCuller( std::size_t aMaxObjects, std::size_t aGroups, ShaderProgram const& aComputeProgram )
+	: mMaxObjects( aMaxObjects )
+	, mGroups( aGroups )
+	, mObjectCount( 0 )
+	, mProgram( &aComputeProgram )
+	, mGroupFirst( aGroups, 0 )
+	, mGroupSize( aGroups, 0 )
+	, mObjects( 0 )
+	, mTransforms( 0 )
+	, mCommands( 0 )
+	, mCounts( 0 )
+	, mGroupRanges( 0 )
+	, mObjectIds( 0 )
+{
+	assert( mProgram->ready() );
+	assert( mMaxObjects > 0 && mGroups > 0 );
+
+	glGenBuffers( 1, &mObjects );
+	glGenBuffers( 1, &mTransforms );
+	glGenBuffers( 1, &mCommands );
+	glGenBuffers( 1, &mCounts );
+	glGenBuffers( 1, &mGroupRanges );
+	glGenBuffers( 1, &mObjectIds );
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mObjects );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, mMaxObjects * sizeof(Object_), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mTransforms );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, mMaxObjects * sizeof(Transform_), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCounts );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, mGroups * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mGroupRanges );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, mGroups * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommands );
+	glBufferData( GL_DRAW_INDIRECT_BUFFER, mMaxObjects * sizeof(DrawElementsIndirectCommand_), nullptr, GL_DYNAMIC_COPY );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	std::vector<GLuint> ids( mMaxObjects );
+	for( std::size_t i = 0; i < ids.size(); ++i )
+		ids[i] = GLuint(i);
+
+	glBindBuffer( GL_ARRAY_BUFFER, mObjectIds );
+	glBufferData( GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+GpuCuller::~GpuCuller()
+{
+	glDeleteBuffers( 1, &mObjectIds );
+	glDeleteBuffers( 1, &mGroupRanges );
+	glDeleteBuffers( 1, &mCounts );
+	glDeleteBuffers( 1, &mCommands );
+	glDeleteBuffers( 1, &mTransforms );
+	glDeleteBuffers( 1, &mObjects );
+}
+
+std::size_t GpuCuller::max_objects() const noexcept
+{
+	return mMaxObjects;
+}
+std::size_t GpuCuller::object_count() const noexcept
+{
+	return mObjectCount;
+}
+
+void GpuCuller::set_objects( GpuDrawObject const* aObjects, std::size_t aCount )
+{
+	if( aCount > mMaxObjects )
+		throw Error( "GpuCuller: %zu objects, but only room for %zu", aCount, mMaxObjects );
+
+	std::vector<Object_> objects( aCount );
+	std::vector<Transform_> transforms( aCount );
+	std::fill( mGroupSize.begin(), mGroupSize.end(), 0 );
+
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		auto const& obj = aObjects[i];
+		if( obj.group >= mGroups )
+			throw Error( "GpuCuller: object %zu is in group %u, but there are only %zu groups", i, obj.group, mGroups );
+
+		auto const& b = obj.bounds;
+		objects[i] = Object_{
+			{ b.min.x, b.min.y, b.min.z, 0.f },
+			{ b.max.x, b.max.y, b.max.z, 0.f },
+			obj.indexCount, obj.firstIndex, obj.baseVertex, obj.group
+		};
+		transforms[i] = make_transform_( obj.model2World, obj.normalMatrix );
+
+		++mGroupSize[obj.group];
+	}
+
+	// Each group's commands are packed at the start of its range.
+	GLuint first = 0;
+	for( std::size_t g = 0; g < mGroups; ++g )
+	{
+		mGroupFirst[g] = first;
+		first += mGroupSize[g];
+	}
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mObjects );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, objects.size() * sizeof(Object_), objects.data() );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mTransforms );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, transforms.size() * sizeof(Transform_), transforms.data() );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mGroupRanges );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, mGroupFirst.size() * sizeof(GLuint), mGroupFirst.data() );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	mObjectCount = aCount;
+}
+
+void GpuCuller::update_object( std::size_t aIndex, Aabb const& aBounds, Mat44f const& aModel2World, Mat33f const& aNormalMatrix )
+{
+	assert( aIndex < mObjectCount );
+
+	float const bounds[8] = {
+		aBounds.min.x, aBounds.min.y, aBounds.min.z, 0.f,
+		aBounds.max.x, aBounds.max.y, aBounds.max.z, 0.f
+	};
+	static_assert( offsetof(Object_, boundsMin) == 0 && offsetof(Object_, boundsMax) == sizeof(float)*4 );
+
+	auto const transform = make_transform_( aModel2World, aNormalMatrix );
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mObjects );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, GLintptr(aIndex * sizeof(Object_)), sizeof(bounds), bounds );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mTransforms );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, GLintptr(aIndex * sizeof(Transform_)), sizeof(transform), &transform );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+void GpuCuller::attach( GLuint aVao ) const
+{
+	glBindVertexArray( aVao );
+	glVertexAttribIFormat( kGpuCullObjectIdAttribute, 1, GL_UNSIGNED_INT, 0 );
+	glVertexAttribBinding( kGpuCullObjectIdAttribute, kObjectIdBinding_ );
+	glVertexBindingDivisor( kObjectIdBinding_, 1 );
+	glBindVertexBuffer( kObjectIdBinding_, mObjectIds, 0, sizeof(GLuint) );
+	glEnableVertexAttribArray( kGpuCullObjectIdAttribute );
+	glBindVertexArray( 0 );
+}
+
+void GpuCuller::cull( Mat44f const& aProjCameraWorld )
+{
+	// Empty draws everywhere, and no visible objects yet
+	clear_buffer_( mCommands, mObjectCount * sizeof(DrawElementsIndirectCommand_) );
+	clear_buffer_( mCounts, mGroups * sizeof(GLuint) );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	if( 0 == mObjectCount )
+		return;
+
+	auto const frustum = make_frustum( aProjCameraWorld );
+	float planes[6][4];
+	for( std::size_t p = 0; p < 6; ++p )
+	{
+		planes[p][0] = frustum.nx[p];
+		planes[p][1] = frustum.ny[p];
+		planes[p][2] = frustum.nz[p];
+		planes[p][3] = frustum.d[p];
+	}
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kBindingObjects_, mObjects );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kBindingCommands_, mCommands );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kBindingCounts_, mCounts );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kBindingGroups_, mGroupRanges );
+
+	glUseProgram( mProgram->programId() );
+	glUniform1ui( 0, GLuint(mObjectCount) );
+	glUniform4fv( 1, 6, &planes[0][0] );
+
+	glDispatchCompute( GLuint((mObjectCount + kWorkGroupSize_ - 1) / kWorkGroupSize_), 1, 1 );
+
+	// Commands and counts are read as draw parameters, and cleared with
+	// glClearBufferSubData() before the next pass.
+	glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT );
+}
+
+void GpuCuller::draw( std::uint32_t aGroup ) const
+{
+	assert( aGroup < mGroups );
+	if( 0 == mGroupSize[aGroup] )
+		return;
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kGpuCullTransformBinding, mTransforms );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommands );
+
+	auto const* commands = reinterpret_cast<void const*>(std::uintptr_t(mGroupFirst[aGroup]) * sizeof(DrawElementsIndirectCommand_));
+	if( GLAD_GL_VERSION_4_6 )
+	{
+		// Only the visible objects' commands
+		glBindBuffer( GL_PARAMETER_BUFFER, mCounts );
+		glMultiDrawElementsIndirectCount( GL_TRIANGLES, GL_UNSIGNED_INT, commands, GLintptr(aGroup * sizeof(GLuint)), GLsizei(mGroupSize[aGroup]), 0 );
+		glBindBuffer( GL_PARAMETER_BUFFER, 0 );
+	}
+	else
+	{
+		// The whole range; the tail past the visible objects is empty.
+		glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, commands, GLsizei(mGroupSize[aGroup]), 0 );
+	}
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
+
+void GpuCuller::read_back_visible( std::vector<std::uint32_t>& aVisible ) const
+{
+	glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+	std::vector<DrawElementsIndirectCommand_> commands( mObjectCount );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommands );
+	glGetBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand_), commands.data() );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	aVisible.clear();
+	for( auto const& cmd : commands )
+	{
+		if( 0 == cmd.instanceCount )
+			continue;
+
+		if( cmd.baseInstance >= mObjectCount )
+			throw Error( "GpuCuller: invalid object index %u in draw command", cmd.baseInstance );
+
+		aVisible.emplace_back( cmd.baseInstance );
+	}
+
+	std::sort( aVisible.begin(), aVisible.end() );
+}
+
+GpuCuller::Transform_ GpuCuller::make_transform_( Mat44f const& aModel2World, Mat33f const& aNormalMatrix ) noexcept
+{
+	Transform_ ret{};
+	for( std::size_t i = 0; i < 16; ++i )
+		ret.model2World[i] = aModel2World.v[i];
+	for( std::size_t r = 0; r < 3; ++r )
+	{
+		for( std::size_t c = 0; c < 3; ++c )
+			ret.normalMatrix[r*4+c] = aNormalMatrix( r, c );
+	}
+	ret.normalMatrix[15] = 1.f;
+	return ret;
+}
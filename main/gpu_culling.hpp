@@ -0,0 +1,135 @@
+#ifndef GPU_CULLING_HPP_7C14A9E2_3D58_4B06_A1F7_E5928B0C6D31
+#define GPU_CULLING_HPP_7C14A9E2_3D58_4B06_A1F7_E5928B0C6D31
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../vmlib/mat33.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "bvh.hpp"
+
+class ShaderProgram;
+
+// Vertex attribute and shader storage binding read by assets/culled.vert
+constexpr GLuint kGpuCullObjectIdAttribute = 4;
+constexpr GLuint kGpuCullTransformBinding = 4;
+
+// One indexed mesh, e.g. from a GeometryHeap, with its placement
+struct GpuDrawObject
+{
+	Aabb bounds; // world space
+	Mat44f model2World;
+	Mat33f normalMatrix;
+
+	std::uint32_t group; // draw group, < group count of the GpuCuller
+
+	GLuint firstIndex;
+	GLuint indexCount;
+	GLint baseVertex;
+};
+
+/** GpuCuller: GPU-driven frustum culling and indirect draws
+ *
+ * Object bounds, meshes and transforms live in shader storage buffers. Each
+ * frame, cull() runs a compute shader (assets/cull.comp) that tests every
+ * object against the view frustum and appends a DrawElementsIndirectCommand
+ * for each visible one. draw() then renders a group with a single
+ * glMultiDrawElementsIndirect(). Nothing is read back, and the CPU work per
+ * frame does not depend on the number of objects.
+ *
+ * Objects are sorted into groups, one per program/texture/material
+ * combination; each group gets its own, compacted, range of commands. The
+ * command buffer is cleared before every pass, so that the unused tail of a
+ * range consists of empty draws. With OpenGL 4.6, draw() instead passes the
+ * visible count from the GPU with glMultiDrawElementsIndirectCount().
+ *
+ * The baseInstance of each command is the object's index. attach() adds an
+ * instanced vertex attribute (kGpuCullObjectIdAttribute) holding 0, 1, 2, ...
+ * to a VAO, through which the vertex shader finds its object's transform
+ * (kGpuCullTransformBinding; see assets/culled.vert).
+ *
+ * The frustum test matches intersects() in bvh.hpp, such that the visible
+ * set equals that of frustum_cull() on the same bounds.
+ *
+ * aComputeProgram is assets/cull.comp, and is not owned. Its id is looked up
+ * on each use, so that reloads of the program take effect.
+ *
+ * Requires a current OpenGL 4.3 context for all methods, including the
+ * constructor and destructor.
+ */
+class GpuCuller final
+{
+	public:
+		GpuCuller( std::size_t aMaxObjects, std::size_t aGroups, ShaderProgram const& aComputeProgram );
+		~GpuCuller();
+
+		GpuCuller( GpuCuller const& ) = delete;
+		GpuCuller& operator= (GpuCuller const&) = delete;
+
+	public:
+		std::size_t max_objects() const noexcept;
+		std::size_t object_count() const noexcept;
+
+		// Replaces all objects. Object indices are positions in aObjects.
+		void set_objects( GpuDrawObject const* aObjects, std::size_t aCount );
+
+		// Moves an existing object; its mesh and group stay.
+		void update_object( std::size_t aIndex, Aabb const& aBounds, Mat44f const& aModel2World, Mat33f const& aNormalMatrix );
+
+		// Sets up kGpuCullObjectIdAttribute in aVao.
+		void attach( GLuint aVao ) const;
+
+		void cull( Mat44f const& aProjCameraWorld );
+
+		// Draws the visible objects of aGroup as GL_TRIANGLES. The caller
+		// binds the program, the attached VAO, textures and materials.
+		void draw( std::uint32_t aGroup ) const;
+
+		// Reads the indices of the visible objects back to the CPU, in
+		// increasing order. This stalls, and is meant for validation
+		// only (see --validate-culling).
+		void read_back_visible( std::vector<std::uint32_t>& aVisible ) const;
+
+	private:
+		// std430 layouts, see assets/cull.comp and assets/culled.vert
+		struct Object_
+		{
+			float boundsMin[4];
+			float boundsMax[4];
+			GLuint indexCount;
+			GLuint firstIndex;
+			GLint baseVertex;
+			GLuint group;
+		};
+		struct Transform_
+		{
+			float model2World[16];
+			float normalMatrix[16]; // rows, padded to vec4; row_major mat4
+		};
+
+		static Transform_ make_transform_( Mat44f const&, Mat33f const& ) noexcept;
+
+	private:
+		std::size_t mMaxObjects;
+		std::size_t mGroups;
+		std::size_t mObjectCount;
+		ShaderProgram const* mProgram;
+
+		// First command and capacity of each group in mCommands
+		std::vector<GLuint> mGroupFirst;
+		std::vector<GLuint> mGroupSize;
+
+		GLuint mObjects;
+		GLuint mTransforms;
+		GLuint mCommands;
+		GLuint mCounts; // visible objects per group
+		GLuint mGroupRanges; // mGroupFirst, for the compute shader
+		GLuint mObjectIds; // 0, 1, 2, ..., per-instance vertex data
+};
+
+#endif // GPU_CULLING_HPP_7C14A9E2_3D58_4B06_A1F7_E5928B0C6D31
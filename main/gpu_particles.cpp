@@ -0,0 +1,193 @@
+#include "gpu_particles.hpp"
+
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/program.hpp"
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	// Must match local_size_x in assets/particles.comp
+	constexpr GLuint kWorkGroupSize_ = 256;
+
+	// Binding points, see assets/particles.comp
+	constexpr GLuint kBindingIn_ = 0;
+	constexpr GLuint kBindingOut_ = 1;
+	constexpr GLuint kBindingEmitted_ = 2;
+	constexpr GLuint kBindingPreviousDraw_ = 3;
+	constexpr GLuint kBindingCounter_ = 0;
+
+	// Layout of the indirect command consumed by glDrawArraysIndirect()
+	struct DrawArraysIndirectCommand_
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+}
+
+GpuParticleSystem::GpuParticleSystem( std::size_t aCapacity, std::size_t aMaxSpawnsPerUpdate, ShaderProgram const& aComputeProgram )
+	: mCapacity( aCapacity )
+	, mMaxSpawns( aMaxSpawnsPerUpdate )
+	, mProgram( &aComputeProgram )
+	, mCurrent( 0 )
+	, mParticles{ 0, 0 }
+	, mDrawCommands{ 0, 0 }
+	, mEmitted( 0 )
+	, mVao( 0 )
+{
+	assert( mProgram->ready() );
+
+	mSpawns.reserve( mMaxSpawns );
+
+	glGenBuffers( 2, mParticles );
+	glGenBuffers( 2, mDrawCommands );
+	glGenBuffers( 1, &mEmitted );
+
+	for( std::size_t i = 0; i < 2; ++i )
+	{
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mParticles[i] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, mCapacity * sizeof(Particle_), nullptr, GL_DYNAMIC_COPY );
+	}
+
+	// At least one element, so that the binding is always valid.
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mEmitted );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, (mMaxSpawns ? mMaxSpawns : 1) * sizeof(Particle_), nullptr, GL_STREAM_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	DrawArraysIndirectCommand_ const empty{ 0, 1, 0, 0 };
+	for( std::size_t i = 0; i < 2; ++i )
+	{
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mDrawCommands[i] );
+		glBufferData( GL_DRAW_INDIRECT_BUFFER, sizeof(empty), &empty, GL_DYNAMIC_COPY );
+	}
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	// Vertex format only; the buffer is attached in draw(), since it changes
+	// every update.
+	glGenVertexArrays( 1, &mVao );
+	glBindVertexArray( mVao );
+	glVertexAttribFormat( 0, 3, GL_FLOAT, GL_FALSE, offsetof(Particle_,positionLife) );
+	glVertexAttribBinding( 0, 0 );
+	glEnableVertexAttribArray( 0 );
+	glBindVertexArray( 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+GpuParticleSystem::~GpuParticleSystem()
+{
+	glDeleteVertexArrays( 1, &mVao );
+	glDeleteBuffers( 1, &mEmitted );
+	glDeleteBuffers( 2, mDrawCommands );
+	glDeleteBuffers( 2, mParticles );
+}
+
+std::size_t GpuParticleSystem::capacity() const noexcept
+{
+	return mCapacity;
+}
+
+void GpuParticleSystem::clear()
+{
+	mSpawns.clear();
+
+	GLuint const zero = 0;
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mDrawCommands[mCurrent] );
+	glBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, sizeof(zero), &zero );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
+
+void GpuParticleSystem::spawn( Vec3f aPosition, Vec3f aVelocity, float aLifespan ) noexcept
+{
+	if( mSpawns.size() >= mMaxSpawns )
+		return;
+
+	mSpawns.emplace_back( Particle_{
+		{ aPosition.x, aPosition.y, aPosition.z, aLifespan },
+		{ aVelocity.x, aVelocity.y, aVelocity.z, 0.f }
+	} );
+}
+
+void GpuParticleSystem::update( float aDt )
+{
+	auto const next = 1 - mCurrent;
+
+	if( !mSpawns.empty() )
+	{
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, mEmitted );
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, mSpawns.size() * sizeof(Particle_), mSpawns.data() );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+	}
+
+	// Reset the append counter (= vertex count of the next draw)
+	GLuint const zero = 0;
+	glBindBuffer( GL_ATOMIC_COUNTER_BUFFER, mDrawCommands[next] );
+	glBufferSubData( GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(zero), &zero );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kBindingIn_, mParticles[mCurrent] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kBindingOut_, mParticles[next] );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kBindingEmitted_, mEmitted );
+	glBindBufferRange( GL_SHADER_STORAGE_BUFFER, kBindingPreviousDraw_, mDrawCommands[mCurrent], 0, sizeof(GLuint) );
+	glBindBufferRange( GL_ATOMIC_COUNTER_BUFFER, kBindingCounter_, mDrawCommands[next], 0, sizeof(GLuint) );
+
+	glUseProgram( mProgram->programId() );
+	glUniform1f( 0, aDt );
+	glUniform1ui( 1, GLuint(mSpawns.size()) );
+	glUniform1ui( 2, GLuint(mCapacity) );
+
+	// The number of survivors is only known on the GPU, so cover the worst
+	// case; surplus invocations exit immediately.
+	auto const invocations = GLuint(mCapacity + mSpawns.size());
+	glDispatchCompute( (invocations + kWorkGroupSize_ - 1) / kWorkGroupSize_, 1, 1 );
+
+	// The results are read as vertices and draw parameters, by the next
+	// dispatch (SSBOs), and the counter is reset with glBufferSubData().
+	glMemoryBarrier( GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT );
+
+	glBindBufferBase( GL_ATOMIC_COUNTER_BUFFER, kBindingCounter_, 0 );
+	glBindBuffer( GL_ATOMIC_COUNTER_BUFFER, 0 );
+
+	mSpawns.clear();
+	mCurrent = next;
+}
+
+void GpuParticleSystem::draw() const
+{
+	glBindVertexArray( mVao );
+	glBindVertexBuffer( 0, mParticles[mCurrent], 0, sizeof(Particle_) );
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mDrawCommands[mCurrent] );
+	glDrawArraysIndirect( GL_POINTS, nullptr );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	glBindVertexArray( 0 );
+}
+
+void GpuParticleSystem::read_back_positions( std::vector<float>& aPositions ) const
+{
+	glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+	DrawArraysIndirectCommand_ cmd{};
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mDrawCommands[mCurrent] );
+	glGetBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0, sizeof(cmd), &cmd );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	if( cmd.count > mCapacity )
+		throw Error( "GpuParticleSystem: invalid particle count %u (capacity %zu)", cmd.count, mCapacity );
+
+	std::vector<Particle_> particles( cmd.count );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mParticles[mCurrent] );
+	glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, particles.size() * sizeof(Particle_), particles.data() );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+
+	aPositions.resize( 3 * particles.size() );
+	for( std::size_t i = 0; i < particles.size(); ++i )
+	{
+		aPositions[3*i+0] = particles[i].positionLife[0];
+		aPositions[3*i+1] = particles[i].positionLife[1];
+		aPositions[3*i+2] = particles[i].positionLife[2];
+	}
+}
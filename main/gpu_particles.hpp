@@ -0,0 +1,85 @@
+#ifndef GPU_PARTICLES_HPP_8E51C3A0_27B4_4D8F_B6E2_91F0A4C7D355
+#define GPU_PARTICLES_HPP_8E51C3A0_27B4_4D8F_B6E2_91F0A4C7D355
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+
+class ShaderProgram;
+
+/** GpuParticleSystem: particle simulation on the GPU
+ *
+ * Alternative to ParticlePool that keeps all particle state in shader storage
+ * buffers. The CPU only records new particles with spawn(). update() uploads
+ * those and runs the compute shader (assets/particles.comp), which integrates
+ * last frame's survivors and the new particles in one dispatch and appends
+ * everything still alive to the other of two ping-ponged buffers. The atomic
+ * append counter is the vertex count of an indirect draw command, so draw()
+ * can render the result with glDrawArraysIndirect() without ever reading the
+ * count back.
+ *
+ * Spawns and integration match ParticlePool::spawn()/update(), so the two are
+ * interchangeable. The exception is overflow: when the buffer is full, the
+ * GPU drops new particles, whereas ParticlePool recycles old ones. Particle
+ * order on the GPU is unspecified.
+ *
+ * aComputeProgram is assets/particles.comp, and is not owned. Its id is
+ * looked up on each update(), so that reloads of the program take effect.
+ *
+ * Requires a current OpenGL 4.3 context for all methods, including the
+ * constructor and destructor.
+ */
+class GpuParticleSystem final
+{
+	public:
+		GpuParticleSystem( std::size_t aCapacity, std::size_t aMaxSpawnsPerUpdate, ShaderProgram const& aComputeProgram );
+		~GpuParticleSystem();
+
+		GpuParticleSystem( GpuParticleSystem const& ) = delete;
+		GpuParticleSystem& operator= (GpuParticleSystem const&) = delete;
+
+	public:
+		std::size_t capacity() const noexcept;
+
+		void clear();
+
+		// Spawns beyond aMaxSpawnsPerUpdate (per update()) are dropped.
+		void spawn( Vec3f aPosition, Vec3f aVelocity, float aLifespan ) noexcept;
+
+		void update( float aDt );
+
+		// Draws the live particles as GL_POINTS, with the position in
+		// attribute 0. The caller sets up the program and its uniforms.
+		void draw() const;
+
+		// Reads the live positions back to the CPU as xyz triplets. This
+		// stalls, and is meant for testing only.
+		void read_back_positions( std::vector<float>& aPositions ) const;
+
+	private:
+		struct Particle_
+		{
+			float positionLife[4];
+			float velocity[4];
+		};
+
+		std::size_t mCapacity;
+		std::size_t mMaxSpawns;
+		ShaderProgram const* mProgram;
+
+		std::vector<Particle_> mSpawns;
+
+		// mParticles[mCurrent] and mDrawCommands[mCurrent] hold the latest
+		// simulation result.
+		std::size_t mCurrent;
+		GLuint mParticles[2];
+		GLuint mDrawCommands[2];
+		GLuint mEmitted;
+		GLuint mVao;
+};
+
+#endif // GPU_PARTICLES_HPP_8E51C3A0_27B4_4D8F_B6E2_91F0A4C7D355
@@ -0,0 +1,221 @@
+#include "headless.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__linux__)
+#	include <EGL/egl.h>
+#	include <EGL/eglext.h>
+#endif // ~ __linux__
+
+#include <stb_image_write.h>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+#if defined(__linux__)
+#	if !defined(EGL_PLATFORM_SURFACELESS_MESA)
+#		define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#	endif
+
+namespace
+{
+	bool has_extension_( char const* aExtensions, char const* aName )
+	{
+		if( !aExtensions )
+			return false;
+
+		auto const len = std::strlen( aName );
+		for( char const* ext = std::strstr( aExtensions, aName ); ext; ext = std::strstr( ext + len, aName ) )
+		{
+			if( (ext == aExtensions || ' ' == ext[-1]) && (' ' == ext[len] || '\0' == ext[len]) )
+				return true;
+		}
+
+		return false;
+	}
+}
+
+HeadlessContext::HeadlessContext( bool aDebugContext )
+	: mDisplay( EGL_NO_DISPLAY )
+	, mContext( EGL_NO_CONTEXT )
+{
+	// Client extensions are queried without a display
+	char const* clientExts = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+	if( !has_extension_( clientExts, "EGL_MESA_platform_surfaceless" ) )
+		throw Error( "HeadlessContext: EGL_MESA_platform_surfaceless is not supported" );
+
+	auto const getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress( "eglGetPlatformDisplayEXT" ));
+	if( !getPlatformDisplay )
+		throw Error( "HeadlessContext: eglGetPlatformDisplayEXT() is not available" );
+
+	EGLDisplay display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr );
+	EGLint major = 0, minor = 0;
+	if( EGL_NO_DISPLAY == display || !eglInitialize( display, &major, &minor ) )
+		throw Error( "HeadlessContext: eglInitialize() failed with 0x%x", unsigned(eglGetError()) );
+
+	mDisplay = display;
+
+	// Without surfaces, there is no need for an EGLConfig
+	char const* displayExts = eglQueryString( display, EGL_EXTENSIONS );
+	if( !has_extension_( displayExts, "EGL_KHR_no_config_context" ) || !has_extension_( displayExts, "EGL_KHR_surfaceless_context" ) )
+	{
+		eglTerminate( display );
+		throw Error( "HeadlessContext: EGL %d.%d lacks EGL_KHR_no_config_context or EGL_KHR_surfaceless_context", major, minor );
+	}
+
+	if( !eglBindAPI( EGL_OPENGL_API ) )
+	{
+		eglTerminate( display );
+		throw Error( "HeadlessContext: eglBindAPI() failed with 0x%x", unsigned(eglGetError()) );
+	}
+
+	EGLint const attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_CONTEXT_OPENGL_DEBUG, aDebugContext ? EGL_TRUE : EGL_FALSE,
+		EGL_NONE
+	};
+
+	EGLContext context = eglCreateContext( display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs );
+	if( EGL_NO_CONTEXT == context )
+	{
+		auto const err = eglGetError();
+		eglTerminate( display );
+		throw Error( "HeadlessContext: eglCreateContext() failed with 0x%x (OpenGL 4.3 core)", unsigned(err) );
+	}
+
+	mContext = context;
+
+	if( !eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, context ) )
+	{
+		auto const err = eglGetError();
+		eglDestroyContext( display, context );
+		eglTerminate( display );
+		throw Error( "HeadlessContext: eglMakeCurrent() failed with 0x%x", unsigned(err) );
+	}
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	eglMakeCurrent( mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+	eglDestroyContext( mDisplay, mContext );
+	eglTerminate( mDisplay );
+}
+
+void* HeadlessContext::get_proc_address( char const* aName )
+{
+	return reinterpret_cast<void*>(eglGetProcAddress( aName ));
+}
+
+#else // !__linux__
+
+HeadlessContext::HeadlessContext( bool )
+	: mDisplay( nullptr )
+	, mContext( nullptr )
+{
+	throw Error( "HeadlessContext: headless rendering requires EGL, which is only used on Linux" );
+}
+
+HeadlessContext::~HeadlessContext() = default;
+
+void* HeadlessContext::get_proc_address( char const* )
+{
+	return nullptr;
+}
+
+#endif // ~ __linux__
+
+
+OffscreenTarget::OffscreenTarget( GLsizei aWidth, GLsizei aHeight )
+	: mWidth( aWidth )
+	, mHeight( aHeight )
+	, mFramebuffer( 0 )
+	, mColor( 0 )
+	, mDepth( 0 )
+{
+	assert( aWidth > 0 && aHeight > 0 );
+
+	glGenRenderbuffers( 1, &mColor );
+	glBindRenderbuffer( GL_RENDERBUFFER, mColor );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_SRGB8_ALPHA8, mWidth, mHeight );
+
+	glGenRenderbuffers( 1, &mDepth );
+	glBindRenderbuffer( GL_RENDERBUFFER, mDepth );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mWidth, mHeight );
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+	glGenFramebuffers( 1, &mFramebuffer );
+	glBindFramebuffer( GL_FRAMEBUFFER, mFramebuffer );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColor );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepth );
+
+	auto const status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	if( GL_FRAMEBUFFER_COMPLETE != status )
+	{
+		glDeleteFramebuffers( 1, &mFramebuffer );
+		glDeleteRenderbuffers( 1, &mDepth );
+		glDeleteRenderbuffers( 1, &mColor );
+		throw Error( "OffscreenTarget: %dx%d framebuffer incomplete (0x%x)", int(mWidth), int(mHeight), unsigned(status) );
+	}
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+	glDeleteFramebuffers( 1, &mFramebuffer );
+	glDeleteRenderbuffers( 1, &mDepth );
+	glDeleteRenderbuffers( 1, &mColor );
+}
+
+GLsizei OffscreenTarget::width() const noexcept
+{
+	return mWidth;
+}
+GLsizei OffscreenTarget::height() const noexcept
+{
+	return mHeight;
+}
+
+void OffscreenTarget::bind() const
+{
+	glBindFramebuffer( GL_FRAMEBUFFER, mFramebuffer );
+	glViewport( 0, 0, mWidth, mHeight );
+}
+
+void OffscreenTarget::read_pixels( std::vector<std::uint8_t>& aRgb ) const
+{
+	auto const rowBytes = std::size_t(mWidth) * 3;
+	aRgb.resize( rowBytes * std::size_t(mHeight) );
+
+	GLint previous = 0;
+	glGetIntegerv( GL_READ_FRAMEBUFFER_BINDING, &previous );
+
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, mFramebuffer );
+	glReadBuffer( GL_COLOR_ATTACHMENT0 );
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	glReadPixels( 0, 0, mWidth, mHeight, GL_RGB, GL_UNSIGNED_BYTE, aRgb.data() );
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, GLuint(previous) );
+
+	// OpenGL returns the bottom row first
+	std::vector<std::uint8_t> row( rowBytes );
+	for( std::size_t top = 0, bottom = std::size_t(mHeight) - 1; top < bottom; ++top, --bottom )
+	{
+		std::memcpy( row.data(), aRgb.data() + top * rowBytes, rowBytes );
+		std::memcpy( aRgb.data() + top * rowBytes, aRgb.data() + bottom * rowBytes, rowBytes );
+		std::memcpy( aRgb.data() + bottom * rowBytes, row.data(), rowBytes );
+	}
+}
+
+void OffscreenTarget::save_png( char const* aPath ) const
+{
+	assert( aPath );
+
+	read_pixels( mPixels );
+	if( !stbi_write_png( aPath, mWidth, mHeight, 3, mPixels.data(), int(mWidth) * 3 ) )
+		throw Error( "OffscreenTarget: unable to write \"%s\"", aPath );
+}
@@ -0,0 +1,82 @@
+#ifndef HEADLESS_HPP_4E1B7A60_92D3_4C8F_B5A1_3F06D9E82C47
+#define HEADLESS_HPP_4E1B7A60_92D3_4C8F_B5A1_3F06D9E82C47
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstdint>
+
+/** HeadlessContext: OpenGL without a window or display
+ *
+ * Creates an OpenGL 4.3 core context on a surfaceless EGL display
+ * (EGL_MESA_platform_surfaceless) and makes it current on the calling
+ * thread. No X server, Wayland compositor or GPU is needed; Mesa's llvmpipe
+ * is enough. The context has no default framebuffer, so all rendering must
+ * go to a framebuffer object, e.g. an OffscreenTarget.
+ *
+ * Only available on Linux. Elsewhere, and where EGL lacks the required
+ * extensions, the constructor throws.
+ */
+class HeadlessContext final
+{
+	public:
+		explicit HeadlessContext( bool aDebugContext = false );
+		~HeadlessContext();
+
+		HeadlessContext( HeadlessContext const& ) = delete;
+		HeadlessContext& operator= (HeadlessContext const&) = delete;
+
+	public:
+		// For gladLoadGLLoader()
+		static void* get_proc_address( char const* aName );
+
+	private:
+		// EGLDisplay and EGLContext; opaque here, so that users do not
+		// depend on the EGL headers.
+		void* mDisplay;
+		void* mContext;
+};
+
+/** OffscreenTarget: framebuffer object to render into without a window
+ *
+ * sRGB color (GL_SRGB8_ALPHA8) and 24-bit depth renderbuffers of a fixed
+ * size. Frames can be read back as 8-bit RGB and written to PNG files. As
+ * with a window, the alpha channel is not part of the image.
+ *
+ * Requires a current OpenGL context for all methods, including the
+ * constructor and destructor.
+ */
+class OffscreenTarget final
+{
+	public:
+		OffscreenTarget( GLsizei aWidth, GLsizei aHeight );
+		~OffscreenTarget();
+
+		OffscreenTarget( OffscreenTarget const& ) = delete;
+		OffscreenTarget& operator= (OffscreenTarget const&) = delete;
+
+	public:
+		GLsizei width() const noexcept;
+		GLsizei height() const noexcept;
+
+		// Binds the framebuffer for drawing and reading, and sets the
+		// viewport to cover it.
+		void bind() const;
+
+		// Reads back the color buffer as RGB, top row first. Waits for the
+		// GPU to finish rendering.
+		void read_pixels( std::vector<std::uint8_t>& aRgb ) const;
+
+		// Same, written to a PNG file. Throws on failure.
+		void save_png( char const* aPath ) const;
+
+	private:
+		GLsizei mWidth, mHeight;
+		GLuint mFramebuffer;
+		GLuint mColor, mDepth;
+
+		mutable std::vector<std::uint8_t> mPixels;
+};
+
+#endif // HEADLESS_HPP_4E1B7A60_92D3_4C8F_B5A1_3F06D9E82C47
@@ -0,0 +1,399 @@
+#include "hud.hpp"
+
+#include <algorithm>
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#if defined(__linux__)
+#	include <unistd.h>
+#endif
+
+#include "fontstash.h"
+
+#include "../support/error.hpp"
+#include "../support/program.hpp"
+#include "../support/profiler.hpp"
+#include "../support/checkpoint.hpp"
+#include "../support/stream_buffer.hpp"
+
+namespace
+{
+	constexpr float kFontSize_ = 14.f; // pixels
+	constexpr float kMargin_ = 8.f;
+	constexpr float kPadding_ = 6.f;
+
+	constexpr float kGraphHeight_ = 60.f;
+	constexpr float kGraphBarWidth_ = 2.f;
+	constexpr float kGraphMinScale_ = 33.4f; // ms; at least two 60 Hz frames
+
+	// Per frame: about 4000 glyphs or quads
+	constexpr std::size_t kMaxVertices_ = 24576;
+
+	constexpr int kInitialAtlasSize_ = 512;
+	constexpr int kMaxAtlasSize_ = 4096;
+
+	// Text (and the memory usage) is laid out again this often. Numbers
+	// that change every frame are unreadable anyway.
+	constexpr auto kTextInterval_ = std::chrono::milliseconds( 250 );
+
+	constexpr std::uint32_t rgba_( unsigned aR, unsigned aG, unsigned aB, unsigned aA = 255 ) noexcept
+	{
+		return aR | (aG << 8) | (aB << 16) | (aA << 24);
+	}
+
+	constexpr std::uint32_t kTextColor_ = rgba_( 255, 255, 255 );
+	constexpr std::uint32_t kLabelColor_ = rgba_( 160, 170, 180 );
+	constexpr std::uint32_t kPanelColor_ = rgba_( 0, 0, 0, 160 );
+	constexpr std::uint32_t kGraphColor_ = rgba_( 40, 40, 40, 200 );
+	constexpr std::uint32_t kBudgetColor_ = rgba_( 90, 90, 90 );
+	constexpr std::uint32_t kGpuColor_ = rgba_( 80, 160, 255 );
+
+	// Green within a 60 Hz frame, yellow within two, red beyond
+	std::uint32_t frame_color_( float aMilliseconds ) noexcept
+	{
+		if( aMilliseconds <= 1000.f / 60.f )
+			return rgba_( 60, 200, 80 );
+		if( aMilliseconds <= 2000.f / 60.f )
+			return rgba_( 230, 190, 40 );
+		return rgba_( 230, 60, 50 );
+	}
+
+	// Resident set size of this process; 0 if unknown
+	std::size_t resident_bytes_()
+	{
+#		if defined(__linux__)
+		std::FILE* fin = std::fopen( "/proc/self/statm", "r" );
+		if( !fin )
+			return 0;
+
+		unsigned long long size = 0, resident = 0;
+		int const fields = std::fscanf( fin, "%llu %llu", &size, &resident );
+		std::fclose( fin );
+
+		if( 2 != fields )
+			return 0;
+
+		return std::size_t(resident) * std::size_t(sysconf( _SC_PAGESIZE ));
+#		else
+		return 0;
+#		endif
+	}
+}
+
+PerformanceHud::PerformanceHud( char const* aFontPath, ShaderProgram const& aProgram, std::size_t aGraphFrames )
+	: mProgram( &aProgram )
+	, mFons( nullptr )
+	, mFont( FONS_INVALID )
+	, mLineHeight( kFontSize_ )
+	, mAtlas( 0 )
+	, mAtlasWidth( 0 )
+	, mAtlasHeight( 0 )
+	, mVao( 0 )
+	, mVertexCount( 0 )
+	, mCpuTimes( aGraphFrames, 0.f )
+	, mGpuTimes( aGraphFrames, -1.f )
+	, mNextFrame( 0 )
+	, mTextRight( 0.f )
+	, mTextBottom( 0.f )
+	, mTextScopes( 0 )
+	, mResidentBytes( 0 )
+{
+	assert( aFontPath && aGraphFrames > 0 );
+
+	FONSparams params{};
+	params.width = kInitialAtlasSize_;
+	params.height = kInitialAtlasSize_;
+	params.flags = FONS_ZERO_TOPLEFT;
+	params.userPtr = this;
+	params.renderCreate = &PerformanceHud::fons_create_;
+	params.renderResize = &PerformanceHud::fons_resize_;
+	params.renderUpdate = &PerformanceHud::fons_update_;
+	params.renderDraw = &PerformanceHud::fons_draw_;
+	params.renderDelete = &PerformanceHud::fons_delete_;
+
+	mFons = fonsCreateInternal( &params );
+	if( !mFons )
+		throw Error( "PerformanceHud: unable to create the fontstash context" );
+
+	fonsSetErrorCallback( mFons, &PerformanceHud::fons_error_, this );
+
+	mFont = fonsAddFont( mFons, "hud", aFontPath );
+	if( FONS_INVALID == mFont )
+	{
+		fonsDeleteInternal( mFons );
+		throw Error( "PerformanceHud: unable to load font '%s'", aFontPath );
+	}
+
+	fonsSetFont( mFons, mFont );
+	fonsSetSize( mFons, kFontSize_ );
+	fonsSetAlign( mFons, FONS_ALIGN_LEFT | FONS_ALIGN_TOP );
+	fonsVertMetrics( mFons, nullptr, nullptr, &mLineHeight );
+
+	mVertices.reserve( kMaxVertices_ );
+	mTextVertices.reserve( kMaxVertices_ );
+	mVertexBuffer = std::make_unique<StreamBuffer>( kMaxVertices_ * sizeof(Vertex_) );
+
+	glGenVertexArrays( 1, &mVao );
+	glBindVertexArray( mVao );
+	glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffer->buffer() );
+	glVertexAttribPointer( 0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex_), reinterpret_cast<void const*>(offsetof(Vertex_, x)) );
+	glEnableVertexAttribArray( 0 );
+	glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex_), reinterpret_cast<void const*>(offsetof(Vertex_, s)) );
+	glEnableVertexAttribArray( 1 );
+	glVertexAttribPointer( 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex_), reinterpret_cast<void const*>(offsetof(Vertex_, color)) );
+	glEnableVertexAttribArray( 2 );
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+PerformanceHud::~PerformanceHud()
+{
+	fonsDeleteInternal( mFons ); // deletes the atlas, see fons_delete_()
+	glDeleteVertexArrays( 1, &mVao );
+}
+
+void PerformanceHud::add_frame( FrameTiming const& aFrame )
+{
+	mCpuTimes[mNextFrame] = float(aFrame.cpuMilliseconds);
+	mGpuTimes[mNextFrame] = float(aFrame.gpuMilliseconds);
+	mNextFrame = (mNextFrame + 1) % mCpuTimes.size();
+}
+
+void PerformanceHud::draw( int aWidth, int aHeight, RenderMetricsTracker const& aMetrics, HudCounters const& aCounters )
+{
+	auto const now = Clock_::now();
+	if( now >= mNextTextUpdate || aMetrics.scope_count() != mTextScopes )
+	{
+		layout_text_( aMetrics, aCounters );
+		mNextTextUpdate = now + kTextInterval_;
+	}
+
+	mVertices.clear();
+
+	// Panel behind everything
+	quad_( kMargin_, kMargin_, mTextRight + kPadding_, mTextBottom + kPadding_, kPanelColor_ );
+
+	// Graph below the first line, oldest frame on the left. CPU times as
+	// bars, GPU times as markers, and a line at 60 Hz.
+	auto const frames = mCpuTimes.size();
+	float const x = kMargin_ + kPadding_;
+	float const y = kMargin_ + kPadding_ + mLineHeight;
+	float const graphWidth = float(frames) * kGraphBarWidth_;
+	float const graphBottom = y + kGraphHeight_;
+
+	float graphMax = kGraphMinScale_;
+	for( std::size_t i = 0; i < frames; ++i )
+		graphMax = std::max( { graphMax, mCpuTimes[i], mGpuTimes[i] } );
+	float const scale = kGraphHeight_ / graphMax;
+
+	quad_( x, y, x + graphWidth, graphBottom, kGraphColor_ );
+
+	for( std::size_t i = 0; i < frames; ++i )
+	{
+		auto const index = (mNextFrame + i) % frames;
+		float const bx = x + float(i) * kGraphBarWidth_;
+
+		float const cpu = mCpuTimes[index];
+		if( cpu > 0.f )
+			quad_( bx, graphBottom - cpu * scale, bx + kGraphBarWidth_, graphBottom, frame_color_( cpu ) );
+
+		float const gpu = mGpuTimes[index];
+		if( gpu >= 0.f )
+		{
+			float const gy = graphBottom - gpu * scale;
+			quad_( bx, gy - 1.f, bx + kGraphBarWidth_, gy + 1.f, kGpuColor_ );
+		}
+	}
+
+	float const budget = graphBottom - 1000.f / 60.f * scale;
+	quad_( x, budget, x + graphWidth, budget + 1.f, kBudgetColor_ );
+
+	mVertices.insert( mVertices.end(), mTextVertices.begin(), mTextVertices.end() );
+
+	// One draw for everything
+	mVertexCount = std::min( mVertices.size(), kMaxVertices_ );
+	std::memcpy( mVertexBuffer->map(), mVertices.data(), mVertexCount * sizeof(Vertex_) );
+
+	glDisable( GL_DEPTH_TEST );
+	glDisable( GL_CULL_FACE );
+	glEnable( GL_BLEND );
+	glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+	glUseProgram( mProgram->programId() );
+	glUniform2f( 0, float(aWidth), float(aHeight) );
+
+	glActiveTexture( GL_TEXTURE0 );
+	glBindTexture( GL_TEXTURE_2D, mAtlas );
+
+	glBindVertexArray( mVao );
+	glDrawArrays( GL_TRIANGLES, GLint(mVertexBuffer->region_offset() / sizeof(Vertex_)), GLsizei(mVertexCount) );
+	glBindVertexArray( 0 );
+
+	mVertexBuffer->fence();
+
+	glBindTexture( GL_TEXTURE_2D, 0 );
+	glUseProgram( 0 );
+
+	glDisable( GL_BLEND );
+	glEnable( GL_CULL_FACE );
+	glEnable( GL_DEPTH_TEST );
+}
+
+std::size_t PerformanceHud::vertex_count() const noexcept
+{
+	return mVertexCount;
+}
+
+void PerformanceHud::layout_text_( RenderMetricsTracker const& aMetrics, HudCounters const& aCounters )
+{
+	PROFILE_SCOPE( "hud text" );
+
+	mResidentBytes = resident_bytes_();
+	mTextVertices.clear();
+
+	float const x = kMargin_ + kPadding_;
+	float y = kMargin_ + kPadding_;
+	float right = x + float(mCpuTimes.size()) * kGraphBarWidth_;
+	char line[128];
+
+	auto const& frameCpu = aMetrics.cpu_stats( RenderMetricsTracker::kFrameScope );
+	auto const& frameGpu = aMetrics.gpu_stats( RenderMetricsTracker::kFrameScope );
+	double const interval = aCounters.frameInterval > 0.0 ? aCounters.frameInterval : frameCpu.mean();
+	std::snprintf( line, sizeof(line), "Frame %6.2f ms CPU  %6.2f ms GPU  %5.0f fps",
+		frameCpu.mean(), frameGpu.mean(), interval > 0.0 ? 1000.0 / interval : 0.0 );
+	right = std::max( right, text_( x, y, kTextColor_, line ) );
+
+	// The graph goes here, see draw()
+	y += mLineHeight + kGraphHeight_ + kPadding_;
+
+	// Rolling averages per scope
+	std::snprintf( line, sizeof(line), "%-20s %8s %8s", "scope (avg ms)", "CPU", "GPU" );
+	right = std::max( right, text_( x, y, kLabelColor_, line ) );
+	y += mLineHeight;
+
+	for( std::size_t i = 0; i < aMetrics.scope_count(); ++i )
+	{
+		auto const scope = RenderMetricsTracker::ScopeId(i);
+		auto const& gpu = aMetrics.gpu_stats( scope );
+
+		if( gpu.size() )
+			std::snprintf( line, sizeof(line), "%-20.20s %8.3f %8.3f", aMetrics.scope_name( scope ).c_str(), aMetrics.cpu_stats( scope ).mean(), gpu.mean() );
+		else
+			std::snprintf( line, sizeof(line), "%-20.20s %8.3f %8s", aMetrics.scope_name( scope ).c_str(), aMetrics.cpu_stats( scope ).mean(), "-" );
+
+		right = std::max( right, text_( x, y, kTextColor_, line ) );
+		y += mLineHeight;
+	}
+
+	y += mLineHeight * 0.5f;
+	std::snprintf( line, sizeof(line), "Draw calls %zu  Triangles %zu", aCounters.drawCalls, aCounters.triangles );
+	right = std::max( right, text_( x, y, kTextColor_, line ) );
+	y += mLineHeight;
+
+	if( mResidentBytes )
+		std::snprintf( line, sizeof(line), "Particles %zu  Memory %.1f MB", aCounters.particles, double(mResidentBytes) / (1024.0 * 1024.0) );
+	else
+		std::snprintf( line, sizeof(line), "Particles %zu  Memory n/a", aCounters.particles );
+	right = std::max( right, text_( x, y, kTextColor_, line ) );
+	y += mLineHeight;
+
+	if( aCounters.pacing )
+	{
+		int const len = std::snprintf( line, sizeof(line), "Pacing %s  %.2f +- %.2f ms", aCounters.pacing, aCounters.frameInterval, aCounters.frameIntervalStddev );
+		if( aCounters.latency >= 0.0 && len > 0 && std::size_t(len) < sizeof(line) )
+			std::snprintf( line + len, sizeof(line) - std::size_t(len), "  Latency %.1f ms", aCounters.latency );
+		right = std::max( right, text_( x, y, kTextColor_, line ) );
+		y += mLineHeight;
+	}
+
+	mTextRight = right;
+	mTextBottom = y;
+	mTextScopes = aMetrics.scope_count();
+}
+
+float PerformanceHud::text_( float aX, float aY, std::uint32_t aColor, char const* aText )
+{
+	fonsSetColor( mFons, aColor );
+	return fonsDrawText( mFons, aX, aY, aText, nullptr ); // see fons_draw_()
+}
+
+void PerformanceHud::quad_( float aX0, float aY0, float aX1, float aY1, std::uint32_t aColor )
+{
+	// Center of the 2x2 white block at the atlas origin
+	float const s = 1.f / float(mAtlasWidth), t = 1.f / float(mAtlasHeight);
+
+	Vertex_ const v00{ aX0, aY0, s, t, aColor }, v10{ aX1, aY0, s, t, aColor };
+	Vertex_ const v01{ aX0, aY1, s, t, aColor }, v11{ aX1, aY1, s, t, aColor };
+	mVertices.insert( mVertices.end(), { v00, v01, v11, v00, v11, v10 } );
+}
+
+void PerformanceHud::create_atlas_( int aWidth, int aHeight )
+{
+	if( mAtlas )
+		glDeleteTextures( 1, &mAtlas );
+
+	glGenTextures( 1, &mAtlas );
+	glBindTexture( GL_TEXTURE_2D, mAtlas );
+	glTexStorage2D( GL_TEXTURE_2D, 1, GL_R8, aWidth, aHeight );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	mAtlasWidth = aWidth;
+	mAtlasHeight = aHeight;
+}
+
+int PerformanceHud::fons_create_( void* aUser, int aWidth, int aHeight )
+{
+	static_cast<PerformanceHud*>(aUser)->create_atlas_( aWidth, aHeight );
+	return 1;
+}
+int PerformanceHud::fons_resize_( void* aUser, int aWidth, int aHeight )
+{
+	// fontstash marks the old contents as dirty, see fons_update_()
+	static_cast<PerformanceHud*>(aUser)->create_atlas_( aWidth, aHeight );
+	return 1;
+}
+void PerformanceHud::fons_update_( void* aUser, int* aRect, unsigned char const* aData )
+{
+	// aData is the whole atlas; upload the dirty rectangle only
+	auto* self = static_cast<PerformanceHud*>(aUser);
+
+	glBindTexture( GL_TEXTURE_2D, self->mAtlas );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, self->mAtlasWidth );
+	glPixelStorei( GL_UNPACK_SKIP_PIXELS, aRect[0] );
+	glPixelStorei( GL_UNPACK_SKIP_ROWS, aRect[1] );
+	glTexSubImage2D( GL_TEXTURE_2D, 0, aRect[0], aRect[1], aRect[2]-aRect[0], aRect[3]-aRect[1], GL_RED, GL_UNSIGNED_BYTE, aData );
+	glPixelStorei( GL_UNPACK_SKIP_ROWS, 0 );
+	glPixelStorei( GL_UNPACK_SKIP_PIXELS, 0 );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+}
+void PerformanceHud::fons_draw_( void* aUser, float const* aVerts, float const* aTexCoords, unsigned int const* aColors, int aCount )
+{
+	// Collected only; draw() submits the whole frame at once
+	auto* self = static_cast<PerformanceHud*>(aUser);
+	for( int i = 0; i < aCount; ++i )
+		self->mTextVertices.emplace_back( Vertex_{ aVerts[2*i], aVerts[2*i+1], aTexCoords[2*i], aTexCoords[2*i+1], aColors[i] } );
+}
+void PerformanceHud::fons_delete_( void* aUser )
+{
+	auto* self = static_cast<PerformanceHud*>(aUser);
+	glDeleteTextures( 1, &self->mAtlas );
+	self->mAtlas = 0;
+}
+void PerformanceHud::fons_error_( void* aUser, int aError, int )
+{
+	// Out of room for new glyphs: double the atlas, up to a limit
+	auto* self = static_cast<PerformanceHud*>(aUser);
+	if( FONS_ATLAS_FULL == aError && self->mAtlasWidth < kMaxAtlasSize_ )
+		fonsExpandAtlas( self->mFons, self->mAtlasWidth * 2, self->mAtlasHeight * 2 );
+}
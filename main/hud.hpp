@@ -0,0 +1,132 @@
+#ifndef HUD_HPP_7A3C91E4_58B2_4F0D_9C6E_2D14B8F05A93
+#define HUD_HPP_7A3C91E4_58B2_4F0D_9C6E_2D14B8F05A93
+
+#include <glad.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "metrics.hpp"
+
+class ShaderProgram;
+
+class StreamBuffer;
+struct FONScontext;
+
+// Renderer counters of one frame, as shown by the HUD
+struct HudCounters
+{
+	std::size_t drawCalls = 0;
+	std::size_t triangles = 0;
+	std::size_t particles = 0;
+
+	// Frame pacing (see FramePacing), in milliseconds. The interval is the
+	// time between presents; latency is from input sampling to GPU completion.
+	char const* pacing = nullptr;
+	double frameInterval = 0.0;
+	double frameIntervalStddev = 0.0;
+	double latency = -1.0; // negative if unknown
+};
+
+/** PerformanceHud: on-screen frame times and renderer statistics
+ *
+ * Shows a graph of the recent CPU and GPU frame times, the rolling averages
+ * of all RenderMetricsTracker scopes, the HudCounters (frame pacing
+ * included) and the resident memory of the process.
+ *
+ * Text goes through fontstash, which rasterizes each glyph once into an
+ * atlas texture (grown on demand). The text is laid out a few times per
+ * second only, and its quads are reused in between; the graph is updated
+ * every frame. The quads of all text and of the graph are collected on the
+ * CPU and drawn with a single glDrawArrays() per frame from a StreamBuffer.
+ * Solid quads sample the white texels that fontstash keeps at the atlas
+ * origin.
+ *
+ * aProgram is assets/hud.vert + assets/hud.frag, and is not owned. Its id
+ * is looked up on each draw, so that reloads of the program take effect.
+ *
+ * Requires a current OpenGL 4.3 context for all methods, including the
+ * constructor and destructor.
+ */
+class PerformanceHud final
+{
+	public:
+		PerformanceHud( char const* aFontPath, ShaderProgram const& aProgram, std::size_t aGraphFrames = 120 );
+		~PerformanceHud();
+
+		PerformanceHud( PerformanceHud const& ) = delete;
+		PerformanceHud& operator= (PerformanceHud const&) = delete;
+
+	public:
+		// Adds a frame to the graph. Frames are shown in the order in which
+		// they are added.
+		void add_frame( FrameTiming const& );
+
+		// Draws the overlay on top of the current framebuffer, which is
+		// aWidth x aHeight pixels. Leaves depth testing and face culling
+		// enabled and blending disabled, like the rest of the renderer.
+		void draw( int aWidth, int aHeight, RenderMetricsTracker const&, HudCounters const& );
+
+		// Vertices drawn by the last draw()
+		std::size_t vertex_count() const noexcept;
+
+	private:
+		using Clock_ = std::chrono::steady_clock;
+
+		struct Vertex_
+		{
+			float x, y; // pixels, origin at the top left
+			float s, t;
+			std::uint32_t color; // RGBA8, as packed by rgba_() in hud.cpp
+		};
+
+		void layout_text_( RenderMetricsTracker const&, HudCounters const& );
+
+		// Returns the x coordinate after the text
+		float text_( float aX, float aY, std::uint32_t aColor, char const* aText );
+		void quad_( float aX0, float aY0, float aX1, float aY1, std::uint32_t aColor );
+
+		void create_atlas_( int aWidth, int aHeight );
+
+		// fontstash callbacks; aUser is the PerformanceHud
+		static int fons_create_( void* aUser, int aWidth, int aHeight );
+		static int fons_resize_( void* aUser, int aWidth, int aHeight );
+		static void fons_update_( void* aUser, int* aRect, unsigned char const* aData );
+		static void fons_draw_( void* aUser, float const* aVerts, float const* aTexCoords, unsigned int const* aColors, int aCount );
+		static void fons_delete_( void* aUser );
+		static void fons_error_( void* aUser, int aError, int aValue );
+
+	private:
+		ShaderProgram const* mProgram;
+
+		FONScontext* mFons;
+		int mFont;
+		float mLineHeight;
+
+		GLuint mAtlas;
+		int mAtlasWidth, mAtlasHeight;
+
+		std::unique_ptr<StreamBuffer> mVertexBuffer;
+		GLuint mVao;
+
+		std::vector<Vertex_> mVertices; // this frame's
+		std::size_t mVertexCount;
+
+		// Frame time ring, in milliseconds; GPU times < 0 are unknown
+		std::vector<float> mCpuTimes, mGpuTimes;
+		std::size_t mNextFrame;
+
+		// Text as of the last layout_text_()
+		std::vector<Vertex_> mTextVertices;
+		float mTextRight, mTextBottom;
+		std::size_t mTextScopes;
+		Clock_::time_point mNextTextUpdate;
+
+		std::size_t mResidentBytes;
+};
+
+#endif // HUD_HPP_7A3C91E4_58B2_4F0D_9C6E_2D14B8F05A93
@@ -0,0 +1,153 @@
+#include "instanced_mesh.hpp"
+
+#include <vector>
+
+#include <cassert>
+#include <cstring>
+
+#include "../support/error.hpp"
+#include "../support/checkpoint.hpp"
+
+#include "../vmlib/mat33.hpp"
+
+namespace
+{
+	// Vertex buffer binding points of the VAO
+	constexpr GLuint kInstanceBinding_ = 4;
+
+	// First per-instance attribute, see InstancedMesh
+	constexpr GLuint kModelAttrib_ = 4;
+	constexpr GLuint kNormalAttrib_ = 8;
+	constexpr GLuint kColorAttrib_ = 11;
+}
+
+InstancedMesh::InstancedMesh( SimpleMeshData const& aMesh, std::size_t aMaxInstances )
+	: mMaxInstances( aMaxInstances )
+	, mVertexCount( GLsizei(aMesh.positions.size()) )
+	, mInstanceCount( 0 )
+	, mVertexBuffers{ 0, 0, 0, 0 }
+	, mInstanceBuffer( 0 )
+	, mVao( 0 )
+{
+	assert( mMaxInstances > 0 );
+
+	glGenVertexArrays( 1, &mVao );
+	glBindVertexArray( mVao );
+
+	// Per-vertex data: one buffer per attribute, as in create_vao()
+	struct Stream_
+	{
+		void const* data;
+		std::size_t count;
+		GLint components;
+	};
+	Stream_ const streams[4] = {
+		{ aMesh.positions.data(), aMesh.positions.size(), 3 },
+		{ aMesh.colors.data(), aMesh.colors.size(), 3 },
+		{ aMesh.normals.data(), aMesh.normals.size(), 3 },
+		{ aMesh.textureCoords.data(), aMesh.textureCoords.size(), 2 }
+	};
+
+	glGenBuffers( 4, mVertexBuffers );
+	for( GLuint i = 0; i < 4; ++i )
+	{
+		auto const stride = GLsizei(streams[i].components * sizeof(float));
+
+		glBindBuffer( GL_ARRAY_BUFFER, mVertexBuffers[i] );
+		glBufferData( GL_ARRAY_BUFFER, streams[i].count * stride, streams[i].data, GL_STATIC_DRAW );
+
+		glVertexAttribFormat( i, streams[i].components, GL_FLOAT, GL_FALSE, 0 );
+		glVertexAttribBinding( i, i );
+		glBindVertexBuffer( i, mVertexBuffers[i], 0, stride );
+		glEnableVertexAttribArray( i );
+	}
+
+	// Per-instance data
+	glGenBuffers( 1, &mInstanceBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mInstanceBuffer );
+	glBufferData( GL_ARRAY_BUFFER, mMaxInstances * sizeof(Instance_), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	auto const instanceAttrib = [] (GLuint aIndex, GLint aComponents, std::size_t aOffset) {
+		glVertexAttribFormat( aIndex, aComponents, GL_FLOAT, GL_FALSE, GLuint(aOffset) );
+		glVertexAttribBinding( aIndex, kInstanceBinding_ );
+		glEnableVertexAttribArray( aIndex );
+	};
+
+	for( GLuint row = 0; row < 4; ++row )
+		instanceAttrib( kModelAttrib_+row, 4, offsetof(Instance_,model2World) + row*4*sizeof(float) );
+	for( GLuint row = 0; row < 3; ++row )
+		instanceAttrib( kNormalAttrib_+row, 3, offsetof(Instance_,normalMatrix) + row*3*sizeof(float) );
+	instanceAttrib( kColorAttrib_, 3, offsetof(Instance_,color) );
+
+	glBindVertexBuffer( kInstanceBinding_, mInstanceBuffer, 0, sizeof(Instance_) );
+	glVertexBindingDivisor( kInstanceBinding_, 1 );
+
+	glBindVertexArray( 0 );
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+InstancedMesh::~InstancedMesh()
+{
+	glDeleteVertexArrays( 1, &mVao );
+	glDeleteBuffers( 1, &mInstanceBuffer );
+	glDeleteBuffers( 4, mVertexBuffers );
+}
+
+void InstancedMesh::set_instances( MeshInstance const* aInstances, std::size_t aCount )
+{
+	if( aCount > mMaxInstances )
+		throw Error( "InstancedMesh: %zu instances, but room for only %zu", aCount, mMaxInstances );
+
+	std::vector<Instance_> packed( aCount );
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		auto const& in = aInstances[i];
+		auto& out = packed[i];
+
+		auto const normalMatrix = mat44_to_mat33( transpose( invert( in.model2World ) ) );
+
+		std::memcpy( out.model2World, in.model2World.v, sizeof(out.model2World) );
+		std::memcpy( out.normalMatrix, normalMatrix.v, sizeof(out.normalMatrix) );
+		out.color[0] = in.color.x;
+		out.color[1] = in.color.y;
+		out.color[2] = in.color.z;
+	}
+
+	if( aCount )
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, mInstanceBuffer );
+		glBufferSubData( GL_ARRAY_BUFFER, 0, aCount * sizeof(Instance_), packed.data() );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	}
+
+	mInstanceCount = GLsizei(aCount);
+}
+
+GLuint InstancedMesh::vao() const noexcept
+{
+	return mVao;
+}
+GLsizei InstancedMesh::vertex_count() const noexcept
+{
+	return mVertexCount;
+}
+GLsizei InstancedMesh::instance_count() const noexcept
+{
+	return mInstanceCount;
+}
+std::size_t InstancedMesh::max_instances() const noexcept
+{
+	return mMaxInstances;
+}
+
+void InstancedMesh::draw() const
+{
+	if( 0 == mInstanceCount )
+		return;
+
+	glBindVertexArray( mVao );
+	glDrawArraysInstanced( GL_TRIANGLES, 0, mVertexCount, mInstanceCount );
+	glBindVertexArray( 0 );
+}
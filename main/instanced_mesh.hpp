@@ -0,0 +1,80 @@
+#ifndef INSTANCED_MESH_HPP_5F2B8C41_D93E_4A07_8C6B_17E0A4D29F63
+#define INSTANCED_MESH_HPP_5F2B8C41_D93E_4A07_8C6B_17E0A4D29F63
+
+#include <glad.h>
+
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "simple_mesh.hpp"
+
+// Placement of one copy of an instanced mesh. The color is multiplied with
+// the mesh's vertex colors.
+struct MeshInstance
+{
+	Mat44f model2World;
+	Vec3f color;
+};
+
+/** InstancedMesh: one mesh, drawn many times with a single draw call
+ *
+ * The mesh is uploaded once. Each instance has its own model transform and
+ * color, stored in a separate instance buffer that feeds per-instance vertex
+ * attributes (glVertexAttribDivisor):
+ *
+ *   0-3  position, color, normal, texture coordinates (as create_vao())
+ *   4-7  model to world, rows
+ *   8-10 normal matrix, rows (derived from the model transform)
+ *   11   instance color
+ *
+ * assets/instanced.vert reads these. It also applies the regular per-draw
+ * model and normal matrices (uniform locations 0 and 1) on top, so an
+ * instanced mesh can be moved as a whole and submitted through the
+ * RenderQueue like any other draw.
+ *
+ * Requires a current OpenGL 4.3 context for all methods, including the
+ * constructor and destructor.
+ */
+class InstancedMesh final
+{
+	public:
+		InstancedMesh( SimpleMeshData const&, std::size_t aMaxInstances );
+		~InstancedMesh();
+
+		InstancedMesh( InstancedMesh const& ) = delete;
+		InstancedMesh& operator= (InstancedMesh const&) = delete;
+
+	public:
+		// Replaces all instances. Throws if there are more than aMaxInstances.
+		void set_instances( MeshInstance const*, std::size_t aCount );
+
+		GLuint vao() const noexcept;
+		GLsizei vertex_count() const noexcept;
+		GLsizei instance_count() const noexcept;
+		std::size_t max_instances() const noexcept;
+
+		// Draws all instances as GL_TRIANGLES. The caller sets up the program
+		// and its uniforms.
+		void draw() const;
+
+	private:
+		// Per-instance attributes, as read by the VAO
+		struct Instance_
+		{
+			float model2World[16];
+			float normalMatrix[9];
+			float color[3];
+		};
+
+		std::size_t mMaxInstances;
+		GLsizei mVertexCount;
+		GLsizei mInstanceCount;
+
+		GLuint mVertexBuffers[4];
+		GLuint mInstanceBuffer;
+		GLuint mVao;
+};
+
+#endif // INSTANCED_MESH_HPP_5F2B8C41_D93E_4A07_8C6B_17E0A4D29F63
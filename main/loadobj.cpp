@@ -3,9 +3,12 @@
 #include <rapidobj/rapidobj.hpp>
 
 #include "../support/error.hpp"
+#include "../support/profiler.hpp"
 
 SimpleMeshData load_wavefront_obj(char const* aPath)
 {
+    PROFILE_SCOPE("load_wavefront_obj");
+
     auto parseAndTriangulate = [&]() {
         auto objResult = rapidobj::ParseFile(aPath);
         if (objResult.error) {
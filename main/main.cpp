@@ -1,18 +1,28 @@
 #include <glad.h>
 #include <GLFW/glfw3.h>
 
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <string>
 #include <typeinfo>
+#include <iterator>
 #include <stdexcept>
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <cmath>
-#include <random>
 
 #include "../support/error.hpp"
 #include "../support/program.hpp"
 #include "../support/checkpoint.hpp"
 #include "../support/debug_output.hpp"
+#include "../support/profiler.hpp"
+#include "../support/stream_buffer.hpp"
+#include "../support/shader_builds.hpp"
+#include "../support/shader_variants.hpp"
+#include "../support/file_watcher.hpp"
 
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat44.hpp"
@@ -25,23 +35,46 @@
 #include "loadobj.hpp"
 #include "simple_mesh.hpp"
 #include "loadcustom.hpp"
+#include "gpu_particles.hpp"
+#include "simulation.hpp"
+#include "render_queue.hpp"
+#include "instanced_mesh.hpp"
+#include "geometry_heap.hpp"
+#include "transform_hierarchy.hpp"
+#include "bvh.hpp"
+#include "occlusion.hpp"
+#include "gpu_culling.hpp"
+#include "culling_validation.hpp"
+#include "draw_list.hpp"
+#include "frame_pipeline.hpp"
+#include "uniform_blocks.hpp"
+#include "worker_pool.hpp"
+#include "options.hpp"
+#include "headless.hpp"
+#include "benchmark.hpp"
+#include "metrics.hpp"
+#include "hud.hpp"
+#include "frame_pacing.hpp"
 
 #include "cube.hpp"
 #include "texture.hpp"
 
-#include "fontstash.h"
-
 namespace
 {
 	constexpr char const* kWindowTitle = "COMP3811 - CW2";
 
 	constexpr float kPi_ = 3.1415926f;
 
+	// Feature bits of the mesh shader variants, see assets/mesh.vert
+	constexpr std::uint32_t kMeshTexture_ = 1u << 0;
+	constexpr std::uint32_t kMeshVertexColor_ = 1u << 1;
+
 	float kMovementPerSecond_ = 5.f; // units per second
 	float kMouseSensitivity_ = 0.01f; // radians per pixel
 	struct State_ //struct for camera control
 	{
-		ShaderProgram* prog;
+		ShaderBuildService* shaderBuilds;
+		Simulation* sim;
 
 		struct CamCtrl_
 		{
@@ -59,12 +92,56 @@ namespace
 			float lastX, lastY;
 		} camControl;
 
-		// spaceship
-		bool moveUp = false;
-		float spaceshipOrigin = 0.f;
-		float spaceshipCurve = 0.f;
-		float acceleration = 0.1f;
-		float curve = 0.f;
+		// particle backend, toggled with P
+		bool gpuParticles = false;
+
+		// GPU-driven culling of terrain and ship, toggled with G
+		bool gpuCulling = false;
+
+		// Performance overlay, toggled with H
+		bool showHud = false;
+
+		// Frame pacing, cycled with V
+		FramePacing pacing = FramePacing::vsync;
+		bool pacingChanged = false;
+	};
+
+	// One frame, as handed from the build stage to the GL thread (see
+	// FramePipeline). The inputs are sampled on the main thread, everything
+	// else is filled in by the build stage.
+	struct Frame_
+	{
+		// Inputs
+		float dt; // seconds since the previous frame's inputs
+		float aspect;
+		float phi, theta;
+		Vec3f movementVec;
+		bool gpuCulling;
+		GLuint terrainProgram, shipProgram, launchPadProgram; // may change with shader reloads
+		float scriptTime; // benchmark timeline position; < 0 during warm-up
+		std::uint64_t inputTime; // profiler_now() when the inputs were sampled
+
+		// Camera and light
+		Mat44f viewProjection;
+		Mat44f projCameraWorld;
+		FrameUniforms uniforms;
+
+		// Draws that go through the render queue, sorted
+		DrawList draws;
+
+		// Ship placement, for the GPU culler
+		bool shipMoved;
+		Aabb shipBounds;
+		Mat44f ship2World;
+		Mat33f shipNormalMatrix;
+
+		// CPU particles, moved to the rendered point in time
+		std::size_t particleCount;
+		std::vector<float> particlePositions;
+
+		// Culling results
+		std::size_t visibleObjects;
+		OcclusionStats occlusion;
 	};
 
 	void glfw_callback_error_(int, char const*);
@@ -84,15 +161,11 @@ namespace
 }
 
 
-struct Sprite {
-	Vec3f position;
-	Vec3f velocity;
-	float lifespan;
-};
-
-std::vector<Sprite> sprites;
-GLuint texture, VBO, VAO;
 int maxSprites = 6000;
+StreamBuffer* spriteStream = nullptr; // one region of positions per frame
+std::size_t spriteFirst = 0; // first vertex of this frame's region
+GpuParticleSystem* gpuSprites = nullptr; // set while the GPU backend is active
+GLuint texture, VAO;
 
 
 void loadTexture() { 
@@ -100,110 +173,46 @@ void loadTexture() {
 	glGetError();
 }
 
-void setupSpriteBuffers() {
+void setupSpriteBuffers(StreamBuffer& stream) {
+	// Each region of the stream buffer holds the positions of a full pool.
+	// Regions are selected with the first vertex when drawing.
+	spriteStream = &stream;
+
 	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
 	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, maxSprites * 3 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0); 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 }
 
-std::mt19937 createRandomEngine() {
-	std::random_device rd;
-	return std::mt19937(rd());
-}
-
-std::uniform_real_distribution<> createUniformDistribution(double min, double max) {
-	return std::uniform_real_distribution<>(min, max);
-}
-
-float generateRandomValue(std::mt19937& gen, std::uniform_real_distribution<>& dis) {
-	return dis(gen);
+void extrapolateSpritePositions(const SimulationSnapshot& snap, float extrapolate, std::vector<float>& out) {
+	// Particles move linearly, so instead of interpolating (which would need
+	// to match particles across snapshots), the latest snapshot is moved
+	// along the velocities to the rendered point in time.
+	out.resize(3 * snap.particleCount);
+	const float* pos = snap.particlePositions.data();
+	const float* vel = snap.particleVelocities.data();
+	for (std::size_t i = 0; i < 3 * snap.particleCount; ++i)
+		out[i] = pos[i] + vel[i] * extrapolate;
 }
 
-Vec3f computeDirection(float phi, float theta) {
-	Vec3f randomDirection;
-	randomDirection.x = sin(phi) * cos(theta);
-	randomDirection.y = sin(phi) * sin(theta);
-	randomDirection.z = cos(phi);
-	return randomDirection;
+void updateSpritePositions(const std::vector<float>& positions) {
+	// Copy this frame's positions into the (mapped) region. The region is
+	// fenced in renderSprites(), after the draw reading it.
+	std::memcpy(spriteStream->map(), positions.data(), positions.size() * sizeof(float));
+	spriteFirst = spriteStream->region_offset() / (3 * sizeof(float));
 }
 
-Vec3f randomConicalDirection(Vec3f direction) {
-	// Initialize random engine and distribution
-	static std::mt19937 gen = createRandomEngine();
-	static std::uniform_real_distribution<> dis(0, 1);
-
-	// Generate random spherical coordinates
-	float theta = 2 * kPi_ * generateRandomValue(gen, dis);
-	float phi = acos(1 - generateRandomValue(gen, dis) * (1 - cos(45)));
-
-	// Compute and return random direction
-	return computeDirection(phi, theta);
+void updateGpuSprites(Simulation& sim, std::vector<ParticleSpawn>& spawns, float dt) {
+	sim.take_gpu_spawns(spawns);
+	for (const auto& sp : spawns)
+		gpuSprites->spawn(sp.position, sp.velocity, sp.lifespan);
+	gpuSprites->update(dt);
 }
 
-void updateSpritePositions(const std::vector<Sprite>& sprites) {
-	// Preallocate memory for positions
-	std::vector<float> positions;
-	positions.reserve(sprites.size() * 3);
-
-	// Populate positions vector
-	for (size_t i = 0; i < sprites.size(); ++i) {
-		const Sprite& s = sprites[i];
-		positions.emplace_back(s.position.x);
-		positions.emplace_back(s.position.y);
-		positions.emplace_back(s.position.z);
-	}
-
-	// Bind VBO and upload data
-	GLsizeiptr dataSize = positions.size() * sizeof(float);
-	const void* bufferData = positions.data();
-	GLenum usage = GL_DYNAMIC_DRAW;
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, dataSize, bufferData, usage);
-
-	// Unbind buffer
-	GLenum target = GL_ARRAY_BUFFER;
-	glBindBuffer(target, 0);
-}
-
-void generateSprites(Vec3f spaceshipPosition, int spriteAmount, Vec3f direction) {
-	for (int i = 0; i < spriteAmount; i++)
-	{
-		Sprite sprite;
-		sprite.position = spaceshipPosition;
-		sprite.velocity = randomConicalDirection(direction);
-		sprite.lifespan = 0.5f;
-		sprites.emplace_back(sprite);
-	}
-}
-
-void updateSprites(float dt) {
-    for (size_t i = 0; i < sprites.size(); ++i) {
-        sprites[i].position.x += sprites[i].velocity.x * dt;
-        sprites[i].position.y += sprites[i].velocity.y * dt;
-        sprites[i].position.z += sprites[i].velocity.z * dt;
-        sprites[i].lifespan -= dt;
-    }
-
-    // Remove dead sprites (manual iteration)
-    std::vector<Sprite> updatedSprites;
-    for (size_t i = 0; i < sprites.size(); ++i) {
-        if (sprites[i].lifespan > 0) {
-            updatedSprites.push_back(sprites[i]);
-        }
-    }
-
-    // Replace the original vector with the updated one
-    sprites = updatedSprites;
-}
-
-void renderSprites(Mat44f project2World, GLuint shader) {
+void renderSprites(Mat44f project2World, GLuint shader, std::size_t count) {
 	glEnable(GL_BLEND); 
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE); 
 	glActiveTexture(GL_TEXTURE0); 
@@ -212,9 +221,15 @@ void renderSprites(Mat44f project2World, GLuint shader) {
 	glEnable(GL_PROGRAM_POINT_SIZE);
 	glUniformMatrix4fv(0,1, GL_TRUE,project2World.v);
 	glUniform1i(1, 0); 
-	glBindVertexArray(VAO);
-	glDrawArrays(GL_POINTS, 0, sprites.size()); 
-	glBindVertexArray(0); 
+	if (gpuSprites) {
+		gpuSprites->draw();
+	}
+	else {
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_POINTS, GLint(spriteFirst), GLsizei(count)); 
+		glBindVertexArray(0); 
+		spriteStream->fence();
+	}
 	glDisable(GL_BLEND);
 }
 
@@ -272,76 +287,124 @@ inline SimpleMeshData spaceship() {
 	return finalSpaceship;
 }
 
-int main() try
+int main( int aArgc, char* aArgv[] ) try
 {
-	// Initialize GLFW
-	if( GLFW_TRUE != glfwInit() )
+	RunOptions options = parse_run_options( aArgc, aArgv );
+	if( options.help )
+	{
+		std::printf( "Usage: %s [options]\n%s", aArgv[0], run_options_usage() );
+		return 0;
+	}
+
+	// Profile the whole run, startup included
+	if( !options.tracePath.empty() )
 	{
-		char const* msg = nullptr;
-		int ecode = glfwGetError( &msg );
-		throw Error( "glfwInit() failed with '%s' (%d)", msg, ecode );
+		PROFILE_THREAD( "main" );
+		profiler_start_capture();
 	}
+	std::uint64_t const startupBegin = profiler_now();
+
+	// Load the timeline first, so that a broken script fails early
+	BenchmarkScript script;
+	if( options.benchmark )
+		script = load_benchmark_script( options.scriptPath.c_str() );
 
-	// Ensure that we call glfwTerminate() at the end of the program.
+	// Ensure that we call glfwTerminate() at the end of the program. This is
+	// harmless if GLFW was never initialized (headless mode).
 	GLFWCleanupHelper cleanupHelper; 
+	GLFWWindowDeleter windowDeleter{ nullptr };
 
-	// Configure GLFW and create window
-	glfwSetErrorCallback( &glfw_callback_error_ );
+	GLFWwindow* window = nullptr;
+	std::unique_ptr<HeadlessContext> headlessContext;
 
-	glfwWindowHint( GLFW_SRGB_CAPABLE, GLFW_TRUE );
-	glfwWindowHint( GLFW_DOUBLEBUFFER, GLFW_TRUE );
+	if( options.headless )
+	{
+		// No window system at all: a surfaceless EGL context, rendering
+		// into an offscreen framebuffer (created below).
+#		if !defined(NDEBUG)
+		headlessContext = std::make_unique<HeadlessContext>( true );
+#		else
+		headlessContext = std::make_unique<HeadlessContext>( false );
+#		endif // ~ !NDEBUG
+	}
+	else
+	{
+		// Initialize GLFW
+		if( GLFW_TRUE != glfwInit() )
+		{
+			char const* msg = nullptr;
+			int ecode = glfwGetError( &msg );
+			throw Error( "glfwInit() failed with '%s' (%d)", msg, ecode );
+		}
 
-	//glfwWindowHint( GLFW_RESIZABLE, GLFW_FALSE );
+		// Configure GLFW and create window
+		glfwSetErrorCallback( &glfw_callback_error_ );
 
-	glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
-	glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
-	glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE );
-	glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
+		glfwWindowHint( GLFW_SRGB_CAPABLE, GLFW_TRUE );
+		glfwWindowHint( GLFW_DOUBLEBUFFER, GLFW_TRUE );
 
-	glfwWindowHint(GLFW_DEPTH_BITS, 24);
+		//glfwWindowHint( GLFW_RESIZABLE, GLFW_FALSE );
 
-#	if !defined(NDEBUG)
-	// When building in debug mode, request an OpenGL debug context. This
-	// enables additional debugging features. However, this can carry extra
-	// overheads. We therefore do not do this for release builds.
-	glfwWindowHint( GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE );
-#	endif // ~ !NDEBUG
+		glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
+		glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+		glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE );
+		glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
 
-	GLFWwindow* window = glfwCreateWindow(
-		1280,
-		720,
-		kWindowTitle,
-		nullptr, nullptr
-	);
+		glfwWindowHint(GLFW_DEPTH_BITS, 24);
 
-	if( !window )
-	{
-		char const* msg = nullptr;
-		int ecode = glfwGetError( &msg );
-		throw Error( "glfwCreateWindow() failed with '%s' (%d)", msg, ecode );
-	}
+#		if !defined(NDEBUG)
+		// When building in debug mode, request an OpenGL debug context. This
+		// enables additional debugging features. However, this can carry extra
+		// overheads. We therefore do not do this for release builds.
+		glfwWindowHint( GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE );
+#		endif // ~ !NDEBUG
+
+		window = glfwCreateWindow(
+			options.width,
+			options.height,
+			kWindowTitle,
+			nullptr, nullptr
+		);
 
-	GLFWWindowDeleter windowDeleter{ window };
+		if( !window )
+		{
+			char const* msg = nullptr;
+			int ecode = glfwGetError( &msg );
+			throw Error( "glfwCreateWindow() failed with '%s' (%d)", msg, ecode );
+		}
+
+		windowDeleter.window = window;
+	}
 
 	// Set up event handling
 	State_ state{};
+	state.pacing = options.pacing;
+	state.gpuCulling = options.validateCulling;
 
-	//TODO: Additional event handling setup
-	//setting up keyboard event handling
-	glfwSetWindowUserPointer(window, &state);
-	glfwSetKeyCallback(window, &glfw_callback_key_);
-	glfwSetCursorPosCallback(window, &glfw_callback_motion_);
-	//endofTODO
-
-	glfwSetKeyCallback( window, &glfw_callback_key_ );
+	if( window )
+	{
+		// Benchmarks ignore all input; the script drives camera and ship.
+		if( !options.benchmark )
+		{
+			//TODO: Additional event handling setup
+			//setting up keyboard event handling
+			glfwSetWindowUserPointer(window, &state);
+			glfwSetKeyCallback(window, &glfw_callback_key_);
+			glfwSetCursorPosCallback(window, &glfw_callback_motion_);
+			//endofTODO
+
+			glfwSetKeyCallback( window, &glfw_callback_key_ );
+		}
 
-	// Set up drawing stuff
-	glfwMakeContextCurrent( window );
-	glfwSwapInterval( 1 ); // V-Sync is on.
+		// Set up drawing stuff
+		glfwMakeContextCurrent( window );
+		glfwSwapInterval( frame_pacing_vsync( options.pacing ) ? 1 : 0 );
+	}
 
 	// Initialize GLAD
 	// This will load the OpenGL API. We mustn't make any OpenGL calls before this!
-	if( !gladLoadGLLoader( (GLADloadproc)&glfwGetProcAddress ) )
+	GLADloadproc loader = window ? (GLADloadproc)&glfwGetProcAddress : (GLADloadproc)&HeadlessContext::get_proc_address;
+	if( !gladLoadGLLoader( loader ) )
 		throw Error( "gladLoaDGLLoader() failed - cannot load GL API!" );
 
 	std::printf( "RENDERER %s\n", glGetString( GL_RENDERER ) );
@@ -366,62 +429,124 @@ int main() try
 
 	OGL_CHECKPOINT_ALWAYS();
 
+	// Headless: everything is drawn into this instead of a default
+	// framebuffer. It stays bound for the whole run.
+	std::unique_ptr<OffscreenTarget> offscreen;
+	if( !window )
+	{
+		offscreen = std::make_unique<OffscreenTarget>( options.width, options.height );
+		offscreen->bind();
+	}
+
 	// Get actual framebuffer size.
 	// This can be different from the window size, as standard window
 	// decorations (title bar, borders, ...) may be included in the window size
 	// but not be part of the drawable surface area.
+	auto getFramebufferSize = [&] (int& aWidth, int& aHeight) {
+		if( window )
+			glfwGetFramebufferSize( window, &aWidth, &aHeight );
+		else
+		{
+			aWidth = offscreen->width();
+			aHeight = offscreen->height();
+		}
+	};
+
 	int iwidth, iheight;
-	glfwGetFramebufferSize( window, &iwidth, &iheight );
+	getFramebufferSize( iwidth, iheight );
 
 	glViewport( 0, 0, iwidth, iheight );
 
-	//load shader program
-	ShaderProgram prog({
-		{ GL_VERTEX_SHADER, "assets/default.vert" },
-		{ GL_FRAGMENT_SHADER, "assets/default.frag" }
-		});
+	// Linked programs are reused across runs; see the summary after startup
+	ShaderProgram::set_binary_cache( options.shaderCacheDirectory );
 
-	state.prog = &prog;
+	// All programs are submitted at once and built in the background, while
+	// the assets below load; until a program is ready, its draws use the
+	// fallback. Programs that cannot fall back (the compute shaders and the
+	// HUD) are waited for.
+	ShaderProgram fallbackProg({
+		{ GL_VERTEX_SHADER, "assets/fallback.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/fallback.frag" }
+		});
+	ShaderBuildService shaderBuilds(fallbackProg.programId());
+
+	// Meshes share one fragment shader, specialized per draw by the features
+	// the mesh has. Variants are built on first use. Landing pads are drawn
+	// instanced (see launchPads below), and the GPU culling path has its own
+	// vertex shader (see gpuCuller below).
+	const std::vector<std::string> meshFeatures{ "HAS_TEXTURE", "HAS_VERTEX_COLOR" };
+	ShaderVariants meshShaders({
+		{ GL_VERTEX_SHADER, "assets/mesh.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/mesh.frag" }
+		}, meshFeatures, &shaderBuilds);
+	ShaderVariants instancedShaders({
+		{ GL_VERTEX_SHADER, "assets/instanced.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/mesh.frag" }
+		}, meshFeatures, &shaderBuilds);
+	ShaderVariants culledShaders({
+		{ GL_VERTEX_SHADER, "assets/culled.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/mesh.frag" }
+		}, meshFeatures, &shaderBuilds);
+
+	const std::uint32_t terrainFeatures = kMeshTexture_;
+	const std::uint32_t shipFeatures = kMeshVertexColor_;
+	const std::uint32_t launchPadFeatures = kMeshVertexColor_;
+
+	// Request the variants that the first frame uses, so that they build
+	// together with the other programs
+	meshShaders.variant(terrainFeatures);
+	meshShaders.variant(shipFeatures);
+	instancedShaders.variant(launchPadFeatures);
+
+	ShaderProgram prog3({
+		{ GL_VERTEX_SHADER, "assets/points.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/points.frag" }
+		}, shaderBuilds);
+
+	ShaderProgram particleProg({
+		{ GL_COMPUTE_SHADER, "assets/particles.comp" }
+		}, shaderBuilds);
+
+	// GPU-driven culling, see gpuCuller below
+	ShaderProgram cullProg({
+		{ GL_COMPUTE_SHADER, "assets/cull.comp" }
+		}, shaderBuilds);
+
+	// Performance overlay
+	ShaderProgram hudProg({
+		{ GL_VERTEX_SHADER, "assets/hud.vert" },
+		{ GL_FRAGMENT_SHADER, "assets/hud.frag" }
+		}, shaderBuilds);
+
+	state.shaderBuilds = &shaderBuilds;
+
+	// Shader hot reload: programs that read a changed file under assets/
+	// are rebuilt in the background and swapped in by shaderBuilds.update()
+	std::unique_ptr<FileWatcher> shaderWatcher;
+	if (options.watchShaders)
+		shaderWatcher = std::make_unique<FileWatcher>("assets");
 	state.camControl.radius = 10.f;
 
 	auto last = Clock::now();
 	float angle = 0.f;
 
 	auto parlahti = load_wavefront_obj("assets/parlahti.obj");
-	
-	GLuint vao = create_vao(parlahti);
-	std::size_t vertexCount = parlahti.positions.size();
 
+	// The sources have likely been read by now; have the driver compile
+	// while the texture decodes
+	shaderBuilds.update();
 
 	GLuint textures = load_texture_2d("assets/L4343A-4k.jpeg");
 
-	ShaderProgram prog2 = ShaderProgram({
-		{GL_VERTEX_SHADER, "assets/launch.vert"},
-		{GL_FRAGMENT_SHADER, "assets/launch.frag"}
-		});
-
-	SimpleMeshData launch = load_wavefront_obj("assets/landingpad.obj");
-	std::size_t launchVertexCount = launch.positions.size();
-	std::vector<Vec3f> originalPositions(launch.positions.begin(), launch.positions.end());
-
-	auto adjustLaunchPositions = [&](SimpleMeshData& mesh, Vec3f offset) {
-		for (Vec3f& position : mesh.positions) {
-			position = position + offset;
-		}
-		};
-
-	adjustLaunchPositions(launch, Vec3f{ 0.f, -0.975f, -60.f });
-
-	GLuint launch_vao_1 = create_vao(launch);
-
-	// Reset positions
-	launch.positions.assign(originalPositions.begin(), originalPositions.end());
-
-	// Move the second launch object
-	adjustLaunchPositions(launch, Vec3f{ -20.f, -0.975f, -10.f });
-
-	// Create VAO for the second launchpad
-	GLuint launch_vao_2 = create_vao(launch);
+	// Landing pads: one copy of the mesh, drawn once per pad with a single
+	// instanced draw call.
+	SimpleMeshData launchPadMesh = load_wavefront_obj("assets/landingpad.obj");
+	InstancedMesh launchPads(launchPadMesh, 256);
+	MeshInstance const launchPadInstances[] = {
+		{ make_translation(Vec3f{ 0.f, -0.975f, -60.f }), Vec3f{ 1.f, 1.f, 1.f } },
+		{ make_translation(Vec3f{ -20.f, -0.975f, -10.f }), Vec3f{ 1.f, 1.f, 1.f } }
+	};
+	launchPads.set_instances(launchPadInstances, std::size(launchPadInstances));
 
 
 	 auto ship = spaceship();
@@ -433,107 +558,321 @@ int main() try
 		 ship.positions[i] = ship.positions[i] + Vec3f{ -20.f, -1.125f, -10.f };
 	 }
 
-	 // Create VAO for the ship
-	 GLuint ship_one_vao = create_vao(ship);
-	 ShaderProgram prog3({
-			 { GL_VERTEX_SHADER, "assets/points.vert" },
-			 { GL_FRAGMENT_SHADER, "assets/points.frag" }
-	 });
+	 // Terrain and ship share one vertex/index buffer and VAO, so that draws
+	 // with the same state can be merged into a single multi-draw.
+	 std::size_t staticVertices = parlahti.positions.size() + shipVertexCount;
+	 GeometryHeap geometry(staticVertices, staticVertices);
+	 GeometryRange terrainMesh = geometry.add(parlahti);
+	 GeometryRange shipMesh = geometry.add(ship);
 	 loadTexture();
-	 setupSpriteBuffers();
-	 
+	 StreamBuffer spriteBuffer(maxSprites * 3 * sizeof(float));
+	 setupSpriteBuffers(spriteBuffer);
+
+	 // Threads for data-parallel work (particle updates on the simulation
+	 // thread, occlusion rasterization in the build stage). The calling
+	 // thread takes part in each job, so this creates
+	 // hardware_concurrency()-1 additional threads.
+	 WorkerPool workers;
+
+	 // GPU particle backend: same emitter, but simulated by a compute shader
+	 // and drawn indirectly. Selected at runtime with P.
+	 shaderBuilds.wait(particleProg);
+	 GpuParticleSystem gpuSystem(maxSprites, maxSprites, particleProg);
+	 std::vector<ParticleSpawn> gpuSpawns;
+
+	 // Ship and particles are simulated at a fixed 60 Hz on their own
+	 // thread; the loop below only renders the latest published state.
+	 // Benchmarks instead step the simulation once per frame (see
+	 // buildFrame), so that every run renders the same states.
+	 Simulation sim(1.f / 60.f, maxSprites, workers);
+	 state.sim = &sim;
+	 if (!options.benchmark)
+		 sim.start();
+
+	 RenderQueue renderQueue;
+	 std::size_t lastDrawCalls = 0, lastStateChanges = 0;
+
+	 // Per-frame camera and light (FrameData uniform block); one region per
+	 // frame in flight.
+	 StreamBuffer frameUniforms(uniform_block_stride(sizeof(FrameUniforms)));
+
+	 // Object transforms. The terrain never moves; the ship pitches around
+	 // its pivot (see ship_pose()), so the mesh hangs below a pivot node.
+	 TransformHierarchy transforms;
+	 TransformNode sceneNode = transforms.add();
+	 TransformNode shipNode = transforms.add();
+	 TransformNode shipModelNode = transforms.add(shipNode);
+	 transforms.set_translation(shipModelNode, kShipPivot);
+
+	 // World space bounds of the scene objects, for frustum culling. Only
+	 // the ship moves; the BVH is refit when it does.
+	 const std::uint32_t terrainObject = 0, launchPadsObject = 1, shipObject = 2;
+	 Aabb shipBounds = make_aabb(ship.positions.data(), ship.positions.size());
+	 Aabb padBounds = make_aabb(launchPadMesh.positions.data(), launchPadMesh.positions.size());
+
+	 std::vector<Aabb> objectBounds(3);
+	 objectBounds[terrainObject] = make_aabb(parlahti.positions.data(), parlahti.positions.size());
+	 objectBounds[launchPadsObject] = transform_aabb(padBounds, launchPadInstances[0].model2World);
+	 for (const MeshInstance& pad : launchPadInstances)
+		 objectBounds[launchPadsObject] = merge(objectBounds[launchPadsObject], transform_aabb(padBounds, pad.model2World));
+	 objectBounds[shipObject] = shipBounds;
+
+	 Bvh sceneBvh;
+	 sceneBvh.build(objectBounds.data(), objectBounds.size());
+	 std::vector<std::uint32_t> visibleObjects;
+	 std::size_t lastVisible = ~std::size_t(0);
+
+	 // Software occlusion culling: terrain and pads are rasterized into a
+	 // small depth buffer on the CPU, and the ship is tested against it.
+	 // The occluders are simplified copies of the meshes, made once here.
+	 // Rasterization shares `workers` with the simulation.
+	 OcclusionBuffer occlusion(256, 128);
+	 std::vector<Vec3f> terrainOccluder = simplify_occluder(parlahti.positions.data(), parlahti.positions.size(), 32);
+	 std::vector<Vec3f> padOccluder = simplify_occluder(launchPadMesh.positions.data(), launchPadMesh.positions.size(), 8);
+	 std::fprintf(stderr, "Occluders: terrain %zu -> %zu triangles, launch pad %zu -> %zu triangles\n",
+		 parlahti.positions.size() / 3, terrainOccluder.size() / 3, launchPadMesh.positions.size() / 3, padOccluder.size() / 3);
+	 std::size_t lastOccluded = ~std::size_t(0);
+
+	 // GPU-driven alternative for the meshes in `geometry`: a compute pass
+	 // culls them and writes the indirect draws. Group 0 is the terrain,
+	 // group 1 the ship; each group is drawn with its mesh's variant of
+	 // culledShaders.
+
+	 const std::uint32_t gpuShipObject = 1;
+	 const std::uint32_t texturedGroup = 0, coloredGroup = 1;
+	 transforms.update();
+	 GpuDrawObject gpuObjects[] = {
+		 { objectBounds[terrainObject], transforms.world(sceneNode), transforms.normal_matrix(sceneNode), texturedGroup,
+			 terrainMesh.firstIndex, terrainMesh.indexCount, GLint(terrainMesh.firstVertex) },
+		 { objectBounds[shipObject], transforms.world(shipModelNode), transforms.normal_matrix(shipModelNode), coloredGroup,
+			 shipMesh.firstIndex, shipMesh.indexCount, GLint(shipMesh.firstVertex) }
+	 };
+	 shaderBuilds.wait(cullProg);
+	 GpuCuller gpuCuller(std::size(gpuObjects), 2, cullProg);
+	 gpuCuller.set_objects(gpuObjects, std::size(gpuObjects));
+	 gpuCuller.attach(geometry.vao());
+
+	 // --validate-culling: after each GPU cull, the visible set read back
+	 // from the GPU must equal frustum_cull() on the bounds the GPU culled.
+	 // A CullingValidator also checks all scene objects plus a field of
+	 // random boxes, from a few fixed views at startup and from each
+	 // frame's camera.
+	 std::vector<Aabb> gpuBounds;
+	 for (const GpuDrawObject& object : gpuObjects)
+		 gpuBounds.emplace_back(object.bounds);
+	 std::vector<std::uint32_t> gpuVisible, cpuVisible;
+	 std::size_t validatedFrames = 0;
+
+	 std::unique_ptr<CullingValidator> cullingValidator;
+	 if (options.validateCulling) {
+		 cullingValidator = std::make_unique<CullingValidator>(objectBounds, 20000, cullProg);
+
+		 Aabb scene = objectBounds[0];
+		 for (const Aabb& bounds : objectBounds)
+			 scene = merge(scene, bounds);
+
+		 const Mat44f projection = make_perspective_projection(60 * kPi_ / 180.f, float(options.width) / float(options.height), 0.1f, 100.f);
+		 std::vector<Mat44f> views = make_validation_views(scene, projection, 8);
+		 for (std::size_t i = 0; i < views.size(); ++i) {
+			 char name[32];
+			 std::snprintf(name, sizeof(name), "fixed view %zu", i);
+			 cullingValidator->check(views[i], name);
+		 }
+	 }
+
+	 auto validateCulling = [&](const Mat44f& viewProjection) {
+		 gpuCuller.read_back_visible(gpuVisible);
+		 frustum_cull(make_frustum(viewProjection), gpuBounds.data(), gpuBounds.size(), cpuVisible);
+
+		 if (gpuVisible != cpuVisible) {
+			 auto list = [](const std::vector<std::uint32_t>& objects) {
+				 std::string ret;
+				 for (std::uint32_t object : objects)
+					 ret += (ret.empty() ? "" : ", ") + std::to_string(object);
+				 return ret.empty() ? std::string("none") : ret;
+			 };
+			 throw Error("Culling validation failed in frame %zu: GPU visible %s, CPU visible %s",
+				 validatedFrames, list(gpuVisible).c_str(), list(cpuVisible).c_str());
+		 }
+
+		 char name[32];
+		 std::snprintf(name, sizeof(name), "frame %zu", validatedFrames);
+		 cullingValidator->check(viewProjection, name);
+
+		 ++validatedFrames;
+	 };
+
+	 // The render queue's material buffer is per frame; the GPU path has
+	 // its own, constant, material.
+	 GLuint gpuMaterial = 0;
+	 MaterialUniforms gpuMaterialData{ Vec4f{ 1.f, 1.f, 1.f, 0.f }, Vec4f{ 1.f, 1.f, 1.f, 0.f } };
+	 glGenBuffers(1, &gpuMaterial);
+	 glBindBuffer(GL_UNIFORM_BUFFER, gpuMaterial);
+	 glBufferData(GL_UNIFORM_BUFFER, sizeof(gpuMaterialData), &gpuMaterialData, GL_STATIC_DRAW);
+	 glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
 
 	OGL_CHECKPOINT_ALWAYS();
 
-	// Main loop
-	while( !glfwWindowShouldClose( window ) )
-	{
-		// Let GLFW process events
-		glfwPollEvents();
+	// Build stage: everything up to the sorted draw list, without any GL
+	// calls. Runs on the pipeline's thread, one frame ahead of the GL
+	// thread. Only the build stage touches the simulation snapshots, the
+	// transforms and the culling structures.
+	std::vector<BenchmarkAction> scriptActions;
+	auto buildFrame = [&](Frame_& frame) {
+		// Benchmark: the timeline's commands for this frame, then exactly
+		// one simulation step. Done here rather than on the main thread, so
+		// that frames cannot pick up steps meant for later ones.
+		if (options.benchmark) {
+			if (frame.scriptTime >= 0.f) {
+				benchmark_events_in(script, frame.scriptTime, frame.scriptTime + sim.step_length(), scriptActions);
+				for (BenchmarkAction action : scriptActions) {
+					if (BenchmarkAction::launch == action)
+						sim.launch();
+					else
+						sim.reset();
+				}
+			}
+			sim.step();
+		}
 
-		
-		// Check if window was resized.
-		float fbwidth, fbheight;
-		{
-			int nwidth, nheight;
-			glfwGetFramebufferSize( window, &nwidth, &nheight );
+		// Latest simulation state. Rendering lags one step behind, so that
+		// the ship can be interpolated between the last two steps.
+		const SimulationSnapshot& snap = sim.latest();
+		float alpha = options.benchmark ? 1.f : sim.interpolation_alpha(snap, sim.current_time());
 
-			fbwidth = float(nwidth);
-			fbheight = float(nheight);
+		ShipState ship = interpolate(snap.previousShip, snap.ship, alpha);
+		ShipPose shipPose = ship_pose(ship);
+		transforms.set_translation(shipNode, shipPose.translation);
+		transforms.set_rotation(shipNode, Vec3f{ shipPose.pitch, 0.f, 0.f });
 
-			if( 0 == nwidth || 0 == nheight )
-			{
-				// Window minimized? Pause until it is unminimized.
-				// This is a bit of a hack.
-				do
-				{
-					glfwWaitEvents();
-					glfwGetFramebufferSize( window, &nwidth, &nheight );
-				} while( 0 == nwidth || 0 == nheight );
-			}
+		// Recomputes only what moved since the last frame
+		transforms.update();
+		const Mat44f& model2World = transforms.world(sceneNode);
+		const Mat44f& spaceship2World = transforms.world(shipModelNode);
 
-			glViewport( 0, 0, nwidth, nheight );
-		}
+		Mat44f Rx = make_rotation_x(frame.theta);
+		Mat44f Ry = make_rotation_y(frame.phi);
+		Mat44f T = make_translation(frame.movementVec);
 
-		//TODO: update state
-		auto calculateDeltaTime = [&](Clock::time_point& lastTime) {
-			auto now = Clock::now();
-			float deltaTime = std::chrono::duration_cast<Secondsf>(now - lastTime).count();
-			lastTime = now;
-			return deltaTime;
-			};
-		float dt = calculateDeltaTime(last);
+		Mat44f world2Camera = Rx * Ry * T;
 
-		angle += dt * kPi_ * 0.3f;
-		if (angle >= 2.f * kPi_) {
-			angle -= 2.f * kPi_;
-		}
+		Mat44f projection = make_perspective_projection(
+			60 * kPi_ / 180.f,
+			frame.aspect,
+			0.1f,
+			100.f);
 
-		Mat44f model2World = make_rotation_y(0);
+		Mat44f viewProjection = projection * world2Camera;
+		Mat44f projCameraWorld = viewProjection * model2World;
+		Mat44f spaceshipModel2World = viewProjection * spaceship2World;
+
+		frame.viewProjection = viewProjection;
+		frame.projCameraWorld = projCameraWorld;
+		frame.uniforms = FrameUniforms{
+			viewProjection,
+			Vec4f{ 0.f, 1.f, -1.f, 0.f } * (1.f / std::sqrt(2.f)),
+			Vec4f{ 0.9f, 0.9f, 0.9f, 0.f },
+			Vec4f{ 0.05f, 0.05f, 0.05f, 0.f }
+		};
 
-		auto updateSpaceshipWorldMatrix = [&]() -> Mat44f {
-			if (!state.moveUp) return model2World;
+		frame.particleCount = snap.particleCount;
+		extrapolateSpritePositions(snap, (alpha - 1.f) * sim.step_length(), frame.particlePositions);
 
-			state.spaceshipOrigin += state.acceleration * dt;
-			state.acceleration *= 1.0025;
+		// Visible set for this frame
+		frame.shipMoved = transforms.world_changed(shipModelNode);
+		if (frame.shipMoved) {
+			objectBounds[shipObject] = transform_aabb(shipBounds, spaceship2World);
+			sceneBvh.refit(objectBounds.data());
 
-			if (state.spaceshipOrigin > 0.5f) {
-				state.spaceshipCurve += (0.05f * dt);
-				state.spaceshipCurve *= 1.005f;
-			}
+			frame.shipBounds = objectBounds[shipObject];
+			frame.ship2World = spaceship2World;
+			frame.shipNormalMatrix = transforms.normal_matrix(shipModelNode);
+		}
+		sceneBvh.cull(make_frustum(viewProjection), visibleObjects);
+
+		bool objectVisible[3] = {};
+		for (std::uint32_t object : visibleObjects)
+			objectVisible[object] = true;
+
+		occlusion.begin(viewProjection);
+		occlusion.add_occluder(terrainOccluder.data(), terrainOccluder.size(), model2World);
+		for (const MeshInstance& pad : launchPadInstances)
+			occlusion.add_occluder(padOccluder.data(), padOccluder.size(), pad.model2World);
+		occlusion.rasterize(workers);
+
+		if (objectVisible[shipObject] && !occlusion.visible(objectBounds[shipObject]))
+			objectVisible[shipObject] = false;
+
+		frame.visibleObjects = 0;
+		for (bool visible : objectVisible)
+			frame.visibleObjects += visible ? 1 : 0;
+		frame.occlusion = occlusion.stats();
+
+		// With GPU culling, terrain and ship are drawn by the GPU culler
+		// instead.
+		if (frame.gpuCulling) {
+			objectVisible[terrainObject] = false;
+			objectVisible[shipObject] = false;
+		}
 
-			// Calculate rotation angle for spaceship
-			auto calculateRotationAngle = [](float curve, float origin) -> float {
-				return std::atan2(curve, origin);
-				};
-			float angleX = calculateRotationAngle(state.spaceshipCurve, state.spaceshipOrigin);
+		// Meshes go through the render queue, which sorts them by state and
+		// skips redundant binds and uniform uploads.
+		DrawList& draws = frame.draws;
+		draws.clear();
+
+		RenderMaterial sceneMaterial{
+			Vec3f{ 1.f, 1.f, 1.f },
+			Vec3f{ 1.f, 1.f, 1.f }
+		};
+		std::uint32_t material = draws.add_material(sceneMaterial);
+		std::uint32_t sceneTransform = draws.add_transform({ model2World, transforms.normal_matrix(sceneNode) });
 
-			Mat44f translationToOrigin = make_translation(Vec3f{ 20.f, 1.125f, 15.f });
-			Mat44f xRotationMatrix = make_rotation_x(angleX);
-			Mat44f originToTranslation = make_translation(Vec3f{ -20.f, -1.125f, -15.f });
-			Mat44f translationMatrix = make_translation(Vec3f{ 0.f, state.spaceshipOrigin, state.spaceshipCurve });
+		// View depth of the object's origin, normalized by the far plane
+		auto viewDepth = [](const Mat44f& projCameraModel) {
+			return (projCameraModel * Vec4f{ 0.f, 0.f, 0.f, 1.f }).w / 100.f;
+			};
 
-			auto generateMultipleSprites = [&](const Vec3f& basePos, float offsetX, float offsetY, float offsetZ, int count, const Vec3f& negOffset) {
-				generateSprites(basePos + Vec3f{ offsetX, offsetY, offsetZ }, count, negOffset);
-				};
+		if (objectVisible[terrainObject]) {
+			draws.submit({ frame.terrainProgram, geometry.vao(), textures, material, sceneTransform,
+				GL_TRIANGLES, GLint(terrainMesh.firstIndex), GLsizei(terrainMesh.indexCount), 1,
+				true, GLint(terrainMesh.firstVertex) }, RenderPass::opaque, viewDepth(projCameraWorld));
+		}
+		if (objectVisible[launchPadsObject]) {
+			draws.submit({ frame.launchPadProgram, launchPads.vao(), 0, material, sceneTransform,
+				GL_TRIANGLES, 0, launchPads.vertex_count(), launchPads.instance_count() },
+				RenderPass::opaque, viewDepth(projCameraWorld));
+		}
+		if (objectVisible[shipObject]) {
+			std::uint32_t shipTransform = draws.add_transform({ spaceship2World, transforms.normal_matrix(shipModelNode) });
+			draws.submit({ frame.shipProgram, geometry.vao(), 0, material, shipTransform,
+				GL_TRIANGLES, GLint(shipMesh.firstIndex), GLsizei(shipMesh.indexCount), 1,
+				true, GLint(shipMesh.firstVertex) }, RenderPass::opaque, viewDepth(spaceshipModel2World));
+		}
 
-			// Generate sprites with offsets
-			Vec3f basePosition = Vec3f{ 0.f, state.spaceshipOrigin, state.spaceshipCurve };
-			Vec3f negOffset = Vec3f{ 0.f, -state.spaceshipOrigin, -state.spaceshipCurve };
+		draws.sort();
+		};
 
-			generateMultipleSprites(basePosition, -20.208f, -1.f, -15.f, 10, negOffset);
-			generateMultipleSprites(basePosition, -19.792f, -1.f, -15.f, 10, negOffset);
-			generateMultipleSprites(basePosition, -20.f, -1.f, -15.208f, 10, negOffset);
-			generateMultipleSprites(basePosition, -20.f, -1.f, -14.792f, 10, negOffset);
+	// Main thread: events, then inputs for the next frame.
+	std::size_t sampledFrames = 0;
+	auto sampleInputs = [&](Frame_& frame, float fbwidth, float fbheight) {
+		PROFILE_SCOPE("sample inputs");
+		frame.inputTime = profiler_now();
 
-			return translationMatrix * originToTranslation * xRotationMatrix * translationToOrigin * model2World;
+		auto calculateDeltaTime = [&](Clock::time_point& lastTime) {
+			auto now = Clock::now();
+			float deltaTime = std::chrono::duration_cast<Secondsf>(now - lastTime).count();
+			lastTime = now;
+			return deltaTime;
 			};
+		float dt = calculateDeltaTime(last);
+		if (options.benchmark)
+			dt = sim.step_length();
 
-		Mat44f spaceship2World = updateSpaceshipWorldMatrix();
-
-		// matrix
-		Mat33f normalMatrix = mat44_to_mat33(transpose(invert(model2World)));
+		angle += dt * kPi_ * 0.3f;
+		if (angle >= 2.f * kPi_) {
+			angle -= 2.f * kPi_;
+		}
 
 		auto updateCameraMovement = [&](float dt) {
 			float sinPhi = sin(state.camControl.phi);
@@ -567,210 +906,429 @@ int main() try
 			};
 		updateCameraMovement(dt);
 
-		Mat44f Rx = make_rotation_x(state.camControl.theta);
-		Mat44f Ry = make_rotation_y(state.camControl.phi);
-		Mat44f T = make_translation(state.camControl.movementVec);
+		frame.dt = dt;
+		frame.aspect = fbwidth / fbheight;
+		frame.phi = state.camControl.phi;
+		frame.theta = state.camControl.theta;
+		frame.movementVec = state.camControl.movementVec;
+		frame.gpuCulling = state.gpuCulling;
+		frame.terrainProgram = meshShaders.programId(terrainFeatures);
+		frame.shipProgram = meshShaders.programId(shipFeatures);
+		frame.launchPadProgram = instancedShaders.programId(launchPadFeatures);
+
+		// Benchmark: camera from the timeline, which starts after the
+		// warm-up frames.
+		frame.scriptTime = (float(sampledFrames) - float(options.warmupFrames)) * sim.step_length();
+		if (options.benchmark) {
+			BenchmarkKeyframe camera = benchmark_camera_at(script, std::max(frame.scriptTime, 0.f));
+			frame.phi = camera.yaw;
+			frame.theta = camera.pitch;
+			frame.movementVec = -camera.position;
+		}
+		++sampledFrames;
+		};
 
-		Mat44f world2Camera = Rx * Ry * T;
+	// Frame N+1 is built while frame N is submitted (see FramePipeline).
+	// Declared last, so that it stops before anything it uses goes away.
+	FramePipeline<Frame_> pipeline(buildFrame);
 
-		Mat44f projection = make_perspective_projection(
-			60 * kPi_ / 180.f,
-			fbwidth / float(fbheight),
-			0.1f,
-			100.f);
+	{
+		int nwidth, nheight;
+		getFramebufferSize( nwidth, nheight );
+		sampleInputs(pipeline.next(), float(nwidth), float(nheight ? nheight : 1));
+		pipeline.kick();
+	}
 
-		Mat44f projCameraWorld = projection * (world2Camera * model2World);
-		Mat44f spaceshipModel2World = projection * (world2Camera * spaceship2World);
-		updateSprites(dt);
-		updateSpritePositions(sprites);
+	OGL_CHECKPOINT_ALWAYS();
 
+	// CPU and GPU times of the whole frame and its parts. GPU results
+	// arrive a few frames late.
+	RenderMetricsTracker metrics;
+	const auto uploadScope = metrics.scope("upload");
+	const auto spritesScope = metrics.scope("sprites");
+	const auto queueScope = metrics.scope("render queue");
+	const auto gpuCullScope = metrics.scope("gpu culling");
+	const auto presentScope = metrics.scope("present");
+	const auto hudScope = metrics.scope("hud");
+
+	// Performance overlay: frame times, the scopes above and counters
+	shaderBuilds.wait(hudProg);
+	PerformanceHud hud("assets/DroidSansMonoDotted.ttf", hudProg);
+	state.showHud = options.hud;
+
+	// Dumped and measured frames must not show the fallback
+	if (options.headless || options.benchmark)
+		shaderBuilds.wait_all();
+
+	// Reported once all programs are built
+	bool shaderBuildsReported = false;
+	auto reportShaderBuilds = [&]() {
+		const ShaderBuildService::Stats builds = shaderBuilds.stats();
+		std::fprintf(stderr, "Shader builds: %zu programs in %.1f ms (parallel compile %s)\n",
+			builds.programs, builds.milliseconds, shaderBuilds.parallel_compile() ? "on" : "off");
+
+		if (!options.shaderCacheDirectory.empty()) {
+			const ShaderProgram::BinaryCacheStats cache = ShaderProgram::binary_cache_stats();
+			std::fprintf(stderr, "Shader cache: %zu hits, %zu misses (%zu rejected); %.1f ms of compiling saved, %.1f ms spent loading\n",
+				cache.hits, cache.misses, cache.rejected, cache.savedMilliseconds, cache.loadMilliseconds);
+		}
+		};
 
-		// Draw scene
-		OGL_CHECKPOINT_DEBUG();
+	// Frame pacing. Frame intervals and input latencies are kept per pacing
+	// mode, over the last few seconds, and reported when the mode changes.
+	// Latency is measured from sampling a frame's inputs until the GPU has
+	// finished that frame, i.e., without the display's scanout.
+	FrameLimiter limiter(double(options.targetFps));
+	GLsync previousFrameDone = nullptr; // low-latency pacing
+	RollingStats frameIntervals(600), inputLatencies(600);
+	std::vector<std::uint64_t> inputTimes(16, 0); // by frame number, modulo size
+	Clock::time_point lastPresent{};
+
+	auto pacingName = [&](char* buffer, std::size_t size) {
+		if (FramePacing::fixed == state.pacing)
+			std::snprintf(buffer, size, "fixed %zu fps", options.targetFps);
+		else
+			std::snprintf(buffer, size, "%s", frame_pacing_name(state.pacing));
+		return buffer;
+		};
+	auto reportPacing = [&]() {
+		if (0 == frameIntervals.size())
+			return;
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		char name[32];
+		std::fprintf(stderr, "Pacing (%s), last %zu frames: interval %.2f ms, stddev %.3f ms, max %.2f ms",
+			pacingName(name, sizeof(name)), frameIntervals.size(), frameIntervals.mean(), frameIntervals.stddev(), frameIntervals.max());
+		if (inputLatencies.size())
+			std::fprintf(stderr, "; input-to-GPU latency %.2f ms, stddev %.3f ms, max %.2f ms\n", inputLatencies.mean(), inputLatencies.stddev(), inputLatencies.max());
+		else
+			std::fprintf(stderr, "; input-to-GPU latency n/a\n");
+		};
 
-		renderSprites(projCameraWorld, prog3.programId());
-	
-		glUseProgram(prog.programId());
+	profiler_record_cpu("startup", startupBegin, profiler_now());
 
-		glUniformMatrix4fv(
-			0,
-			1,
-			GL_TRUE,
-			projCameraWorld.v
-		);
+	// Benchmark measurements, per frame after the warm-up
+	std::vector<BenchmarkFrame> benchmarkFrames;
+	std::vector<FrameTiming> frameTimings;
+	std::size_t warmupFrames = options.benchmark ? options.warmupFrames : 0;
 
-		glUniformMatrix3fv(
-			1,
-			1,
-			GL_TRUE,
-			normalMatrix.v
-		);
+	auto recordFrameTimings = [&]() {
+		frameTimings.clear();
+		metrics.take_completed(frameTimings);
+		for (const FrameTiming& timing : frameTimings) {
+			hud.add_frame(timing);
 
-		Vec3f lightDir = normalize(Vec3f{ 0.f, 1.f, -1.f });
-		glUniform3fv(2, 1, &lightDir.x);     
-		glUniform3f(3, 0.9f, 0.9f, 0.9f);   
-		glUniform3f(4, 0.05f, 0.05f, 0.05f); 
+			double latency = -1.0;
+			const std::uint64_t inputTime = inputTimes[timing.frame % inputTimes.size()];
+			if (timing.gpuEnd && inputTime && timing.gpuEnd > inputTime) {
+				latency = double(timing.gpuEnd - inputTime) * 1e-6;
+				inputLatencies.add(latency);
+			}
 
-		glBindVertexArray(vao);
+			if (timing.frame >= warmupFrames && timing.frame - warmupFrames < benchmarkFrames.size()) {
+				BenchmarkFrame& measured = benchmarkFrames[timing.frame - warmupFrames];
+				measured.cpuMilliseconds = timing.cpuMilliseconds;
+				measured.gpuMilliseconds = timing.gpuMilliseconds;
+				measured.latencyMilliseconds = latency;
+			}
+		}
+		};
 
-		if (textures != 0) {
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, textures);
+	// Main loop. Runs until the window is closed, or for the requested
+	// number of frames.
+	std::size_t frameCount = 0;
+	auto running = [&] {
+		if( options.frames && frameCount >= warmupFrames + options.frames )
+			return false;
+		return !window || !glfwWindowShouldClose( window );
+	};
+
+	while( running() )
+	{
+		if (state.pacingChanged) {
+			state.pacingChanged = false;
+			reportPacing();
+			frameIntervals.clear();
+			inputLatencies.clear();
+			limiter.reset();
+			if (window)
+				glfwSwapInterval(frame_pacing_vsync(state.pacing) ? 1 : 0);
+
+			char name[32];
+			std::fprintf(stderr, "Pacing: %s\n", pacingName(name, sizeof(name)));
 		}
-		else {
-			glBindTexture(GL_TEXTURE_2D, 0);
+
+		// Pace the frame before its inputs are sampled, so that they are as
+		// fresh as possible.
+		if (FramePacing::fixed == state.pacing) {
+			PROFILE_SCOPE("frame limiter");
+			limiter.wait();
+		}
+		if (previousFrameDone) {
+			// Low latency: no frames may queue up in front of the GPU
+			PROFILE_SCOPE("wait for GPU");
+			glClientWaitSync(previousFrameDone, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 /* 1 s */);
+			glDeleteSync(previousFrameDone);
+			previousFrameDone = nullptr;
 		}
 
-		glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+		metrics.begin_frame();
 
-		glUseProgram(prog2.programId());
+		// Install the programs that finished building, start the next ones
+		if (shaderWatcher) {
+			const std::vector<std::string> changes = shaderWatcher->take_changes();
+			if (!changes.empty())
+				shaderBuilds.rebuild_changed(changes);
+		}
+		shaderBuilds.update();
+		if (!shaderBuildsReported && 0 == shaderBuilds.pending()) {
+			shaderBuildsReported = true;
+			reportShaderBuilds();
+		}
 
-		auto setUniformMatrix4fv = [](GLuint location, const Mat44f& matrix) {
-			glUniformMatrix4fv(location, 1, GL_TRUE, matrix.v);
-			};
-		setUniformMatrix4fv(0, projCameraWorld);
+		// Let GLFW process events
+		if( window )
+		{
+			PROFILE_SCOPE( "poll events" );
+			glfwPollEvents();
+		}
 
-		auto setUniformMatrix3fv = [](GLuint location, const Mat33f& matrix) {
-			glUniformMatrix3fv(location, 1, GL_TRUE, matrix.v);
-			};
-		setUniformMatrix3fv(1, normalMatrix);
+		
+		// Check if window was resized.
+		float fbwidth, fbheight;
+		{
+			int nwidth, nheight;
+			getFramebufferSize( nwidth, nheight );
 
-		auto setLightingUniforms = []() {
-			Vec3f lightDirection = normalize(Vec3f{ 0.f, 1.f, -1.f });
-			glUniform3fv(2, 1, &lightDirection.x);
-			glUniform3f(3, 0.9f, 0.9f, 0.9f);
-			glUniform3f(4, 0.05f, 0.05f, 0.05f);
-			};
-		setLightingUniforms();
+			fbwidth = float(nwidth);
+			fbheight = float(nheight);
 
-		auto bindTexture = [](GLuint textureId) {
-			if (textureId != 0) {
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, textureId);
-			}
-			else {
-				glBindTexture(GL_TEXTURE_2D, 0);
+			if( 0 == nwidth || 0 == nheight )
+			{
+				// Window minimized? Pause until it is unminimized.
+				// This is a bit of a hack.
+				do
+				{
+					glfwWaitEvents();
+					glfwGetFramebufferSize( window, &nwidth, &nheight );
+				} while( 0 == nwidth || 0 == nheight );
+
+				fbwidth = float(nwidth);
+				fbheight = float(nheight);
 			}
-			};
-		bindTexture(0);
 
-		auto executeDrawCall = [](GLuint vaoId, size_t count) {
-			glBindVertexArray(vaoId);
-			glDrawArrays(GL_TRIANGLES, 0, count);
-			};
-		executeDrawCall(launch_vao_1, launchVertexCount);
+			glViewport( 0, 0, nwidth, nheight );
+		}
 
-		// Draw the second launchpad
-		glUseProgram(prog2.programId());
+		// Start building the next frame while this one is submitted. Low
+		// latency pacing skips the lookahead: the frame is built from the
+		// inputs sampled just now, after the GPU wait, and submitted right
+		// away. A frame that is already in flight when switching to low
+		// latency is submitted first; when switching back, the pipeline is
+		// refilled with one more frame.
+		const bool lookahead = FramePacing::lowLatency != state.pacing;
+		if (lookahead && 0 == pipeline.in_flight()) {
+			sampleInputs(pipeline.next(), fbwidth, fbheight);
+			pipeline.kick();
+		}
+		if (lookahead || 0 == pipeline.in_flight()) {
+			sampleInputs(pipeline.next(), fbwidth, fbheight);
+			pipeline.kick();
+		}
 
-	
-		auto uploadMatrix4 = [](GLuint location, const Mat44f& matrix) {
-			glUniformMatrix4fv(location, 1, GL_TRUE, matrix.v);
-			};
-		uploadMatrix4(0, projCameraWorld);
+		Frame_& frame = pipeline.acquire();
+		inputTimes[metrics.frames() % inputTimes.size()] = frame.inputTime;
+
+		metrics.begin(uploadScope);
+		std::memcpy(frameUniforms.map(), &frame.uniforms, sizeof(frame.uniforms));
+		glBindBufferRange(GL_UNIFORM_BUFFER, kFrameUniformBinding, frameUniforms.buffer(),
+			GLintptr(frameUniforms.region_offset()), sizeof(FrameUniforms));
+		if (state.gpuParticles != (gpuSprites != nullptr)) {
+			// Switching backends drops the live particles of the old one.
+			// The simulation clears its pool at its next step.
+			sim.set_gpu_particles(state.gpuParticles);
+			gpuSystem.clear();
+			gpuSprites = state.gpuParticles ? &gpuSystem : nullptr;
+			std::fprintf(stderr, "Particles: %s\n", gpuSprites ? "GPU (compute)" : "CPU");
+		}
+		if (gpuSprites)
+			updateGpuSprites(sim, gpuSpawns, frame.dt);
+		else
+			updateSpritePositions(frame.particlePositions);
+
+		if (frame.shipMoved) {
+			gpuCuller.update_object(gpuShipObject, frame.shipBounds, frame.ship2World, frame.shipNormalMatrix);
+			gpuBounds[gpuShipObject] = frame.shipBounds;
+			if (cullingValidator)
+				cullingValidator->update_object(shipObject, frame.shipBounds);
+		}
+		metrics.end(uploadScope);
 
-	
-		auto uploadMatrix3 = [](GLuint location, const Mat33f& matrix) {
-			glUniformMatrix3fv(location, 1, GL_TRUE, matrix.v);
-			};
-		uploadMatrix3(1, normalMatrix);
+		// Draw scene
+		OGL_CHECKPOINT_DEBUG();
 
-	
-		auto configureLighting = []() {
-			auto calculateLightDirection = []() -> Vec3f {
-				return normalize(Vec3f{ 0.f, 1.f, -1.f });
-				};
-			Vec3f lightDir = calculateLightDirection();
-
-			glUniform3fv(2, 1, &lightDir.x); 
-			glUniform3f(3, 0.9f, 0.9f, 0.9f); 
-			glUniform3f(4, 0.05f, 0.05f, 0.05f); 
-			};
-		configureLighting();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		metrics.begin(spritesScope);
+		renderSprites(frame.projCameraWorld, prog3.programId(), frame.particleCount);
+		metrics.end(spritesScope);
 
-		auto handleTextureBinding = [](GLuint textureId) {
-			if (textureId != 0) {
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, textureId);
-			}
-			else {
-				glBindTexture(GL_TEXTURE_2D, 0);
-			}
-			};
-		handleTextureBinding(0);
+		metrics.begin(queueScope);
+		renderQueue.execute(frame.draws);
+		metrics.end(queueScope);
 
+		if (frame.gpuCulling) {
+			metrics.begin(gpuCullScope);
+			gpuCuller.cull(frame.viewProjection);
+			if (options.validateCulling)
+				validateCulling(frame.viewProjection);
 
-		auto drawMesh = [](GLuint vao, size_t count) {
-			auto bindVAO = [](GLuint vaoId) {
-				glBindVertexArray(vaoId);
-				};
-			bindVAO(vao);
-			glDrawArrays(GL_TRIANGLES, 0, count);
-			};
-		drawMesh(launch_vao_2, launchVertexCount);
-
-		// Draw ship
-		auto mesh_renderer = [](GLuint vao, size_t vertexCount, GLuint textureObjectId, GLuint programID, Mat44f projCameraWorld, Mat33f normalMatrix) {
-			auto setUniformMatrix4fv = [](GLuint location, const Mat44f& matrix) {
-				glUniformMatrix4fv(location, 1, GL_TRUE, matrix.v);
-				};
-
-			auto setUniformMatrix3fv = [](GLuint location, const Mat33f& matrix) {
-				glUniformMatrix3fv(location, 1, GL_TRUE, matrix.v);
-				};
-
-			auto setLightingUniforms = []() {
-				Vec3f lightDirection = normalize(Vec3f{ 0.f, 1.f, -1.f });
-				glUniform3fv(2, 1, &lightDirection.x);
-				glUniform3f(3, 0.9f, 0.9f, 0.9f);    
-				glUniform3f(4, 0.05f, 0.05f, 0.05f);
-				};
-
-			auto bindTexture = [](GLuint textureId) {
-				if (textureId != 0) {
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, textureId);
-				}
-				else {
-					glBindTexture(GL_TEXTURE_2D, 0);
-				}
-				};
+			glBindBufferBase(GL_UNIFORM_BUFFER, kMaterialUniformBinding, gpuMaterial);
+			glBindVertexArray(geometry.vao());
 
-			auto executeDrawCall = [](GLuint vaoId, GLsizei count) {
-				glBindVertexArray(vaoId);
-				glDrawArrays(GL_TRIANGLES, 0, count);
-				};
+			glUseProgram(culledShaders.programId(terrainFeatures));
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, textures);
+			gpuCuller.draw(texturedGroup);
 
-			glUseProgram(programID);
+			glUseProgram(culledShaders.programId(shipFeatures));
+			gpuCuller.draw(coloredGroup);
 
-			setUniformMatrix4fv(0, projCameraWorld);
-			setUniformMatrix3fv(1, normalMatrix);
-			setLightingUniforms();
-			bindTexture(textureObjectId);
+			glBindVertexArray(0);
+			glUseProgram(0);
+			metrics.end(gpuCullScope);
+		}
 
-			// Convert vertexCount to GLsizei to avoid warnings
-			GLsizei vertexCountGL = static_cast<GLsizei>(vertexCount);
-			executeDrawCall(vao, vertexCountGL);
-			};
-		mesh_renderer(ship_one_vao, shipVertexCount, 0, prog2.programId(), spaceshipModel2World, normalMatrix);
+		if (state.showHud) {
+			metrics.begin(hudScope);
+			HudCounters counters;
+			counters.drawCalls = renderQueue.stats().drawCalls;
+			counters.triangles = renderQueue.stats().triangles;
+			counters.particles = frame.particleCount;
+
+			char pacing[32];
+			counters.pacing = pacingName(pacing, sizeof(pacing));
+			counters.frameInterval = frameIntervals.mean();
+			counters.frameIntervalStddev = frameIntervals.stddev();
+			counters.latency = inputLatencies.size() ? inputLatencies.mean() : -1.0;
+			hud.draw(int(fbwidth), int(fbheight), metrics, counters);
+			metrics.end(hudScope);
+		}
+		frameUniforms.fence();
+
+		const RenderQueueStats& rqStats = renderQueue.stats();
+		const OcclusionStats& occStats = frame.occlusion;
+		metrics.record_visibility(frame.visibleObjects, objectBounds.size());
+		if (rqStats.drawCalls != lastDrawCalls || rqStats.state_changes() != lastStateChanges || frame.visibleObjects != lastVisible || occStats.occluded != lastOccluded) {
+			lastDrawCalls = rqStats.drawCalls;
+			lastStateChanges = rqStats.state_changes();
+			lastVisible = frame.visibleObjects;
+			lastOccluded = occStats.occluded;
+			std::fprintf(stderr, "Occlusion: %zu occluder triangles, %zu/%zu tested objects occluded (%.0f%%)\n",
+				occStats.occluderTriangles, occStats.occluded, occStats.tested, 100.f * occStats.cull_rate());
+			std::fprintf(stderr, "Render queue: %zu/%zu objects visible, %zu draws (%zu instances) in %zu calls, %zu state changes (%zu redundant skipped)\n",
+				frame.visibleObjects, objectBounds.size(), rqStats.draws, rqStats.instances, rqStats.drawCalls, rqStats.state_changes(), rqStats.skipped);
+		}
 
-		
-		glBindVertexArray(0);
-		glUseProgram(0);
+		std::size_t frameParticles = frame.particleCount;
+		pipeline.release();
 
 		OGL_CHECKPOINT_DEBUG();
-		glfwSwapBuffers( window );
-		glfwPollEvents();
+		metrics.begin( presentScope );
+		if( window )
+			glfwSwapBuffers( window );
+		else
+		{
+			if( !options.dumpDirectory.empty() && 0 == frameCount % options.dumpEvery )
+			{
+				char path[32];
+				std::snprintf( path, sizeof(path), "/frame_%05zu.png", frameCount );
+				offscreen->save_png( (options.dumpDirectory + path).c_str() );
+			}
+
+			glFlush();
+		}
+
+		metrics.end( presentScope );
+
+		const Clock::time_point presented = Clock::now();
+		double interval = 0.0;
+		if (Clock::time_point{} != lastPresent) {
+			interval = std::chrono::duration<double, std::milli>(presented - lastPresent).count();
+			frameIntervals.add(interval);
+		}
+		lastPresent = presented;
+
+		if (FramePacing::lowLatency == state.pacing)
+			previousFrameDone = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		if (options.benchmark && frameCount >= warmupFrames) {
+			BenchmarkFrame measured;
+			measured.intervalMilliseconds = interval;
+			measured.draws = rqStats.draws;
+			measured.drawCalls = rqStats.drawCalls;
+			measured.particles = frameParticles;
+			benchmarkFrames.emplace_back(measured);
+		}
+
+		metrics.end_frame();
+		recordFrameTimings();
+
+		++frameCount;
 	}
 
+	if (previousFrameDone)
+		glDeleteSync(previousFrameDone);
+
+	metrics.flush();
+	recordFrameTimings();
+	metrics.print_summary(stderr);
+	reportPacing();
+
+	// After the flush, so that the GPU track is complete
+	if( !options.tracePath.empty() )
+	{
+		profiler_stop_capture();
+		profiler_write_chrome_trace( options.tracePath.c_str() );
+
+		ProfilerStats const stats = profiler_stats();
+		std::printf( "Profile: %zu events from %zu threads (%zu dropped) written to %s\n",
+			stats.events, stats.threads, stats.dropped, options.tracePath.c_str() );
+	}
+
+	if (options.benchmark && !benchmarkFrames.empty()) {
+
+		BenchmarkInfo info;
+		info.script = options.scriptPath;
+		info.renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+		info.version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+		getFramebufferSize(info.width, info.height);
+		info.headless = options.headless;
+		info.warmupFrames = warmupFrames;
+		info.frameTime = sim.step_length();
+		info.pacing = frame_pacing_name(state.pacing);
+		if (FramePacing::fixed == state.pacing)
+			info.targetFps = double(options.targetFps);
+		write_benchmark_report(options.reportPath.c_str(), info, benchmarkFrames);
+
+		std::vector<double> cpuTimes;
+		for (const BenchmarkFrame& measured : benchmarkFrames)
+			cpuTimes.push_back(measured.cpuMilliseconds);
+		SampleStats cpu = summarize_samples(std::move(cpuTimes));
+		std::printf("Benchmark: %zu frames, CPU p50 %.2f ms, p99 %.2f ms; report written to %s\n",
+			cpu.count, cpu.p50, cpu.p99, options.reportPath.c_str());
+	}
+
+	if (options.validateCulling)
+		std::printf("Culling validation: %zu views of %zu objects and %zu frames, no mismatches\n",
+			cullingValidator->checked_views() - validatedFrames, cullingValidator->object_count(), validatedFrames);
+
+	if( offscreen )
+		std::printf( "Rendered %zu frames (%dx%d) offscreen\n", frameCount, int(offscreen->width()), int(offscreen->height()) );
+
 	// Cleanup.
 	//TODO: additional cleanup
 	glDeleteVertexArrays(1, &VAO); 
-	glDeleteBuffers(1, &VBO); 
-	glDeleteProgram(prog3.programId()); 
+	glDeleteBuffers(1, &gpuMaterial);
 
 	glfwTerminate();
 	
@@ -802,19 +1360,35 @@ namespace
 		if (auto* st = static_cast<State_*>(glfwGetWindowUserPointer(aWindow))) {
 			// Shader reload functionality
 			if (GLFW_KEY_R == aKey && GLFW_PRESS == aAction) {
-				if (st->prog) {
-					try {
-						st->prog->reload();
-						std::fprintf(stderr, "Shaders reloaded and recompiled.\n");
-					}
-					catch (std::exception const& ex) {
-						std::fprintf(stderr, "Error when reloading shader:\n");
-						std::fprintf(stderr, "%s\n", ex.what());
-						std::fprintf(stderr, "Keeping old shader.\n");
-					}
+				// Rebuilt in the background, see ShaderBuildService::update()
+				if (st->shaderBuilds) {
+					st->shaderBuilds->rebuild_all();
+					std::fprintf(stderr, "Rebuilding all shader programs.\n");
 				}
 			}
 
+			// Particle backend toggle
+			if (GLFW_KEY_P == aKey && GLFW_PRESS == aAction) {
+				st->gpuParticles = !st->gpuParticles;
+			}
+
+			// Culling path toggle
+			if (GLFW_KEY_G == aKey && GLFW_PRESS == aAction) {
+				st->gpuCulling = !st->gpuCulling;
+				std::fprintf(stderr, "Culling: %s\n", st->gpuCulling ? "GPU (compute, indirect draws)" : "CPU (BVH + occlusion)");
+			}
+
+			// Performance overlay toggle
+			if (GLFW_KEY_H == aKey && GLFW_PRESS == aAction) {
+				st->showHud = !st->showHud;
+			}
+
+			// Frame pacing cycle; applied by the main loop
+			if (GLFW_KEY_V == aKey && GLFW_PRESS == aAction) {
+				st->pacing = next_frame_pacing(st->pacing);
+				st->pacingChanged = true;
+			}
+
 			// Movement speed modification (SHIFT)
 			if (GLFW_KEY_LEFT_SHIFT == aKey) {
 				if (GLFW_PRESS == aAction) {
@@ -864,14 +1438,10 @@ namespace
 
 			// Spaceship animation control
 			if (GLFW_KEY_F == aKey) {
-				st->moveUp = true;
+				if (st->sim) st->sim->launch();
 			}
 			else if (GLFW_KEY_R == aKey) {
-				st->moveUp = false;
-				st->spaceshipOrigin = 0.f;
-				st->spaceshipCurve = 0.f;
-				st->curve = 0.005f;
-				st->acceleration = 0.1f;
+				if (st->sim) st->sim->reset();
 			}
 		}
 	}
@@ -0,0 +1,330 @@
+#include "metrics.hpp"
+
+#include <cstring>
+#include <cassert>
+
+#include "../support/error.hpp"
+#include "../support/profiler.hpp"
+
+namespace
+{
+	// Per scope and query set: which timestamps were issued this frame
+	constexpr std::uint8_t kScopeIdle_ = 0;
+	constexpr std::uint8_t kScopeBegun_ = 1;
+	constexpr std::uint8_t kScopeEnded_ = 2;
+
+	// How often the GPU clock offset is checked for drift, and the drift
+	// that triggers a new measurement
+	constexpr auto kClockCheckInterval_ = std::chrono::seconds( 2 );
+	constexpr std::int64_t kClockDriftLimit_ = 250'000; // ns
+
+	double milliseconds_( std::chrono::steady_clock::duration aDuration )
+	{
+		return std::chrono::duration<double, std::milli>( aDuration ).count();
+	}
+
+#	if PROFILER_ENABLED
+	std::uint64_t nanoseconds_( std::chrono::steady_clock::time_point aTime )
+	{
+		return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>( aTime.time_since_epoch() ).count());
+	}
+#	endif
+}
+
+RenderMetricsTracker::RenderMetricsTracker( std::size_t aLatency, std::size_t aMaxScopes, std::size_t aWindow )
+	: mMaxScopes( aMaxScopes )
+	, mWindow( aWindow )
+	, mGpuTiming( false )
+	, mNext( 0 )
+	, mCurrent( nullptr )
+	, mFrame( 0 )
+	, mDropped( 0 )
+	, mVisible( aWindow )
+	, mTotalObjects( 0 )
+	, mGpuClockOffset( 0 )
+	, mClockSyncs( 0 )
+{
+	assert( aLatency > 0 && aMaxScopes > 0 );
+
+	GLint timestampBits = 0;
+	glGetQueryiv( GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &timestampBits );
+	mGpuTiming = timestampBits > 0;
+
+	if( mGpuTiming )
+	{
+		mRing.resize( aLatency );
+		for( auto& set : mRing )
+		{
+			set.queries.resize( 2 * mMaxScopes );
+			set.state.assign( mMaxScopes, kScopeIdle_ );
+			set.frame = 0;
+			set.cpuMilliseconds = 0.0;
+			set.clockOffset = 0;
+			set.pending = false;
+			glGenQueries( GLsizei(set.queries.size()), set.queries.data() );
+		}
+
+		sync_gpu_clock_();
+	}
+
+	mScopes.reserve( mMaxScopes );
+	scope( "frame" );
+}
+
+RenderMetricsTracker::~RenderMetricsTracker()
+{
+	for( auto& set : mRing )
+		glDeleteQueries( GLsizei(set.queries.size()), set.queries.data() );
+}
+
+bool RenderMetricsTracker::gpu_timing() const noexcept
+{
+	return mGpuTiming;
+}
+
+RenderMetricsTracker::ScopeId RenderMetricsTracker::scope( char const* aName )
+{
+	assert( aName );
+	for( std::size_t i = 0; i < mScopes.size(); ++i )
+	{
+		if( mScopes[i].name == aName )
+			return ScopeId(i);
+	}
+
+	if( mScopes.size() == mMaxScopes )
+		throw Error( "RenderMetricsTracker: no room for scope '%s' (%zu scopes)", aName, mMaxScopes );
+
+	mScopes.emplace_back( Scope_{ aName, RollingStats( mWindow ), RollingStats( mWindow ), Clock_::time_point{} } );
+	return ScopeId(mScopes.size() - 1);
+}
+
+void RenderMetricsTracker::begin_frame()
+{
+	assert( !mCurrent );
+
+	if( mGpuTiming )
+	{
+		// A quick probe first; only a noticeable drift is worth the stall
+		// of a proper measurement.
+		auto const now = Clock_::now();
+		if( now - mClockChecked >= kClockCheckInterval_ )
+		{
+			mClockChecked = now;
+			auto const drift = sample_gpu_clock_offset_() - mGpuClockOffset;
+			if( drift > kClockDriftLimit_ || drift < -kClockDriftLimit_ )
+				sync_gpu_clock_();
+		}
+
+		collect_( false );
+
+		auto& set = mRing[mNext];
+		if( set.pending )
+			++mDropped; // GPU too far behind; time this frame on the CPU only
+		else
+		{
+			std::memset( set.state.data(), kScopeIdle_, set.state.size() );
+			set.frame = mFrame;
+			set.clockOffset = mGpuClockOffset;
+			mCurrent = &set;
+		}
+	}
+
+	begin( kFrameScope );
+}
+
+void RenderMetricsTracker::end_frame()
+{
+	end( kFrameScope );
+
+	double const cpu = mScopes[kFrameScope].cpu.last();
+	if( mCurrent )
+	{
+		mCurrent->cpuMilliseconds = cpu;
+		mCurrent->pending = true;
+		mCurrent = nullptr;
+		mNext = (mNext + 1) % mRing.size();
+	}
+	else
+		mCompleted.emplace_back( FrameTiming{ mFrame, cpu, -1.0, 0 } );
+
+	++mFrame;
+}
+
+void RenderMetricsTracker::begin( ScopeId aScope )
+{
+	assert( aScope < mScopes.size() );
+
+	if( mCurrent )
+	{
+		assert( kScopeIdle_ == mCurrent->state[aScope] ); // once per frame
+		glQueryCounter( mCurrent->queries[2 * aScope], GL_TIMESTAMP );
+		mCurrent->state[aScope] = kScopeBegun_;
+	}
+
+	mScopes[aScope].cpuBegin = Clock_::now();
+}
+
+void RenderMetricsTracker::end( ScopeId aScope )
+{
+	assert( aScope < mScopes.size() );
+
+	auto& scope = mScopes[aScope];
+	auto const now = Clock_::now();
+	scope.cpu.add( milliseconds_( now - scope.cpuBegin ) );
+
+#	if PROFILER_ENABLED
+	profiler_record_cpu( scope.name.c_str(), nanoseconds_( scope.cpuBegin ), nanoseconds_( now ) );
+#	endif
+
+	if( mCurrent && kScopeBegun_ == mCurrent->state[aScope] )
+	{
+		glQueryCounter( mCurrent->queries[2 * aScope + 1], GL_TIMESTAMP );
+		mCurrent->state[aScope] = kScopeEnded_;
+	}
+}
+
+void RenderMetricsTracker::flush()
+{
+	if( mGpuTiming )
+		collect_( true );
+}
+
+void RenderMetricsTracker::take_completed( std::vector<FrameTiming>& aFrames )
+{
+	aFrames.insert( aFrames.end(), mCompleted.begin(), mCompleted.end() );
+	mCompleted.clear();
+}
+
+std::size_t RenderMetricsTracker::scope_count() const noexcept
+{
+	return mScopes.size();
+}
+std::string const& RenderMetricsTracker::scope_name( ScopeId aScope ) const
+{
+	assert( aScope < mScopes.size() );
+	return mScopes[aScope].name;
+}
+RollingStats const& RenderMetricsTracker::cpu_stats( ScopeId aScope ) const
+{
+	assert( aScope < mScopes.size() );
+	return mScopes[aScope].cpu;
+}
+RollingStats const& RenderMetricsTracker::gpu_stats( ScopeId aScope ) const
+{
+	assert( aScope < mScopes.size() );
+	return mScopes[aScope].gpu;
+}
+
+void RenderMetricsTracker::record_visibility( std::size_t aVisible, std::size_t aTotal )
+{
+	mVisible.add( double(aVisible) );
+	mTotalObjects = aTotal;
+}
+RollingStats const& RenderMetricsTracker::visibility_stats() const noexcept
+{
+	return mVisible;
+}
+
+std::uint64_t RenderMetricsTracker::frames() const noexcept
+{
+	return mFrame;
+}
+std::size_t RenderMetricsTracker::dropped_frames() const noexcept
+{
+	return mDropped;
+}
+
+void RenderMetricsTracker::print_summary( std::FILE* aOut ) const
+{
+	std::fprintf( aOut, "Frame metrics: %llu frames, %zu timed on the CPU only, GPU clock synced %zu times; last %zu frames in ms:\n",
+		static_cast<unsigned long long>(mFrame), mDropped, mClockSyncs, mWindow );
+	std::fprintf( aOut, "  %-20s %8s %8s %8s   %8s %8s %8s\n", "scope", "GPU avg", "min", "max", "CPU avg", "min", "max" );
+
+	for( auto const& scope : mScopes )
+	{
+		std::fprintf( aOut, "  %-20s %8.3f %8.3f %8.3f   %8.3f %8.3f %8.3f\n", scope.name.c_str(),
+			scope.gpu.mean(), scope.gpu.min(), scope.gpu.max(),
+			scope.cpu.mean(), scope.cpu.min(), scope.cpu.max() );
+	}
+
+	if( mVisible.size() )
+	{
+		std::fprintf( aOut, "Visible objects: %.1f avg, %.0f min, %.0f max of %zu\n",
+			mVisible.mean(), mVisible.min(), mVisible.max(), mTotalObjects );
+	}
+}
+
+std::size_t RenderMetricsTracker::gpu_clock_syncs() const noexcept
+{
+	return mClockSyncs;
+}
+
+void RenderMetricsTracker::sync_gpu_clock_()
+{
+	// With the GPU idle, the GL_TIMESTAMP state is the current GPU time.
+	// Otherwise it is the time at which the commands issued so far reach
+	// the GPU, which may lag by the depth of the queue.
+	glFinish();
+	mGpuClockOffset = sample_gpu_clock_offset_();
+	mClockChecked = Clock_::now();
+	++mClockSyncs;
+}
+
+std::int64_t RenderMetricsTracker::sample_gpu_clock_offset_() const
+{
+	// Against the middle of the CPU time spent in the query
+	auto const before = std::int64_t(profiler_now());
+	GLint64 gpuNow = 0;
+	glGetInteger64v( GL_TIMESTAMP, &gpuNow );
+	auto const after = std::int64_t(profiler_now());
+
+	return before + (after - before) / 2 - std::int64_t(gpuNow);
+}
+
+void RenderMetricsTracker::collect_( bool aWait )
+{
+	// Oldest first. The frame's end timestamp is its last query; once that
+	// is available, so are the others. Queries complete in order, so the
+	// first frame that is not done ends the search.
+	for( std::size_t i = 0; i < mRing.size(); ++i )
+	{
+		auto& set = mRing[(mNext + i) % mRing.size()];
+		if( !set.pending )
+			continue;
+
+		if( !aWait )
+		{
+			GLint available = 0;
+			glGetQueryObjectiv( set.queries[2 * kFrameScope + 1], GL_QUERY_RESULT_AVAILABLE, &available );
+			if( !available )
+				break;
+		}
+
+		double frameGpu = -1.0;
+		std::uint64_t frameEnd = 0;
+		for( std::size_t s = 0; s < mScopes.size(); ++s )
+		{
+			if( kScopeEnded_ != set.state[s] )
+				continue;
+
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v( set.queries[2 * s], GL_QUERY_RESULT, &begin );
+			glGetQueryObjectui64v( set.queries[2 * s + 1], GL_QUERY_RESULT, &end );
+
+			double const ms = end > begin ? double(end - begin) * 1e-6 : 0.0;
+			mScopes[s].gpu.add( ms );
+
+#			if PROFILER_ENABLED
+			profiler_record_gpu( mScopes[s].name.c_str(), std::uint64_t(std::int64_t(begin) + set.clockOffset), std::uint64_t(std::int64_t(end) + set.clockOffset) );
+#			endif
+			if( kFrameScope == s )
+			{
+				frameGpu = ms;
+				frameEnd = std::uint64_t(std::int64_t(end) + set.clockOffset);
+			}
+		}
+
+		mCompleted.emplace_back( FrameTiming{ set.frame, set.cpuMilliseconds, frameGpu, frameEnd } );
+		set.pending = false;
+	}
+}
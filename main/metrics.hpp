@@ -1,186 +1,166 @@
-#ifndef SYSTEM_METRICS_ANALYZER_HPP
-#define SYSTEM_METRICS_ANALYZER_HPP
+#ifndef METRICS_HPP_8D41F6A3_2E97_4B5C_A0D8_F7193C6E2B54
+#define METRICS_HPP_8D41F6A3_2E97_4B5C_A0D8_F7193C6E2B54
 
 #include <glad.h>
-#include <array>
-#include <deque>
+
 #include <chrono>
-#include <thread>
+#include <string>
+#include <vector>
+
 #include <cstdio>
+#include <cstdint>
+#include <cstddef>
 
-#define METRICS_COLLECTION_ENABLED
+#include "rolling_stats.hpp"
 
-#ifdef METRICS_COLLECTION_ENABLED
-struct MetricsData {
-    GLuint64 gpuTotalTime;
-    GLuint64 gpuTimeSectionA;
-    GLuint64 gpuTimeSectionB;
-    GLuint64 gpuTimeSectionC;
-    std::chrono::nanoseconds cpuTimeFrame;
-    std::chrono::nanoseconds cpuTimeCommands;
+// Timings of one frame, see RenderMetricsTracker::take_completed()
+struct FrameTiming
+{
+	std::uint64_t frame;
+	double cpuMilliseconds;
+	double gpuMilliseconds; // negative if the frame was not measured on the GPU
+
+	// When the GPU finished the frame, in profiler_now() nanoseconds; zero if
+	// the frame was not measured on the GPU
+	std::uint64_t gpuEnd;
 };
 
-// task1.12
-class RenderMetricsTracker {
-private:
-    static const size_t QUERY_BUFFER_SIZE = 8;  // Total queries used for tracking
-    static const size_t MAX_HISTORY_DEPTH = 5; // Maximum number of frames to track
-
-    std::array<GLuint, QUERY_BUFFER_SIZE> gpuTimers;  // GPU timer queries
-    std::deque<MetricsData> historyBuffer;           // History of recorded metrics
-    bool featureEnabled;                             // Indicates support for GPU queries
-
-    std::chrono::steady_clock::time_point frameStartTime;  // Frame start timestamp
-    std::chrono::steady_clock::time_point commandStartTime; // Command submission start
-
-    struct InternalStatus {
-        bool initialized = false;
-        bool errorOccurred = false;
-    };
-
-    InternalStatus statusFlags;
-
-public:
-    RenderMetricsTracker() : featureEnabled(false) {
-        GLint timestampCapability = 0;
-        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &timestampCapability);
-
-        if (timestampCapability == 0) {
-            printf("[WARNING] GPU lacks support for GL_TIMESTAMP.\n");
-            featureEnabled = false;
-            return;
-        }
-
-        featureEnabled = true;
-
-        glGenQueries(QUERY_BUFFER_SIZE, gpuTimers.data());
-        if (glGetError() != GL_NO_ERROR) {
-            printf("[ERROR] Failed to initialize GPU query objects.\n");
-            featureEnabled = false;
-            return;
-        }
-
-        for (size_t i = 0; i < MAX_HISTORY_DEPTH; ++i) {
-            historyBuffer.emplace_back();
-        }
-        statusFlags.initialized = true;
-    }
-
-    ~RenderMetricsTracker() {
-        if (featureEnabled) {
-            glDeleteQueries(QUERY_BUFFER_SIZE, gpuTimers.data());
-        }
-    }
-
-    void startFrame() {
-        frameStartTime = std::chrono::steady_clock::now();
-        if (featureEnabled) {
-            glQueryCounter(gpuTimers[0], GL_TIMESTAMP);
-        }
-    }
-
-    void beginTrackingEvent(GLuint eventIndex) {
-        if (featureEnabled) {
-            glQueryCounter(gpuTimers[eventIndex], GL_TIMESTAMP);
-        }
-    }
-
-    void endTrackingEvent(GLuint eventIndex) {
-        if (featureEnabled) {
-            glQueryCounter(gpuTimers[eventIndex + 1], GL_TIMESTAMP);
-        }
-    }
-
-    void recordCommandStart() {
-        commandStartTime = std::chrono::steady_clock::now();
-    }
-
-    void completeFrame() {
-        if (!featureEnabled) {
-            return;
-        }
-
-        glQueryCounter(gpuTimers[1], GL_TIMESTAMP);
-        auto frameEndTime = std::chrono::steady_clock::now();
-
-        auto cpuFrameDuration = frameEndTime - frameStartTime;
-        auto cpuCommandDuration = frameEndTime - commandStartTime;
-
-        GLuint64 gpuStart = 0, gpuEnd = 0;
-        GLuint64 gpuSectionStart1 = 0, gpuSectionEnd1 = 0;
-        GLuint64 gpuSectionStart2 = 0, gpuSectionEnd2 = 0;
-        GLuint64 gpuSectionStart3 = 0, gpuSectionEnd3 = 0;
-
-        GLint resultAvailable = 0;
-        int retryAttempts = 0;
-        constexpr int MAX_RETRIES = 500;
-
-        while (!resultAvailable && retryAttempts < MAX_RETRIES) {
-            glGetQueryObjectiv(gpuTimers[1], GL_QUERY_RESULT_AVAILABLE, &resultAvailable);
-            if (!resultAvailable) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
-                retryAttempts++;
-            }
-        }
-
-        if (!resultAvailable) {
-            printf("[ERROR] Timed out while waiting for query results.\n");
-            return;
-        }
-
-        glGetQueryObjectui64v(gpuTimers[0], GL_QUERY_RESULT, &gpuStart);
-        glGetQueryObjectui64v(gpuTimers[1], GL_QUERY_RESULT, &gpuEnd);
-        glGetQueryObjectui64v(gpuTimers[2], GL_QUERY_RESULT, &gpuSectionStart1);
-        glGetQueryObjectui64v(gpuTimers[3], GL_QUERY_RESULT, &gpuSectionEnd1);
-        glGetQueryObjectui64v(gpuTimers[4], GL_QUERY_RESULT, &gpuSectionStart2);
-        glGetQueryObjectui64v(gpuTimers[5], GL_QUERY_RESULT, &gpuSectionEnd2);
-        glGetQueryObjectui64v(gpuTimers[6], GL_QUERY_RESULT, &gpuSectionStart3);
-        glGetQueryObjectui64v(gpuTimers[7], GL_QUERY_RESULT, &gpuSectionEnd3);
-
-        MetricsData frameMetrics{
-            gpuEnd - gpuStart,
-            gpuSectionEnd1 - gpuSectionStart1,
-            gpuSectionEnd2 - gpuSectionStart2,
-            gpuSectionEnd3 - gpuSectionStart3,
-            std::chrono::duration_cast<std::chrono::nanoseconds>(cpuFrameDuration),
-            std::chrono::duration_cast<std::chrono::nanoseconds>(cpuCommandDuration)
-        };
-
-        if (historyBuffer.size() >= MAX_HISTORY_DEPTH) {
-            historyBuffer.pop_front();
-        }
-        historyBuffer.push_back(frameMetrics);
-    }
-
-    void displaySummary() const {
-        if (!featureEnabled || historyBuffer.empty()) {
-            return;
-        }
-
-        GLuint64 totalGpuTime = 0, time1 = 0, time2 = 0, time3 = 0;
-        std::chrono::nanoseconds totalCpuFrameTime{0}, totalCpuCmdTime{0};
-
-        for (const auto& metrics : historyBuffer) {
-            totalGpuTime += metrics.gpuTotalTime;
-            time1 += metrics.gpuTimeSectionA;
-            time2 += metrics.gpuTimeSectionB;
-            time3 += metrics.gpuTimeSectionC;
-        }
-
-        size_t trackedFrames = historyBuffer.size();
-
-        printf("\n[METRICS REPORT]\n");
-        printf("Frames: %zu\n", trackedFrames);
-        printf("GPU: Total: %.2fms, A: %.2fms, B: %.2fms, C: %.2fms\n",
-               (totalGpuTime / trackedFrames) / 1e6,
-               (time1 / trackedFrames) / 1e6,
-               (time2 / trackedFrames) / 1e6,
-               (time3 / trackedFrames) / 1e6);
-        printf("CPU: Frame: %.2fms, Commands: %.2fms\n",
-               totalCpuFrameTime.count() / (trackedFrames * 1e6),
-               totalCpuCmdTime.count() / (trackedFrames * 1e6));
-    }
+/** RenderMetricsTracker: CPU and GPU times of named scopes, without stalls
+ *
+ * Each frame is bracketed by begin_frame() and end_frame(). In between, any
+ * registered scope may be timed once with begin() and end(); scopes may
+ * nest. The frame itself is the predefined scope kFrameScope.
+ *
+ * GPU times come from GL_TIMESTAMP queries. Every frame gets its own set of
+ * queries from a ring aLatency frames deep. Results are read back only once
+ * the GPU reports them as available, which is checked (without waiting) at
+ * the start of each frame. If the GPU is more than aLatency frames behind,
+ * the ring is full, and the frame is timed on the CPU only; see
+ * dropped_frames(). Measuring therefore never waits for the GPU, except in
+ * flush() and when the clock offset is measured (see below).
+ *
+ * Per scope, the tracker keeps rolling statistics over the last aWindow
+ * frames of CPU and of GPU time, in milliseconds.
+ *
+ * GPU timestamps are mapped to the CPU clock (profiler_now()) with an offset
+ * that is measured in the constructor, after a glFinish(), so that startup
+ * uploads still in the queue do not skew it. Every couple of seconds,
+ * begin_frame() probes the offset without waiting for the GPU, and measures
+ * it again, with a glFinish(), if the clocks drifted apart by more than a
+ * fraction of a millisecond. Frames keep the offset they began with: the
+ * glFinish() completes the frames in flight, so their timestamps belong to
+ * the old offset, even if their results are only read later. While the
+ * profiler captures, every timed scope is also recorded as a CPU event and,
+ * once its results are in, as a GPU event (with the mapped timestamps). The scope names are referenced by those events, so a trace must
+ * be written before the tracker is destroyed.
+ *
+ * Without GL_TIMESTAMP support, only CPU times are recorded.
+ *
+ * Requires a current OpenGL context for all methods, including the
+ * constructor and destructor.
+ */
+class RenderMetricsTracker final
+{
+	public:
+		using ScopeId = std::uint32_t;
+		static constexpr ScopeId kFrameScope = 0;
+
+	public:
+		explicit RenderMetricsTracker( std::size_t aLatency = 4, std::size_t aMaxScopes = 32, std::size_t aWindow = 120 );
+		~RenderMetricsTracker();
+
+		RenderMetricsTracker( RenderMetricsTracker const& ) = delete;
+		RenderMetricsTracker& operator= (RenderMetricsTracker const&) = delete;
+
+	public:
+		bool gpu_timing() const noexcept;
+
+		// Returns the scope with this name, registering it on first use.
+		// Throws Error if that would exceed aMaxScopes.
+		ScopeId scope( char const* aName );
+
+		void begin_frame();
+		void end_frame();
+
+		void begin( ScopeId );
+		void end( ScopeId );
+
+		// Waits for all frames in flight and processes their results. Meant
+		// for the end of a run.
+		void flush();
+
+		// Appends the frames completed since the last call. CPU-only frames
+		// complete in end_frame(), others only once their GPU results are
+		// in, so frames may arrive out of order.
+		void take_completed( std::vector<FrameTiming>& aFrames );
+
+		std::size_t scope_count() const noexcept;
+		std::string const& scope_name( ScopeId ) const;
+		RollingStats const& cpu_stats( ScopeId ) const;
+		RollingStats const& gpu_stats( ScopeId ) const;
+
+		// Objects that passed culling in the current frame, out of aTotal.
+		// Kept as rolling statistics, like the scope times.
+		void record_visibility( std::size_t aVisible, std::size_t aTotal );
+		RollingStats const& visibility_stats() const noexcept;
+
+		std::uint64_t frames() const noexcept;
+		std::size_t dropped_frames() const noexcept;
+
+		// Measurements of the GPU clock offset, including the initial one
+		std::size_t gpu_clock_syncs() const noexcept;
+
+		// Table of the rolling means, minima and maxima of all scopes, and
+		// of the visible objects
+		void print_summary( std::FILE* ) const;
+
+	private:
+		using Clock_ = std::chrono::steady_clock;
+
+		struct QuerySet_
+		{
+			std::vector<GLuint> queries; // begin and end timestamp per scope
+			std::vector<std::uint8_t> state; // per scope, see metrics.cpp
+			std::uint64_t frame;
+			double cpuMilliseconds;
+			std::int64_t clockOffset; // mGpuClockOffset when the frame began
+			bool pending;
+		};
+
+		struct Scope_
+		{
+			std::string name;
+			RollingStats cpu, gpu;
+			Clock_::time_point cpuBegin;
+		};
+
+		void collect_( bool aWait );
+
+		void sync_gpu_clock_();
+		std::int64_t sample_gpu_clock_offset_() const;
+
+	private:
+		std::size_t mMaxScopes;
+		std::size_t mWindow;
+		bool mGpuTiming;
+
+		std::vector<Scope_> mScopes;
+
+		std::vector<QuerySet_> mRing;
+		std::size_t mNext; // oldest query set, and the next to use
+		QuerySet_* mCurrent; // null if this frame is CPU only
+
+		std::uint64_t mFrame;
+		std::size_t mDropped;
+
+		RollingStats mVisible;
+		std::size_t mTotalObjects;
+
+		std::int64_t mGpuClockOffset; // CPU minus GPU time, in ns
+		Clock_::time_point mClockChecked;
+		std::size_t mClockSyncs;
+
+		std::vector<FrameTiming> mCompleted;
 };
 
-#endif
-#endif
\ No newline at end of file
+#endif // METRICS_HPP_8D41F6A3_2E97_4B5C_A0D8_F7193C6E2B54
@@ -0,0 +1,413 @@
+#include "occlusion.hpp"
+
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cmath>
+#include <cassert>
+
+#include "worker_pool.hpp"
+
+#include "../support/profiler.hpp"
+
+namespace
+{
+	// Triangles per setup chunk
+	constexpr std::size_t kSetupChunk_ = 1024;
+
+	// Pixels per inner loop iteration; must divide kOcclusionTileSize.
+	constexpr std::size_t kBlock_ = 8;
+	static_assert( kOcclusionTileSize % kBlock_ == 0 );
+
+	std::size_t round_up_( std::size_t aValue, std::size_t aMultiple ) noexcept
+	{
+		return (aValue + aMultiple - 1) / aMultiple * aMultiple;
+	}
+
+	// Distance to the near plane (z = -w in clip space); >= 0 is in front.
+	float near_distance_( Vec4f const& aV ) noexcept
+	{
+		return aV.z + aV.w;
+	}
+}
+
+std::vector<Vec3f> simplify_occluder( Vec3f const* aPositions, std::size_t aVertexCount, std::size_t aCells )
+{
+	assert( aCells > 0 );
+
+	std::vector<Vec3f> ret;
+
+	Aabb const bounds = make_aabb( aPositions, aVertexCount );
+	Vec3f const extent = bounds.max - bounds.min;
+	float const cellSize = std::max( { extent.x, extent.y, extent.z } ) / float(aCells);
+	if( !(cellSize > 0.f) )
+		return ret; // no triangles, or all in one point
+
+	auto const cell_coord = [&] (float aValue, float aMin) {
+		return std::min( std::uint64_t((aValue - aMin) / cellSize), std::uint64_t(aCells - 1) );
+	};
+
+	// Cluster of each vertex, and the sum of its members
+	struct Cluster
+	{
+		Vec3f sum{ 0.f, 0.f, 0.f };
+		std::size_t count = 0;
+	};
+	std::vector<Cluster> clusters;
+	std::unordered_map<std::uint64_t, std::uint32_t> cellClusters;
+	std::vector<std::uint32_t> vertexClusters( aVertexCount );
+
+	for( std::size_t i = 0; i < aVertexCount; ++i )
+	{
+		Vec3f const p = aPositions[i];
+		std::uint64_t const cell = (cell_coord( p.x, bounds.min.x ) * aCells + cell_coord( p.y, bounds.min.y )) * aCells + cell_coord( p.z, bounds.min.z );
+
+		auto const [it, added] = cellClusters.emplace( cell, std::uint32_t(clusters.size()) );
+		if( added )
+			clusters.emplace_back();
+
+		clusters[it->second].sum += p;
+		++clusters[it->second].count;
+		vertexClusters[i] = it->second;
+	}
+
+	// Surviving triangles, by their clusters in increasing order, such that
+	// duplicates compare equal
+	std::vector<std::array<std::uint32_t,3>> triangles;
+	for( std::size_t i = 0; i + 3 <= aVertexCount; i += 3 )
+	{
+		std::array<std::uint32_t,3> tri{ vertexClusters[i], vertexClusters[i+1], vertexClusters[i+2] };
+		std::sort( tri.begin(), tri.end() );
+		if( tri[0] != tri[1] && tri[1] != tri[2] )
+			triangles.emplace_back( tri );
+	}
+
+	std::sort( triangles.begin(), triangles.end() );
+	triangles.erase( std::unique( triangles.begin(), triangles.end() ), triangles.end() );
+
+	ret.reserve( 3 * triangles.size() );
+	for( auto const& tri : triangles )
+	{
+		for( auto const c : tri )
+			ret.emplace_back( clusters[c].sum / float(clusters[c].count) );
+	}
+
+	return ret;
+}
+
+OcclusionBuffer::OcclusionBuffer( std::size_t aWidth, std::size_t aHeight )
+	: mWidth( round_up_( aWidth, kOcclusionTileSize ) )
+	, mHeight( round_up_( aHeight, kOcclusionTileSize ) )
+	, mTilesX( mWidth / kOcclusionTileSize )
+	, mTilesY( mHeight / kOcclusionTileSize )
+	, mProjCameraWorld( kIdentity44f )
+	, mDepth( mWidth * mHeight, 1.f )
+	, mTileMax( mTilesX * mTilesY, 1.f )
+{
+	assert( mWidth > 0 && mHeight > 0 );
+}
+
+void OcclusionBuffer::begin( Mat44f const& aProjCameraWorld )
+{
+	mProjCameraWorld = aProjCameraWorld;
+	mOccluders.clear();
+	mStats = OcclusionStats{};
+
+	std::fill( mDepth.begin(), mDepth.end(), 1.f );
+	std::fill( mTileMax.begin(), mTileMax.end(), 1.f );
+}
+
+void OcclusionBuffer::add_occluder( Vec3f const* aPositions, std::size_t aVertexCount, Mat44f const& aModel2World )
+{
+	assert( aVertexCount % 3 == 0 );
+	if( aVertexCount < 3 )
+		return;
+
+	mOccluders.emplace_back( Occluder_{ aPositions, aVertexCount / 3, mProjCameraWorld * aModel2World } );
+}
+
+void OcclusionBuffer::rasterize( WorkerPool& aPool )
+{
+	PROFILE_SCOPE( "occlusion rasterize" );
+
+	// Triangle setup, in chunks over all occluder triangles
+	std::vector<std::size_t> firstTriangle( mOccluders.size() + 1, 0 );
+	for( std::size_t i = 0; i < mOccluders.size(); ++i )
+		firstTriangle[i+1] = firstTriangle[i] + mOccluders[i].triangles;
+
+	auto const triangles = firstTriangle.back();
+	auto const chunks = (triangles + kSetupChunk_ - 1) / kSetupChunk_;
+
+	if( mChunkTriangles.size() < chunks )
+		mChunkTriangles.resize( chunks );
+	for( auto& chunk : mChunkTriangles )
+		chunk.clear();
+
+	aPool.parallel_for( triangles, kSetupChunk_, [&] (std::size_t aFirst, std::size_t aLast, std::size_t aChunk) {
+		auto& out = mChunkTriangles[aChunk];
+
+		auto occ = std::size_t(std::upper_bound( firstTriangle.begin(), firstTriangle.end(), aFirst ) - firstTriangle.begin()) - 1;
+		for( auto t = aFirst; t < aLast; ++t )
+		{
+			while( t >= firstTriangle[occ+1] )
+				++occ;
+
+			auto const& o = mOccluders[occ];
+			auto const* p = o.positions + 3 * (t - firstTriangle[occ]);
+
+			Vec4f const clip[3] = {
+				o.projCameraModel * Vec4f{ p[0].x, p[0].y, p[0].z, 1.f },
+				o.projCameraModel * Vec4f{ p[1].x, p[1].y, p[1].z, 1.f },
+				o.projCameraModel * Vec4f{ p[2].x, p[2].y, p[2].z, 1.f }
+			};
+
+			float const dist[3] = { near_distance_( clip[0] ), near_distance_( clip[1] ), near_distance_( clip[2] ) };
+			if( dist[0] >= 0.f && dist[1] >= 0.f && dist[2] >= 0.f )
+			{
+				setup_( clip, out );
+				continue;
+			}
+			if( dist[0] < 0.f && dist[1] < 0.f && dist[2] < 0.f )
+				continue;
+
+			// Clip against the near plane (Sutherland-Hodgman); the result
+			// has three or four vertices.
+			Vec4f poly[4];
+			std::size_t count = 0;
+			for( std::size_t i = 0; i < 3; ++i )
+			{
+				auto const j = (i + 1) % 3;
+				if( dist[i] >= 0.f )
+					poly[count++] = clip[i];
+				if( (dist[i] >= 0.f) != (dist[j] >= 0.f) )
+				{
+					float const s = dist[i] / (dist[i] - dist[j]);
+					poly[count++] = clip[i] + s * (clip[j] - clip[i]);
+				}
+			}
+
+			for( std::size_t i = 2; i < count; ++i )
+			{
+				Vec4f const fan[3] = { poly[0], poly[i-1], poly[i] };
+				setup_( fan, out );
+			}
+		}
+	} );
+
+	for( std::size_t i = 0; i < chunks; ++i )
+		mStats.occluderTriangles += mChunkTriangles[i].size();
+
+	// Scan conversion, one band of tiles at a time
+	aPool.parallel_for( mTilesY, 1, [&] (std::size_t aFirst, std::size_t aLast, std::size_t) {
+		for( auto band = aFirst; band < aLast; ++band )
+			rasterize_band_( band );
+	} );
+}
+
+bool OcclusionBuffer::visible( Aabb const& aBox ) noexcept
+{
+	++mStats.tested;
+
+	float minX = float(mWidth), maxX = -1.f, minY = float(mHeight), maxY = -1.f;
+	float minZ = 1.f;
+	for( int i = 0; i < 8; ++i )
+	{
+		Vec4f const corner{
+			(i & 1) ? aBox.max.x : aBox.min.x,
+			(i & 2) ? aBox.max.y : aBox.min.y,
+			(i & 4) ? aBox.max.z : aBox.min.z,
+			1.f
+		};
+		auto const c = mProjCameraWorld * corner;
+
+		// Reaches behind the near plane: assume visible.
+		if( near_distance_( c ) < 0.f || c.w <= 0.f )
+			return true;
+
+		float const inv = 1.f / c.w;
+		float const sx = (c.x * inv * 0.5f + 0.5f) * float(mWidth);
+		float const sy = (c.y * inv * 0.5f + 0.5f) * float(mHeight);
+		float const sz = c.z * inv * 0.5f + 0.5f;
+
+		minX = std::min( minX, sx ); maxX = std::max( maxX, sx );
+		minY = std::min( minY, sy ); maxY = std::max( maxY, sy );
+		minZ = std::min( minZ, sz );
+	}
+
+	// All pixels the box touches
+	auto const x0 = std::int32_t(std::max( 0.f, std::floor( minX ) ));
+	auto const x1 = std::int32_t(std::min( float(mWidth-1), std::floor( maxX ) ));
+	auto const y0 = std::int32_t(std::max( 0.f, std::floor( minY ) ));
+	auto const y1 = std::int32_t(std::min( float(mHeight-1), std::floor( maxY ) ));
+
+	// Off screen; that is for the frustum culling to decide.
+	if( x0 > x1 || y0 > y1 )
+		return true;
+
+	auto const ts = std::int32_t(kOcclusionTileSize);
+	for( auto ty = y0 / ts; ty <= y1 / ts; ++ty )
+	{
+		for( auto tx = x0 / ts; tx <= x1 / ts; ++tx )
+		{
+			if( minZ > mTileMax[ty*mTilesX + tx] )
+				continue; // behind everything in this tile
+
+			auto const px0 = std::max( x0, tx*ts ), px1 = std::min( x1, tx*ts + ts-1 );
+			auto const py0 = std::max( y0, ty*ts ), py1 = std::min( y1, ty*ts + ts-1 );
+			for( auto y = py0; y <= py1; ++y )
+			{
+				float const* row = mDepth.data() + std::size_t(y) * mWidth;
+				for( auto x = px0; x <= px1; ++x )
+				{
+					if( minZ <= row[x] )
+						return true;
+				}
+			}
+		}
+	}
+
+	++mStats.occluded;
+	return false;
+}
+
+OcclusionStats const& OcclusionBuffer::stats() const noexcept
+{
+	return mStats;
+}
+
+std::size_t OcclusionBuffer::width() const noexcept
+{
+	return mWidth;
+}
+std::size_t OcclusionBuffer::height() const noexcept
+{
+	return mHeight;
+}
+float OcclusionBuffer::depth( std::size_t aX, std::size_t aY ) const noexcept
+{
+	assert( aX < mWidth && aY < mHeight );
+	return mDepth[aY * mWidth + aX];
+}
+
+void OcclusionBuffer::setup_( Vec4f const (&aClip)[3], std::vector<Triangle_>& aOut ) const
+{
+	float x[3], y[3], z[3];
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		float const inv = 1.f / aClip[i].w;
+		x[i] = (aClip[i].x * inv * 0.5f + 0.5f) * float(mWidth);
+		y[i] = (aClip[i].y * inv * 0.5f + 0.5f) * float(mHeight);
+		z[i] = aClip[i].z * inv * 0.5f + 0.5f;
+	}
+
+	// Pixels whose centers may be covered
+	auto const minX = std::max( 0.f, std::ceil( std::min( { x[0], x[1], x[2] } ) - 0.5f ) );
+	auto const maxX = std::min( float(mWidth-1), std::floor( std::max( { x[0], x[1], x[2] } ) - 0.5f ) );
+	auto const minY = std::max( 0.f, std::ceil( std::min( { y[0], y[1], y[2] } ) - 0.5f ) );
+	auto const maxY = std::min( float(mHeight-1), std::floor( std::max( { y[0], y[1], y[2] } ) - 0.5f ) );
+	if( minX > maxX || minY > maxY )
+		return;
+
+	float area = (x[1]-x[0]) * (y[2]-y[0]) - (x[2]-x[0]) * (y[1]-y[0]);
+	if( std::abs( area ) < 1e-8f )
+		return;
+
+	Triangle_ tri;
+
+	// Edge k is opposite of vertex k, and evaluates to the (signed) area
+	// there. Flip clockwise triangles, so that inside is always >= 0.
+	//
+	// The two triangles sharing an edge must get exactly negated edge
+	// functions, or pixel centers on the edge may be missed by both. a and b
+	// are, but x[i]*y[j] - x[j]*y[i] does not round like its negation (e.g.,
+	// with FMA contraction), so it is always computed with the vertices in
+	// the same order.
+	float const sign = area < 0.f ? -1.f : 1.f;
+	area *= sign;
+	for( std::size_t k = 0; k < 3; ++k )
+	{
+		auto const i = (k + 1) % 3, j = (k + 2) % 3;
+		bool const ordered = x[i] < x[j] || (x[i] == x[j] && y[i] <= y[j]);
+		auto const p = ordered ? i : j, q = ordered ? j : i;
+		float const c = x[p]*y[q] - x[q]*y[p];
+
+		tri.a[k] = sign * (y[i] - y[j]);
+		tri.b[k] = sign * (x[j] - x[i]);
+		tri.c[k] = sign * (ordered ? c : -c);
+	}
+
+	// z = sum of barycentric weights (e_k / area) times z_k
+	float const inv = 1.f / area;
+	tri.za = (tri.a[0]*z[0] + tri.a[1]*z[1] + tri.a[2]*z[2]) * inv;
+	tri.zb = (tri.b[0]*z[0] + tri.b[1]*z[1] + tri.b[2]*z[2]) * inv;
+	tri.zc = (tri.c[0]*z[0] + tri.c[1]*z[1] + tri.c[2]*z[2]) * inv;
+
+	tri.minX = std::int32_t(minX);
+	tri.maxX = std::int32_t(maxX);
+	tri.minY = std::int32_t(minY);
+	tri.maxY = std::int32_t(maxY);
+
+	aOut.emplace_back( tri );
+}
+
+void OcclusionBuffer::rasterize_band_( std::size_t aBand )
+{
+	auto const y0 = std::int32_t(aBand * kOcclusionTileSize);
+	auto const y1 = y0 + std::int32_t(kOcclusionTileSize) - 1;
+
+	for( auto const& chunk : mChunkTriangles )
+	{
+		for( auto const& tri : chunk )
+		{
+			if( tri.maxY < y0 || tri.minY > y1 )
+				continue;
+
+			auto const rowBegin = std::max( tri.minY, y0 );
+			auto const rowEnd = std::min( tri.maxY, y1 );
+			auto const blockBegin = tri.minX / std::int32_t(kBlock_) * std::int32_t(kBlock_);
+
+			for( auto y = rowBegin; y <= rowEnd; ++y )
+			{
+				float const py = float(y) + 0.5f;
+				float const e0 = tri.b[0]*py + tri.c[0];
+				float const e1 = tri.b[1]*py + tri.c[1];
+				float const e2 = tri.b[2]*py + tri.c[2];
+				float const ez = tri.zb*py + tri.zc;
+
+				float* row = mDepth.data() + std::size_t(y) * mWidth;
+				for( auto bx = blockBegin; bx <= tri.maxX; bx += std::int32_t(kBlock_) )
+				{
+					float* block = row + bx;
+
+					// Fixed-size loop without early outs, so that it
+					// vectorizes.
+					for( std::size_t k = 0; k < kBlock_; ++k )
+					{
+						float const px = float(bx) + float(k) + 0.5f;
+						float const w0 = tri.a[0]*px + e0;
+						float const w1 = tri.a[1]*px + e1;
+						float const w2 = tri.a[2]*px + e2;
+						float const z = tri.za*px + ez;
+
+						bool const inside = w0 >= 0.f && w1 >= 0.f && w2 >= 0.f;
+						block[k] = (inside && z < block[k]) ? z : block[k];
+					}
+				}
+			}
+		}
+	}
+
+	// Farthest depth per tile
+	for( std::size_t tx = 0; tx < mTilesX; ++tx )
+	{
+		float farthest = 0.f;
+		for( std::size_t y = 0; y < kOcclusionTileSize; ++y )
+		{
+			float const* row = mDepth.data() + (std::size_t(y0) + y) * mWidth + tx * kOcclusionTileSize;
+			for( std::size_t x = 0; x < kOcclusionTileSize; ++x )
+				farthest = std::max( farthest, row[x] );
+		}
+		mTileMax[aBand * mTilesX + tx] = farthest;
+	}
+}
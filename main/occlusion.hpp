@@ -0,0 +1,132 @@
+#ifndef OCCLUSION_HPP_2E8B5D16_A7C4_4F39_91D0_6C3F7E8A2B45
+#define OCCLUSION_HPP_2E8B5D16_A7C4_4F39_91D0_6C3F7E8A2B45
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+#include "bvh.hpp"
+
+class WorkerPool;
+
+// Counters since the last begin()
+struct OcclusionStats
+{
+	std::size_t occluderTriangles = 0; // after near plane clipping
+	std::size_t tested = 0;
+	std::size_t occluded = 0;
+
+	float cull_rate() const noexcept
+	{
+		return tested ? float(occluded) / float(tested) : 0.f;
+	}
+};
+
+// Simplifies a triangle list (three positions per triangle) for use as an
+// occluder, by vertex clustering: the bounds are split into cubic cells,
+// aCells along the longest axis, and each vertex moves to the mean of the
+// vertices in its cell. Triangles that collapse, and duplicates, are
+// dropped. Meant to run once, at load time.
+//
+// Vertices move by up to a cell diagonal, so the simplified surface may
+// hide objects that are just barely visible past the original one.
+std::vector<Vec3f> simplify_occluder( Vec3f const* aPositions, std::size_t aVertexCount, std::size_t aCells );
+
+constexpr std::size_t kOcclusionTileSize = 8;
+
+/** OcclusionBuffer: software occlusion culling on the CPU
+ *
+ * Each frame, a few large occluder meshes (terrain, buildings, ...), usually
+ * simplified with simplify_occluder(), are rasterized into a small depth
+ * buffer, against which the bounding boxes of other objects are tested
+ * before they are submitted to the GPU.
+ *
+ *   begin( projCameraWorld );
+ *   add_occluder( ... );   // any number of times
+ *   rasterize( pool );
+ *   visible( box );        // any number of times
+ *
+ * Depth is NDC z mapped to [0,1], with the buffer cleared to 1 (far). The
+ * buffer is split into kOcclusionTileSize^2 pixel tiles, each of which also
+ * stores the farthest depth in it. visible() first compares a box's nearest
+ * depth against those, and only looks at single pixels for tiles where that
+ * is inconclusive.
+ *
+ * Rasterization runs on a WorkerPool: triangle setup (transform, near plane
+ * clipping, edge equations) is split over the triangles, and the scan
+ * conversion over horizontal bands of tiles, so that no two threads write
+ * the same pixels. The inner loop handles fixed blocks of eight pixels, which
+ * the compiler turns into SIMD code.
+ *
+ * Occluders are drawn without back face culling. Triangles crossing the near
+ * plane are clipped. Box tests are conservative: boxes that reach behind the
+ * near plane are always visible.
+ */
+class OcclusionBuffer final
+{
+	public:
+		// Width and height are rounded up to multiples of kOcclusionTileSize.
+		explicit OcclusionBuffer( std::size_t aWidth = 256, std::size_t aHeight = 128 );
+
+	public:
+		void begin( Mat44f const& aProjCameraWorld );
+
+		// Adds a triangle list (three positions per triangle). The data is
+		// read during rasterize() and must stay valid until then.
+		void add_occluder( Vec3f const* aPositions, std::size_t aVertexCount, Mat44f const& aModel2World );
+
+		void rasterize( WorkerPool& );
+
+		// Whether any part of the box may be visible past the occluders.
+		bool visible( Aabb const& aWorldBox ) noexcept;
+
+		OcclusionStats const& stats() const noexcept;
+
+		std::size_t width() const noexcept;
+		std::size_t height() const noexcept;
+		float depth( std::size_t aX, std::size_t aY ) const noexcept;
+
+	private:
+		struct Occluder_
+		{
+			Vec3f const* positions;
+			std::size_t triangles;
+			Mat44f projCameraModel;
+		};
+
+		// Screen space triangle, ready for scan conversion
+		struct Triangle_
+		{
+			// Edge functions e_i(x,y) = a[i]*x + b[i]*y + c[i], >= 0 inside
+			float a[3], b[3], c[3];
+
+			// Depth plane z(x,y) = za*x + zb*y + zc
+			float za, zb, zc;
+
+			std::int32_t minX, maxX, minY, maxY; // pixel bounds, inclusive
+		};
+
+		void setup_( Vec4f const (&aClip)[3], std::vector<Triangle_>& ) const;
+		void rasterize_band_( std::size_t aBand );
+
+	private:
+		std::size_t mWidth, mHeight;
+		std::size_t mTilesX, mTilesY;
+
+		Mat44f mProjCameraWorld;
+
+		std::vector<float> mDepth; // mWidth * mHeight
+		std::vector<float> mTileMax; // mTilesX * mTilesY
+
+		std::vector<Occluder_> mOccluders;
+		std::vector<std::vector<Triangle_>> mChunkTriangles;
+
+		OcclusionStats mStats;
+};
+
+#endif // OCCLUSION_HPP_2E8B5D16_A7C4_4F39_91D0_6C3F7E8A2B45
@@ -0,0 +1,205 @@
+#include "options.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	std::size_t parse_count_( char const* aOption, char const* aValue )
+	{
+		char* end = nullptr;
+		errno = 0;
+		auto const value = std::strtoull( aValue, &end, 10 );
+		if( end == aValue || '\0' != *end || '-' == aValue[0] || ERANGE == errno )
+			throw Error( "%s: expected a non-negative integer, got '%s'", aOption, aValue );
+
+		return std::size_t(value);
+	}
+
+	void parse_size_( char const* aValue, int& aWidth, int& aHeight )
+	{
+		int width = 0, height = 0;
+		char tail = 0;
+		if( 2 != std::sscanf( aValue, "%dx%d%c", &width, &height, &tail ) || width <= 0 || height <= 0 )
+			throw Error( "--size: expected WIDTHxHEIGHT, got '%s'", aValue );
+
+		aWidth = width;
+		aHeight = height;
+	}
+}
+
+RunOptions parse_run_options( int aArgc, char const* const* aArgv )
+{
+	RunOptions ret;
+	bool framesGiven = false;
+	bool benchmarkOptions = false;
+	bool hudGiven = false;
+	bool pacingGiven = false;
+	bool fpsGiven = false;
+	bool watchGiven = false;
+
+	for( int i = 1; i < aArgc; ++i )
+	{
+		char const* const arg = aArgv[i];
+
+		auto value = [&] () -> char const* {
+			if( i + 1 >= aArgc )
+				throw Error( "%s: missing value", arg );
+			return aArgv[++i];
+		};
+
+		if( 0 == std::strcmp( arg, "--help" ) || 0 == std::strcmp( arg, "-h" ) )
+			ret.help = true;
+		else if( 0 == std::strcmp( arg, "--headless" ) )
+			ret.headless = true;
+		else if( 0 == std::strcmp( arg, "--size" ) )
+			parse_size_( value(), ret.width, ret.height );
+		else if( 0 == std::strcmp( arg, "--frames" ) )
+		{
+			ret.frames = parse_count_( arg, value() );
+			framesGiven = true;
+		}
+		else if( 0 == std::strcmp( arg, "--dump" ) )
+		{
+			ret.dumpDirectory = value();
+			if( ret.dumpDirectory.empty() )
+				throw Error( "--dump: empty directory" );
+		}
+		else if( 0 == std::strcmp( arg, "--dump-every" ) )
+		{
+			ret.dumpEvery = parse_count_( arg, value() );
+			if( 0 == ret.dumpEvery )
+				throw Error( "--dump-every: must be at least 1" );
+		}
+		else if( 0 == std::strcmp( arg, "--benchmark" ) )
+			ret.benchmark = true;
+		else if( 0 == std::strcmp( arg, "--script" ) )
+		{
+			ret.scriptPath = value();
+			benchmarkOptions = true;
+		}
+		else if( 0 == std::strcmp( arg, "--warmup" ) )
+		{
+			ret.warmupFrames = parse_count_( arg, value() );
+			benchmarkOptions = true;
+		}
+		else if( 0 == std::strcmp( arg, "--report" ) )
+		{
+			ret.reportPath = value();
+			benchmarkOptions = true;
+		}
+		else if( 0 == std::strcmp( arg, "--hud" ) || 0 == std::strcmp( arg, "--no-hud" ) )
+		{
+			ret.hud = 0 == std::strcmp( arg, "--hud" );
+			hudGiven = true;
+		}
+		else if( 0 == std::strcmp( arg, "--pacing" ) )
+		{
+			ret.pacing = parse_frame_pacing( value() );
+			pacingGiven = true;
+		}
+		else if( 0 == std::strcmp( arg, "--fps" ) )
+		{
+			ret.targetFps = parse_count_( arg, value() );
+			if( 0 == ret.targetFps )
+				throw Error( "--fps: must be at least 1" );
+			fpsGiven = true;
+		}
+		else if( 0 == std::strcmp( arg, "--shader-cache" ) )
+		{
+			ret.shaderCacheDirectory = value();
+			if( ret.shaderCacheDirectory.empty() )
+				throw Error( "--shader-cache: empty directory" );
+		}
+		else if( 0 == std::strcmp( arg, "--no-shader-cache" ) )
+			ret.shaderCacheDirectory.clear();
+		else if( 0 == std::strcmp( arg, "--watch-shaders" ) || 0 == std::strcmp( arg, "--no-watch-shaders" ) )
+		{
+			ret.watchShaders = 0 == std::strcmp( arg, "--watch-shaders" );
+			watchGiven = true;
+		}
+		else if( 0 == std::strcmp( arg, "--trace" ) )
+		{
+			ret.tracePath = value();
+			if( ret.tracePath.empty() )
+				throw Error( "--trace: empty path" );
+		}
+		else if( 0 == std::strcmp( arg, "--validate-culling" ) )
+			ret.validateCulling = true;
+		else
+			throw Error( "Unknown option '%s' (see --help)", arg );
+	}
+
+	if( !ret.dumpDirectory.empty() && !ret.headless )
+		throw Error( "--dump requires --headless" );
+
+	if( ret.validateCulling && !ret.headless )
+		throw Error( "--validate-culling requires --headless" );
+
+	if( benchmarkOptions && !ret.benchmark )
+		throw Error( "--script, --warmup and --report require --benchmark" );
+
+	if( fpsGiven && pacingGiven && FramePacing::fixed != ret.pacing )
+		throw Error( "--fps requires --pacing fixed" );
+
+	if( fpsGiven )
+		ret.pacing = FramePacing::fixed;
+	else if( !pacingGiven && (ret.headless || ret.benchmark) )
+		ret.pacing = FramePacing::uncapped;
+
+	if( !hudGiven )
+		ret.hud = !ret.headless && !ret.benchmark;
+	if( !watchGiven )
+		ret.watchShaders = !ret.headless && !ret.benchmark;
+
+	// Nobody can close a headless run, and benchmarks are finite anyway
+	if( !framesGiven )
+	{
+		if( ret.benchmark )
+			ret.frames = kDefaultBenchmarkFrames;
+		else if( ret.headless )
+			ret.frames = kDefaultHeadlessFrames;
+	}
+	if( (ret.headless || ret.benchmark) && 0 == ret.frames )
+		throw Error( "--frames: a %s run needs at least one frame", ret.benchmark ? "benchmark" : "headless" );
+
+	return ret;
+}
+
+char const* run_options_usage() noexcept
+{
+	return
+		"Options:\n"
+		"  --help             Show this text\n"
+		"  --headless         Render offscreen, without a window (needs EGL)\n"
+		"  --size WxH         Window/framebuffer size (default: 1280x720)\n"
+		"  --frames N         Exit after N frames (default with --headless: 600)\n"
+		"  --dump DIR         Write frames to DIR/frame_NNNNN.png (headless only)\n"
+		"  --dump-every K     Only write every K'th frame (default: 1)\n"
+		"  --benchmark        Follow a scripted timeline, measure N frames\n"
+		"                     (default: 600) and write a JSON report\n"
+		"  --script PATH      Benchmark timeline (default: assets/benchmark.txt)\n"
+		"  --warmup N         Unmeasured frames before the timeline (default: 120)\n"
+		"  --report PATH      Benchmark report (default: benchmark.json)\n"
+		"  --hud, --no-hud    Show/hide the performance overlay (default: shown\n"
+		"                     in a window, hidden in headless and benchmark runs)\n"
+		"  --pacing MODE      vsync, uncapped, fixed (--fps) or latency (V-Sync,\n"
+		"                     waiting for the GPU before sampling inputs);\n"
+		"                     default: vsync in a window, uncapped otherwise\n"
+		"  --fps N            Fixed pacing at N frames per second (default: 60)\n"
+		"  --shader-cache DIR Cache linked shader programs in DIR (default:\n"
+		"                     shader-cache)\n"
+		"  --no-shader-cache  Always compile shaders from source\n"
+		"  --watch-shaders, --no-watch-shaders\n"
+		"                     Rebuild shaders when their files change (default:\n"
+		"                     in a window only)\n"
+		"  --trace PATH       Profile the run and write a Chrome trace to PATH\n"
+		"  --validate-culling Cull on the GPU and fail if a visible set differs\n"
+		"                     from the CPU's, for fixed views and each frame\n"
+		"                     (headless only)\n"
+	;
+}
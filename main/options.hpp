@@ -0,0 +1,92 @@
+#ifndef OPTIONS_HPP_A85C3F17_0D4E_4B92_9E6B_72F1C04D5A38
+#define OPTIONS_HPP_A85C3F17_0D4E_4B92_9E6B_72F1C04D5A38
+
+#include <string>
+
+#include <cstddef>
+
+#include "frame_pacing.hpp"
+
+// Frames rendered by a headless run without --frames
+constexpr std::size_t kDefaultHeadlessFrames = 600;
+
+// Target rate of fixed pacing without --fps
+constexpr std::size_t kDefaultTargetFps = 60;
+
+// Measured frames of a benchmark without --frames, and its warm-up
+constexpr std::size_t kDefaultBenchmarkFrames = 600;
+constexpr std::size_t kDefaultBenchmarkWarmup = 120;
+
+// Command line options of main
+struct RunOptions
+{
+	bool help = false;
+
+	// Render into an offscreen framebuffer, without a window or display
+	bool headless = false;
+
+	// Window or offscreen framebuffer size
+	int width = 1280;
+	int height = 720;
+
+	// Frames to render before exiting; 0 = until the window is closed. A
+	// benchmark renders its warm-up frames in addition.
+	std::size_t frames = 0;
+
+	// Where to write frames as PNG files (headless only); empty = nowhere.
+	// Every dumpEvery'th frame is written, starting with the first.
+	std::string dumpDirectory;
+	std::size_t dumpEvery = 1;
+
+	// Benchmark: follow the scripted timeline (see BenchmarkScript) with
+	// a fixed simulation step per frame. `frames` frames
+	// are measured after warmupFrames unmeasured ones, and reported in
+	// reportPath.
+	bool benchmark = false;
+	std::string scriptPath = "assets/benchmark.txt";
+	std::size_t warmupFrames = kDefaultBenchmarkWarmup;
+	std::string reportPath = "benchmark.json";
+
+	// Performance overlay (see PerformanceHud), toggled with H in a window.
+	// Shown by default in interactive runs only, so that neither dumped
+	// frames nor benchmarks include it unless asked to.
+	bool hud = false;
+
+	// Frame pacing (see FramePacing), cycled with V in a window. V-Sync by
+	// default in a window; uncapped by default in benchmarks, which measure
+	// throughput, and in headless runs, which have no display to sync to.
+	// --fps selects fixed pacing.
+	FramePacing pacing = FramePacing::vsync;
+	std::size_t targetFps = kDefaultTargetFps;
+
+	// Where linked shader programs are cached as driver binaries (see
+	// ShaderProgram::set_binary_cache()); empty = no cache.
+	std::string shaderCacheDirectory = "shader-cache";
+
+	// Rebuild shader programs in the background when their files under
+	// assets/ change (see FileWatcher). On by default in interactive runs
+	// only, so that headless runs and benchmarks render what they started
+	// with.
+	bool watchShaders = false;
+
+	// Profile the whole run, from startup, and write a Chrome trace (see
+	// profiler.hpp) to tracePath at exit; empty = no profiling.
+	std::string tracePath;
+
+	// Cull with the GPU culler (see GpuCuller), read its visible set back
+	// each frame and compare it with frustum_cull() on the same bounds.
+	// A CullingValidator does the same for all scene objects plus random
+	// boxes, from fixed views at startup and from each frame's camera. The
+	// run fails on the first mismatch. Headless only, as the read back
+	// stalls the pipeline.
+	bool validateCulling = false;
+};
+
+// Parses the arguments after argv[0]. Throws Error on unknown options and
+// invalid values.
+RunOptions parse_run_options( int aArgc, char const* const* aArgv );
+
+// Usage text for --help
+char const* run_options_usage() noexcept;
+
+#endif // OPTIONS_HPP_A85C3F17_0D4E_4B92_9E6B_72F1C04D5A38
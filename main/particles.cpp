@@ -0,0 +1,290 @@
+#include "particles.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "worker_pool.hpp"
+
+namespace
+{
+	// Items per chunk for the parallel update. 16k particles are 64kB per
+	// stream, which keeps the scheduling overhead well below the work done
+	// per chunk.
+	constexpr std::size_t kParallelChunk_ = 16*1024;
+
+	// Integrates particles [aBegin, aEnd) and returns how many of them are
+	// still alive afterwards.
+	std::size_t integrate_( std::vector<float>*, std::size_t aBegin, std::size_t aEnd, float aDt ) noexcept;
+
+	// Swap-removes expired particles in [aBegin, aEnd). Survivors end up in
+	// [aBegin, return value). The lifespan must be the last stream.
+	std::size_t compact_( std::vector<float>*, std::size_t aStreamCount, std::size_t aBegin, std::size_t aEnd ) noexcept;
+}
+
+ParticlePool::ParticlePool( std::size_t aCapacity )
+	: mCount( 0 )
+	, mRecycle( 0 )
+{
+	for( auto& stream : mStreams )
+		stream.resize( aCapacity );
+}
+
+std::size_t ParticlePool::size() const noexcept
+{
+	return mCount;
+}
+std::size_t ParticlePool::capacity() const noexcept
+{
+	return mStreams[kLife_].size();
+}
+bool ParticlePool::empty() const noexcept
+{
+	return 0 == mCount;
+}
+
+void ParticlePool::clear() noexcept
+{
+	mCount = 0;
+	mRecycle = 0;
+}
+
+void ParticlePool::spawn( Vec3f aPosition, Vec3f aVelocity, float aLifespan ) noexcept
+{
+	auto const cap = capacity();
+	if( 0 == cap )
+		return;
+
+	std::size_t slot;
+	if( mCount < cap )
+	{
+		slot = mCount++;
+	}
+	else
+	{
+		slot = mRecycle;
+		mRecycle = (mRecycle + 1 == cap) ? 0 : mRecycle + 1;
+	}
+
+	mStreams[kPosX_][slot] = aPosition.x;
+	mStreams[kPosY_][slot] = aPosition.y;
+	mStreams[kPosZ_][slot] = aPosition.z;
+	mStreams[kVelX_][slot] = aVelocity.x;
+	mStreams[kVelY_][slot] = aVelocity.y;
+	mStreams[kVelZ_][slot] = aVelocity.z;
+	mStreams[kLife_][slot] = aLifespan;
+}
+
+void ParticlePool::update( float aDt ) noexcept
+{
+	auto const count = mCount;
+
+	// Nothing expired this step? Then there is nothing to compact, and we can
+	// skip the second pass over the lifespans.
+	if( integrate_( mStreams, 0, count, aDt ) == count )
+		return;
+
+	mCount = compact_( mStreams, kStreamCount_, 0, count );
+	if( mRecycle >= mCount )
+		mRecycle = 0;
+}
+
+void ParticlePool::update( float aDt, WorkerPool& aWorkers )
+{
+	auto const count = mCount;
+
+	// Fewer than two chunks cannot be split across threads; the serial
+	// path is cheaper for those.
+	if( 1 == aWorkers.thread_count() || count < 2*kParallelChunk_ )
+	{
+		update( aDt );
+		return;
+	}
+
+	// One-time allocation of the per-chunk bookkeeping
+	std::size_t const maxChunks = (capacity() + kParallelChunk_ - 1) / kParallelChunk_;
+	if( mChunkLive.size() != maxChunks )
+	{
+		mChunkLive.resize( maxChunks );
+		mHoles.reserve( maxChunks );
+		mMovers.reserve( maxChunks );
+	}
+
+	// Pass 1: integrate and compact each chunk in place
+	aWorkers.parallel_for( count, kParallelChunk_, [this,aDt] (std::size_t aBegin, std::size_t aEnd, std::size_t aChunk) {
+		auto live = integrate_( mStreams, aBegin, aEnd, aDt );
+		if( live != aEnd - aBegin )
+			live = compact_( mStreams, kStreamCount_, aBegin, aEnd ) - aBegin;
+
+		mChunkLive[aChunk] = live;
+	} );
+
+	// Prefix sum over the per-chunk survivor counts gives the final size.
+	std::size_t const chunks = (count + kParallelChunk_ - 1) / kParallelChunk_;
+
+	std::size_t live = 0;
+	for( std::size_t c = 0; c < chunks; ++c )
+		live += mChunkLive[c];
+
+	if( live == count )
+		return; // nobody died
+
+	// Chunk c now holds survivors in [begin, begin+n) and garbage in
+	// [begin+n, end). Holes below "live" must be filled; survivors at or
+	// above "live" must move. There are exactly as many of each. Collect
+	// both as spans with exclusive prefix sums over their lengths.
+	mHoles.clear();
+	mMovers.clear();
+
+	std::size_t holes = 0, movers = 0;
+	for( std::size_t c = 0; c < chunks; ++c )
+	{
+		auto const begin = c * kParallelChunk_;
+		auto const end = std::min( count, begin + kParallelChunk_ );
+		auto const liveEnd = begin + mChunkLive[c];
+
+		auto const holeEnd = std::min( end, live );
+		if( liveEnd < holeEnd )
+		{
+			mHoles.emplace_back( Span_{ liveEnd, holeEnd - liveEnd, holes } );
+			holes += holeEnd - liveEnd;
+		}
+
+		auto const moverBegin = std::max( begin, live );
+		if( moverBegin < liveEnd )
+		{
+			mMovers.emplace_back( Span_{ moverBegin, liveEnd - moverBegin, movers } );
+			movers += liveEnd - moverBegin;
+		}
+	}
+
+	assert( holes == movers );
+
+	// Pass 2: move the k-th mover into the k-th hole. Sources are all at or
+	// above "live" and targets all below, so the moves are independent.
+	aWorkers.parallel_for( holes, kParallelChunk_, [this] (std::size_t aBegin, std::size_t aEnd, std::size_t) {
+		auto const find_ = [] (std::vector<Span_> const& aSpans, std::size_t aK) {
+			auto it = std::upper_bound( aSpans.begin(), aSpans.end(), aK, [] (std::size_t aX, Span_ const& aSpan) {
+				return aX < aSpan.prefix;
+			} );
+			return std::size_t(it - aSpans.begin()) - 1;
+		};
+
+		auto hi = find_( mHoles, aBegin );
+		auto mi = find_( mMovers, aBegin );
+
+		for( std::size_t k = aBegin; k < aEnd; ++k )
+		{
+			while( k >= mHoles[hi].prefix + mHoles[hi].count ) ++hi;
+			while( k >= mMovers[mi].prefix + mMovers[mi].count ) ++mi;
+
+			auto const dst = mHoles[hi].begin + (k - mHoles[hi].prefix);
+			auto const src = mMovers[mi].begin + (k - mMovers[mi].prefix);
+
+			for( auto& stream : mStreams )
+				stream[dst] = stream[src];
+		}
+	} );
+
+	mCount = live;
+	if( mRecycle >= mCount )
+		mRecycle = 0;
+}
+
+void ParticlePool::copy_positions( float* aOut ) const noexcept
+{
+	assert( aOut || 0 == mCount );
+
+	float const* px = mStreams[kPosX_].data();
+	float const* py = mStreams[kPosY_].data();
+	float const* pz = mStreams[kPosZ_].data();
+
+	for( std::size_t i = 0; i < mCount; ++i )
+	{
+		aOut[3*i+0] = px[i];
+		aOut[3*i+1] = py[i];
+		aOut[3*i+2] = pz[i];
+	}
+}
+
+void ParticlePool::copy_velocities( float* aOut ) const noexcept
+{
+	assert( aOut || 0 == mCount );
+
+	float const* vx = mStreams[kVelX_].data();
+	float const* vy = mStreams[kVelY_].data();
+	float const* vz = mStreams[kVelZ_].data();
+
+	for( std::size_t i = 0; i < mCount; ++i )
+	{
+		aOut[3*i+0] = vx[i];
+		aOut[3*i+1] = vy[i];
+		aOut[3*i+2] = vz[i];
+	}
+}
+
+Vec3f ParticlePool::position( std::size_t aI ) const noexcept
+{
+	assert( aI < mCount );
+	return Vec3f{ mStreams[kPosX_][aI], mStreams[kPosY_][aI], mStreams[kPosZ_][aI] };
+}
+Vec3f ParticlePool::velocity( std::size_t aI ) const noexcept
+{
+	assert( aI < mCount );
+	return Vec3f{ mStreams[kVelX_][aI], mStreams[kVelY_][aI], mStreams[kVelZ_][aI] };
+}
+float ParticlePool::lifespan( std::size_t aI ) const noexcept
+{
+	assert( aI < mCount );
+	return mStreams[kLife_][aI];
+}
+
+namespace
+{
+	std::size_t integrate_( std::vector<float>* aStreams, std::size_t aBegin, std::size_t aEnd, float aDt ) noexcept
+	{
+		// Raw pointers keep the compiler from worrying about aliasing between
+		// the vectors' internals, so this loop vectorizes cleanly. The stream
+		// order matches ParticlePool::Stream_.
+		float* __restrict px = aStreams[0].data();
+		float* __restrict py = aStreams[1].data();
+		float* __restrict pz = aStreams[2].data();
+		float const* __restrict vx = aStreams[3].data();
+		float const* __restrict vy = aStreams[4].data();
+		float const* __restrict vz = aStreams[5].data();
+		float* __restrict life = aStreams[6].data();
+
+		std::size_t live = 0;
+		for( std::size_t i = aBegin; i < aEnd; ++i )
+		{
+			px[i] += vx[i] * aDt;
+			py[i] += vy[i] * aDt;
+			pz[i] += vz[i] * aDt;
+			life[i] -= aDt;
+			live += life[i] > 0.f ? 1 : 0;
+		}
+
+		return live;
+	}
+
+	std::size_t compact_( std::vector<float>* aStreams, std::size_t aStreamCount, std::size_t aBegin, std::size_t aEnd ) noexcept
+	{
+		float const* life = aStreams[aStreamCount-1].data();
+
+		std::size_t live = aEnd;
+		for( std::size_t i = aBegin; i < live; )
+		{
+			if( life[i] > 0.f )
+			{
+				++i;
+				continue;
+			}
+
+			--live;
+			for( std::size_t s = 0; s < aStreamCount; ++s )
+				aStreams[s][i] = aStreams[s][live];
+		}
+
+		return live;
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef PARTICLES_HPP_F6F8388C_ACC7_482E_B456_EF92B65E8D8B
+#define PARTICLES_HPP_F6F8388C_ACC7_482E_B456_EF92B65E8D8B
+
+#include <vector>
+
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+
+class WorkerPool;
+
+/** ParticlePool: fixed-capacity particle storage in structure-of-arrays form
+ *
+ * Particle storage is allocated once, in the constructor. Spawning appends to
+ * the end of the live range in O(1). Once the pool is full, new particles
+ * recycle existing slots in round-robin order (ring-buffer style), so a large
+ * burst never allocates and never drops the newest particles.
+ *
+ * update() integrates all live particles and removes expired ones by moving
+ * the last live particle into the freed slot ("swap-remove"). The order of
+ * the particles is therefore not stable, which is fine for additive sprites.
+ *
+ * update() with a WorkerPool splits the particles into fixed-size chunks.
+ * Each chunk is integrated and swap-compacted in place, in parallel. An
+ * exclusive prefix sum over the per-chunk survivor counts then determines the
+ * final live range [0, live): the holes left at the tail of each chunk inside
+ * that range are filled, in parallel, with survivors from beyond it. Only as
+ * many particles move as have expired, so the parallel path moves no more
+ * data than the serial one.
+ *
+ * Each attribute lives in its own contiguous array, such that the integration
+ * loop is a straight streaming pass that the compiler can vectorize.
+ */
+class ParticlePool final
+{
+	public:
+		explicit ParticlePool( std::size_t aCapacity = 0 );
+
+	public:
+		std::size_t size() const noexcept;
+		std::size_t capacity() const noexcept;
+		bool empty() const noexcept;
+
+		void clear() noexcept;
+
+		void spawn( Vec3f aPosition, Vec3f aVelocity, float aLifespan ) noexcept;
+
+		void update( float aDt ) noexcept;
+		void update( float aDt, WorkerPool& );
+
+		// Writes the live positions as interleaved xyz triplets (3*size()
+		// floats). Used to fill vertex buffers for rendering.
+		void copy_positions( float* aOut ) const noexcept;
+		// Same for the velocities
+		void copy_velocities( float* aOut ) const noexcept;
+
+		Vec3f position( std::size_t ) const noexcept;
+		Vec3f velocity( std::size_t ) const noexcept;
+		float lifespan( std::size_t ) const noexcept;
+
+	private:
+		enum Stream_
+		{
+			kPosX_, kPosY_, kPosZ_,
+			kVelX_, kVelY_, kVelZ_,
+			kLife_,
+			kStreamCount_
+		};
+
+		std::size_t mCount;
+		std::size_t mRecycle;
+
+		std::vector<float> mStreams[kStreamCount_];
+
+		// Parallel update only; sized on first use.
+		struct Span_
+		{
+			std::size_t begin, count;
+			std::size_t prefix; // exclusive prefix sum of the counts
+		};
+
+		std::vector<std::size_t> mChunkLive;
+		std::vector<Span_> mHoles, mMovers;
+};
+
+#endif // PARTICLES_HPP_F6F8388C_ACC7_482E_B456_EF92B65E8D8B
@@ -0,0 +1,107 @@
+#include "range_allocator.hpp"
+
+#include <iterator>
+
+#include <cassert>
+
+RangeAllocator::RangeAllocator( std::size_t aCapacity )
+	: mCapacity( aCapacity )
+	, mFreeSpace( 0 )
+{
+	if( aCapacity )
+		insert_free_( 0, aCapacity );
+}
+
+std::size_t RangeAllocator::allocate( std::size_t aSize )
+{
+	assert( aSize > 0 );
+
+	auto const fit = mBySize.lower_bound( aSize );
+	if( mBySize.end() == fit )
+		return kInvalid;
+
+	auto const offset = fit->second;
+	auto const size = fit->first;
+
+	erase_free_( mByOffset.find( offset ) );
+	if( size > aSize )
+		insert_free_( offset + aSize, size - aSize );
+
+	return offset;
+}
+
+void RangeAllocator::release( std::size_t aOffset, std::size_t aSize )
+{
+	assert( aSize > 0 && aOffset + aSize <= mCapacity );
+
+	auto offset = aOffset;
+	auto size = aSize;
+
+	// Merge with the following free range
+	auto next = mByOffset.lower_bound( aOffset );
+	assert( mByOffset.end() == next || next->first >= aOffset + aSize ); // double release?
+	if( mByOffset.end() != next && next->first == aOffset + aSize )
+	{
+		size += next->second;
+		erase_free_( next );
+	}
+
+	// Merge with the preceding free range
+	next = mByOffset.lower_bound( aOffset );
+	if( mByOffset.begin() != next )
+	{
+		auto const prev = std::prev( next );
+		assert( prev->first + prev->second <= aOffset ); // double release?
+		if( prev->first + prev->second == aOffset )
+		{
+			offset = prev->first;
+			size += prev->second;
+			erase_free_( prev );
+		}
+	}
+
+	insert_free_( offset, size );
+}
+
+std::size_t RangeAllocator::capacity() const noexcept
+{
+	return mCapacity;
+}
+std::size_t RangeAllocator::free_space() const noexcept
+{
+	return mFreeSpace;
+}
+std::size_t RangeAllocator::largest_free_range() const noexcept
+{
+	return mBySize.empty() ? 0 : mBySize.rbegin()->first;
+}
+std::size_t RangeAllocator::free_range_count() const noexcept
+{
+	return mByOffset.size();
+}
+
+void RangeAllocator::insert_free_( std::size_t aOffset, std::size_t aSize )
+{
+	mByOffset.emplace( aOffset, aSize );
+	mBySize.emplace( aSize, aOffset );
+	mFreeSpace += aSize;
+}
+
+void RangeAllocator::erase_free_( std::map<std::size_t,std::size_t>::iterator aIt )
+{
+	auto const offset = aIt->first;
+	auto const size = aIt->second;
+
+	auto range = mBySize.equal_range( size );
+	for( auto it = range.first; it != range.second; ++it )
+	{
+		if( it->second == offset )
+		{
+			mBySize.erase( it );
+			break;
+		}
+	}
+
+	mByOffset.erase( aIt );
+	mFreeSpace -= size;
+}
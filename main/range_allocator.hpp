@@ -0,0 +1,55 @@
+#ifndef RANGE_ALLOCATOR_HPP_A7D40E93_2C61_4B8F_9E35_6F0B18C2D4A7
+#define RANGE_ALLOCATOR_HPP_A7D40E93_2C61_4B8F_9E35_6F0B18C2D4A7
+
+#include <map>
+
+#include <cstddef>
+
+/** RangeAllocator: sub-allocation of ranges from a fixed-size space
+ *
+ * Hands out [offset, offset+size) ranges from [0, capacity). The allocator
+ * does not own any memory; it only does the bookkeeping, e.g., for ranges of
+ * elements in a large GPU buffer.
+ *
+ * Free ranges are kept in two ordered maps, one by offset and one by size.
+ * allocate() picks the smallest free range that fits (best fit), in
+ * O(log n) of the number of free ranges. release() merges the range with
+ * free neighbours, so free space does not fragment into adjacent pieces.
+ *
+ * The caller remembers the size of each allocation and passes it back to
+ * release().
+ */
+class RangeAllocator final
+{
+	public:
+		static constexpr std::size_t kInvalid = ~std::size_t(0);
+
+	public:
+		explicit RangeAllocator( std::size_t aCapacity );
+
+	public:
+		// Returns the offset of the new range, or kInvalid if there is no
+		// free range of at least aSize. aSize must be nonzero.
+		std::size_t allocate( std::size_t aSize );
+
+		// Returns a range obtained from allocate().
+		void release( std::size_t aOffset, std::size_t aSize );
+
+		std::size_t capacity() const noexcept;
+		std::size_t free_space() const noexcept;
+		std::size_t largest_free_range() const noexcept;
+		std::size_t free_range_count() const noexcept;
+
+	private:
+		void insert_free_( std::size_t aOffset, std::size_t aSize );
+		void erase_free_( std::map<std::size_t,std::size_t>::iterator );
+
+	private:
+		std::size_t mCapacity;
+		std::size_t mFreeSpace;
+
+		std::map<std::size_t,std::size_t> mByOffset; // offset -> size
+		std::multimap<std::size_t,std::size_t> mBySize; // size -> offset
+};
+
+#endif // RANGE_ALLOCATOR_HPP_A7D40E93_2C61_4B8F_9E35_6F0B18C2D4A7
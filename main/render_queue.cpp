@@ -0,0 +1,283 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#include "../support/error.hpp"
+#include "../support/stream_buffer.hpp"
+
+#include "uniform_blocks.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kNone_ = ~std::uint32_t(0);
+
+	// Indirect command layouts, as consumed by glMultiDraw*Indirect()
+	struct DrawArraysIndirectCommand_
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+	struct DrawElementsIndirectCommand_
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// Whether two draws can go into the same multi-draw
+	bool same_state_( DrawItem const& aA, DrawItem const& aB ) noexcept
+	{
+		return aA.program == aB.program
+			&& aA.vao == aB.vao
+			&& aA.texture == aB.texture
+			&& aA.material == aB.material
+			&& aA.transform == aB.transform
+			&& aA.mode == aB.mode
+			&& aA.indexed == aB.indexed
+		;
+	}
+
+	std::size_t triangles_( DrawItem const& aItem ) noexcept
+	{
+		std::size_t perInstance = 0;
+		if( GL_TRIANGLES == aItem.mode )
+			perInstance = std::size_t(aItem.count) / 3;
+		else if( (GL_TRIANGLE_STRIP == aItem.mode || GL_TRIANGLE_FAN == aItem.mode) && aItem.count > 2 )
+			perInstance = std::size_t(aItem.count) - 2;
+
+		return perInstance * std::size_t(aItem.instanceCount);
+	}
+}
+
+RenderQueue::RenderQueue( std::size_t aMaxMaterials, std::size_t aMaxIndirectDraws )
+	: mList( aMaxMaterials )
+	, mMaxMaterials( aMaxMaterials )
+	, mMaterialStride( uniform_block_stride( sizeof(MaterialUniforms) ) )
+	, mMaterialBuffer( std::make_unique<StreamBuffer>( aMaxMaterials * mMaterialStride ) )
+	, mMaxIndirectDraws( aMaxIndirectDraws )
+	, mCommandBuffer( std::make_unique<StreamBuffer>( aMaxIndirectDraws * sizeof(DrawElementsIndirectCommand_) ) )
+	, mCommands( nullptr )
+	, mCommandBytes( 0 )
+{
+	assert( mMaxMaterials > 0 && mMaxMaterials <= (std::size_t(1) << kDrawKeyMaterialBits) );
+}
+
+RenderQueue::~RenderQueue() = default;
+
+std::uint32_t RenderQueue::add_material( RenderMaterial const& aMaterial )
+{
+	return mList.add_material( aMaterial );
+}
+
+std::uint32_t RenderQueue::add_transform( RenderTransform const& aTransform )
+{
+	return mList.add_transform( aTransform );
+}
+
+void RenderQueue::submit( DrawItem const& aItem, RenderPass aPass, float aDepth )
+{
+	mList.submit( aItem, aPass, aDepth );
+}
+
+void RenderQueue::execute()
+{
+	execute( mList );
+}
+
+void RenderQueue::execute( DrawList& aList )
+{
+	aList.sort();
+
+	auto const& materialList = aList.materials();
+	auto const& transforms = aList.transforms();
+	if( materialList.size() > mMaxMaterials )
+		throw Error( "RenderQueue: %zu materials in a frame, but only room for %zu", materialList.size(), mMaxMaterials );
+
+	mStats = RenderQueueStats{};
+	mUniformCache.clear();
+
+	// Upload this frame's materials
+	auto* const materials = static_cast<unsigned char*>(mMaterialBuffer->map());
+	for( std::size_t i = 0; i < materialList.size(); ++i )
+	{
+		auto const& mat = materialList[i];
+		MaterialUniforms const block{
+			Vec4f{ mat.diffuse.x, mat.diffuse.y, mat.diffuse.z, 0.f },
+			Vec4f{ mat.ambient.x, mat.ambient.y, mat.ambient.z, 0.f }
+		};
+		std::memcpy( materials + i * mMaterialStride, &block, sizeof(block) );
+	}
+
+	mCommands = static_cast<unsigned char*>(mCommandBuffer->map());
+	mCommandBytes = 0;
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommandBuffer->buffer() );
+
+	GLuint program = 0, vao = 0, texture = 0;
+	std::uint32_t material = 0;
+	bool first = true;
+
+	ProgramUniforms_* uniforms = nullptr;
+
+	for( std::size_t i = 0; i < aList.size(); )
+	{
+		auto const& item = aList.sorted_item( i );
+
+		if( first || item.program != program )
+		{
+			glUseProgram( item.program );
+			program = item.program;
+			++mStats.programBinds;
+
+			auto it = std::find_if( mUniformCache.begin(), mUniformCache.end(), [&] (ProgramUniforms_ const& aU) {
+				return aU.program == program;
+			} );
+			if( mUniformCache.end() == it )
+			{
+				mUniformCache.emplace_back( ProgramUniforms_{ program, kNone_ } );
+				it = mUniformCache.end() - 1;
+			}
+			uniforms = &*it;
+		}
+		else
+			++mStats.skipped;
+
+		if( first || item.material != material )
+		{
+			auto const offset = mMaterialBuffer->region_offset() + item.material * mMaterialStride;
+			glBindBufferRange( GL_UNIFORM_BUFFER, kMaterialUniformBinding, mMaterialBuffer->buffer(), GLintptr(offset), sizeof(MaterialUniforms) );
+			material = item.material;
+			++mStats.materialBinds;
+		}
+		else
+			++mStats.skipped;
+
+		if( uniforms->transform != item.transform )
+		{
+			auto const& xform = transforms[item.transform];
+			glUniformMatrix4fv( 0, 1, GL_TRUE, xform.model2World.v );
+			glUniformMatrix3fv( 1, 1, GL_TRUE, xform.normalMatrix.v );
+			uniforms->transform = item.transform;
+			++mStats.uniformUploads;
+		}
+		else
+			++mStats.skipped;
+
+		if( first || item.texture != texture )
+		{
+			glActiveTexture( GL_TEXTURE0 );
+			glBindTexture( GL_TEXTURE_2D, item.texture );
+			texture = item.texture;
+			++mStats.textureBinds;
+		}
+		else
+			++mStats.skipped;
+
+		if( first || item.vao != vao )
+		{
+			glBindVertexArray( item.vao );
+			vao = item.vao;
+			++mStats.vaoBinds;
+		}
+		else
+			++mStats.skipped;
+
+		// Following draws with the same state go into one multi-draw. Their
+		// state changes are all redundant.
+		auto end = i + 1;
+		while( end < aList.size() && same_state_( item, aList.sorted_item( end ) ) )
+			++end;
+
+		if( end - i > 1 && multi_draw_( aList, i, end ) )
+			mStats.skipped += 5 * (end - i - 1);
+		else
+		{
+			draw_( item );
+			end = i + 1;
+		}
+
+		first = false;
+		i = end;
+	}
+
+	mStats.draws = aList.size();
+
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+	glBindVertexArray( 0 );
+	glUseProgram( 0 );
+
+	mMaterialBuffer->fence();
+	mCommandBuffer->fence();
+	mCommands = nullptr;
+
+	aList.clear();
+}
+
+void RenderQueue::draw_( DrawItem const& aItem )
+{
+	if( aItem.indexed )
+	{
+		auto const* offset = reinterpret_cast<void const*>(std::uintptr_t(aItem.first) * sizeof(GLuint));
+		glDrawElementsInstancedBaseVertex( aItem.mode, aItem.count, GL_UNSIGNED_INT, offset, aItem.instanceCount, aItem.baseVertex );
+	}
+	else if( 1 == aItem.instanceCount )
+		glDrawArrays( aItem.mode, aItem.first, aItem.count );
+	else
+		glDrawArraysInstanced( aItem.mode, aItem.first, aItem.count, aItem.instanceCount );
+
+	++mStats.drawCalls;
+	mStats.instances += std::size_t(aItem.instanceCount);
+	mStats.triangles += triangles_( aItem );
+}
+
+bool RenderQueue::multi_draw_( DrawList const& aList, std::size_t aBegin, std::size_t aEnd )
+{
+	auto const count = aEnd - aBegin;
+	auto const& head = aList.sorted_item( aBegin );
+
+	// Out of room for commands this frame? Caller falls back to single draws.
+	auto const stride = head.indexed ? sizeof(DrawElementsIndirectCommand_) : sizeof(DrawArraysIndirectCommand_);
+	if( mCommandBytes + count * stride > mMaxIndirectDraws * sizeof(DrawElementsIndirectCommand_) )
+		return false;
+
+	auto const offset = mCommandBytes;
+	for( auto i = aBegin; i < aEnd; ++i )
+	{
+		auto const& item = aList.sorted_item( i );
+		if( item.indexed )
+		{
+			DrawElementsIndirectCommand_ const cmd{ GLuint(item.count), GLuint(item.instanceCount), GLuint(item.first), item.baseVertex, 0 };
+			std::memcpy( mCommands + mCommandBytes, &cmd, sizeof(cmd) );
+		}
+		else
+		{
+			DrawArraysIndirectCommand_ const cmd{ GLuint(item.count), GLuint(item.instanceCount), GLuint(item.first), 0 };
+			std::memcpy( mCommands + mCommandBytes, &cmd, sizeof(cmd) );
+		}
+
+		mCommandBytes += stride;
+		mStats.instances += std::size_t(item.instanceCount);
+		mStats.triangles += triangles_( item );
+	}
+
+	auto const* indirect = reinterpret_cast<void const*>(mCommandBuffer->region_offset() + offset);
+	if( head.indexed )
+		glMultiDrawElementsIndirect( head.mode, GL_UNSIGNED_INT, indirect, GLsizei(count), 0 );
+	else
+		glMultiDrawArraysIndirect( head.mode, indirect, GLsizei(count), 0 );
+
+	++mStats.drawCalls;
+	++mStats.multiDrawCalls;
+	return true;
+}
+
+RenderQueueStats const& RenderQueue::stats() const noexcept
+{
+	return mStats;
+}
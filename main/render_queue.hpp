@@ -0,0 +1,120 @@
+#ifndef RENDER_QUEUE_HPP_B0D73E29_5A18_4C6F_A2E4_9F61C3D807B5
+#define RENDER_QUEUE_HPP_B0D73E29_5A18_4C6F_A2E4_9F61C3D807B5
+
+#include <glad.h>
+
+#include <vector>
+#include <memory>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "draw_list.hpp"
+
+class StreamBuffer;
+
+// Counters for one execute()
+struct RenderQueueStats
+{
+	std::size_t draws = 0; // submitted draws
+	std::size_t drawCalls = 0; // GL draw calls, including multi-draws
+	std::size_t multiDrawCalls = 0;
+	std::size_t instances = 0; // summed over all draws
+	std::size_t triangles = 0; // summed over all draws and instances
+
+	// State changes that were issued
+	std::size_t programBinds = 0;
+	std::size_t vaoBinds = 0;
+	std::size_t textureBinds = 0;
+	std::size_t uniformUploads = 0; // per-draw transform uploads
+	std::size_t materialBinds = 0; // uniform block range binds
+
+	// State changes that were filtered out as redundant
+	std::size_t skipped = 0;
+
+	std::size_t state_changes() const noexcept
+	{
+		return programBinds + vaoBinds + textureBinds + uniformUploads + materialBinds;
+	}
+};
+
+/** RenderQueue: sorted submission of draws with redundant state filtering
+ *
+ * Each frame, the scene registers the materials and transforms it needs,
+ * submits its draws, and calls execute(). execute() sorts the draws by their
+ * 64-bit draw key (see draw_keys.hpp) and issues them in that order. It only
+ * changes state (program, VAO, texture, material, transform) where the
+ * previous draw used something different. Transforms are tracked per
+ * program, since plain uniforms are program state in OpenGL.
+ *
+ * Alternatively, the draws are collected in a DrawList, possibly on another
+ * thread, and passed to execute( DrawList& ).
+ *
+ * All materials of a frame are written to a persistently mapped uniform
+ * buffer in one go; switching materials is a glBindBufferRange() to the
+ * MaterialData binding point, which does not depend on the program.
+ *
+ * Consecutive draws (after sorting) that use the same state, including the
+ * transform and VAO, are issued together with a single
+ * glMultiDrawElementsIndirect() or glMultiDrawArraysIndirect(). Static
+ * meshes placed in a shared GeometryHeap with a common transform thus cost
+ * one call per program/material/texture combination, however many there
+ * are.
+ *
+ * The queue keeps its allocations between frames. It requires a current
+ * OpenGL context from construction to destruction.
+ */
+class RenderQueue final
+{
+	public:
+		explicit RenderQueue( std::size_t aMaxMaterials = 256, std::size_t aMaxIndirectDraws = 4096 );
+		~RenderQueue();
+
+		RenderQueue( RenderQueue const& ) = delete;
+		RenderQueue& operator= (RenderQueue const&) = delete;
+
+	public:
+		// As for DrawList, on the queue's own list
+		std::uint32_t add_material( RenderMaterial const& );
+		std::uint32_t add_transform( RenderTransform const& );
+		void submit( DrawItem const&, RenderPass = RenderPass::opaque, float aDepth = 0.f );
+
+		// Sorts and issues all draws submitted since the last execute(), then
+		// clears the queue. Leaves the VAO and program bindings at zero.
+		void execute();
+
+		// Same, for the draws in aList (sorted first, if needed), which is
+		// cleared afterwards.
+		void execute( DrawList& aList );
+
+		RenderQueueStats const& stats() const noexcept;
+
+	private:
+		void draw_( DrawItem const& );
+		bool multi_draw_( DrawList const&, std::size_t aBegin, std::size_t aEnd );
+
+	private:
+		DrawList mList;
+
+		std::size_t mMaxMaterials;
+		std::size_t mMaterialStride;
+		std::unique_ptr<StreamBuffer> mMaterialBuffer;
+
+		// Indirect commands for the multi-draws; one region per frame.
+		std::size_t mMaxIndirectDraws;
+		std::unique_ptr<StreamBuffer> mCommandBuffer;
+		unsigned char* mCommands;
+		std::size_t mCommandBytes;
+
+		// Transform last uploaded to each program during execute()
+		struct ProgramUniforms_
+		{
+			GLuint program;
+			std::uint32_t transform;
+		};
+		std::vector<ProgramUniforms_> mUniformCache;
+
+		RenderQueueStats mStats;
+};
+
+#endif // RENDER_QUEUE_HPP_B0D73E29_5A18_4C6F_A2E4_9F61C3D807B5
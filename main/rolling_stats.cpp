@@ -0,0 +1,96 @@
+#include "rolling_stats.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+RollingStats::RollingStats( std::size_t aWindow )
+	: mSamples( aWindow, 0.0 )
+	, mNext( 0 )
+	, mSize( 0 )
+	, mTotal( 0 )
+	, mSum( 0.0 )
+	, mLast( 0.0 )
+{
+	assert( aWindow > 0 );
+}
+
+void RollingStats::add( double aSample ) noexcept
+{
+	if( mSize == mSamples.size() )
+		mSum -= mSamples[mNext];
+	else
+		++mSize;
+
+	mSamples[mNext] = aSample;
+	mSum += aSample;
+	mNext = (mNext + 1) % mSamples.size();
+
+	mLast = aSample;
+	++mTotal;
+
+	// Resum now and then, so that rounding errors of the running sum do
+	// not accumulate.
+	if( 0 == mNext )
+	{
+		mSum = 0.0;
+		for( std::size_t i = 0; i < mSize; ++i )
+			mSum += mSamples[i];
+	}
+}
+
+void RollingStats::clear() noexcept
+{
+	mNext = 0;
+	mSize = 0;
+	mTotal = 0;
+	mSum = 0.0;
+	mLast = 0.0;
+}
+
+std::size_t RollingStats::window() const noexcept
+{
+	return mSamples.size();
+}
+std::size_t RollingStats::size() const noexcept
+{
+	return mSize;
+}
+std::size_t RollingStats::total() const noexcept
+{
+	return mTotal;
+}
+
+double RollingStats::last() const noexcept
+{
+	return mLast;
+}
+double RollingStats::mean() const noexcept
+{
+	return mSize ? mSum / double(mSize) : 0.0;
+}
+double RollingStats::min() const noexcept
+{
+	if( 0 == mSize )
+		return 0.0;
+	return *std::min_element( mSamples.begin(), mSamples.begin() + std::ptrdiff_t(mSize) );
+}
+double RollingStats::max() const noexcept
+{
+	if( 0 == mSize )
+		return 0.0;
+	return *std::max_element( mSamples.begin(), mSamples.begin() + std::ptrdiff_t(mSize) );
+}
+double RollingStats::stddev() const noexcept
+{
+	if( 0 == mSize )
+		return 0.0;
+
+	double const mu = mean();
+	double sum = 0.0;
+	for( std::size_t i = 0; i < mSize; ++i )
+		sum += (mSamples[i] - mu) * (mSamples[i] - mu);
+
+	return std::sqrt( sum / double(mSize) );
+}
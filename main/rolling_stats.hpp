@@ -0,0 +1,43 @@
+#ifndef ROLLING_STATS_HPP_C2F85A1E_7B34_4D06_A9E1_63D0B8F4E527
+#define ROLLING_STATS_HPP_C2F85A1E_7B34_4D06_A9E1_63D0B8F4E527
+
+#include <vector>
+
+#include <cstddef>
+
+/** RollingStats: statistics over the most recent samples of a series
+ *
+ * Keeps the last window() samples in a ring. The mean is maintained
+ * incrementally; min(), max() and stddev() scan the window, which is meant
+ * to be small (a few hundred frames). total() counts all samples ever added.
+ */
+class RollingStats final
+{
+	public:
+		explicit RollingStats( std::size_t aWindow = 120 );
+
+	public:
+		void add( double aSample ) noexcept;
+		void clear() noexcept;
+
+		std::size_t window() const noexcept;
+		std::size_t size() const noexcept; // samples in the window
+		std::size_t total() const noexcept;
+
+		// Zero while empty
+		double last() const noexcept;
+		double mean() const noexcept;
+		double min() const noexcept;
+		double max() const noexcept;
+		double stddev() const noexcept; // of the samples in the window
+
+	private:
+		std::vector<double> mSamples;
+		std::size_t mNext;
+		std::size_t mSize;
+		std::size_t mTotal;
+		double mSum;
+		double mLast;
+};
+
+#endif // ROLLING_STATS_HPP_C2F85A1E_7B34_4D06_A9E1_63D0B8F4E527
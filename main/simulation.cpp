@@ -0,0 +1,272 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include "worker_pool.hpp"
+
+#include "../support/profiler.hpp"
+
+namespace
+{
+	// Exhaust emitter. The cone points along +z with a half-angle of
+	// acos(cos(45)) (45 radians, i.e., ~58 degrees), matching the original
+	// emitter.
+	constexpr Vec3f kExhaustAxis_{ 0.f, 0.f, 1.f };
+	float const kExhaustHalfAngle_ = std::acos( std::cos( 45.f ) );
+	constexpr float kExhaustLifespan_ = 0.5f;
+
+	// Nozzles, relative to the ship's launch offset, and particles emitted by
+	// each per step.
+	constexpr Vec3f kNozzles_[] = {
+		{ -20.208f, -1.f, -15.f },
+		{ -19.792f, -1.f, -15.f },
+		{ -20.f, -1.f, -15.208f },
+		{ -20.f, -1.f, -14.792f }
+	};
+	constexpr std::size_t kParticlesPerNozzle_ = 10;
+
+	// If the simulation thread falls behind real time by more than this
+	// (e.g., while stopped in a debugger), it skips ahead instead of trying
+	// to catch up.
+	constexpr auto kMaxLag_ = std::chrono::milliseconds( 250 );
+}
+
+ShipState interpolate( ShipState const& aFrom, ShipState const& aTo, float aAlpha ) noexcept
+{
+	if( !aFrom.launched || !aTo.launched )
+		return aTo;
+
+	ShipState ret = aTo;
+	ret.origin = aFrom.origin + (aTo.origin - aFrom.origin) * aAlpha;
+	ret.curve = aFrom.curve + (aTo.curve - aFrom.curve) * aAlpha;
+	ret.acceleration = aFrom.acceleration + (aTo.acceleration - aFrom.acceleration) * aAlpha;
+	return ret;
+}
+
+Mat44f ship_model_to_world( ShipState const& aShip ) noexcept
+{
+	if( !aShip.launched )
+		return kIdentity44f;
+
+	auto const pose = ship_pose( aShip );
+	return make_translation( pose.translation ) * make_rotation_x( pose.pitch ) * make_translation( kShipPivot );
+}
+
+ShipPose ship_pose( ShipState const& aShip ) noexcept
+{
+	if( !aShip.launched )
+		return ShipPose{ -kShipPivot, 0.f };
+
+	// Pitch the ship along its flight path, around the launch pad position
+	return ShipPose{
+		Vec3f{ 0.f, aShip.origin, aShip.curve } - kShipPivot,
+		std::atan2( aShip.curve, aShip.origin )
+	};
+}
+
+
+Simulation::Simulation( float aStepLength, std::size_t aParticleCapacity, WorkerPool& aWorkers, std::uint64_t aSeed )
+	: mStepLength( aStepLength )
+	, mWorkers( aWorkers )
+	, mParticles( aParticleCapacity )
+	, mRng( aSeed )
+	, mStep( 0 )
+	, mGpuParticles( false )
+	, mLaunchRequested( false )
+	, mResetRequested( false )
+	, mGpuRequested( false )
+	, mQuit( false )
+	, mStartTicks( Clock::now().time_since_epoch().count() )
+{
+	assert( mStepLength > 0.f );
+
+	for( auto& d : mDirections )
+		d.resize( kParticlesPerNozzle_ );
+}
+
+Simulation::~Simulation()
+{
+	stop();
+}
+
+float Simulation::step_length() const noexcept
+{
+	return mStepLength;
+}
+
+void Simulation::start()
+{
+	assert( !mThread.joinable() );
+
+	mQuit = false;
+	mStartTicks = (Clock::now() - std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( mStep * double(mStepLength) ) )).time_since_epoch().count();
+	mThread = std::thread( &Simulation::thread_main_, this );
+}
+void Simulation::stop()
+{
+	if( !mThread.joinable() )
+		return;
+
+	mQuit = true;
+	mThread.join();
+}
+
+void Simulation::step()
+{
+	PROFILE_SCOPE( "simulation step" );
+
+	float const dt = mStepLength;
+
+	// Apply commands
+	if( mResetRequested.exchange( false ) )
+		mShip = ShipState{};
+	if( mLaunchRequested.exchange( false ) )
+		mShip.launched = true;
+
+	if( bool const gpu = mGpuRequested.load(); gpu != mGpuParticles )
+	{
+		// Switching backends drops the live particles of the old one.
+		mGpuParticles = gpu;
+		mParticles.clear();
+	}
+
+	// Ship
+	ShipState const previous = mShip;
+	if( mShip.launched )
+	{
+		mShip.origin += mShip.acceleration * dt;
+		mShip.acceleration *= 1.0025f;
+
+		if( mShip.origin > 0.5f )
+		{
+			mShip.curve += 0.05f * dt;
+			mShip.curve *= 1.005f;
+		}
+
+		Vec3f const base{ 0.f, mShip.origin, mShip.curve };
+		for( auto const& nozzle : kNozzles_ )
+			emit_( base + nozzle, kParticlesPerNozzle_ );
+	}
+
+	// Particles
+	if( !mGpuParticles )
+		mParticles.update( dt, mWorkers );
+
+	++mStep;
+
+	// Publish
+	auto& snap = mSnapshots.back();
+	snap.step = mStep;
+	snap.time = mStep * double(mStepLength);
+	snap.previousShip = previous;
+	snap.ship = mShip;
+
+	auto const floats = 3 * mParticles.capacity();
+	if( snap.particlePositions.size() != floats )
+	{
+		// Once per snapshot slot
+		snap.particlePositions.resize( floats );
+		snap.particleVelocities.resize( floats );
+	}
+
+	snap.particleCount = mParticles.size();
+	mParticles.copy_positions( snap.particlePositions.data() );
+	mParticles.copy_velocities( snap.particleVelocities.data() );
+
+	mSnapshots.publish();
+}
+
+void Simulation::launch() noexcept
+{
+	mLaunchRequested = true;
+}
+void Simulation::reset() noexcept
+{
+	mResetRequested = true;
+}
+void Simulation::set_gpu_particles( bool aEnabled ) noexcept
+{
+	mGpuRequested = aEnabled;
+}
+
+SimulationSnapshot const& Simulation::latest() noexcept
+{
+	mSnapshots.update();
+	return mSnapshots.front();
+}
+
+void Simulation::take_gpu_spawns( std::vector<ParticleSpawn>& aSpawns )
+{
+	aSpawns.clear();
+
+	std::lock_guard<std::mutex> lock( mSpawnMutex );
+	std::swap( aSpawns, mGpuSpawns );
+}
+
+double Simulation::current_time() const noexcept
+{
+	Clock::time_point const start( Clock::duration( mStartTicks.load() ) );
+	return std::chrono::duration<double>( Clock::now() - start ).count();
+}
+
+float Simulation::interpolation_alpha( SimulationSnapshot const& aSnap, double aTime ) const noexcept
+{
+	// The snapshot for step n is published at (about) time n * h; render
+	// between steps n-1 and n as time advances to (n+1) * h.
+	auto const alpha = float( (aTime - aSnap.time) / mStepLength );
+	return std::clamp( alpha, 0.f, 1.f );
+}
+
+void Simulation::thread_main_()
+{
+	PROFILE_THREAD( "simulation" );
+
+	auto const stepLength = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( mStepLength ) );
+
+	Clock::time_point const start( Clock::duration( mStartTicks.load() ) );
+	auto next = start + stepLength * mStep;
+
+	while( !mQuit )
+	{
+		std::this_thread::sleep_until( next );
+		step();
+
+		next += stepLength;
+
+		auto const now = Clock::now();
+		if( now - next > kMaxLag_ )
+		{
+			// Skip ahead: shift the time origin, such that the current step
+			// corresponds to now.
+			mStartTicks = (now - stepLength * mStep).time_since_epoch().count();
+			next = now + stepLength;
+		}
+	}
+}
+
+void Simulation::emit_( Vec3f aPosition, std::size_t aCount )
+{
+	assert( aCount <= mDirections[0].size() );
+
+	cone_direction( mRng, kExhaustAxis_, kExhaustHalfAngle_, mDirections[0].data(), mDirections[1].data(), mDirections[2].data(), aCount );
+
+	if( mGpuParticles )
+	{
+		std::lock_guard<std::mutex> lock( mSpawnMutex );
+		for( std::size_t i = 0; i < aCount; ++i )
+		{
+			Vec3f const velocity{ mDirections[0][i], mDirections[1][i], mDirections[2][i] };
+			mGpuSpawns.emplace_back( ParticleSpawn{ aPosition, velocity, kExhaustLifespan_ } );
+		}
+		return;
+	}
+
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		Vec3f const velocity{ mDirections[0][i], mDirections[1][i], mDirections[2][i] };
+		mParticles.spawn( aPosition, velocity, kExhaustLifespan_ );
+	}
+}
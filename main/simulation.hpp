@@ -0,0 +1,166 @@
+#ifndef SIMULATION_HPP_7D2E94B1_C856_4F0A_B3E7_1A60C8F25D94
+#define SIMULATION_HPP_7D2E94B1_C856_4F0A_B3E7_1A60C8F25D94
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/random.hpp"
+
+#include "particles.hpp"
+#include "triple_buffer.hpp"
+
+class WorkerPool;
+
+// Spaceship launch animation
+struct ShipState
+{
+	bool launched = false;
+	float origin = 0.f; // vertical offset
+	float curve = 0.f; // forward offset, once the ship has cleared the pad
+	float acceleration = 0.1f;
+};
+
+// Linear interpolation between two consecutive ship states. Across a reset,
+// this returns aTo.
+ShipState interpolate( ShipState const& aFrom, ShipState const& aTo, float aAlpha ) noexcept;
+
+// Model-to-world transform of the ship for the given state
+Mat44f ship_model_to_world( ShipState const& ) noexcept;
+
+// The same transform as a pose, for a TransformHierarchy: the ship pitches
+// around kShipPivot, i.e.
+//   ship_model_to_world() = T(translation) * Rx(pitch) * T(kShipPivot)
+constexpr Vec3f kShipPivot{ 20.f, 1.125f, 15.f };
+
+struct ShipPose
+{
+	Vec3f translation;
+	float pitch;
+};
+
+ShipPose ship_pose( ShipState const& ) noexcept;
+
+// Particle spawn, as recorded for the GPU particle backend
+struct ParticleSpawn
+{
+	Vec3f position;
+	Vec3f velocity;
+	float lifespan;
+};
+
+// State of the simulation after a step, as seen by the renderer
+struct SimulationSnapshot
+{
+	std::uint64_t step = 0;
+	double time = 0.0; // simulated time in seconds = step * step length
+
+	ShipState previousShip; // state after the step before
+	ShipState ship;
+
+	// Live particles, as interleaved xyz triplets. Only particleCount
+	// entries are valid; the vectors are sized for the full pool.
+	std::size_t particleCount = 0;
+	std::vector<float> particlePositions;
+	std::vector<float> particleVelocities;
+};
+
+/** Simulation: fixed-timestep simulation of the ship and its exhaust
+ *
+ * All simulation state advances in steps of exactly step_length() seconds,
+ * independently of the frame rate. Given the same seed and the same commands
+ * at the same steps, the results are identical on every machine.
+ *
+ * start() runs the simulation on its own thread, paced to real time. After
+ * each step, a snapshot is published through a triple buffer. The renderer
+ * picks up the latest one with latest() and interpolates between its
+ * previous and current state (see interpolation_alpha()). Rendering therefore
+ * lags the simulation by up to one step, but the simulation never stalls a
+ * frame and vice versa.
+ *
+ * Without start(), step() advances the simulation manually (e.g. for tests).
+ *
+ * Commands (launch(), reset(), set_gpu_particles()) may be issued from any
+ * thread; they take effect at the beginning of the next step.
+ *
+ * In GPU particle mode, the simulation does not simulate particles itself.
+ * It only records spawns, which the renderer collects with take_gpu_spawns().
+ */
+class Simulation final
+{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+	public:
+		Simulation( float aStepLength, std::size_t aParticleCapacity, WorkerPool&, std::uint64_t aSeed = 0x5eed );
+		~Simulation();
+
+		Simulation( Simulation const& ) = delete;
+		Simulation& operator= (Simulation const&) = delete;
+
+	public:
+		float step_length() const noexcept;
+
+		void start();
+		void stop();
+
+		void step();
+
+		// Commands
+		void launch() noexcept;
+		void reset() noexcept;
+		void set_gpu_particles( bool ) noexcept;
+
+		// Renderer side. latest() must be called from a single thread.
+		SimulationSnapshot const& latest() noexcept;
+		void take_gpu_spawns( std::vector<ParticleSpawn>& aSpawns );
+
+		// Seconds of simulated time that correspond to "now" on the wall
+		// clock. Only meaningful while the simulation thread runs.
+		double current_time() const noexcept;
+
+		// Interpolation factor between aSnap.previousShip (0) and aSnap.ship
+		// (1) for rendering at aTime.
+		float interpolation_alpha( SimulationSnapshot const& aSnap, double aTime ) const noexcept;
+
+	private:
+		void thread_main_();
+		void emit_( Vec3f aPosition, std::size_t aCount );
+
+	private:
+		float mStepLength;
+
+		WorkerPool& mWorkers;
+		ParticlePool mParticles;
+		Xoshiro256PlusPacket mRng;
+		std::vector<float> mDirections[3];
+
+		std::uint64_t mStep;
+		ShipState mShip;
+		bool mGpuParticles;
+
+		std::atomic<bool> mLaunchRequested;
+		std::atomic<bool> mResetRequested;
+		std::atomic<bool> mGpuRequested;
+
+		std::mutex mSpawnMutex;
+		std::vector<ParticleSpawn> mGpuSpawns;
+
+		TripleBuffer<SimulationSnapshot> mSnapshots;
+
+		std::thread mThread;
+		std::atomic<bool> mQuit;
+
+		// Wall clock time of step 0 (Clock ticks). Written by the simulation
+		// thread when it has to skip ahead, read by the renderer.
+		std::atomic<Clock::rep> mStartTicks;
+};
+
+#endif // SIMULATION_HPP_7D2E94B1_C856_4F0A_B3E7_1A60C8F25D94
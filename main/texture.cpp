@@ -5,10 +5,12 @@
 #include <stb_image.h>
 
 #include "../support/error.hpp"
+#include "../support/profiler.hpp"
 
 GLuint load_texture_2d(const char* aPath)
 {
     assert(aPath);
+    PROFILE_SCOPE("load_texture_2d");
 
     auto configureTextureParameters = [](GLuint target, GLenum pname, GLint param) {
         glTexParameteri(target, pname, param);
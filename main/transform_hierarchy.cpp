@@ -0,0 +1,191 @@
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	constexpr std::uint32_t kNoSlot_ = ~std::uint32_t(0);
+
+	bool same_( Vec3f aA, Vec3f aB ) noexcept
+	{
+		return aA.x == aB.x && aA.y == aB.y && aA.z == aB.z;
+	}
+
+	Mat44f local_transform_( Vec3f aT, Vec3f aR, Vec3f aS ) noexcept
+	{
+		Mat44f ret = make_rotation_z( aR.z ) * make_rotation_y( aR.y ) * make_rotation_x( aR.x );
+
+		for( std::size_t i = 0; i < 3; ++i )
+		{
+			ret( i, 0 ) *= aS.x;
+			ret( i, 1 ) *= aS.y;
+			ret( i, 2 ) *= aS.z;
+		}
+
+		ret( 0, 3 ) = aT.x;
+		ret( 1, 3 ) = aT.y;
+		ret( 2, 3 ) = aT.z;
+		return ret;
+	}
+
+	template< typename tType >
+	void insert_at_( std::vector<tType>& aVec, std::size_t aPos, tType const& aValue )
+	{
+		aVec.insert( aVec.begin() + std::ptrdiff_t(aPos), aValue );
+	}
+}
+
+TransformNode TransformHierarchy::add( TransformNode aParent )
+{
+	auto const parentSlot = kNoTransformNode == aParent ? kNoSlot_ : slot_( aParent );
+	auto const depth = kNoSlot_ == parentSlot ? 0u : mDepth[parentSlot] + 1;
+
+	// Append to the end of the node's level
+	auto const pos = std::uint32_t(std::upper_bound( mDepth.begin(), mDepth.end(), depth ) - mDepth.begin());
+	auto const node = TransformNode(mSlot.size());
+
+	insert_at_( mParent, pos, parentSlot );
+	insert_at_( mDepth, pos, depth );
+	insert_at_( mNode, pos, node );
+	insert_at_( mFlags, pos, std::uint8_t(kLocalDirty_|kNormalStale_) );
+	insert_at_( mTranslation, pos, Vec3f{ 0.f, 0.f, 0.f } );
+	insert_at_( mRotation, pos, Vec3f{ 0.f, 0.f, 0.f } );
+	insert_at_( mScale, pos, Vec3f{ 1.f, 1.f, 1.f } );
+	insert_at_( mWorld, pos, kIdentity44f );
+	insert_at_( mNormal, pos, kIdentity33f );
+
+	// Fix up the slots that moved back by one. The new node's parent is on
+	// an earlier level, and thus before pos.
+	for( auto& p : mParent )
+	{
+		if( kNoSlot_ != p && p >= pos )
+			++p;
+	}
+
+	mSlot.emplace_back( pos );
+	for( std::size_t i = pos+1; i < mNode.size(); ++i )
+		mSlot[mNode[i]] = std::uint32_t(i);
+
+	mFirstDirty = std::min( mFirstDirty, std::size_t(pos) );
+	mFirstChanged = std::min( mFirstChanged, std::size_t(pos) );
+	return node;
+}
+
+std::size_t TransformHierarchy::size() const noexcept
+{
+	return mNode.size();
+}
+
+TransformNode TransformHierarchy::parent( TransformNode aNode ) const noexcept
+{
+	auto const p = mParent[slot_( aNode )];
+	return kNoSlot_ == p ? kNoTransformNode : mNode[p];
+}
+
+void TransformHierarchy::set_translation( TransformNode aNode, Vec3f aValue )
+{
+	auto const slot = slot_( aNode );
+	if( !same_( mTranslation[slot], aValue ) )
+	{
+		mTranslation[slot] = aValue;
+		mark_dirty_( slot );
+	}
+}
+void TransformHierarchy::set_rotation( TransformNode aNode, Vec3f aValue )
+{
+	auto const slot = slot_( aNode );
+	if( !same_( mRotation[slot], aValue ) )
+	{
+		mRotation[slot] = aValue;
+		mark_dirty_( slot );
+	}
+}
+void TransformHierarchy::set_scale( TransformNode aNode, Vec3f aValue )
+{
+	auto const slot = slot_( aNode );
+	if( !same_( mScale[slot], aValue ) )
+	{
+		mScale[slot] = aValue;
+		mark_dirty_( slot );
+	}
+}
+
+Vec3f TransformHierarchy::translation( TransformNode aNode ) const noexcept
+{
+	return mTranslation[slot_( aNode )];
+}
+Vec3f TransformHierarchy::rotation( TransformNode aNode ) const noexcept
+{
+	return mRotation[slot_( aNode )];
+}
+Vec3f TransformHierarchy::scale( TransformNode aNode ) const noexcept
+{
+	return mScale[slot_( aNode )];
+}
+
+std::size_t TransformHierarchy::update()
+{
+	auto const count = mNode.size();
+
+	// Clear the change flags of the last update
+	for( auto i = mFirstChanged; i < count; ++i )
+		mFlags[i] &= std::uint8_t(~kWorldChanged_);
+
+	mFirstChanged = mFirstDirty;
+	if( mFirstDirty >= count )
+		return 0;
+
+	std::size_t updated = 0;
+	for( auto i = mFirstDirty; i < count; ++i )
+	{
+		auto const parent = mParent[i];
+		bool const parentChanged = kNoSlot_ != parent && (mFlags[parent] & kWorldChanged_);
+
+		if( !(mFlags[i] & kLocalDirty_) && !parentChanged )
+			continue;
+
+		auto const local = local_transform_( mTranslation[i], mRotation[i], mScale[i] );
+		mWorld[i] = kNoSlot_ == parent ? local : mWorld[parent] * local;
+
+		mFlags[i] = std::uint8_t((mFlags[i] & ~kLocalDirty_) | kWorldChanged_ | kNormalStale_);
+		++updated;
+	}
+
+	mFirstDirty = ~std::size_t(0);
+	return updated;
+}
+
+Mat44f const& TransformHierarchy::world( TransformNode aNode ) const noexcept
+{
+	return mWorld[slot_( aNode )];
+}
+
+Mat33f const& TransformHierarchy::normal_matrix( TransformNode aNode )
+{
+	auto const slot = slot_( aNode );
+	if( mFlags[slot] & kNormalStale_ )
+	{
+		mNormal[slot] = mat44_to_mat33( transpose( invert( mWorld[slot] ) ) );
+		mFlags[slot] &= std::uint8_t(~kNormalStale_);
+	}
+	return mNormal[slot];
+}
+
+bool TransformHierarchy::world_changed( TransformNode aNode ) const noexcept
+{
+	return 0 != (mFlags[slot_( aNode )] & kWorldChanged_);
+}
+
+std::uint32_t TransformHierarchy::slot_( TransformNode aNode ) const noexcept
+{
+	assert( aNode < mSlot.size() );
+	return mSlot[aNode];
+}
+
+void TransformHierarchy::mark_dirty_( std::uint32_t aSlot ) noexcept
+{
+	mFlags[aSlot] |= kLocalDirty_;
+	mFirstDirty = std::min( mFirstDirty, std::size_t(aSlot) );
+}
@@ -0,0 +1,105 @@
+#ifndef TRANSFORM_HIERARCHY_HPP_C41E8A07_39D2_4B6F_A815_7E2D90F3B6C4
+#define TRANSFORM_HIERARCHY_HPP_C41E8A07_39D2_4B6F_A815_7E2D90F3B6C4
+
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat33.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Handle of a node in a TransformHierarchy. Handles stay valid when nodes
+// are added.
+using TransformNode = std::uint32_t;
+
+constexpr TransformNode kNoTransformNode = ~TransformNode(0);
+
+/** TransformHierarchy: parent/child transforms with cached world matrices
+ *
+ * Each node has a local translation, rotation and scale (TRS). Its local
+ * transform is
+ *
+ *   T(translation) * Rz(rotation.z) * Ry(rotation.y) * Rx(rotation.x) * S(scale)
+ *
+ * and its world transform is the parent's world transform times the local
+ * one.
+ *
+ * Setters only mark the node dirty (and only if the value actually changes).
+ * update() recomputes the world matrices of dirty nodes and their
+ * descendants, and nothing else; when nothing changed, it returns right
+ * away. Nodes are stored level by level (breadth first) in flat arrays, so
+ * that a single forward pass sees each parent before its children.
+ *
+ * Normal matrices (inverse transpose of the world transform's upper 3x3) are
+ * only computed when asked for, and cached until the node moves again.
+ */
+class TransformHierarchy final
+{
+	public:
+		TransformHierarchy() = default;
+
+	public:
+		// Adds a node with an identity local transform. Adding nodes
+		// reorders the internal arrays and is meant for load time.
+		TransformNode add( TransformNode aParent = kNoTransformNode );
+
+		std::size_t size() const noexcept;
+		TransformNode parent( TransformNode ) const noexcept;
+
+		void set_translation( TransformNode, Vec3f );
+		void set_rotation( TransformNode, Vec3f aRadians );
+		void set_scale( TransformNode, Vec3f );
+
+		Vec3f translation( TransformNode ) const noexcept;
+		Vec3f rotation( TransformNode ) const noexcept;
+		Vec3f scale( TransformNode ) const noexcept;
+
+		// Propagates changes to the world matrices. Returns the number of
+		// world matrices that were recomputed.
+		std::size_t update();
+
+		// As of the last update()
+		Mat44f const& world( TransformNode ) const noexcept;
+		Mat33f const& normal_matrix( TransformNode );
+
+		// Whether the world matrix changed in the last update()
+		bool world_changed( TransformNode ) const noexcept;
+
+	private:
+		std::uint32_t slot_( TransformNode ) const noexcept;
+		void mark_dirty_( std::uint32_t aSlot ) noexcept;
+
+	private:
+		enum Flags_ : std::uint8_t
+		{
+			kLocalDirty_ = 1,
+			kWorldChanged_ = 2,
+			kNormalStale_ = 4
+		};
+
+		// Per slot, in level order
+		std::vector<std::uint32_t> mParent; // slot of the parent, or ~0
+		std::vector<std::uint32_t> mDepth;
+		std::vector<TransformNode> mNode;
+		std::vector<std::uint8_t> mFlags;
+
+		std::vector<Vec3f> mTranslation;
+		std::vector<Vec3f> mRotation;
+		std::vector<Vec3f> mScale;
+
+		std::vector<Mat44f> mWorld;
+		std::vector<Mat33f> mNormal;
+
+		// Per node handle
+		std::vector<std::uint32_t> mSlot;
+
+		// Lowest slot that is dirty; everything before it is up to date.
+		std::size_t mFirstDirty = ~std::size_t(0);
+
+		// Lowest slot that may have kWorldChanged_ set
+		std::size_t mFirstChanged = ~std::size_t(0);
+};
+
+#endif // TRANSFORM_HIERARCHY_HPP_C41E8A07_39D2_4B6F_A815_7E2D90F3B6C4
@@ -0,0 +1,70 @@
+#ifndef TRIPLE_BUFFER_HPP_A31C6E58_0D47_4B92_8F6A_E2570B9C14D3
+#define TRIPLE_BUFFER_HPP_A31C6E58_0D47_4B92_8F6A_E2570B9C14D3
+
+#include <atomic>
+
+/** TripleBuffer: lock-free hand-over of the latest value between two threads
+ *
+ * One writer thread fills back() and calls publish(). One reader thread calls
+ * update() to fetch the most recently published value and then reads it
+ * through front(). Neither side ever waits for the other. The writer may
+ * publish several times between two update()s; the reader then skips the
+ * intermediate values.
+ *
+ * There are three slots: the writer owns one (back), the reader owns one
+ * (front), and the third (middle) holds the latest published value. publish()
+ * and update() atomically swap their slot with the middle one.
+ *
+ * Slots are reused, so a T holding e.g. std::vector keeps its allocations.
+ */
+template< typename tT >
+class TripleBuffer final
+{
+	public:
+		TripleBuffer() = default;
+
+		TripleBuffer( TripleBuffer const& ) = delete;
+		TripleBuffer& operator= (TripleBuffer const&) = delete;
+
+	public:
+		// Writer side
+		tT& back() noexcept
+		{
+			return mSlots[mBack];
+		}
+
+		void publish() noexcept
+		{
+			auto const prev = mMiddle.exchange( mBack | kFresh_, std::memory_order_acq_rel );
+			mBack = prev & kIndexMask_;
+		}
+
+		// Reader side. Returns true if a new value was published since the
+		// last call.
+		bool update() noexcept
+		{
+			if( !(mMiddle.load( std::memory_order_relaxed ) & kFresh_) )
+				return false;
+
+			auto const prev = mMiddle.exchange( mFront, std::memory_order_acq_rel );
+			mFront = prev & kIndexMask_;
+			return true;
+		}
+
+		tT const& front() const noexcept
+		{
+			return mSlots[mFront];
+		}
+
+	private:
+		static constexpr unsigned kIndexMask_ = 0x3;
+		static constexpr unsigned kFresh_ = 0x4;
+
+		tT mSlots[3];
+
+		unsigned mBack = 0; // writer only
+		unsigned mFront = 1; // reader only
+		std::atomic<unsigned> mMiddle{ 2 };
+};
+
+#endif // TRIPLE_BUFFER_HPP_A31C6E58_0D47_4B92_8F6A_E2570B9C14D3
@@ -0,0 +1,10 @@
+#include "uniform_blocks.hpp"
+
+std::size_t uniform_block_stride( std::size_t aSize )
+{
+	GLint align = 0;
+	glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align );
+
+	auto const a = std::size_t(align > 0 ? align : 256);
+	return (aSize + a - 1) / a * a;
+}
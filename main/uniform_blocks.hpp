@@ -0,0 +1,44 @@
+#ifndef UNIFORM_BLOCKS_HPP_E29A0C5D_8B14_4F73_96D1_2C7B45E0A3F8
+#define UNIFORM_BLOCKS_HPP_E29A0C5D_8B14_4F73_96D1_2C7B45E0A3F8
+
+#include <glad.h>
+
+#include <cstddef>
+
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Uniform blocks shared by the mesh shaders (default.*, launch.*). The C++
+// structs mirror the std140 layout of the GLSL blocks; keep them in sync.
+// Matrices are declared row_major in GLSL, so Mat44f is copied as-is.
+
+// Binding points
+constexpr GLuint kFrameUniformBinding = 0;
+constexpr GLuint kMaterialUniformBinding = 1;
+
+// layout (std140, row_major, binding = 0) uniform FrameData
+struct FrameUniforms
+{
+	Mat44f viewProjection;
+	Vec4f lightDirection; // xyz, normalized
+	Vec4f lightDiffuse;   // rgb
+	Vec4f ambientLight;   // rgb
+};
+
+static_assert( sizeof(FrameUniforms) == 112 );
+static_assert( offsetof(FrameUniforms, lightDirection) == 64 );
+
+// layout (std140, binding = 1) uniform MaterialData
+struct MaterialUniforms
+{
+	Vec4f diffuse; // rgb, reflectance for the diffuse light
+	Vec4f ambient; // rgb, reflectance for the ambient light
+};
+
+static_assert( sizeof(MaterialUniforms) == 32 );
+
+// Rounds aSize up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, such that blocks
+// placed at multiples of the result can be bound with glBindBufferRange().
+std::size_t uniform_block_stride( std::size_t aSize );
+
+#endif // UNIFORM_BLOCKS_HPP_E29A0C5D_8B14_4F73_96D1_2C7B45E0A3F8
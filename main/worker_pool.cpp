@@ -0,0 +1,142 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "../support/profiler.hpp"
+
+WorkerPool::WorkerPool( std::size_t aThreads )
+	: mQuit( false )
+	, mGeneration( 0 )
+	, mJob( nullptr )
+	, mJobCount( 0 )
+	, mJobChunk( 0 )
+	, mJobChunks( 0 )
+	, mNextChunk( 0 )
+	, mFinishedChunks( 0 )
+	, mBusyWorkers( 0 )
+{
+	if( 0 == aThreads )
+		aThreads = std::max( 1u, std::thread::hardware_concurrency() );
+
+	// The calling thread is the first "worker"
+	mThreads.reserve( aThreads-1 );
+	for( std::size_t i = 1; i < aThreads; ++i )
+		mThreads.emplace_back( [this] { worker_main_(); } );
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+
+	for( auto& thread : mThreads )
+		thread.join();
+}
+
+std::size_t WorkerPool::thread_count() const noexcept
+{
+	return mThreads.size() + 1;
+}
+
+void WorkerPool::parallel_for( std::size_t aCount, std::size_t aChunkSize, ChunkFn const& aFn )
+{
+	assert( aChunkSize > 0 );
+
+	std::size_t const chunks = (aCount + aChunkSize - 1) / aChunkSize;
+	if( 0 == chunks )
+		return;
+
+	// Not worth waking anybody up?
+	if( mThreads.empty() || 1 == chunks )
+	{
+		for( std::size_t c = 0; c < chunks; ++c )
+			{
+			PROFILE_SCOPE( "parallel_for chunk" );
+			aFn( c*aChunkSize, std::min( aCount, (c+1)*aChunkSize ), c );
+		}
+		return;
+	}
+
+	std::unique_lock<std::mutex> turn( mTurn );
+
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		assert( !mJob ); // no nested parallel_for()
+
+		mJob = &aFn;
+		mJobCount = aCount;
+		mJobChunk = aChunkSize;
+		mJobChunks = chunks;
+		mNextChunk.store( 0, std::memory_order_relaxed );
+		mFinishedChunks.store( 0, std::memory_order_relaxed );
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	run_chunks_( aFn, aCount, aChunkSize, chunks );
+
+	// Wait for the other chunks to finish *and* for every worker that joined
+	// this job to leave it. The latter ensures that no straggler can pick up
+	// chunks of the next job with this job's parameters.
+	std::unique_lock<std::mutex> lock( mMutex );
+	mDone.wait( lock, [&] {
+		return mFinishedChunks.load( std::memory_order_acquire ) == chunks && 0 == mBusyWorkers;
+	} );
+
+	mJob = nullptr;
+}
+
+void WorkerPool::worker_main_()
+{
+	PROFILE_THREAD( "worker" );
+
+	std::size_t seen = 0;
+
+	for( ;; )
+	{
+		ChunkFn const* job;
+		std::size_t count, chunk, chunks;
+
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mWake.wait( lock, [&] { return mQuit || (mJob && seen != mGeneration); } );
+
+			if( mQuit )
+				return;
+
+			seen = mGeneration;
+			job = mJob;
+			count = mJobCount;
+			chunk = mJobChunk;
+			chunks = mJobChunks;
+			++mBusyWorkers;
+		}
+
+		run_chunks_( *job, count, chunk, chunks );
+
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			--mBusyWorkers;
+		}
+		mDone.notify_all();
+	}
+}
+
+void WorkerPool::run_chunks_( ChunkFn const& aFn, std::size_t aCount, std::size_t aChunkSize, std::size_t aChunks ) noexcept
+{
+	for( ;; )
+	{
+		auto const c = mNextChunk.fetch_add( 1, std::memory_order_relaxed );
+		if( c >= aChunks )
+			break;
+
+		aFn( c*aChunkSize, std::min( aCount, (c+1)*aChunkSize ), c );
+
+		mFinishedChunks.fetch_add( 1, std::memory_order_release );
+	}
+}
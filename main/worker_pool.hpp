@@ -0,0 +1,73 @@
+#ifndef WORKER_POOL_HPP_0C4E2B7A_5D19_4F63_9A8E_3B7C1D2E6F40
+#define WORKER_POOL_HPP_0C4E2B7A_5D19_4F63_9A8E_3B7C1D2E6F40
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <cstddef>
+
+/** WorkerPool: a small fixed set of threads for data-parallel loops
+ *
+ * parallel_for() splits [0, aCount) into chunks of (at most) aChunkSize items
+ * and hands them out to the workers through a shared atomic counter. The
+ * calling thread participates as well, and parallel_for() returns only once
+ * all chunks have been processed. Several threads may share a pool (e.g.,
+ * the simulation and the frame build stage); their parallel_for() calls take
+ * turns, so the machine is never oversubscribed by one pool's jobs. A
+ * parallel_for() must not be nested in another one's chunk callback.
+ *
+ * The chunk callback must not throw.
+ *
+ * A pool constructed with aThreads == 1 has no workers and runs everything on
+ * the calling thread, which makes it convenient as a serial reference.
+ */
+class WorkerPool final
+{
+	public:
+		// Chunk callback: (first item, one-past-last item, chunk index)
+		using ChunkFn = std::function<void(std::size_t,std::size_t,std::size_t)>;
+
+	public:
+		// aThreads is the total number of threads, including the caller. Zero
+		// selects std::thread::hardware_concurrency().
+		explicit WorkerPool( std::size_t aThreads = 0 );
+		~WorkerPool();
+
+		WorkerPool( WorkerPool const& ) = delete;
+		WorkerPool& operator= (WorkerPool const&) = delete;
+
+	public:
+		std::size_t thread_count() const noexcept;
+
+		void parallel_for( std::size_t aCount, std::size_t aChunkSize, ChunkFn const& );
+
+	private:
+		void worker_main_();
+		void run_chunks_( ChunkFn const&, std::size_t, std::size_t, std::size_t ) noexcept;
+
+	private:
+		std::vector<std::thread> mThreads;
+
+		std::mutex mTurn; // held by the parallel_for() that owns the workers
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		std::condition_variable mDone;
+
+		bool mQuit;
+		std::size_t mGeneration;
+
+		// Current job; only valid while a parallel_for() is in flight.
+		ChunkFn const* mJob;
+		std::size_t mJobCount;
+		std::size_t mJobChunk;
+		std::size_t mJobChunks;
+		std::atomic<std::size_t> mNextChunk;
+		std::atomic<std::size_t> mFinishedChunks;
+		std::size_t mBusyWorkers;
+};
+
+#endif // WORKER_POOL_HPP_0C4E2B7A_5D19_4F63_9A8E_3B7C1D2E6F40
@@ -90,6 +90,13 @@ project "main"
 	links "x-stb"
 	links "x-glad"
 	links "x-glfw"
+	links "x-fontstash"
+
+	-- Headless mode (see main/headless.hpp)
+	filter "system:linux"
+		links "EGL"
+
+	filter "*"
 
 	files( sources )
 
@@ -100,7 +107,8 @@ project "main-shaders"
 		"assets/*.geom",
 		"assets/*.tesc",
 		"assets/*.tese",
-		"assets/*.comp"
+		"assets/*.comp",
+		"assets/*.glsl"
 	}
 
 	kind "Utility"
@@ -147,7 +155,40 @@ project "vmlib-test"
 
 	files( sources )
 
+	-- CPU-only modules from main/ that are unit tested here
+	files {
+		"main/benchmark.cpp",
+		"main/benchmark.hpp",
+		"main/bvh.cpp",
+		"main/bvh.hpp",
+		"main/draw_keys.cpp",
+		"main/draw_keys.hpp",
+		"main/draw_list.cpp",
+		"main/draw_list.hpp",
+		"main/frame_pacing.cpp",
+		"main/frame_pacing.hpp",
+		"main/frame_pipeline.hpp",
+		"main/occlusion.cpp",
+		"main/occlusion.hpp",
+		"main/options.cpp",
+		"main/options.hpp",
+		"main/particles.cpp",
+		"main/particles.hpp",
+		"main/range_allocator.cpp",
+		"main/range_allocator.hpp",
+		"main/rolling_stats.cpp",
+		"main/rolling_stats.hpp",
+		"main/simulation.cpp",
+		"main/simulation.hpp",
+		"main/transform_hierarchy.cpp",
+		"main/transform_hierarchy.hpp",
+		"main/triple_buffer.hpp",
+		"main/worker_pool.cpp",
+		"main/worker_pool.hpp"
+	}
+
 	links "vmlib"
+	links "support"
 	links "x-catch2"
 
 	files( sources )
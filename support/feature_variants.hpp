@@ -0,0 +1,87 @@
+#ifndef FEATURE_VARIANTS_HPP_02EE7E8E_C623_4E96_8275_2A33F437267F
+#define FEATURE_VARIANTS_HPP_02EE7E8E_C623_4E96_8275_2A33F437267F
+
+#include <map>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "error.hpp"
+
+/** FeatureVariants: one tVariant per feature mask, created on first use
+ *
+ * Bit i of a feature mask selects aFeatures[i]. The defines of a mask are
+ * its selected features, in the order of aFeatures (not of the bits). This is
+ * the bookkeeping behind ShaderVariants, which uses it with ShaderProgram;
+ * nothing here requires OpenGL.
+ *
+ * Variants are kept in a std::map, so they do not move once constructed
+ * (ShaderPrograms must not move while a ShaderBuildService builds them).
+ */
+template< typename tVariant >
+class FeatureVariants final
+{
+	public:
+		using Map = std::map<std::uint32_t, tVariant>;
+
+	public:
+		// Throws Error if there are more features than mask bits
+		explicit FeatureVariants( std::vector<std::string> aFeatures )
+			: mFeatures( std::move(aFeatures) )
+		{
+			if( mFeatures.size() > 32 )
+				throw Error( "FeatureVariants: %zu features, but masks have 32 bits", mFeatures.size() );
+		}
+
+	public:
+		// Returns the variant aFeatureMask. If there is none yet, it is
+		// constructed in place as tVariant( aArgs..., defines( aFeatureMask ) ).
+		// If that throws, nothing is added, and the next call tries again.
+		template< typename... tArgs >
+		tVariant& get( std::uint32_t aFeatureMask, tArgs&&... aArgs )
+		{
+			if( auto const it = mVariants.find( aFeatureMask ); mVariants.end() != it )
+				return it->second;
+
+			return mVariants.emplace( std::piecewise_construct,
+				std::forward_as_tuple( aFeatureMask ),
+				std::forward_as_tuple( std::forward<tArgs>(aArgs)..., defines( aFeatureMask ) )
+			).first->second;
+		}
+
+		// Throws Error if aFeatureMask has bits for features that do not
+		// exist
+		std::vector<std::string> defines( std::uint32_t aFeatureMask ) const
+		{
+			if( mFeatures.size() < 32 && (aFeatureMask >> mFeatures.size()) )
+				throw Error( "FeatureVariants: feature mask %#x selects unknown features (%zu defined)", unsigned(aFeatureMask), mFeatures.size() );
+
+			std::vector<std::string> ret;
+			for( std::size_t i = 0; i < mFeatures.size(); ++i )
+			{
+				if( aFeatureMask & (std::uint32_t(1) << i) )
+					ret.emplace_back( mFeatures[i] );
+			}
+			return ret;
+		}
+
+		// Number of variants created so far
+		std::size_t size() const noexcept
+		{
+			return mVariants.size();
+		}
+
+		// Variants created so far, by mask
+		typename Map::iterator begin() noexcept { return mVariants.begin(); }
+		typename Map::iterator end() noexcept { return mVariants.end(); }
+
+	private:
+		std::vector<std::string> mFeatures;
+		Map mVariants;
+};
+
+#endif // FEATURE_VARIANTS_HPP_02EE7E8E_C623_4E96_8275_2A33F437267F
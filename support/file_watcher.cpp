@@ -0,0 +1,156 @@
+#include "file_watcher.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#	include <poll.h>
+#	include <unistd.h>
+#	include <sys/inotify.h>
+#endif // ~ __linux__
+
+#include "error.hpp"
+#include "profiler.hpp"
+
+FileWatcher::FileWatcher( std::string aDirectory, Clock::duration aSettle, Clock::duration aPollInterval )
+	: mDirectory( std::move(aDirectory) )
+	, mSettle( aSettle )
+	, mPollInterval( aPollInterval )
+	, mInotify( -1 )
+	, mQuit( false )
+{
+	std::error_code ec;
+	if( !std::filesystem::is_directory( mDirectory, ec ) )
+		throw Error( "FileWatcher: '%s' is not a directory", mDirectory.c_str() );
+
+#	if defined(__linux__)
+	mInotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( -1 == mInotify )
+		throw Error( "FileWatcher: inotify_init1() failed: %s", std::strerror( errno ) );
+
+	if( -1 == inotify_add_watch( mInotify, mDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO ) )
+	{
+		int const err = errno;
+		close( mInotify );
+		throw Error( "FileWatcher: unable to watch '%s': %s", mDirectory.c_str(), std::strerror( err ) );
+	}
+#	else // !__linux__
+	// The first scan only records the current times, so that existing
+	// files are not reported. Scanning here rather than on the thread
+	// means that any change after the constructor returns is seen.
+	scan_( false );
+#	endif // ~ __linux__
+
+	mThread = std::thread( [this] { thread_main_(); } );
+}
+
+FileWatcher::~FileWatcher()
+{
+	mQuit.store( true, std::memory_order_relaxed );
+	mThread.join();
+
+#	if defined(__linux__)
+	if( -1 != mInotify )
+		close( mInotify );
+#	endif // ~ __linux__
+}
+
+std::vector<std::string> FileWatcher::take_changes()
+{
+	return take_changes( Clock::now() );
+}
+
+std::vector<std::string> FileWatcher::take_changes( Clock::time_point aNow )
+{
+	auto const settled = aNow - mSettle;
+
+	std::vector<std::string> ret;
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	for( auto it = mPending.begin(); mPending.end() != it; )
+	{
+		if( it->second <= settled )
+		{
+			ret.emplace_back( it->first );
+			it = mPending.erase( it );
+		}
+		else
+			++it;
+	}
+
+	return ret;
+}
+
+std::size_t FileWatcher::pending()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	return mPending.size();
+}
+
+void FileWatcher::thread_main_()
+{
+	PROFILE_THREAD( "file watcher" );
+
+	// Wake up regularly to check mQuit
+	auto const timeout = std::chrono::duration_cast<std::chrono::milliseconds>( mPollInterval );
+
+#	if defined(__linux__)
+	alignas(inotify_event) char buffer[4096];
+
+	while( !mQuit.load( std::memory_order_relaxed ) )
+	{
+		pollfd pfd{ mInotify, POLLIN, 0 };
+		if( poll( &pfd, 1, int(timeout.count()) ) <= 0 )
+			continue;
+
+		for( ;; )
+		{
+			auto const bytes = read( mInotify, buffer, sizeof(buffer) );
+			if( bytes <= 0 )
+				break; // EAGAIN: drained
+
+			for( char const* ptr = buffer; ptr < buffer + bytes; )
+			{
+				auto const* event = reinterpret_cast<inotify_event const*>(ptr);
+				if( event->len && !(event->mask & IN_ISDIR) )
+					changed_( event->name );
+
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+#	else // !__linux__
+	while( !mQuit.load( std::memory_order_relaxed ) )
+	{
+		std::this_thread::sleep_for( timeout );
+		scan_( true );
+	}
+#	endif // ~ __linux__
+}
+
+void FileWatcher::changed_( std::string const& aName )
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	mPending[mDirectory + "/" + aName] = Clock::now();
+}
+
+void FileWatcher::scan_( bool aReport )
+{
+	std::error_code ec;
+	for( auto const& entry : std::filesystem::directory_iterator( mDirectory, ec ) )
+	{
+		if( !entry.is_regular_file( ec ) )
+			continue;
+
+		auto const name = entry.path().filename().string();
+		auto const time = entry.last_write_time( ec );
+
+		auto& known = mTimes[name];
+		if( aReport && known != time )
+			changed_( name );
+		known = time;
+	}
+}
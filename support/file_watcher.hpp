@@ -0,0 +1,82 @@
+#ifndef FILE_WATCHER_HPP_6284D968_08DD_4C0C_A98A_63A890FA7B00
+#define FILE_WATCHER_HPP_6284D968_08DD_4C0C_A98A_63A890FA7B00
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+
+/** FileWatcher: reports files that change in a directory
+ *
+ * A thread waits for changes to the files directly in aDirectory (not in
+ * subdirectories). On Linux, it uses inotify and sees files that were
+ * written and closed, or renamed into the directory; elsewhere, it compares
+ * modification times every aPollInterval.
+ *
+ * Editors often save in several steps (e.g., truncate and write, or write a
+ * temporary file and rename it), so a file is only reported once no further
+ * change arrived for aSettle. Changes are seen once the constructor has
+ * returned.
+ *
+ * take_changes() and pending() may be called from any thread.
+ */
+class FileWatcher final
+{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+	public:
+		// Throws Error if aDirectory cannot be watched
+		explicit FileWatcher( 
+			std::string aDirectory,
+			Clock::duration aSettle = std::chrono::milliseconds(50),
+			Clock::duration aPollInterval = std::chrono::milliseconds(250)
+		);
+		~FileWatcher();
+
+		FileWatcher( FileWatcher const& ) = delete;
+		FileWatcher& operator= (FileWatcher const&) = delete;
+
+	public:
+		// Files that changed since the last call, as aDirectory + "/" +
+		// name, sorted. Never blocks on the watcher thread.
+		std::vector<std::string> take_changes();
+
+		// As above, but as if the time was aNow, e.g., to check the settle
+		// window without waiting for it
+		std::vector<std::string> take_changes( Clock::time_point aNow );
+
+		// Number of changed files not taken yet, settled or not
+		std::size_t pending();
+
+	private:
+		void thread_main_();
+		void changed_( std::string const& aName );
+
+		// Polling: updates mTimes; with aReport, reports files whose time
+		// changed
+		void scan_( bool aReport );
+
+	private:
+		std::string mDirectory;
+		Clock::duration mSettle;
+		Clock::duration mPollInterval;
+
+		std::mutex mMutex;
+		std::map<std::string, Clock::time_point> mPending; // path -> last change
+
+		int mInotify; // -1 if polling
+
+		// Polling: last seen modification times, by name. Only used by the
+		// watcher thread once it runs.
+		std::map<std::string, std::filesystem::file_time_type> mTimes;
+
+		std::atomic<bool> mQuit;
+		std::thread mThread;
+};
+
+#endif // FILE_WATCHER_HPP_6284D968_08DD_4C0C_A98A_63A890FA7B00
@@ -0,0 +1,257 @@
+#include "profiler.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+
+#include "error.hpp"
+
+namespace
+{
+	// Per thread; at 24 bytes each 6 MB, allocated on the thread's first
+	// event. Enough for several thousand frames.
+	constexpr std::size_t kEventsPerThread_ = 262144;
+
+	struct Event_
+	{
+		char const* name;
+		std::uint64_t begin, end;
+	};
+
+	struct ThreadBuffer_
+	{
+		std::uint32_t id;
+		bool gpu;
+		std::string name; // guarded by gRegistryMutex_
+
+		// Written by the owning thread only. Events [0, count) are complete.
+		std::unique_ptr<Event_[]> events;
+		std::atomic<std::size_t> count{ 0 };
+		std::atomic<std::size_t> dropped{ 0 };
+	};
+
+	std::mutex gRegistryMutex_;
+	std::vector<std::unique_ptr<ThreadBuffer_>> gBuffers_; // never shrinks
+
+	std::atomic<bool> gCapturing_{ false };
+	std::atomic<std::uint64_t> gCaptureBegin_{ 0 };
+
+	thread_local ThreadBuffer_* tBuffer_ = nullptr;
+
+	ThreadBuffer_* register_buffer_( char const* aName, bool aGpu )
+	{
+		std::lock_guard<std::mutex> lock( gRegistryMutex_ );
+
+		auto buffer = std::make_unique<ThreadBuffer_>();
+		buffer->id = std::uint32_t(gBuffers_.size() + 1);
+		buffer->gpu = aGpu;
+		buffer->name = aName ? aName : "thread " + std::to_string( buffer->id );
+
+		gBuffers_.emplace_back( std::move(buffer) );
+		return gBuffers_.back().get();
+	}
+
+	ThreadBuffer_* thread_buffer_()
+	{
+		if( !tBuffer_ )
+			tBuffer_ = register_buffer_( nullptr, false );
+		return tBuffer_;
+	}
+
+	ThreadBuffer_* gpu_buffer_()
+	{
+		static ThreadBuffer_* const buffer = register_buffer_( "GPU", true );
+		return buffer;
+	}
+
+	void append_( ThreadBuffer_* aBuffer, char const* aName, std::uint64_t aBegin, std::uint64_t aEnd ) noexcept
+	{
+		if( !aBuffer->events )
+		{
+			aBuffer->events.reset( new (std::nothrow) Event_[kEventsPerThread_] );
+			if( !aBuffer->events )
+			{
+				aBuffer->dropped.fetch_add( 1, std::memory_order_relaxed );
+				return;
+			}
+		}
+
+		auto const index = aBuffer->count.load( std::memory_order_relaxed );
+		if( index == kEventsPerThread_ )
+		{
+			aBuffer->dropped.fetch_add( 1, std::memory_order_relaxed );
+			return;
+		}
+
+		aBuffer->events[index] = Event_{ aName, aBegin, aEnd };
+		aBuffer->count.store( index + 1, std::memory_order_release );
+	}
+
+	void write_string_( std::FILE* aOut, char const* aStr )
+	{
+		std::fputc( '"', aOut );
+		for( ; *aStr; ++aStr )
+		{
+			char const c = *aStr;
+			if( '"' == c || '\\' == c )
+				std::fprintf( aOut, "\\%c", c );
+			else if( static_cast<unsigned char>(c) < 0x20 )
+				std::fprintf( aOut, "\\u%04x", unsigned(c) );
+			else
+				std::fputc( c, aOut );
+		}
+		std::fputc( '"', aOut );
+	}
+
+	// Chrome traces use microseconds
+	double trace_time_( std::uint64_t aTime, std::uint64_t aOrigin ) noexcept
+	{
+		return aTime > aOrigin ? double(aTime - aOrigin) * 1e-3 : 0.0;
+	}
+}
+
+std::uint64_t profiler_now() noexcept
+{
+	using namespace std::chrono;
+	return std::uint64_t(duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count());
+}
+
+void profiler_start_capture()
+{
+	std::lock_guard<std::mutex> lock( gRegistryMutex_ );
+	for( auto& buffer : gBuffers_ )
+	{
+		buffer->count.store( 0, std::memory_order_relaxed );
+		buffer->dropped.store( 0, std::memory_order_relaxed );
+	}
+
+	gCaptureBegin_.store( profiler_now(), std::memory_order_relaxed );
+	gCapturing_.store( true, std::memory_order_release );
+}
+void profiler_stop_capture() noexcept
+{
+	gCapturing_.store( false, std::memory_order_release );
+}
+bool profiler_capturing() noexcept
+{
+	return gCapturing_.load( std::memory_order_acquire );
+}
+
+void profiler_set_thread_name( char const* aName )
+{
+	if( !tBuffer_ )
+	{
+		tBuffer_ = register_buffer_( aName, false );
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( gRegistryMutex_ );
+	tBuffer_->name = aName;
+}
+
+void profiler_record_cpu( char const* aName, std::uint64_t aBegin, std::uint64_t aEnd ) noexcept
+{
+	if( !profiler_capturing() )
+		return;
+
+	ThreadBuffer_* buffer = tBuffer_;
+	if( !buffer )
+	{
+		try
+		{
+			buffer = thread_buffer_();
+		}
+		catch( ... )
+		{
+			return;
+		}
+	}
+
+	append_( buffer, aName, aBegin, aEnd );
+}
+
+void profiler_record_gpu( char const* aName, std::uint64_t aBegin, std::uint64_t aEnd ) noexcept
+{
+	if( !profiler_capturing() )
+		return;
+
+	ThreadBuffer_* buffer = nullptr;
+	try
+	{
+		buffer = gpu_buffer_();
+	}
+	catch( ... )
+	{
+		return;
+	}
+
+	append_( buffer, aName, aBegin, aEnd );
+}
+
+ProfilerStats profiler_stats()
+{
+	std::lock_guard<std::mutex> lock( gRegistryMutex_ );
+
+	ProfilerStats ret;
+	for( auto const& buffer : gBuffers_ )
+	{
+		auto const count = buffer->count.load( std::memory_order_acquire );
+		auto const dropped = buffer->dropped.load( std::memory_order_relaxed );
+		if( count || dropped )
+			++ret.threads;
+
+		ret.events += count;
+		ret.dropped += dropped;
+	}
+
+	return ret;
+}
+
+void profiler_write_chrome_trace( char const* aPath )
+{
+	std::FILE* fout = std::fopen( aPath, "wb" );
+	if( !fout )
+		throw Error( "profiler_write_chrome_trace(): Unable to open '%s' for writing", aPath );
+
+	std::lock_guard<std::mutex> lock( gRegistryMutex_ );
+	auto const origin = gCaptureBegin_.load( std::memory_order_relaxed );
+
+	std::fprintf( fout, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+	std::fprintf( fout, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"renderer\"}}" );
+
+	for( auto const& buffer : gBuffers_ )
+	{
+		auto const count = buffer->count.load( std::memory_order_acquire );
+
+		// Keep the GPU track below the threads
+		std::fprintf( fout, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", unsigned(buffer->id) );
+		write_string_( fout, buffer->name.c_str() );
+		std::fprintf( fout, "}},\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}",
+			unsigned(buffer->id), unsigned(buffer->gpu ? 1000 + buffer->id : buffer->id) );
+
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			auto const& event = buffer->events[i];
+
+			std::fprintf( fout, ",\n{\"name\":" );
+			write_string_( fout, event.name );
+			std::fprintf( fout, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				buffer->gpu ? "gpu" : "cpu", unsigned(buffer->id),
+				trace_time_( event.begin, origin ),
+				event.end > event.begin ? double(event.end - event.begin) * 1e-3 : 0.0 );
+		}
+	}
+
+	std::fprintf( fout, "\n]}\n" );
+
+	bool const failed = 0 != std::ferror( fout );
+	std::fclose( fout );
+
+	if( failed )
+		throw Error( "profiler_write_chrome_trace(): Error while writing '%s'", aPath );
+}
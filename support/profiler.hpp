@@ -0,0 +1,107 @@
+#ifndef PROFILER_HPP_5B9E27C4_D063_4A8F_B1E2_7C40F9A3D618
+#define PROFILER_HPP_5B9E27C4_D063_4A8F_B1E2_7C40F9A3D618
+
+#include <cstdint>
+#include <cstddef>
+
+// Set to 0 to compile the PROFILE_* macros to nothing. The profiler_*()
+// functions remain available either way.
+#if !defined(PROFILER_ENABLED)
+#	define PROFILER_ENABLED 1
+#endif
+
+/* Hierarchical scope profiler with Chrome trace export
+ *
+ * Scopes are recorded as complete events (name, begin and end time) into a
+ * buffer per thread. Each buffer has a single writer, its own thread, and is
+ * appended to without locks; a thread takes a lock only once, to register
+ * its buffer on its first event. Events are only recorded while a capture is
+ * running; otherwise a scope costs a single atomic load. A full buffer drops
+ * further events of its thread, see ProfilerStats::dropped.
+ *
+ * Nesting is implied by the times: a scope that begins and ends within
+ * another one on the same thread is shown as its child.
+ *
+ * GPU times are recorded through profiler_record_gpu() on a separate GPU
+ * track, after conversion to the CPU clock (see RenderMetricsTracker).
+ *
+ * Event names are stored by pointer and must remain valid until the trace is
+ * written; PROFILE_SCOPE() is meant for string literals.
+ *
+ * Example:
+ *
+ *	void load_things()
+ *	{
+ *		PROFILE_SCOPE( "load things" );
+ *		...
+ *	}
+ */
+
+#define PROFILE_CONCAT_IMPL_(a,b) a##b
+#define PROFILE_CONCAT_(a,b) PROFILE_CONCAT_IMPL_(a,b)
+
+#if PROFILER_ENABLED
+#	define PROFILE_SCOPE(name) ::ProfileScope PROFILE_CONCAT_(profileScope_,__LINE__)( name )
+#	define PROFILE_THREAD(name) ::profiler_set_thread_name( name )
+#else
+#	define PROFILE_SCOPE(name) do {} while(0)
+#	define PROFILE_THREAD(name) do {} while(0)
+#endif
+
+struct ProfilerStats
+{
+	std::size_t threads = 0; // that recorded at least one event
+	std::size_t events = 0;
+	std::size_t dropped = 0;
+};
+
+// Nanoseconds on the profiler's clock (std::chrono::steady_clock)
+std::uint64_t profiler_now() noexcept;
+
+// Starting a capture discards the events of the previous one. Neither should
+// be called while other threads are recording.
+void profiler_start_capture();
+void profiler_stop_capture() noexcept;
+bool profiler_capturing() noexcept;
+
+// Name of the calling thread in the trace. Recorded even when not capturing.
+void profiler_set_thread_name( char const* aName );
+
+void profiler_record_cpu( char const* aName, std::uint64_t aBegin, std::uint64_t aEnd ) noexcept;
+void profiler_record_gpu( char const* aName, std::uint64_t aBegin, std::uint64_t aEnd ) noexcept;
+
+ProfilerStats profiler_stats();
+
+// Writes the events recorded so far in the Chrome trace event format, for
+// chrome://tracing or ui.perfetto.dev. Throws Error if the file cannot be
+// written.
+void profiler_write_chrome_trace( char const* aPath );
+
+
+/** ProfileScope: records a CPU event from construction to destruction
+ *
+ * Usually created through PROFILE_SCOPE().
+ */
+class ProfileScope final
+{
+	public:
+		explicit ProfileScope( char const* aName ) noexcept
+			: mName( aName )
+			, mBegin( profiler_capturing() ? profiler_now() : 0 )
+		{}
+
+		~ProfileScope()
+		{
+			if( mBegin )
+				profiler_record_cpu( mName, mBegin, profiler_now() );
+		}
+
+		ProfileScope( ProfileScope const& ) = delete;
+		ProfileScope& operator= (ProfileScope const&) = delete;
+
+	private:
+		char const* mName;
+		std::uint64_t mBegin;
+};
+
+#endif // PROFILER_HPP_5B9E27C4_D063_4A8F_B1E2_7C40F9A3D618
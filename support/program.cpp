@@ -1,23 +1,63 @@
 #include "program.hpp"
 
+#include <chrono>
 #include <vector>
 #include <utility>
+#include <string_view>
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
 
 #include <cstdio>
+#include <cstring>
+#include <cassert>
 
 #include <glad.h>
 #include <GLFW/glfw3.h>
 
 #include "error.hpp"
+#include "profiler.hpp"
+#include "program_cache.hpp"
 #include "checkpoint.hpp"
+#include "shader_builds.hpp"
 
 namespace
 {
-	GLuint load_shader_( 
+	// Creates the shader and starts compiling it
+	GLuint start_shader_( 
 		GLenum aShaderType, 
-		char const* aSourcePath
+		std::string const& aSource
 	);
 
+	// Throws Error if the shader did not compile. aFiles as in ShaderText.
+	void check_shader_( 
+		GLuint aShader,
+		GLenum aShaderType, 
+		std::vector<std::string> const& aFiles
+	);
+
+	// Program binary cache, see ShaderProgram::set_binary_cache()
+	struct BinaryCache_
+	{
+		std::string directory; // empty = disabled
+		int formats = -1; // GL_NUM_PROGRAM_BINARY_FORMATS; < 0 = not queried yet
+		ShaderProgram::BinaryCacheStats stats;
+	};
+
+	BinaryCache_ gBinaryCache_;
+
+	bool binary_cache_enabled_();
+
+	std::uint64_t program_key_( 
+		std::vector<ShaderProgram::ShaderSource> const& aSources, 
+		std::vector<ShaderText> const& aSourceTexts
+	);
+
+	// Returns 0 if there is no usable binary. Otherwise, aCompileMilliseconds
+	// is the time it took to build the program from source.
+	GLuint load_binary_( std::uint64_t aKey, double& aCompileMilliseconds );
+	void store_binary_( GLuint aProgram, std::uint64_t aKey, double aCompileMilliseconds );
+
 	// lightweight std::experimental::scope_exit alternative
 	// Not the most complete or convenient implementation...
 	template< typename tFunc >
@@ -37,145 +77,267 @@ namespace
 	}
 }
 
-ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources )
+ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources, std::vector<std::string> aDefines )
 	: mProgram( 0 )
+	, mFallback( 0 )
+	, mService( nullptr )
 	, mSources( std::move(aShaderSources) )
+	, mDefines( std::move(aDefines) )
 {
+	for( auto const& source : mSources )
+		mFiles.emplace_back( source.sourcePath );
+
 	reload();
 }
 
+ShaderProgram::ShaderProgram( std::vector<ShaderSource> aShaderSources, ShaderBuildService& aService, std::vector<std::string> aDefines )
+	: mProgram( 0 )
+	, mFallback( aService.fallback_program() )
+	, mService( &aService )
+	, mSources( std::move(aShaderSources) )
+	, mDefines( std::move(aDefines) )
+{
+	for( auto const& source : mSources )
+		mFiles.emplace_back( source.sourcePath );
+
+	aService.submit_( *this );
+}
+
 ShaderProgram::~ShaderProgram()
 {
-	if( 0 != mProgram )
-		glDeleteProgram( mProgram );
+	if( mService )
+		mService->release_( *this );
+
+	if( GLuint const prog = mProgram.load( std::memory_order_relaxed ) )
+		glDeleteProgram( prog );
 }
 
 ShaderProgram::ShaderProgram( ShaderProgram&& aOther ) noexcept
-	: mProgram( std::exchange( aOther.mProgram, 0 ) )
+	: mProgram( aOther.mProgram.exchange( 0, std::memory_order_relaxed ) )
+	, mFallback( aOther.mFallback )
+	, mService( nullptr )
 	, mSources( std::move(aOther.mSources) )
-{}
+	, mDefines( std::move(aOther.mDefines) )
+	, mFiles( std::move(aOther.mFiles) )
+{
+	assert( !aOther.mService ); // the service refers to aOther
+}
 ShaderProgram& ShaderProgram::operator= (ShaderProgram&& aOther) noexcept
 {
-	std::swap( mProgram, aOther.mProgram );
+	assert( !mService && !aOther.mService );
+
+	GLuint const prog = mProgram.load( std::memory_order_relaxed );
+	mProgram.store( aOther.mProgram.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+	aOther.mProgram.store( prog, std::memory_order_relaxed );
+
+	std::swap( mFallback, aOther.mFallback );
 	std::swap( mSources, aOther.mSources );
+	std::swap( mDefines, aOther.mDefines );
+	std::swap( mFiles, aOther.mFiles );
 	return *this;
 }
 
 GLuint ShaderProgram::programId() const noexcept
 {
-	return mProgram;
+	GLuint const prog = mProgram.load( std::memory_order_acquire );
+	return prog ? prog : mFallback;
+}
+
+bool ShaderProgram::ready() const noexcept
+{
+	return 0 != mProgram.load( std::memory_order_acquire );
 }
 
 void ShaderProgram::reload()
 {
-	// Space to hold the shaders when we load them
-	std::vector<GLuint> shaders;
-	shaders.reserve( mSources.size() );
+	PROFILE_SCOPE( "compile shader program" );
 
-	// Ensure that shaders are cleaned up properly, regardless of how we leave
-	// the function (e.g., either by returning or by exception)
-	auto const scopeShaders_ = scope_exit_( [&shaders] {
-		for( auto const shader : shaders )
-			glDeleteShader( shader );
-	} );
+	// Its result would replace this one
+	if( mService )
+		mService->wait( *this );
+
+	auto build = start_build_( load_sources_() );
+	if( GLuint const old = finish_build_( build ) )
+	{
+		if( mService )
+			mService->retire_program_( old );
+		else
+			glDeleteProgram( old );
+	}
+}
+
+std::vector<std::string> const& ShaderProgram::files() const noexcept
+{
+	return mFiles;
+}
+
+std::vector<ShaderText> ShaderProgram::load_sources_() const
+{
+	std::vector<ShaderText> texts;
+	texts.reserve( mSources.size() );
 
-	// Load shaders
 	for( auto const& source : mSources )
-		shaders.emplace_back( load_shader_( source.type, source.sourcePath.c_str() ) );
+		texts.emplace_back( preprocess_shader( source.sourcePath, mDefines ) );
+
+	return texts;
+}
+
+ShaderProgram::Build_ ShaderProgram::start_build_( std::vector<ShaderText> const& aSourceTexts ) const
+{
+	assert( aSourceTexts.size() == mSources.size() );
+
+	auto const begin = Clock_::now();
+
+	Build_ build;
 
-	// Create program object
+	build.files.reserve( aSourceTexts.size() );
+	for( auto const& text : aSourceTexts )
+		build.files.emplace_back( text.files );
+
+	// Try the binary cache first
+	build.cached = binary_cache_enabled_();
+	if( build.cached )
+	{
+		build.key = program_key_( mSources, aSourceTexts );
+		build.program = load_binary_( build.key, build.compileMilliseconds );
+		if( build.program )
+		{
+			build.fromCache = true;
+			build.milliseconds = std::chrono::duration<double, std::milli>( Clock_::now() - begin ).count();
+			return build;
+		}
+	}
+
+	// Compile and link. No status is queried here, so that the driver may
+	// work on several programs concurrently; see finish_build_().
 	OGL_CHECKPOINT_ALWAYS();
 
-	GLuint prog = glCreateProgram();
+	build.shaders.reserve( mSources.size() );
+	for( std::size_t i = 0; i < mSources.size(); ++i )
+		build.shaders.emplace_back( start_shader_( mSources[i].type, aSourceTexts[i].text ) );
 
-	// Ensure that the program is cleaned up. 
+	build.program = glCreateProgram();
 
-	/* There is a small trick here. If we successfully compile and link the new
-	 * program, we will replace the value of the "prog" variable with the old
-	 * program's ID. In this case, the following will delete the old program
-	 * (if there was any). If we do not reach the end (e.g. exception thrown),
-	 * the new program ID will still be in the "prog" variable, and we will
-	 * delete it appropriately. (However, the old program in mProgram is left
-	 * intact).
-	 */
-	auto const scopeProgram_ = scope_exit_( [&prog] {
-		if( 0 != prog )
-			glDeleteProgram( prog );
-	} );
+	if( build.cached )
+		glProgramParameteri( build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
 
 	// Link individual shaders to create the final shader program
-	for( auto const shader : shaders )
-		glAttachShader( prog, shader );
+	for( auto const shader : build.shaders )
+		glAttachShader( build.program, shader );
+
+	glLinkProgram( build.program );
 
-	glLinkProgram( prog );
+	OGL_CHECKPOINT_ALWAYS();
+
+	build.milliseconds = std::chrono::duration<double, std::milli>( Clock_::now() - begin ).count();
+	return build;
+}
+
+bool ShaderProgram::build_done_( Build_ const& aBuild ) noexcept
+{
+	if( aBuild.fromCache || !GLAD_GL_KHR_parallel_shader_compile )
+		return true;
+
+	GLint done = GL_FALSE;
+	glGetProgramiv( aBuild.program, GL_COMPLETION_STATUS_KHR, &done );
+	return GL_FALSE != done;
+}
+
+GLuint ShaderProgram::finish_build_( Build_& aBuild )
+{
+	// Ensure that the shaders and the new program are cleaned up, regardless
+	// of how we leave the function. A successful build hands its program
+	// over to mProgram first.
+	auto const scopeBuild_ = scope_exit_( [&aBuild] {
+		discard_build_( aBuild );
+	} );
+
+	// Track the includes even if the build fails; fixing one of them should
+	// trigger a rebuild (see ShaderBuildService::rebuild_changed()).
+	mFiles.clear();
+	for( auto const& files : aBuild.files )
+	{
+		for( auto const& file : files )
+		{
+			if( mFiles.end() == std::find( mFiles.begin(), mFiles.end(), file ) )
+				mFiles.emplace_back( file );
+		}
+	}
+
+	auto const begin = Clock_::now();
+	auto const milliseconds = [&aBuild, begin] {
+		return aBuild.milliseconds + std::chrono::duration<double, std::milli>( Clock_::now() - begin ).count();
+	};
 
+	if( aBuild.fromCache )
 	{
+		double const loadMilliseconds = milliseconds();
+
+		auto& stats = gBinaryCache_.stats;
+		stats.loadMilliseconds += loadMilliseconds;
+		stats.savedMilliseconds += std::max( aBuild.compileMilliseconds - loadMilliseconds, 0.0 );
+	}
+	else
+	{
+		// Compile errors first; they explain a failed link
+		for( std::size_t i = 0; i < aBuild.shaders.size(); ++i )
+			check_shader_( aBuild.shaders[i], mSources[i].type, aBuild.files[i] );
+
 		// Get info log
 		GLint logLength = 0;
-		glGetProgramiv( prog, GL_INFO_LOG_LENGTH, &logLength );
+		glGetProgramiv( aBuild.program, GL_INFO_LOG_LENGTH, &logLength );
 
 		std::vector<GLchar> log;
 		if( logLength )
 		{
 			log.resize( logLength );
-			glGetProgramInfoLog( prog, GLsizei(log.size()), nullptr, log.data() );
+			glGetProgramInfoLog( aBuild.program, GLsizei(log.size()), nullptr, log.data() );
 		}
 
 		// Check link status
 		GLint status = 0;
-		glGetProgramiv( prog, GL_LINK_STATUS, &status );
+		glGetProgramiv( aBuild.program, GL_LINK_STATUS, &status );
 
 		if( GL_TRUE != status )
 			throw Error( "Shader program linking failed: \n%s\n", log.data() );
 
 		if( !log.empty() )
 			std::fprintf( stderr, "Note: shader program linking log:\n%s\n", log.data() );
+
+		OGL_CHECKPOINT_ALWAYS();
+
+		if( aBuild.cached )
+			store_binary_( aBuild.program, aBuild.key, milliseconds() );
 	}
-	
-	OGL_CHECKPOINT_ALWAYS();
 
 	// Replace the old shader program (if any) with the new one
-	std::swap( mProgram, prog );
+	return mProgram.exchange( std::exchange( aBuild.program, 0 ), std::memory_order_acq_rel );
 }
 
-namespace
+void ShaderProgram::discard_build_( Build_& aBuild ) noexcept
 {
-	GLuint load_shader_( GLenum aShaderType, char const* aSourcePath )
-	{
-		// Load the shader source code from file
-		std::vector<GLchar> source;
+	for( auto const shader : aBuild.shaders )
+		glDeleteShader( shader );
+	aBuild.shaders.clear();
 
-		if( std::FILE* fin = std::fopen( aSourcePath, "rb" ) )
-		{
-			auto const scopeFile_ = scope_exit_( [&fin] {
-				std::fclose( fin );
-			} );
-
-			std::fseek( fin, 0, SEEK_END );
-			auto const length = std::size_t(std::ftell( fin ));
-			std::fseek( fin, 0, SEEK_SET );
-
-			source.resize( length );
-			for( std::size_t read = 0; read != length; )
-			{
-				auto const ret = std::fread( source.data()+read, 1, length-read, fin );
-
-				if( 0 == ret )
-				{
-					if( auto const err = std::ferror( fin ) )
-						throw Error( "load_shader_(): error while reading from '%s': %d (%zu bytes read, %zu total)", aSourcePath, err, read, length );
-					if( std::feof( fin ) )
-						throw Error( "load_shader_(): unexpected EOF in '%s' (%zu bytes read, %zu total)", aSourcePath, read, length );
-				}
-			
-				read += ret;
-			}
-		}
-		else
-		{
-			throw Error( "load_shader_(): unable to open input file '%s'", aSourcePath );
-		}
+	if( 0 != aBuild.program )
+		glDeleteProgram( std::exchange( aBuild.program, 0 ) );
+}
 
+void ShaderProgram::set_binary_cache( std::string aDirectory )
+{
+	gBinaryCache_.directory = std::move(aDirectory);
+}
+
+ShaderProgram::BinaryCacheStats ShaderProgram::binary_cache_stats()
+{
+	return gBinaryCache_.stats;
+}
+
+namespace
+{
+	GLuint start_shader_( GLenum aShaderType, std::string const& aSource )
+	{
 		// Create shader object
 		OGL_CHECKPOINT_ALWAYS();
 
@@ -183,17 +345,32 @@ namespace
 
 		// Compile shader
 		GLchar const* sources[] = {
-			source.data()
+			aSource.data()
 		};
 		GLsizei lengths[] = {
-			GLsizei(source.size())
+			GLsizei(aSource.size())
 		};
 
 		glShaderSource( shader, sizeof(sources)/sizeof(sources[0]), sources, lengths );
 
 		glCompileShader( shader );
 
-		OGL_CHECKPOINT_ALWAYS();
+		return shader;
+	}
+
+	void check_shader_( GLuint aShader, GLenum aShaderType, std::vector<std::string> const& aFiles )
+	{
+		assert( !aFiles.empty() );
+		char const* sourcePath = aFiles.front().c_str();
+
+		// Source string numbers in the log refer to included files
+		std::string sourceStrings;
+		if( aFiles.size() > 1 )
+		{
+			sourceStrings = "Source strings:";
+			for( std::size_t i = 0; i < aFiles.size(); ++i )
+				sourceStrings += " " + std::to_string( i ) + " = " + aFiles[i] + (i+1 < aFiles.size() ? "," : "\n");
+		}
 
 		// Get compile info log
 		/* The compile log is mainly relevant if there is an error. However, on some
@@ -201,13 +378,13 @@ namespace
 		 * successful. This might include warnings and/or usage hints.
 		 */
 		GLint logLength = 0;
-		glGetShaderiv( shader, GL_INFO_LOG_LENGTH, &logLength );
+		glGetShaderiv( aShader, GL_INFO_LOG_LENGTH, &logLength );
 
 		std::vector<GLchar> log;
 		if( logLength )
 		{
 			log.resize( logLength );
-			glGetShaderInfoLog( shader, GLsizei(log.size()), nullptr, log.data() );
+			glGetShaderInfoLog( aShader, GLsizei(log.size()), nullptr, log.data() );
 		}
 
 		char const* shaderTypeName = "unknown shader";
@@ -223,19 +400,128 @@ namespace
 
 		// Check compile status
 		GLint status = 0;
-		glGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+		glGetShaderiv( aShader, GL_COMPILE_STATUS, &status );
 
 		if( GL_TRUE != status )
 		{
-			glDeleteShader( shader );
-			throw Error( "%s \"%s\" compilation failed:\n%s\n", shaderTypeName, aSourcePath, log.data() );
+			throw Error( "%s \"%s\" compilation failed:\n%s%s\n", shaderTypeName, sourcePath, sourceStrings.c_str(), log.data() );
 		}
 
 		if( !log.empty() )
-			std::fprintf( stderr, "Note: %s \"%s\" log:\n%s\n", shaderTypeName, aSourcePath, log.data() );
+			std::fprintf( stderr, "Note: %s \"%s\" log:\n%s%s\n", shaderTypeName, sourcePath, sourceStrings.c_str(), log.data() );
+	}
 
-		OGL_CHECKPOINT_ALWAYS();
+	bool binary_cache_enabled_()
+	{
+		if( gBinaryCache_.directory.empty() )
+			return false;
 
-		return shader;
+		if( gBinaryCache_.formats < 0 )
+		{
+			GLint formats = 0;
+			glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+			gBinaryCache_.formats = formats;
+
+			if( 0 == formats )
+				std::fprintf( stderr, "Note: the driver supports no program binary formats; shader cache disabled\n" );
+		}
+
+		return gBinaryCache_.formats > 0;
+	}
+
+	std::uint64_t program_key_( std::vector<ShaderProgram::ShaderSource> const& aSources, std::vector<ShaderText> const& aSourceTexts )
+	{
+		std::vector<std::string_view> driver;
+		for( GLenum const name : { GL_VENDOR, GL_RENDERER, GL_VERSION } )
+		{
+			if( auto const* str = reinterpret_cast<char const*>(glGetString( name )) )
+				driver.emplace_back( str );
+		}
+
+		std::vector<std::pair<std::uint32_t,std::string_view>> shaders;
+		for( std::size_t i = 0; i < aSources.size(); ++i )
+			shaders.emplace_back( std::uint32_t(aSources[i].type), aSourceTexts[i].text );
+
+		return program_binary_key( driver, shaders );
+	}
+
+	GLuint load_binary_( std::uint64_t aKey, double& aCompileMilliseconds )
+	{
+		auto& stats = gBinaryCache_.stats;
+		auto const path = program_binary_path( gBinaryCache_.directory, aKey );
+
+		ProgramBinary binary;
+		auto const status = read_program_binary( path, aKey, binary );
+		if( ProgramBinaryStatus::missing == status )
+		{
+			++stats.misses;
+			return 0;
+		}
+
+		// The format must be one that the driver still offers
+		bool valid = ProgramBinaryStatus::loaded == status;
+		if( valid )
+		{
+			std::vector<GLint> formats( std::size_t(gBinaryCache_.formats) );
+			glGetIntegerv( GL_PROGRAM_BINARY_FORMATS, formats.data() );
+			valid = formats.end() != std::find( formats.begin(), formats.end(), GLint(binary.format) );
+		}
+
+		if( !valid )
+		{
+			std::fprintf( stderr, "Note: ignoring invalid shader cache file '%s'\n", path.c_str() );
+			++stats.misses;
+			++stats.rejected;
+			return 0;
+		}
+
+		GLuint prog = glCreateProgram();
+		glProgramBinary( prog, GLenum(binary.format), binary.data.data(), GLsizei(binary.data.size()) );
+
+		GLint linked = 0;
+		glGetProgramiv( prog, GL_LINK_STATUS, &linked );
+
+		if( GL_TRUE != linked )
+		{
+			// Typically after a driver update, which changes the key
+			// anyway; the fresh binary replaces this one.
+			glDeleteProgram( prog );
+			std::fprintf( stderr, "Note: driver rejected cached shader program '%s'; recompiling\n", path.c_str() );
+			++stats.misses;
+			++stats.rejected;
+			return 0;
+		}
+
+		++stats.hits;
+		aCompileMilliseconds = binary.compileMilliseconds;
+		return prog;
+	}
+
+	void store_binary_( GLuint aProgram, std::uint64_t aKey, double aCompileMilliseconds )
+	{
+		GLint length = 0;
+		glGetProgramiv( aProgram, GL_PROGRAM_BINARY_LENGTH, &length );
+		if( length <= 0 )
+			return;
+
+		ProgramBinary binary;
+		binary.data.resize( static_cast<std::size_t>(length) );
+		binary.compileMilliseconds = aCompileMilliseconds;
+
+		GLsizei written = 0;
+		GLenum format = 0;
+		glGetProgramBinary( aProgram, length, &written, &format, binary.data.data() );
+		if( written <= 0 )
+			return;
+
+		binary.format = format;
+		binary.data.resize( std::size_t(written) );
+
+		std::error_code ec;
+		std::filesystem::create_directories( gBinaryCache_.directory, ec );
+
+		auto const path = program_binary_path( gBinaryCache_.directory, aKey );
+		if( !write_program_binary( path, aKey, binary ) )
+			std::fprintf( stderr, "Note: unable to write shader cache file '%s'\n", path.c_str() );
 	}
 }
@@ -3,11 +3,18 @@
 
 #include <glad.h>
 
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <vector>
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstddef>
+
+#include "shader_source.hpp"
+
+class ShaderBuildService;
 
 class ShaderProgram final
 {
@@ -18,9 +25,32 @@ class ShaderProgram final
 			std::string sourcePath;
 		};
 
+		struct BinaryCacheStats
+		{
+			std::size_t hits = 0;
+			std::size_t misses = 0; // includes rejected binaries
+			std::size_t rejected = 0; // found, but refused by the driver
+			double loadMilliseconds = 0.0; // spent loading cached binaries
+			double savedMilliseconds = 0.0; // compile and link time of hits, minus loading
+		};
+
 	public:
+		// Compiles and links right away. Throws Error on failure.
+		//
+		// Sources are preprocessed with preprocess_shader(), i.e., they may
+		// #include other files, and aDefines are #defined in each shader.
 		explicit ShaderProgram( 
-			std::vector<ShaderSource> = {}
+			std::vector<ShaderSource> = {},
+			std::vector<std::string> aDefines = {}
+		);
+
+		// Builds asynchronously through aService, which must outlive the
+		// program; see ShaderBuildService. aService may rebuild the program
+		// later, so the program must never be moved.
+		ShaderProgram( 
+			std::vector<ShaderSource>,
+			ShaderBuildService& aService,
+			std::vector<std::string> aDefines = {}
 		);
 
 		~ShaderProgram();
@@ -32,13 +62,84 @@ class ShaderProgram final
 		ShaderProgram& operator= (ShaderProgram&&) noexcept;
 
 	public:
+		// The service's fallback program while an asynchronous build is
+		// pending. May be called from any thread.
 		GLuint programId() const noexcept;
 
+		bool ready() const noexcept;
+
+		// Rebuilds synchronously, after waiting for a pending asynchronous
+		// build. Throws Error on failure and keeps the current program.
 		void reload();
 
+		// Files that the last build read, i.e., the sources and the files
+		// they #include. Just the sources until a build got that far.
+		std::vector<std::string> const& files() const noexcept;
+
+	public:
+		/* Linked programs are cached on disk as driver-specific binaries (see
+		 * glGetProgramBinary()), one file per program in aDirectory, which is
+		 * created as needed. Files are keyed by a hash of the shader types and
+		 * sources and of the driver's vendor, renderer and version strings.
+		 * reload() loads a cached binary with glProgramBinary() and falls back
+		 * to compiling from source if there is none or if the driver refuses
+		 * it; freshly linked programs are then stored. An empty aDirectory
+		 * disables the cache, which is the default.
+		 *
+		 * Not thread safe; meant to be configured once, at startup.
+		 */
+		static void set_binary_cache( std::string aDirectory );
+		static BinaryCacheStats binary_cache_stats();
+
 	private:
-		GLuint mProgram;
+		friend class ShaderBuildService;
+
+		using Clock_ = std::chrono::steady_clock;
+
+		// A build in progress. start_build_() issues all GL commands without
+		// querying any status; finish_build_() checks the results.
+		struct Build_
+		{
+			GLuint program = 0;
+			std::vector<GLuint> shaders;
+			std::vector<std::vector<std::string>> files; // per shader, see ShaderText
+
+			bool cached = false; // the binary cache is in use
+			bool fromCache = false; // program is a linked cached binary
+			std::uint64_t key = 0;
+
+			// Time spent in start_build_() and finish_build_(), i.e., that
+			// the calling thread was blocked. With parallel compile, this
+			// excludes the time the driver compiled in the background.
+			double milliseconds = 0.0;
+			double compileMilliseconds = 0.0; // recorded with a cached binary
+		};
+
+		// Preprocesses the sources; throws Error if that fails. Does not
+		// require OpenGL and may be called from any thread.
+		std::vector<ShaderText> load_sources_() const;
+
+		Build_ start_build_( std::vector<ShaderText> const& aSourceTexts ) const;
+
+		// Whether finish_build_() would not block. Always true without
+		// GL_KHR_parallel_shader_compile.
+		static bool build_done_( Build_ const& ) noexcept;
+
+		// Installs the new program, or throws Error. Consumes aBuild either
+		// way. Returns the replaced program (or 0), which the caller deletes
+		// once no longer in use.
+		GLuint finish_build_( Build_& aBuild );
+
+		static void discard_build_( Build_& ) noexcept;
+
+	private:
+		std::atomic<GLuint> mProgram;
+		GLuint mFallback;
+		ShaderBuildService* mService; // that builds this program, if any
+
 		std::vector<ShaderSource> mSources;
+		std::vector<std::string> mDefines;
+		std::vector<std::string> mFiles;
 };
 
 #endif // PROGRAM_HPP_39793FD2_7845_47A7_9E21_6DDAD42C9A09
@@ -0,0 +1,149 @@
+#include "program_cache.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#	include <process.h>
+#else
+#	include <unistd.h>
+#endif // ~ _WIN32
+
+namespace
+{
+	// Bump when the file layout or the key changes
+	constexpr std::uint32_t kVersion_ = 1;
+
+	// File header, followed by the binary
+	struct Header_
+	{
+		char magic[4]; // "GLPB"
+		std::uint32_t version;
+		std::uint64_t key;
+		std::uint32_t format;
+		std::uint32_t size;
+		double compileMilliseconds;
+	};
+
+	// 64-bit FNV-1a
+	constexpr std::uint64_t kFnvBasis_ = 14695981039346656037ull;
+
+	std::uint64_t fnv1a_( std::uint64_t aHash, void const* aData, std::size_t aSize )
+	{
+		auto const* bytes = static_cast<unsigned char const*>(aData);
+		for( std::size_t i = 0; i < aSize; ++i )
+		{
+			aHash ^= bytes[i];
+			aHash *= 1099511628211ull;
+		}
+		return aHash;
+	}
+
+	unsigned long process_id_()
+	{
+#		if defined(_WIN32)
+		return static_cast<unsigned long>(_getpid());
+#		else
+		return static_cast<unsigned long>(getpid());
+#		endif // ~ _WIN32
+	}
+
+	// Distinguishes temporary files of the same process
+	std::atomic<unsigned long> gTempCounter_{ 0 };
+}
+
+std::uint64_t program_binary_key( std::vector<std::string_view> const& aDriverStrings, std::vector<std::pair<std::uint32_t,std::string_view>> const& aShaders )
+{
+	std::uint64_t key = fnv1a_( kFnvBasis_, &kVersion_, sizeof(kVersion_) );
+
+	// Binaries are only valid for the driver that produced them. The
+	// terminating zero keeps ("ab", "c") and ("a", "bc") apart.
+	for( auto const str : aDriverStrings )
+	{
+		char const zero = 0;
+		key = fnv1a_( key, str.data(), str.size() );
+		key = fnv1a_( key, &zero, 1 );
+	}
+
+	for( auto const& [type, text] : aShaders )
+	{
+		std::uint64_t const size = text.size();
+		key = fnv1a_( key, &type, sizeof(type) );
+		key = fnv1a_( key, &size, sizeof(size) );
+		key = fnv1a_( key, text.data(), text.size() );
+	}
+
+	return key;
+}
+
+std::string program_binary_path( std::string const& aDirectory, std::uint64_t aKey )
+{
+	char name[32];
+	std::snprintf( name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(aKey) );
+	return aDirectory + name;
+}
+
+ProgramBinaryStatus read_program_binary( std::string const& aPath, std::uint64_t aKey, ProgramBinary& aBinary )
+{
+	std::FILE* fin = std::fopen( aPath.c_str(), "rb" );
+	if( !fin )
+		return ProgramBinaryStatus::missing;
+
+	Header_ header{};
+	bool valid = 1 == std::fread( &header, sizeof(header), 1, fin )
+		&& 0 == std::memcmp( header.magic, "GLPB", 4 )
+		&& kVersion_ == header.version
+		&& aKey == header.key
+		&& header.size > 0;
+
+	if( valid )
+	{
+		aBinary.format = header.format;
+		aBinary.compileMilliseconds = header.compileMilliseconds;
+		aBinary.data.resize( header.size );
+		valid = 1 == std::fread( aBinary.data.data(), aBinary.data.size(), 1, fin );
+	}
+
+	std::fclose( fin );
+	return valid ? ProgramBinaryStatus::loaded : ProgramBinaryStatus::invalid;
+}
+
+bool write_program_binary( std::string const& aPath, std::uint64_t aKey, ProgramBinary const& aBinary )
+{
+	if( aBinary.data.empty() )
+		return false;
+
+	Header_ header{};
+	std::memcpy( header.magic, "GLPB", 4 );
+	header.version = kVersion_;
+	header.key = aKey;
+	header.format = aBinary.format;
+	header.size = std::uint32_t(aBinary.data.size());
+	header.compileMilliseconds = aBinary.compileMilliseconds;
+
+	auto const temp = aPath + "." + std::to_string( process_id_() )
+		+ "-" + std::to_string( gTempCounter_.fetch_add( 1, std::memory_order_relaxed ) ) + ".tmp";
+
+	std::FILE* fout = std::fopen( temp.c_str(), "wb" );
+	if( !fout )
+		return false;
+
+	bool ok = 1 == std::fwrite( &header, sizeof(header), 1, fout )
+		&& 1 == std::fwrite( aBinary.data.data(), aBinary.data.size(), 1, fout );
+	ok = 0 == std::fclose( fout ) && ok;
+
+	std::error_code ec;
+	if( ok )
+		std::filesystem::rename( temp, aPath, ec );
+	if( !ok || ec )
+	{
+		std::filesystem::remove( temp, ec );
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,65 @@
+#ifndef PROGRAM_CACHE_HPP_CA50DB44_01E6_48C2_AAF9_4266EC62544A
+#define PROGRAM_CACHE_HPP_CA50DB44_01E6_48C2_AAF9_4266EC62544A
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <string_view>
+
+#include <cstdint>
+
+/* Program binary cache files, see ShaderProgram::set_binary_cache()
+ *
+ * Each file holds one program binary (from glGetProgramBinary()) behind a
+ * header with the file format version and the program's key. A file is only
+ * used if it was written with the same key, so changing a shader, or the
+ * driver, makes the old file unusable; the program is then compiled from
+ * source and stored again.
+ *
+ * Nothing here requires OpenGL.
+ */
+
+// A program binary, as returned by glGetProgramBinary()
+struct ProgramBinary
+{
+	std::uint32_t format = 0; // binaryFormat
+	std::vector<char> data;
+	double compileMilliseconds = 0.0; // of the build that produced the binary
+};
+
+enum class ProgramBinaryStatus
+{
+	loaded,
+	missing, // no file
+	invalid // unreadable, truncated, or of a different version or key
+};
+
+// Key of a program: a hash of the driver strings (GL_VENDOR, GL_RENDERER,
+// GL_VERSION) and of the (shader type, source text) pairs, in order.
+std::uint64_t program_binary_key(
+	std::vector<std::string_view> const& aDriverStrings,
+	std::vector<std::pair<std::uint32_t,std::string_view>> const& aShaders
+);
+
+// aDirectory + "/<key in hex>.bin"
+std::string program_binary_path( std::string const& aDirectory, std::uint64_t aKey );
+
+// Leaves aBinary unspecified unless the file was loaded
+ProgramBinaryStatus read_program_binary(
+	std::string const& aPath,
+	std::uint64_t aKey,
+	ProgramBinary& aBinary
+);
+
+/* Writes to a temporary file next to aPath, which is then renamed to aPath,
+ * so that readers never see a partial file. The temporary name is unique per
+ * process and call, so concurrent writers of the same file do not interfere;
+ * the last rename wins. Returns false on failure, leaving aPath as it was.
+ */
+bool write_program_binary(
+	std::string const& aPath,
+	std::uint64_t aKey,
+	ProgramBinary const& aBinary
+);
+
+#endif // PROGRAM_CACHE_HPP_CA50DB44_01E6_48C2_AAF9_4266EC62544A
@@ -0,0 +1,465 @@
+#include "shader_builds.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+#include <cstdio>
+#include <cassert>
+
+#include "error.hpp"
+#include "profiler.hpp"
+
+namespace
+{
+	// Replaced programs are deleted this many update()s later. Frames are
+	// recorded ahead of their submission, so the ones in flight may still
+	// refer to the old id.
+	constexpr std::size_t kRetireUpdates_ = 3;
+
+	// For messages, e.g., "assets/mesh.vert + assets/mesh.frag (HAS_TEXTURE)"
+	std::string describe_( std::vector<std::string> const& aPaths, std::vector<std::string> const& aDefines )
+	{
+		std::string ret;
+		for( auto const& path : aPaths )
+			ret += (ret.empty() ? "" : " + ") + path;
+
+		for( std::size_t i = 0; i < aDefines.size(); ++i )
+			ret += (0 == i ? " (" : ", ") + aDefines[i] + (i+1 == aDefines.size() ? ")" : "");
+
+		return ret;
+	}
+}
+
+ShaderBuildService::ShaderBuildService( GLuint aFallbackProgram, std::size_t aLoaderThreads )
+	: mFallback( aFallbackProgram )
+	, mParallel( GLAD_GL_KHR_parallel_shader_compile )
+	, mQuit( false )
+	, mUpdates( 0 )
+{
+	// Let the driver pick the number of compiler threads
+	if( mParallel )
+		glMaxShaderCompilerThreadsKHR( 0xffffffffu );
+
+	mLoaders.reserve( aLoaderThreads );
+	for( std::size_t i = 0; i < aLoaderThreads; ++i )
+		mLoaders.emplace_back( [this] { loader_main_(); } );
+}
+
+ShaderBuildService::~ShaderBuildService()
+{
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		mQuit = true;
+	}
+	mWake.notify_all();
+
+	for( auto& thread : mLoaders )
+		thread.join();
+
+	for( auto& job : mJobs )
+	{
+		if( State_::compiling == job.state )
+			ShaderProgram::discard_build_( job.build );
+	}
+
+	for( auto* program : mPrograms )
+		program->mService = nullptr;
+
+	for( auto const& retired : mRetired )
+		glDeleteProgram( retired.program );
+}
+
+void ShaderBuildService::update()
+{
+	PROFILE_SCOPE( "update shader builds" );
+
+	++mUpdates;
+	mRetired.erase( std::remove_if( mRetired.begin(), mRetired.end(), [this] (Retired_ const& aRetired) {
+		if( aRetired.update > mUpdates )
+			return false;
+
+		glDeleteProgram( aRetired.program );
+		return true;
+	} ), mRetired.end() );
+
+	std::vector<Job_*> done, loaded;
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		for( auto& job : mJobs )
+		{
+			if( State_::compiling == job.state && ShaderProgram::build_done_( job.build ) )
+				done.emplace_back( &job );
+			else if( State_::loaded == job.state )
+				loaded.emplace_back( &job );
+		}
+	}
+
+	for( auto* job : done )
+		finish_( *job );
+
+	// Without parallel compile, glCompileShader() probably blocks until the
+	// shader is compiled, so start one program per frame only.
+	if( !mParallel && loaded.size() > 1 )
+		loaded.resize( 1 );
+
+	for( auto* job : loaded )
+		start_( *job );
+}
+
+void ShaderBuildService::wait( ShaderProgram& aProgram )
+{
+	PROFILE_SCOPE( "wait for shader build" );
+
+	Job_* job = nullptr;
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		job = find_( aProgram );
+		if( !job )
+			return;
+
+		// Don't wait for a loader to get around to it
+		if( State_::queued == job->state )
+		{
+			job->state = State_::loading;
+
+			lock.unlock();
+			load_( *job );
+			lock.lock();
+
+			job->state = State_::loaded;
+		}
+		else
+		{
+			mLoaded.wait( lock, [job] { return State_::loading != job->state; } );
+		}
+	}
+
+	if( State_::loaded == job->state && !start_( *job ) )
+		return;
+
+	finish_( *job );
+}
+
+void ShaderBuildService::wait_all()
+{
+	for( ;; )
+	{
+		ShaderProgram* program = nullptr;
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			for( auto const& job : mJobs )
+			{
+				if( job.program )
+				{
+					program = job.program;
+					break;
+				}
+			}
+		}
+
+		if( !program )
+			return;
+
+		wait( *program );
+	}
+}
+
+void ShaderBuildService::rebuild( ShaderProgram& aProgram )
+{
+	assert( this == aProgram.mService );
+
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		if( Job_* job = find_( aProgram ) )
+		{
+			// A queued job reads the files later anyway
+			if( State_::queued != job->state )
+				job->again = true;
+			return;
+		}
+
+		queue_( aProgram, true );
+	}
+	mWake.notify_one();
+}
+
+void ShaderBuildService::rebuild_all()
+{
+	for( auto* program : mPrograms )
+		rebuild( *program );
+}
+
+std::size_t ShaderBuildService::rebuild_changed( std::vector<std::string> const& aPaths )
+{
+	// Compare normalized paths, e.g., "assets/./a.glsl" and "assets/a.glsl"
+	auto const normal = [] (std::string const& aPath) {
+		return std::filesystem::path( aPath ).lexically_normal();
+	};
+
+	std::vector<std::filesystem::path> changed;
+	changed.reserve( aPaths.size() );
+	for( auto const& path : aPaths )
+		changed.emplace_back( normal( path ) );
+
+	std::size_t count = 0;
+	for( auto* program : mPrograms )
+	{
+		auto const& files = program->files();
+		bool const uses = std::any_of( files.begin(), files.end(), [&] (std::string const& aFile) {
+			return changed.end() != std::find( changed.begin(), changed.end(), normal( aFile ) );
+		} );
+
+		if( uses )
+		{
+			rebuild( *program );
+			++count;
+		}
+	}
+
+	return count;
+}
+
+std::size_t ShaderBuildService::pending() const
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	return std::size_t(std::count_if( mJobs.begin(), mJobs.end(), [] (Job_ const& aJob) {
+		return nullptr != aJob.program;
+	} ));
+}
+
+GLuint ShaderBuildService::fallback_program() const noexcept
+{
+	return mFallback;
+}
+
+bool ShaderBuildService::parallel_compile() const noexcept
+{
+	return mParallel;
+}
+
+ShaderBuildService::Stats ShaderBuildService::stats() const
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	return mStats;
+}
+
+void ShaderBuildService::submit_( ShaderProgram& aProgram )
+{
+	mPrograms.emplace_back( &aProgram );
+
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		assert( !find_( aProgram ) );
+		queue_( aProgram, false );
+	}
+	mWake.notify_one();
+}
+
+void ShaderBuildService::release_( ShaderProgram& aProgram ) noexcept
+{
+	mPrograms.erase( std::remove( mPrograms.begin(), mPrograms.end(), &aProgram ), mPrograms.end() );
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	aProgram.mService = nullptr;
+
+	Job_* job = find_( aProgram );
+	if( !job )
+		return;
+
+	switch( job->state )
+	{
+		case State_::loading:
+			job->program = nullptr; // the loader removes it
+			break;
+		case State_::compiling:
+			ShaderProgram::discard_build_( job->build );
+			erase_( job );
+			break;
+		case State_::queued:
+		case State_::loaded:
+			erase_( job );
+			break;
+	}
+}
+
+void ShaderBuildService::retire_program_( GLuint aProgram )
+{
+	mRetired.emplace_back( Retired_{ aProgram, mUpdates + kRetireUpdates_ } );
+}
+
+void ShaderBuildService::loader_main_()
+{
+	PROFILE_THREAD( "shader loader" );
+
+	for( ;; )
+	{
+		Job_* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mWake.wait( lock, [&] {
+				if( mQuit )
+					return true;
+
+				for( auto& candidate : mJobs )
+				{
+					if( State_::queued == candidate.state )
+					{
+						job = &candidate;
+						return true;
+					}
+				}
+				return false;
+			} );
+
+			if( mQuit )
+				return;
+
+			job->state = State_::loading;
+		}
+
+		load_( *job );
+
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			if( job->program )
+				job->state = State_::loaded;
+			else
+				erase_( job );
+		}
+		mLoaded.notify_all();
+	}
+}
+
+void ShaderBuildService::load_( Job_& aJob ) noexcept
+{
+	PROFILE_SCOPE( "load shader sources" );
+
+	try
+	{
+		aJob.texts.reserve( aJob.paths.size() );
+		for( auto const& path : aJob.paths )
+			aJob.texts.emplace_back( preprocess_shader( path, aJob.defines ) );
+	}
+	catch( std::exception const& eErr )
+	{
+		aJob.texts.clear();
+		aJob.error = eErr.what();
+	}
+}
+
+void ShaderBuildService::queue_( ShaderProgram& aProgram, bool aRebuild )
+{
+	Job_ job;
+	job.program = &aProgram;
+	for( auto const& source : aProgram.mSources )
+		job.paths.emplace_back( source.sourcePath );
+	job.defines = aProgram.mDefines;
+	job.rebuild = aRebuild;
+
+	if( mJobs.empty() )
+		mBusySince = Clock_::now();
+
+	mJobs.emplace_back( std::move(job) );
+}
+
+ShaderBuildService::Job_* ShaderBuildService::find_( ShaderProgram const& aProgram ) noexcept
+{
+	for( auto& job : mJobs )
+	{
+		if( &aProgram == job.program )
+			return &job;
+	}
+
+	return nullptr;
+}
+
+void ShaderBuildService::erase_( Job_* aJob ) noexcept
+{
+	mJobs.remove_if( [aJob] (Job_ const& aOther) { return &aOther == aJob; } );
+
+	if( mJobs.empty() )
+		mStats.milliseconds += std::chrono::duration<double, std::milli>( Clock_::now() - mBusySince ).count();
+}
+
+bool ShaderBuildService::start_( Job_& aJob )
+{
+	assert( State_::loaded == aJob.state && aJob.program );
+
+	try
+	{
+		if( !aJob.error.empty() )
+			throw Error( "%s", aJob.error.c_str() );
+
+		aJob.build = aJob.program->start_build_( aJob.texts );
+	}
+	catch( std::exception const& eErr )
+	{
+		if( !fail_( aJob, eErr ) )
+			throw;
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	aJob.texts.clear();
+	aJob.state = State_::compiling;
+	return true;
+}
+
+void ShaderBuildService::finish_( Job_& aJob )
+{
+	assert( State_::compiling == aJob.state && aJob.program );
+
+	GLuint old = 0;
+	try
+	{
+		old = aJob.program->finish_build_( aJob.build );
+	}
+	catch( std::exception const& eErr )
+	{
+		if( !fail_( aJob, eErr ) )
+			throw;
+		return;
+	}
+
+	if( 0 != old )
+		retire_program_( old );
+
+	if( aJob.rebuild )
+		std::fprintf( stderr, "Rebuilt shader program %s\n", describe_( aJob.paths, aJob.defines ).c_str() );
+
+	retire_( aJob );
+}
+
+void ShaderBuildService::retire_( Job_& aJob ) noexcept
+{
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		++mStats.programs;
+
+		if( !aJob.again )
+		{
+			erase_( &aJob );
+			return;
+		}
+
+		// The files changed while they were being built; start over
+		aJob.state = State_::queued;
+		aJob.rebuild = true;
+		aJob.again = false;
+		aJob.texts.clear();
+		aJob.error.clear();
+		aJob.build = ShaderProgram::Build_{};
+	}
+	mWake.notify_one();
+}
+
+bool ShaderBuildService::fail_( Job_& aJob, std::exception const& aErr ) noexcept
+{
+	bool const rebuild = aJob.rebuild;
+	if( rebuild )
+		std::fprintf( stderr, "Error when rebuilding shader program %s:\n%s\nKeeping the old program.\n", describe_( aJob.paths, aJob.defines ).c_str(), aErr.what() );
+
+	retire_( aJob );
+	return rebuild;
+}
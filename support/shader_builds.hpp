@@ -0,0 +1,172 @@
+#ifndef SHADER_BUILDS_HPP_92A330F4_7275_4042_8FBB_D820BA0B300B
+#define SHADER_BUILDS_HPP_92A330F4_7275_4042_8FBB_D820BA0B300B
+
+#include <glad.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <exception>
+#include <condition_variable>
+
+#include <cstddef>
+
+#include "program.hpp"
+
+/** ShaderBuildService: builds ShaderPrograms in the background
+ *
+ * Programs constructed with a ShaderBuildService are submitted to it instead
+ * of being built right away. Their sources are read from disk by loader
+ * threads. update(), called once per frame on the GL thread, then issues the
+ * compile and link commands of all loaded programs back to back, and only
+ * later queries their status. With GL_KHR_parallel_shader_compile, the driver
+ * compiles on its own threads, and update() installs each program once
+ * GL_COMPLETION_STATUS_KHR reports it as done, so the GL thread never blocks.
+ * Without the extension, the driver usually compiles on glCompileShader();
+ * update() then starts one program per call to bound the hitch.
+ *
+ * Until a program is ready(), its programId() is the fallback program, if
+ * one was given. Code that must have the real program (e.g., because it keeps
+ * the id) uses wait().
+ *
+ * A failed build leaves its program with the fallback; the Error is thrown
+ * from the update() or wait() that finished the build.
+ *
+ * Built programs may be rebuilt later, e.g., when their sources change on
+ * disk (see rebuild_changed()). Rebuilds go through the same steps, so the
+ * program keeps its current version until update() swaps in the new one.
+ * A failed rebuild is reported on stderr and keeps the current version.
+ * Frames recorded earlier may still refer to a replaced program's id, so
+ * update() only deletes it a few calls later.
+ *
+ * All methods, including the constructor and destructor, must be called on
+ * the GL thread, with a current context. The destructor abandons pending
+ * builds; their programs keep the fallback (or their current version).
+ */
+class ShaderBuildService final
+{
+	public:
+		struct Stats
+		{
+			std::size_t programs = 0; // finished builds, failed ones included
+			double milliseconds = 0.0; // from the first submission until the queue last ran empty
+		};
+
+	public:
+		explicit ShaderBuildService( GLuint aFallbackProgram = 0, std::size_t aLoaderThreads = 2 );
+		~ShaderBuildService();
+
+		ShaderBuildService( ShaderBuildService const& ) = delete;
+		ShaderBuildService& operator= (ShaderBuildService const&) = delete;
+
+	public:
+		// Starts and finishes builds that are ready to proceed; never blocks
+		// on the driver when parallel_compile().
+		void update();
+
+		// Finishes the build of aProgram, blocking as needed. Returns
+		// immediately if aProgram has no pending build.
+		void wait( ShaderProgram& aProgram );
+		void wait_all();
+
+		// Queues a rebuild of aProgram, which was constructed with this
+		// service, from the current files. If a build of aProgram is under
+		// way, it is finished and then started over.
+		void rebuild( ShaderProgram& aProgram );
+		void rebuild_all();
+
+		// Rebuilds the programs that read any of aPaths (see
+		// ShaderProgram::files()). Returns the number of programs.
+		std::size_t rebuild_changed( std::vector<std::string> const& aPaths );
+
+		std::size_t pending() const;
+
+		GLuint fallback_program() const noexcept;
+
+		// Whether GL_KHR_parallel_shader_compile is in use
+		bool parallel_compile() const noexcept;
+
+		Stats stats() const;
+
+	private:
+		using Clock_ = std::chrono::steady_clock;
+
+		enum class State_
+		{
+			queued,
+			loading,
+			loaded,
+			compiling
+		};
+
+		struct Job_
+		{
+			ShaderProgram* program; // null if cancelled while loading
+			std::vector<std::string> paths;
+			std::vector<std::string> defines;
+			State_ state = State_::queued;
+			bool rebuild = false; // errors are reported, not thrown
+			bool again = false; // files changed during the build
+
+			std::vector<ShaderText> texts;
+			std::string error; // loading failed if nonempty
+
+			ShaderProgram::Build_ build;
+		};
+
+		struct Retired_
+		{
+			GLuint program;
+			std::size_t update; // deleted by this update()
+		};
+
+		friend class ShaderProgram;
+		void submit_( ShaderProgram& );
+		void release_( ShaderProgram& ) noexcept;
+		void retire_program_( GLuint );
+
+		void loader_main_();
+		static void load_( Job_& ) noexcept;
+
+		// Require mMutex
+		void queue_( ShaderProgram&, bool aRebuild );
+		Job_* find_( ShaderProgram const& ) noexcept;
+		void erase_( Job_* ) noexcept;
+
+		// GL thread, without holding mMutex. finish_() removes the job;
+		// both remove it if the build fails, and rethrow unless it is a
+		// rebuild. start_() returns false if it removed the job.
+		bool start_( Job_& );
+		void finish_( Job_& );
+		void retire_( Job_& ) noexcept;
+
+		// Retires a failed job. Reports the error and returns true for
+		// rebuilds; the caller rethrows otherwise.
+		bool fail_( Job_&, std::exception const& ) noexcept;
+
+	private:
+		GLuint mFallback;
+		bool mParallel;
+
+		std::vector<std::thread> mLoaders;
+
+		mutable std::mutex mMutex;
+		std::condition_variable mWake; // a job was queued, or quit
+		std::condition_variable mLoaded; // a job finished loading
+		bool mQuit;
+
+		std::list<Job_> mJobs; // std::list: Job_ pointers stay valid
+
+		// GL thread only
+		std::vector<ShaderProgram*> mPrograms;
+		std::vector<Retired_> mRetired;
+		std::size_t mUpdates;
+
+		Stats mStats;
+		Clock_::time_point mBusySince;
+};
+
+#endif // SHADER_BUILDS_HPP_92A330F4_7275_4042_8FBB_D820BA0B300B
@@ -0,0 +1,201 @@
+#include "shader_source.hpp"
+
+#include <algorithm>
+
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+
+#include "error.hpp"
+
+namespace
+{
+	// Bounds the nesting when the same file is reached through different
+	// paths ("a/../b.glsl" vs "b.glsl"), which include-once does not catch
+	constexpr std::size_t kMaxIncludeDepth_ = 32;
+
+	struct FileDeleter_
+	{
+		~FileDeleter_()
+		{
+			if( file )
+				std::fclose( file );
+		}
+
+		std::FILE* file;
+	};
+
+	struct Context_
+	{
+		std::vector<std::string> const& defines;
+		ShaderFileReader const& reader;
+
+		ShaderText result;
+	};
+
+	std::string directory_of_( std::string const& aPath )
+	{
+		auto const slash = aPath.find_last_of( "/\\" );
+		return std::string::npos == slash ? std::string() : aPath.substr( 0, slash+1 );
+	}
+
+	// If aLine is the preprocessor directive aName, returns the position
+	// after the name; otherwise std::string::npos
+	std::size_t directive_( std::string const& aLine, char const* aName )
+	{
+		std::size_t pos = 0;
+		auto const skipSpace = [&] {
+			while( pos < aLine.size() && (' ' == aLine[pos] || '\t' == aLine[pos]) )
+				++pos;
+		};
+
+		skipSpace();
+		if( pos >= aLine.size() || '#' != aLine[pos] )
+			return std::string::npos;
+
+		++pos;
+		skipSpace();
+
+		auto const length = std::strlen( aName );
+		if( 0 != aLine.compare( pos, length, aName ) )
+			return std::string::npos;
+
+		pos += length;
+		if( pos < aLine.size() && (std::isalnum( static_cast<unsigned char>(aLine[pos]) ) || '_' == aLine[pos]) )
+			return std::string::npos; // e.g. #includes
+
+		return pos;
+	}
+
+	void append_defines_( Context_& aCtx )
+	{
+		for( auto const& define : aCtx.defines )
+			aCtx.result.text += "#define " + define + "\n";
+	}
+
+	void append_file_( Context_& aCtx, std::string const& aPath, std::size_t aDepth )
+	{
+		auto const index = aCtx.result.files.size();
+		aCtx.result.files.emplace_back( aPath );
+
+		std::string const text = aCtx.reader( aPath );
+		auto& out = aCtx.result.text;
+
+		// Defines go after #version, which must come first. Without one,
+		// they go to the very start.
+		bool needDefines = 0 == aDepth && !aCtx.defines.empty();
+		if( needDefines )
+		{
+			bool hasVersion = false;
+			for( std::size_t begin = 0; begin < text.size() && !hasVersion; )
+			{
+				auto end = text.find( '\n', begin );
+				if( std::string::npos == end )
+					end = text.size();
+
+				hasVersion = std::string::npos != directive_( text.substr( begin, end-begin ), "version" );
+				begin = end + 1;
+			}
+
+			if( !hasVersion )
+			{
+				append_defines_( aCtx );
+				out += "#line 1 0\n";
+				needDefines = false;
+			}
+		}
+
+		std::size_t lineNumber = 0;
+		for( std::size_t begin = 0; begin < text.size(); )
+		{
+			auto end = text.find( '\n', begin );
+			if( std::string::npos == end )
+				end = text.size();
+
+			std::string line = text.substr( begin, end-begin );
+			begin = end + 1;
+			++lineNumber;
+
+			if( !line.empty() && '\r' == line.back() )
+				line.pop_back();
+
+			if( needDefines && std::string::npos != directive_( line, "version" ) )
+			{
+				out += line + "\n";
+				append_defines_( aCtx );
+				out += "#line " + std::to_string( lineNumber+1 ) + " " + std::to_string( index ) + "\n";
+				needDefines = false;
+				continue;
+			}
+
+			auto const args = directive_( line, "include" );
+			if( std::string::npos == args )
+			{
+				out += line + "\n";
+				continue;
+			}
+
+			auto const open = line.find( '"', args );
+			auto const close = std::string::npos == open ? open : line.find( '"', open+1 );
+			if( std::string::npos == close || close == open+1 || std::string::npos != line.find_first_not_of( " \t", close+1 ) )
+				throw Error( "%s:%zu: expected #include \"name\"", aPath.c_str(), lineNumber );
+
+			auto const path = directory_of_( aPath ) + line.substr( open+1, close-open-1 );
+
+			// Include once; the empty line keeps the line numbers intact
+			auto const& files = aCtx.result.files;
+			if( files.end() != std::find( files.begin(), files.end(), path ) )
+			{
+				out += "\n";
+				continue;
+			}
+
+			if( aDepth+1 >= kMaxIncludeDepth_ )
+				throw Error( "%s:%zu: #include nested too deeply", aPath.c_str(), lineNumber );
+
+			out += "#line 1 " + std::to_string( files.size() ) + "\n";
+
+			try
+			{
+				append_file_( aCtx, path, aDepth+1 );
+			}
+			catch( Error const& eErr )
+			{
+				throw Error( "%s\n  included from %s:%zu", eErr.what(), aPath.c_str(), lineNumber );
+			}
+
+			out += "#line " + std::to_string( lineNumber+1 ) + " " + std::to_string( index ) + "\n";
+		}
+	}
+}
+
+ShaderText preprocess_shader( std::string const& aPath, std::vector<std::string> const& aDefines )
+{
+	return preprocess_shader( aPath, aDefines, &read_shader_file );
+}
+
+ShaderText preprocess_shader( std::string const& aPath, std::vector<std::string> const& aDefines, ShaderFileReader const& aReader )
+{
+	Context_ ctx{ aDefines, aReader, {} };
+	append_file_( ctx, aPath, 0 );
+	return std::move(ctx.result);
+}
+
+std::string read_shader_file( std::string const& aPath )
+{
+	std::FILE* fin = std::fopen( aPath.c_str(), "rb" );
+	if( !fin )
+		throw Error( "read_shader_file(): unable to open input file '%s'", aPath.c_str() );
+
+	FileDeleter_ fd{ fin };
+
+	std::string text;
+	char buffer[4096];
+	while( auto const count = std::fread( buffer, 1, sizeof(buffer), fin ) )
+		text.append( buffer, count );
+
+	if( std::ferror( fin ) )
+		throw Error( "read_shader_file(): error while reading from '%s'", aPath.c_str() );
+
+	return text;
+}
@@ -0,0 +1,49 @@
+#ifndef SHADER_SOURCE_HPP_6049AF22_CB5B_4540_A67B_8DD043162C6F
+#define SHADER_SOURCE_HPP_6049AF22_CB5B_4540_A67B_8DD043162C6F
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// A preprocessed shader, ready for glShaderSource()
+struct ShaderText
+{
+	std::string text;
+
+	// The files that text was assembled from; files[0] is the shader
+	// itself. Source string number k in #line directives, and therefore in
+	// the compiler's messages, refers to files[k].
+	std::vector<std::string> files;
+};
+
+// Reads a whole file. Throws Error on failure.
+using ShaderFileReader = std::function<std::string(std::string const& aPath)>;
+
+/* Loads the shader aPath and resolves its #include "name" directives.
+ *
+ * Names are relative to the including file. Each file is included at most
+ * once (as if by #pragma once), which also breaks cycles. #line directives
+ * keep the compiler's line numbers pointing at the original files.
+ *
+ * aDefines are inserted as "#define <entry>" right after the #version line
+ * (or at the very start, if there is none), e.g. "HAS_TEXTURE" or
+ * "MAX_LIGHTS 4".
+ *
+ * Throws Error if a file cannot be read or an #include is malformed.
+ */
+ShaderText preprocess_shader(
+	std::string const& aPath,
+	std::vector<std::string> const& aDefines = {}
+);
+
+// As above, but reads files through aReader
+ShaderText preprocess_shader(
+	std::string const& aPath,
+	std::vector<std::string> const& aDefines,
+	ShaderFileReader const& aReader
+);
+
+// The default ShaderFileReader
+std::string read_shader_file( std::string const& aPath );
+
+#endif // SHADER_SOURCE_HPP_6049AF22_CB5B_4540_A67B_8DD043162C6F
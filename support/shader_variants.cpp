@@ -0,0 +1,50 @@
+#include "shader_variants.hpp"
+
+#include <utility>
+#include <exception>
+
+ShaderVariants::ShaderVariants( std::vector<ShaderProgram::ShaderSource> aSources, std::vector<std::string> aFeatures, ShaderBuildService* aService )
+	: mSources( std::move(aSources) )
+	, mService( aService )
+	, mVariants( std::move(aFeatures) )
+{}
+
+ShaderProgram& ShaderVariants::variant( std::uint32_t aFeatureMask )
+{
+	// A synchronous build happens in the constructor; if it fails, the
+	// variant is not added and the next call retries
+	if( mService )
+		return mVariants.get( aFeatureMask, mSources, *mService );
+
+	return mVariants.get( aFeatureMask, mSources );
+}
+
+GLuint ShaderVariants::programId( std::uint32_t aFeatureMask )
+{
+	return variant( aFeatureMask ).programId();
+}
+
+std::size_t ShaderVariants::size() const noexcept
+{
+	return mVariants.size();
+}
+
+void ShaderVariants::reload()
+{
+	std::exception_ptr first;
+	for( auto& [mask, program] : mVariants )
+	{
+		try
+		{
+			program.reload();
+		}
+		catch( ... )
+		{
+			if( !first )
+				first = std::current_exception();
+		}
+	}
+
+	if( first )
+		std::rethrow_exception( first );
+}
@@ -0,0 +1,64 @@
+#ifndef SHADER_VARIANTS_HPP_ACF7ABFB_DB48_4E37_9E16_9A707565A7EA
+#define SHADER_VARIANTS_HPP_ACF7ABFB_DB48_4E37_9E16_9A707565A7EA
+
+#include <glad.h>
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+#include <cstddef>
+
+#include "program.hpp"
+#include "feature_variants.hpp"
+
+/** ShaderVariants: permutations of one shader program, by feature mask
+ *
+ * The sources are shared by all variants; each feature is a preprocessor
+ * symbol that the sources test with #ifdef, e.g. HAS_TEXTURE. Bit i of a
+ * feature mask selects aFeatures[i], which is then #defined in every shader
+ * of the variant (see preprocess_shader()).
+ *
+ * Variants are built on first use and kept for the lifetime of the object,
+ * so that each draw can use a program without code for features it does not
+ * use. With a ShaderBuildService, variants are built asynchronously like any
+ * other ShaderProgram.
+ *
+ * Not thread safe: variant() and programId() create programs and must be
+ * called on the GL thread. The ids returned by programId() may be used on
+ * any thread.
+ */
+class ShaderVariants final
+{
+	public:
+		ShaderVariants( 
+			std::vector<ShaderProgram::ShaderSource>,
+			std::vector<std::string> aFeatures,
+			ShaderBuildService* aService = nullptr
+		);
+
+		ShaderVariants( ShaderVariants const& ) = delete;
+		ShaderVariants& operator= (ShaderVariants const&) = delete;
+
+	public:
+		// Returns the variant with the features in aFeatureMask, creating it
+		// if needed. Throws Error if aFeatureMask has bits for features that
+		// do not exist, or if a synchronous build fails.
+		ShaderProgram& variant( std::uint32_t aFeatureMask );
+
+		GLuint programId( std::uint32_t aFeatureMask );
+
+		// Number of variants created so far
+		std::size_t size() const noexcept;
+
+		// Rebuilds all variants created so far, see ShaderProgram::reload().
+		// Throws the first Error, after trying all variants.
+		void reload();
+
+	private:
+		std::vector<ShaderProgram::ShaderSource> mSources;
+		ShaderBuildService* mService;
+		FeatureVariants<ShaderProgram> mVariants;
+};
+
+#endif // SHADER_VARIANTS_HPP_ACF7ABFB_DB48_4E37_9E16_9A707565A7EA
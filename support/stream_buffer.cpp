@@ -0,0 +1,143 @@
+#include "stream_buffer.hpp"
+
+#include <utility>
+
+#include <cassert>
+
+#include "error.hpp"
+#include "checkpoint.hpp"
+
+namespace
+{
+	// Upper bound for a single wait on a fence. We keep waiting after this,
+	// but it gives the driver a chance to make progress in between.
+	constexpr GLuint64 kFenceTimeoutNs_ = 100'000'000; // 100ms
+}
+
+StreamBuffer::StreamBuffer( std::size_t aRegionSize, std::size_t aRegionCount )
+	: mBuffer( 0 )
+	, mMapped( nullptr )
+	, mRegionSize( aRegionSize )
+	, mRegionCount( aRegionCount )
+	, mCurrent( 0 )
+	, mFences( aRegionCount, nullptr )
+	, mStalls( 0 )
+{
+	assert( mRegionSize > 0 && mRegionCount > 0 );
+
+	if( !glBufferStorage )
+		throw Error( "StreamBuffer: glBufferStorage() not available (requires OpenGL 4.4 or ARB_buffer_storage)" );
+
+	GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	auto const bytes = GLsizeiptr(mRegionSize * mRegionCount);
+
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, mBuffer );
+	glBufferStorage( GL_COPY_WRITE_BUFFER, bytes, nullptr, flags );
+
+	mMapped = static_cast<unsigned char*>(glMapBufferRange( GL_COPY_WRITE_BUFFER, 0, bytes, flags ));
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	if( !mMapped )
+	{
+		glDeleteBuffers( 1, &mBuffer );
+		throw Error( "StreamBuffer: unable to map %zu bytes persistently", std::size_t(bytes) );
+	}
+
+	OGL_CHECKPOINT_ALWAYS();
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for( auto const fence : mFences )
+	{
+		if( fence )
+			glDeleteSync( fence );
+	}
+
+	if( 0 != mBuffer )
+	{
+		// Deleting a buffer implicitly unmaps it.
+		glDeleteBuffers( 1, &mBuffer );
+	}
+}
+
+StreamBuffer::StreamBuffer( StreamBuffer&& aOther ) noexcept
+	: mBuffer( std::exchange( aOther.mBuffer, 0 ) )
+	, mMapped( std::exchange( aOther.mMapped, nullptr ) )
+	, mRegionSize( aOther.mRegionSize )
+	, mRegionCount( aOther.mRegionCount )
+	, mCurrent( aOther.mCurrent )
+	, mFences( std::move(aOther.mFences) )
+	, mStalls( aOther.mStalls )
+{}
+StreamBuffer& StreamBuffer::operator= (StreamBuffer&& aOther) noexcept
+{
+	std::swap( mBuffer, aOther.mBuffer );
+	std::swap( mMapped, aOther.mMapped );
+	std::swap( mRegionSize, aOther.mRegionSize );
+	std::swap( mRegionCount, aOther.mRegionCount );
+	std::swap( mCurrent, aOther.mCurrent );
+	std::swap( mFences, aOther.mFences );
+	std::swap( mStalls, aOther.mStalls );
+	return *this;
+}
+
+GLuint StreamBuffer::buffer() const noexcept
+{
+	return mBuffer;
+}
+
+std::size_t StreamBuffer::region_size() const noexcept
+{
+	return mRegionSize;
+}
+std::size_t StreamBuffer::region_count() const noexcept
+{
+	return mRegionCount;
+}
+
+void* StreamBuffer::map()
+{
+	assert( mMapped );
+
+	if( GLsync fence = mFences[mCurrent] )
+	{
+		GLenum res = glClientWaitSync( fence, 0, 0 );
+		if( GL_TIMEOUT_EXPIRED == res )
+		{
+			++mStalls;
+
+			do
+			{
+				res = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeoutNs_ );
+			} while( GL_TIMEOUT_EXPIRED == res );
+		}
+
+		if( GL_WAIT_FAILED == res )
+			throw Error( "StreamBuffer: glClientWaitSync() failed" );
+
+		glDeleteSync( fence );
+		mFences[mCurrent] = nullptr;
+	}
+
+	return mMapped + region_offset();
+}
+
+std::size_t StreamBuffer::region_offset() const noexcept
+{
+	return mCurrent * mRegionSize;
+}
+
+void StreamBuffer::fence()
+{
+	assert( !mFences[mCurrent] );
+	mFences[mCurrent] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+	mCurrent = (mCurrent + 1) % mRegionCount;
+}
+
+std::size_t StreamBuffer::stall_count() const noexcept
+{
+	return mStalls;
+}
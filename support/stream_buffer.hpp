@@ -0,0 +1,77 @@
+#ifndef STREAM_BUFFER_HPP_5B2F7D14_93A6_4C0E_8F1B_6AD2E4C90B37
+#define STREAM_BUFFER_HPP_5B2F7D14_93A6_4C0E_8F1B_6AD2E4C90B37
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstddef>
+
+/** StreamBuffer: persistently mapped ring of buffer regions
+ *
+ * For data that is regenerated every frame (particles, debug lines, text).
+ * The buffer is created once with glBufferStorage() and stays mapped, so
+ * data is written straight into GPU-visible memory without an intermediate
+ * copy or reallocating the buffer.
+ *
+ * The buffer is split into aRegionCount equally sized regions (default:
+ * three, i.e. triple buffering). Each frame writes to one region while the
+ * GPU may still read from the others. A fence per region tracks when the GPU
+ * is done with it:
+ *
+ *	auto* ptr = static_cast<float*>( buf.map() ); // waits only if the GPU
+ *	                                              // still uses this region
+ *	... write up to region_size() bytes to ptr ...
+ *	... draw, sourcing data from buf.region_offset() ...
+ *	buf.fence(); // after the last command that reads the region
+ *
+ * The mapping is coherent, so no explicit flush is needed.
+ *
+ * Requires OpenGL 4.4 or ARB_buffer_storage.
+ */
+class StreamBuffer final
+{
+	public:
+		explicit StreamBuffer( std::size_t aRegionSize, std::size_t aRegionCount = 3 );
+		~StreamBuffer();
+
+		StreamBuffer( StreamBuffer const& ) = delete;
+		StreamBuffer& operator= (StreamBuffer const&) = delete;
+
+		StreamBuffer( StreamBuffer&& ) noexcept;
+		StreamBuffer& operator= (StreamBuffer&&) noexcept;
+
+	public:
+		GLuint buffer() const noexcept;
+
+		std::size_t region_size() const noexcept;
+		std::size_t region_count() const noexcept;
+
+		// Returns the start of the current region, after waiting for the GPU
+		// to finish reading it (if necessary).
+		void* map();
+
+		// Byte offset of the current region within buffer()
+		std::size_t region_offset() const noexcept;
+
+		// Marks the current region as in use by the commands submitted so
+		// far, and moves on to the next region.
+		void fence();
+
+		// Number of map() calls that had to wait for the GPU. Should stay at
+		// (or near) zero; otherwise, more regions are needed.
+		std::size_t stall_count() const noexcept;
+
+	private:
+		GLuint mBuffer;
+		unsigned char* mMapped;
+
+		std::size_t mRegionSize;
+		std::size_t mRegionCount;
+		std::size_t mCurrent;
+
+		std::vector<GLsync> mFences; // one per region, null if unused
+		std::size_t mStalls;
+};
+
+#endif // STREAM_BUFFER_HPP_5B2F7D14_93A6_4C0E_8F1B_6AD2E4C90B37
@@ -9,16 +9,17 @@
     Extensions:
         GL_ARB_debug_output,
         GL_EXT_debug_label,
-        GL_EXT_debug_marker
+        GL_EXT_debug_marker,
+        GL_KHR_parallel_shader_compile
     Loader: True
     Local files: True
     Omit khrplatform: False
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=4.6" --generator="c" --spec="gl" --local-files --extensions="GL_ARB_debug_output,GL_EXT_debug_label,GL_EXT_debug_marker"
+        --profile="core" --api="gl=4.6" --generator="c" --spec="gl" --local-files --extensions="GL_ARB_debug_output,GL_EXT_debug_label,GL_EXT_debug_marker,GL_KHR_parallel_shader_compile"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.6&extensions=GL_ARB_debug_output&extensions=GL_EXT_debug_label&extensions=GL_EXT_debug_marker
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.6&extensions=GL_ARB_debug_output&extensions=GL_EXT_debug_label&extensions=GL_EXT_debug_marker&extensions=GL_KHR_parallel_shader_compile
 */
 
 
@@ -3716,6 +3717,8 @@ GLAPI PFNGLPOLYGONOFFSETCLAMPPROC glad_glPolygonOffsetClamp;
 #define GL_BUFFER_OBJECT_EXT 0x9151
 #define GL_QUERY_OBJECT_EXT 0x9153
 #define GL_VERTEX_ARRAY_OBJECT_EXT 0x9154
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
 #ifndef GL_ARB_debug_output
 #define GL_ARB_debug_output 1
 GLAPI int GLAD_GL_ARB_debug_output;
@@ -3755,6 +3758,13 @@ typedef void (APIENTRYP PFNGLPOPGROUPMARKEREXTPROC)(void);
 GLAPI PFNGLPOPGROUPMARKEREXTPROC glad_glPopGroupMarkerEXT;
 #define glPopGroupMarkerEXT glad_glPopGroupMarkerEXT
 #endif
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_KHR_parallel_shader_compile 1
+GLAPI int GLAD_GL_KHR_parallel_shader_compile;
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+GLAPI PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glad_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glad_glMaxShaderCompilerThreadsKHR
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,141 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <vector>
+
+#include <cstdio>
+
+#include "../main/benchmark.hpp"
+
+TEST_CASE("Benchmark script", "[benchmark]")
+{
+	auto const script = parse_benchmark_script(
+		"# comment\n"
+		"camera 2 10 0 0 90 0\n"
+		"\n"
+		"camera 0  0 0 0  0 0   # trailing comment\n"
+		"launch 1\n"
+		"reset 3.5\n"
+	);
+
+	SECTION("Commands are parsed and sorted by time")
+	{
+		REQUIRE( script.camera.size() == 2 );
+		REQUIRE( script.camera[0].time == 0.f );
+		REQUIRE( script.camera[1].time == 2.f );
+		REQUIRE( script.camera[1].yaw == Catch::Approx( 3.1415926f / 2.f ) );
+
+		REQUIRE( script.events.size() == 2 );
+		REQUIRE( script.events[0].action == BenchmarkAction::launch );
+		REQUIRE( script.events[1].action == BenchmarkAction::reset );
+		REQUIRE( script.duration() == 3.5f );
+	}
+
+	SECTION("Camera is interpolated between keyframes and held outside")
+	{
+		auto const mid = benchmark_camera_at( script, 0.5f );
+		REQUIRE( mid.position.x == Catch::Approx( 2.5f ) );
+		REQUIRE( mid.yaw == Catch::Approx( 3.1415926f / 8.f ) );
+
+		REQUIRE( benchmark_camera_at( script, -1.f ).position.x == 0.f );
+		REQUIRE( benchmark_camera_at( script, 100.f ).position.x == 10.f );
+	}
+
+	SECTION("Each event falls into exactly one frame")
+	{
+		std::vector<BenchmarkAction> actions;
+		std::size_t launches = 0, resets = 0;
+		for( int frame = 0; frame < 300; ++frame )
+		{
+			benchmark_events_in( script, frame / 60.f, (frame + 1) / 60.f, actions );
+			for( auto action : actions )
+				++(BenchmarkAction::launch == action ? launches : resets);
+		}
+
+		REQUIRE( launches == 1 );
+		REQUIRE( resets == 1 );
+	}
+
+	SECTION("Errors")
+	{
+		REQUIRE_THROWS( parse_benchmark_script( "launch 1\n" ) ); // no camera
+		REQUIRE_THROWS( parse_benchmark_script( "camera 0 0 0 0 0\n" ) );
+		REQUIRE_THROWS( parse_benchmark_script( "camera 0 0 0 0 0 0 0\n" ) );
+		REQUIRE_THROWS( parse_benchmark_script( "camera 0 0 0 0 0 0\nfly 1\n" ) );
+		REQUIRE_THROWS( load_benchmark_script( "does/not/exist.txt" ) );
+	}
+}
+
+TEST_CASE("Benchmark statistics", "[benchmark]")
+{
+	SECTION("Nearest rank percentiles")
+	{
+		std::vector<double> samples;
+		for( int i = 100; i >= 1; --i )
+			samples.push_back( double(i) );
+
+		auto const stats = summarize_samples( samples );
+		REQUIRE( stats.count == 100 );
+		REQUIRE( stats.mean == Catch::Approx( 50.5 ) );
+		REQUIRE( stats.stddev == Catch::Approx( 28.866 ).epsilon( 1e-4 ) );
+		REQUIRE( stats.p50 == 50.0 );
+		REQUIRE( stats.p90 == 90.0 );
+		REQUIRE( stats.p99 == 99.0 );
+		REQUIRE( stats.max == 100.0 );
+	}
+
+	SECTION("Single and no samples")
+	{
+		auto const one = summarize_samples( { 7.0 } );
+		REQUIRE( one.p50 == 7.0 );
+		REQUIRE( one.p99 == 7.0 );
+		REQUIRE( one.stddev == 0.0 );
+
+		auto const none = summarize_samples( {} );
+		REQUIRE( none.count == 0 );
+		REQUIRE( none.max == 0.0 );
+	}
+
+	SECTION("Report")
+	{
+		BenchmarkInfo info;
+		info.script = "assets/benchmark.txt";
+		info.renderer = "test \"renderer\"";
+		info.pacing = "fixed";
+		info.targetFps = 120.0;
+
+		std::vector<BenchmarkFrame> frames( 10 );
+		for( std::size_t i = 0; i < frames.size(); ++i )
+		{
+			frames[i].cpuMilliseconds = double(i);
+			frames[i].gpuMilliseconds = i % 2 ? 1.0 : -1.0; // half unmeasured
+			frames[i].intervalMilliseconds = 8.0;
+			frames[i].latencyMilliseconds = i < 2 ? -1.0 : 20.0; // first ones unknown
+			frames[i].draws = 3;
+		}
+
+		char const* path = "benchmark_test_report.json";
+		write_benchmark_report( path, info, frames );
+
+		std::string json;
+		if( std::FILE* f = std::fopen( path, "rb" ) )
+		{
+			char buffer[1024];
+			while( auto const n = std::fread( buffer, 1, sizeof(buffer), f ) )
+				json.append( buffer, n );
+			std::fclose( f );
+		}
+		std::remove( path );
+
+		REQUIRE( json.find( "\"frames\": 10" ) != std::string::npos );
+		REQUIRE( json.find( "\"test \\\"renderer\\\"\"" ) != std::string::npos );
+		REQUIRE( json.find( "\"cpu_ms\": { \"count\": 10," ) != std::string::npos );
+		REQUIRE( json.find( "\"gpu_ms\": { \"count\": 5," ) != std::string::npos );
+		REQUIRE( json.find( "\"pacing\": \"fixed\"" ) != std::string::npos );
+		REQUIRE( json.find( "\"target_fps\": 120.000" ) != std::string::npos );
+		REQUIRE( json.find( "\"interval_ms\": { \"count\": 10, \"mean\": 8.0000, \"stddev\": 0.0000" ) != std::string::npos );
+		REQUIRE( json.find( "\"latency_ms\": { \"count\": 8," ) != std::string::npos );
+		REQUIRE( json.find( "\"draws\": { \"count\": 10, \"mean\": 3.0000" ) != std::string::npos );
+		REQUIRE( json.find( "\"particles\"" ) != std::string::npos );
+	}
+}
@@ -0,0 +1,173 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include "../vmlib/random.hpp"
+
+#include "../main/bvh.hpp"
+
+#include "culling_helpers.hpp"
+
+namespace
+{
+	using culling_test::camera;
+	using culling_test::uniform;
+
+	std::vector<Aabb> random_boxes_( std::size_t aCount, std::uint64_t aSeed, float aExtent )
+	{
+		Xoshiro256Plus rng( aSeed );
+		std::vector<Aabb> boxes( aCount );
+		for( auto& box : boxes )
+		{
+			Vec3f const c{ uniform( rng, -aExtent, aExtent ), uniform( rng, -5.f, 5.f ), uniform( rng, -aExtent, aExtent ) };
+			Vec3f const h{ uniform( rng, 0.1f, 2.f ), uniform( rng, 0.1f, 2.f ), uniform( rng, 0.1f, 2.f ) };
+			box = Aabb{ c - h, c + h };
+		}
+		return boxes;
+	}
+
+	std::vector<std::uint32_t> sorted_( std::vector<std::uint32_t> aV )
+	{
+		std::sort( aV.begin(), aV.end() );
+		return aV;
+	}
+}
+
+TEST_CASE("Frustum and box helpers", "[bvh]")
+{
+	SECTION("Frustum planes")
+	{
+		auto const f = make_frustum( camera( { 0.f, 0.f, 0.f } ) );
+
+		auto const point = [] (Vec3f aP) { return Aabb{ aP, aP }; };
+		REQUIRE( intersects( f, point( { 0.f, 0.f, -5.f } ) ) );
+		REQUIRE( !intersects( f, point( { 0.f, 0.f, 5.f } ) ) );   // behind
+		REQUIRE( !intersects( f, point( { 0.f, 0.f, -150.f } ) ) ); // beyond far
+		REQUIRE( !intersects( f, point( { 0.f, 0.f, -0.05f } ) ) ); // before near
+		REQUIRE( !intersects( f, point( { 50.f, 0.f, -5.f } ) ) );  // right
+		REQUIRE( !intersects( f, point( { 0.f, 50.f, -5.f } ) ) );  // above
+
+		// Straddling a plane counts as visible
+		REQUIRE( intersects( f, Aabb{ { -1.f, -1.f, -1.f }, { 1.f, 1.f, 1.f } } ) );
+	}
+
+	SECTION("Transformed boxes contain the transformed corners")
+	{
+		Aabb const box{ { -1.f, 0.f, 2.f }, { 3.f, 1.f, 4.f } };
+		auto const m = make_translation( { 5.f, -2.f, 1.f } ) * make_rotation_y( 0.7f ) * make_rotation_x( -0.3f );
+		auto const t = transform_aabb( box, m );
+
+		bool contained = true;
+		for( int i = 0; i < 8; ++i )
+		{
+			Vec4f const c{ (i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z, 1.f };
+			auto const p = m * c;
+			contained = contained
+				&& p.x >= t.min.x - 1e-5f && p.x <= t.max.x + 1e-5f
+				&& p.y >= t.min.y - 1e-5f && p.y <= t.max.y + 1e-5f
+				&& p.z >= t.min.z - 1e-5f && p.z <= t.max.z + 1e-5f;
+		}
+		REQUIRE( contained );
+	}
+}
+
+TEST_CASE("BVH frustum culling", "[bvh]")
+{
+	Bvh bvh;
+	std::vector<std::uint32_t> expected, visible;
+
+	SECTION("Matches the brute force culler")
+	{
+		auto const boxes = random_boxes_( 5000, 3, 150.f );
+		bvh.build( boxes.data(), boxes.size() );
+		REQUIRE( bvh.object_count() == boxes.size() );
+
+		for( int i = 0; i < 8; ++i )
+		{
+			auto const f = make_frustum( camera( { float(10*i) - 40.f, 0.f, 0.f }, 0.8f * float(i) ) );
+
+			frustum_cull( f, boxes.data(), boxes.size(), expected );
+			bvh.cull( f, visible );
+
+			REQUIRE( !expected.empty() );
+			REQUIRE( expected.size() < boxes.size() );
+			REQUIRE( sorted_( visible ) == expected );
+		}
+	}
+
+	SECTION("Refit follows moving objects")
+	{
+		auto boxes = random_boxes_( 1000, 4, 60.f );
+		bvh.build( boxes.data(), boxes.size() );
+
+		Xoshiro256Plus rng( 5 );
+		for( auto& box : boxes )
+		{
+			Vec3f const d{ uniform( rng, -30.f, 30.f ), 0.f, uniform( rng, -30.f, 30.f ) };
+			box = Aabb{ box.min + d, box.max + d };
+		}
+		bvh.refit( boxes.data() );
+
+		auto const f = make_frustum( camera( { 0.f, 0.f, 0.f }, 2.f ) );
+		frustum_cull( f, boxes.data(), boxes.size(), expected );
+		bvh.cull( f, visible );
+		REQUIRE( sorted_( visible ) == expected );
+	}
+
+	SECTION("Small and empty inputs")
+	{
+		auto const f = make_frustum( camera( { 0.f, 0.f, 0.f } ) );
+
+		bvh.build( nullptr, 0 );
+		bvh.cull( f, visible );
+		REQUIRE( visible.empty() );
+
+		Aabb const boxes[] = {
+			{ { -1.f, -1.f, -6.f }, { 1.f, 1.f, -4.f } },
+			{ { -1.f, -1.f, 4.f }, { 1.f, 1.f, 6.f } }
+		};
+		bvh.build( boxes, 2 );
+		bvh.cull( f, visible );
+		REQUIRE( visible == std::vector<std::uint32_t>{ 0 } );
+	}
+}
+
+TEST_CASE("BVH culling throughput", "[.][benchmark][bvh]")
+{
+	for( std::size_t count : { std::size_t(10000), std::size_t(100000) } )
+	{
+		auto boxes = random_boxes_( count, 9, 1000.f );
+		auto const f = make_frustum( camera( { 0.f, 0.f, 0.f }, 0.3f ) );
+
+		Bvh bvh;
+		bvh.build( boxes.data(), boxes.size() );
+
+		std::vector<std::uint32_t> visible;
+		bvh.cull( f, visible );
+		WARN( count << " objects: " << visible.size() << " visible, " << bvh.node_count() << " nodes" );
+
+		auto const name = std::to_string( count / 1000 ) + "k objects";
+
+		BENCHMARK( "bvh cull " + name )
+		{
+			bvh.cull( f, visible );
+			return visible.size();
+		};
+		BENCHMARK( "brute force cull " + name + " (reference)" )
+		{
+			frustum_cull( f, boxes.data(), boxes.size(), visible );
+			return visible.size();
+		};
+		BENCHMARK( "bvh refit " + name )
+		{
+			bvh.refit( boxes.data() );
+			return bvh.node_count();
+		};
+		BENCHMARK( "bvh build " + name )
+		{
+			bvh.build( boxes.data(), boxes.size() );
+			return bvh.node_count();
+		};
+	}
+}
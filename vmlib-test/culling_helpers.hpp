@@ -0,0 +1,27 @@
+#ifndef CULLING_HELPERS_HPP_AE2F20F6_3AB3_40C1_ADFF_9DCDE70441FC
+#define CULLING_HELPERS_HPP_AE2F20F6_3AB3_40C1_ADFF_9DCDE70441FC
+
+// Scene setup shared by the culling tests (bvh_tests.cpp, occlusion_tests.cpp)
+
+#include "../vmlib/mat44.hpp"
+#include "../vmlib/random.hpp"
+
+namespace culling_test
+{
+	constexpr float kPi = 3.1415926f;
+
+	// Camera at aPosition, turned by aYaw about +y; yaw 0 looks down -z.
+	// 60 degree vertical field of view, near 0.1, far 100.
+	inline Mat44f camera( Vec3f aPosition, float aYaw = 0.f, float aAspect = 16.f / 9.f )
+	{
+		auto const projection = make_perspective_projection( 60.f * kPi / 180.f, aAspect, 0.1f, 100.f );
+		return projection * make_rotation_y( aYaw ) * make_translation( -aPosition );
+	}
+
+	inline float uniform( Xoshiro256Plus& aRng, float aMin, float aMax )
+	{
+		return aMin + (aMax - aMin) * aRng.uniform_float();
+	}
+}
+
+#endif // CULLING_HELPERS_HPP_AE2F20F6_3AB3_40C1_ADFF_9DCDE70441FC
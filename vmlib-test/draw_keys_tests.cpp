@@ -0,0 +1,129 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include "../vmlib/random.hpp"
+
+#include "../main/draw_keys.hpp"
+
+TEST_CASE("Draw key packing", "[render_queue]")
+{
+	SECTION("Fields round-trip")
+	{
+		auto const key = make_draw_key( 3, 1234, 56, 4095, 0.5f );
+
+		REQUIRE( draw_key_pass( key ) == 3 );
+		REQUIRE( draw_key_program( key ) == 1234 );
+		REQUIRE( draw_key_material( key ) == 56 );
+		REQUIRE( draw_key_texture( key ) == 4095 );
+	}
+
+	SECTION("Fields order by significance")
+	{
+		// Pass dominates program dominates material dominates texture
+		// dominates depth.
+		REQUIRE( make_draw_key( 1, 0, 0, 0, 0.f ) > make_draw_key( 0, 4095, 4095, 4095, 1.f ) );
+		REQUIRE( make_draw_key( 0, 1, 0, 0, 0.f ) > make_draw_key( 0, 0, 4095, 4095, 1.f ) );
+		REQUIRE( make_draw_key( 0, 0, 1, 0, 0.f ) > make_draw_key( 0, 0, 0, 4095, 1.f ) );
+		REQUIRE( make_draw_key( 0, 0, 0, 1, 0.f ) > make_draw_key( 0, 0, 0, 0, 1.f ) );
+		REQUIRE( make_draw_key( 0, 0, 0, 0, 0.75f ) > make_draw_key( 0, 0, 0, 0, 0.25f ) );
+	}
+
+	SECTION("Depth is clamped")
+	{
+		REQUIRE( make_draw_key( 0, 0, 0, 0, -1.f ) == make_draw_key( 0, 0, 0, 0, 0.f ) );
+		REQUIRE( make_draw_key( 0, 0, 0, 0, 2.f ) == make_draw_key( 0, 0, 0, 0, 1.f ) );
+		REQUIRE( draw_key_texture( make_draw_key( 0, 0, 0, 0, 2.f ) ) == 0 );
+	}
+}
+
+TEST_CASE("Draw key radix sort", "[render_queue]")
+{
+	std::vector<DrawKeyEntry> entries, scratch;
+
+	SECTION("Matches a stable sort")
+	{
+		Xoshiro256Plus rng( 99 );
+		for( std::uint32_t i = 0; i < 5000; ++i )
+		{
+			// Few distinct states and coarse depths -> many equal keys
+			auto const r = rng.next();
+			auto const key = make_draw_key( unsigned(r & 1), unsigned((r >> 8) % 5), unsigned((r >> 16) % 3), unsigned((r >> 24) % 7), float((r >> 32) % 16) / 16.f );
+			entries.emplace_back( DrawKeyEntry{ key, i } );
+		}
+
+		auto expected = entries;
+		std::stable_sort( expected.begin(), expected.end(), [] (DrawKeyEntry const& aA, DrawKeyEntry const& aB) {
+			return aA.key < aB.key;
+		} );
+
+		radix_sort_draw_keys( entries, scratch );
+
+		std::size_t mismatches = 0;
+		for( std::size_t i = 0; i < entries.size(); ++i )
+			mismatches += (entries[i].key != expected[i].key || entries[i].item != expected[i].item) ? 1 : 0;
+
+		REQUIRE( mismatches == 0 );
+	}
+
+	SECTION("Keys differing in a single digit")
+	{
+		// Exercises the skipped passes, with an odd number of real passes.
+		for( std::uint32_t i = 0; i < 256; ++i )
+			entries.emplace_back( DrawKeyEntry{ std::uint64_t(255 - i) << 56, i } );
+
+		radix_sort_draw_keys( entries, scratch );
+
+		bool sorted = true;
+		for( std::size_t i = 0; i < entries.size(); ++i )
+			sorted = sorted && entries[i].item == 255 - i;
+		REQUIRE( sorted );
+	}
+
+	SECTION("Trivial inputs")
+	{
+		radix_sort_draw_keys( entries, scratch );
+		REQUIRE( entries.empty() );
+
+		entries.emplace_back( DrawKeyEntry{ 42, 0 } );
+		radix_sort_draw_keys( entries, scratch );
+		REQUIRE( entries.size() == 1 );
+		REQUIRE( entries[0].key == 42 );
+	}
+}
+
+TEST_CASE("Draw key sort throughput", "[.][benchmark][render_queue]")
+{
+	static constexpr std::size_t kDraws_ = 10000;
+
+	Xoshiro256Plus rng( 1 );
+	std::vector<DrawKeyEntry> source;
+	for( std::uint32_t i = 0; i < kDraws_; ++i )
+	{
+		auto const r = rng.next();
+		source.emplace_back( DrawKeyEntry{ make_draw_key( 0, unsigned(r % 8), unsigned((r >> 8) % 32), unsigned((r >> 16) % 64), float((r >> 32) & 0xffff) / 65535.f ), i } );
+	}
+
+	std::vector<DrawKeyEntry> entries, scratch;
+
+	BENCHMARK_ADVANCED("radix sort 10k draws")(Catch::Benchmark::Chronometer meter)
+	{
+		meter.measure( [&] {
+			entries = source;
+			radix_sort_draw_keys( entries, scratch );
+			return entries[0].key;
+		} );
+	};
+
+	BENCHMARK_ADVANCED("std::sort 10k draws (reference)")(Catch::Benchmark::Chronometer meter)
+	{
+		meter.measure( [&] {
+			entries = source;
+			std::sort( entries.begin(), entries.end(), [] (DrawKeyEntry const& aA, DrawKeyEntry const& aB) {
+				return aA.key < aB.key;
+			} );
+			return entries[0].key;
+		} );
+	};
+}
@@ -0,0 +1,121 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include "../main/draw_list.hpp"
+#include "../main/draw_keys.hpp"
+
+namespace
+{
+	DrawItem item_( GLuint aProgram, GLuint aTexture, std::uint32_t aMaterial, std::uint32_t aTransform, GLint aFirst )
+	{
+		return DrawItem{ aProgram, 1, aTexture, aMaterial, aTransform, GL_TRIANGLES, aFirst, 3 };
+	}
+}
+
+TEST_CASE("Draw list", "[render_queue]")
+{
+	DrawList list;
+
+	SECTION("Materials are merged")
+	{
+		auto const a = list.add_material( { { 1.f, 0.f, 0.f }, { 0.1f, 0.f, 0.f } } );
+		auto const b = list.add_material( { { 0.f, 1.f, 0.f }, { 0.f, 0.1f, 0.f } } );
+		auto const c = list.add_material( { { 1.f, 0.f, 0.f }, { 0.1f, 0.f, 0.f } } );
+
+		REQUIRE( a != b );
+		REQUIRE( a == c );
+		REQUIRE( list.materials().size() == 2 );
+	}
+
+	SECTION("Consecutive transforms are merged")
+	{
+		auto const a = list.add_transform( { kIdentity44f, kIdentity33f } );
+		auto const b = list.add_transform( { kIdentity44f, kIdentity33f } );
+		auto const c = list.add_transform( { make_translation( { 1.f, 0.f, 0.f } ), kIdentity33f } );
+
+		REQUIRE( a == b );
+		REQUIRE( a != c );
+		REQUIRE( list.transforms().size() == 2 );
+	}
+
+	SECTION("Draws are sorted by state, then depth")
+	{
+		auto const m = list.add_material( { { 1.f, 1.f, 1.f }, { 1.f, 1.f, 1.f } } );
+		auto const t = list.add_transform( { kIdentity44f, kIdentity33f } );
+
+		list.submit( item_( 7, 0, m, t, 0 ), RenderPass::transparent, 0.1f );
+		list.submit( item_( 5, 0, m, t, 1 ), RenderPass::opaque, 0.9f );
+		list.submit( item_( 7, 0, m, t, 2 ), RenderPass::opaque, 0.5f );
+		list.submit( item_( 5, 0, m, t, 3 ), RenderPass::opaque, 0.2f );
+
+		REQUIRE( !list.sorted() );
+		list.sort();
+		REQUIRE( list.sorted() );
+
+		// Program ids are assigned in order of appearance: 7 -> 0, 5 -> 1
+		REQUIRE( list.size() == 4 );
+		REQUIRE( list.sorted_item( 0 ).first == 2 );
+		REQUIRE( list.sorted_item( 1 ).first == 3 );
+		REQUIRE( list.sorted_item( 2 ).first == 1 );
+		REQUIRE( list.sorted_item( 3 ).first == 0 );
+	}
+
+	SECTION("clear() keeps the draw key ids")
+	{
+		auto const m = list.add_material( { { 1.f, 1.f, 1.f }, { 1.f, 1.f, 1.f } } );
+		auto const t = list.add_transform( { kIdentity44f, kIdentity33f } );
+		list.submit( item_( 7, 0, m, t, 0 ) );
+		list.submit( item_( 5, 0, m, t, 1 ) );
+		list.sort();
+
+		list.clear();
+		REQUIRE( list.empty() );
+		REQUIRE( list.materials().empty() );
+		REQUIRE( list.transforms().empty() );
+
+		// Program 5 now appears first, but keeps the larger id.
+		auto const m2 = list.add_material( { { 1.f, 1.f, 1.f }, { 1.f, 1.f, 1.f } } );
+		auto const t2 = list.add_transform( { kIdentity44f, kIdentity33f } );
+		list.submit( item_( 5, 0, m2, t2, 1 ) );
+		list.submit( item_( 7, 0, m2, t2, 0 ) );
+		list.sort();
+
+		REQUIRE( list.sorted_item( 0 ).program == 7 );
+		REQUIRE( list.sorted_item( 1 ).program == 5 );
+	}
+
+	SECTION("Ids of names that are no longer used are reused")
+	{
+		// Like a long editing session: program 1 is always drawn, and each
+		// frame also draws a freshly reloaded program. Program 1 appears
+		// first, so it gets id 0, and keeps it.
+		std::size_t const frames = 3 * (std::size_t(1) << kDrawKeyProgramBits);
+		std::size_t wrongOrder = 0;
+
+		for( std::size_t frame = 0; frame < frames; ++frame )
+		{
+			auto const m = list.add_material( { { 1.f, 1.f, 1.f }, { 1.f, 1.f, 1.f } } );
+			auto const t = list.add_transform( { kIdentity44f, kIdentity33f } );
+
+			list.submit( item_( 1, 0, m, t, 0 ) );
+			list.submit( item_( GLuint(100 + frame), 0, m, t, 1 ) );
+			list.sort();
+
+			wrongOrder += (1 == list.sorted_item( 0 ).program) ? 0 : 1;
+			list.clear();
+		}
+
+		REQUIRE( wrongOrder == 0 );
+	}
+
+	SECTION("Too many distinct names in one frame throw")
+	{
+		auto const m = list.add_material( { { 1.f, 1.f, 1.f }, { 1.f, 1.f, 1.f } } );
+		auto const t = list.add_transform( { kIdentity44f, kIdentity33f } );
+
+		std::size_t const ids = std::size_t(1) << kDrawKeyTextureBits;
+		for( std::size_t i = 0; i < ids; ++i )
+			list.submit( item_( 1, GLuint(1 + i), m, t, 0 ) );
+
+		REQUIRE_THROWS( list.submit( item_( 1, GLuint(1 + ids), m, t, 0 ) ) );
+	}
+}
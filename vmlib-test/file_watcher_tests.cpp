@@ -0,0 +1,133 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+
+#include "../support/file_watcher.hpp"
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	struct TempDir_
+	{
+		TempDir_()
+			: path( fs::temp_directory_path() / ("file_watcher_tests_" + std::to_string( std::hash<std::thread::id>()( std::this_thread::get_id() ) )) )
+		{
+			fs::remove_all( path );
+			fs::create_directories( path );
+		}
+		~TempDir_()
+		{
+			std::error_code ec;
+			fs::remove_all( path, ec );
+		}
+
+		fs::path path;
+	};
+
+	void write_( fs::path const& aPath, char const* aText )
+	{
+		std::ofstream( aPath, std::ios::binary ) << aText;
+	}
+
+	// Generous, for loaded machines; passing tests do not wait this long
+	constexpr std::chrono::milliseconds kDeadline_( 2000 );
+
+	// Takes changes until aPath is among them, for up to kDeadline_. Returns
+	// all changes taken.
+	std::vector<std::string> wait_for_( FileWatcher& aWatcher, std::string const& aPath )
+	{
+		std::vector<std::string> ret;
+
+		auto const deadline = FileWatcher::Clock::now() + kDeadline_;
+		while( ret.end() == std::find( ret.begin(), ret.end(), aPath ) && FileWatcher::Clock::now() < deadline )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds(5) );
+			for( auto& change : aWatcher.take_changes() )
+				ret.emplace_back( std::move(change) );
+		}
+
+		return ret;
+	}
+
+	// Waits up to kDeadline_ for a change to be pending
+	bool wait_for_pending_( FileWatcher& aWatcher )
+	{
+		auto const deadline = FileWatcher::Clock::now() + kDeadline_;
+		while( 0 == aWatcher.pending() && FileWatcher::Clock::now() < deadline )
+			std::this_thread::sleep_for( std::chrono::milliseconds(5) );
+
+		return aWatcher.pending() > 0;
+	}
+}
+
+TEST_CASE("File watcher", "[watcher]")
+{
+	using namespace std::chrono;
+
+	TempDir_ dir;
+	auto const prefix = dir.path.string() + "/";
+
+	write_( dir.path / "old.txt", "old" );
+
+	SECTION("Written files are reported once")
+	{
+		FileWatcher watcher( dir.path.string(), milliseconds(20), milliseconds(20) );
+
+		write_( dir.path / "a.glsl", "a" );
+
+		auto const changes = wait_for_( watcher, prefix + "a.glsl" );
+		REQUIRE( changes == std::vector<std::string>{ prefix + "a.glsl" } );
+
+		// Changes arrive in order, so a second report of a.glsl would come
+		// before that of the marker
+		write_( dir.path / "marker.txt", "m" );
+
+		auto const later = wait_for_( watcher, prefix + "marker.txt" );
+		REQUIRE( later == std::vector<std::string>{ prefix + "marker.txt" } );
+	}
+
+	SECTION("Files renamed into the directory are reported")
+	{
+		FileWatcher watcher( dir.path.string(), milliseconds(20), milliseconds(20) );
+
+		write_( dir.path / "b.tmp~", "b" );
+		fs::rename( dir.path / "b.tmp~", dir.path / "b.glsl" );
+
+		auto const changes = wait_for_( watcher, prefix + "b.glsl" );
+		REQUIRE( changes.end() != std::find( changes.begin(), changes.end(), prefix + "b.glsl" ) );
+	}
+
+	SECTION("Changes are held back until they settle")
+	{
+		// The times passed to take_changes() bracket the change: it was seen
+		// no earlier than before, and no later than after
+		auto const settle = seconds(10);
+		FileWatcher watcher( dir.path.string(), settle, milliseconds(20) );
+
+		auto const before = FileWatcher::Clock::now();
+		write_( dir.path / "old.txt", "new" );
+
+		REQUIRE( wait_for_pending_( watcher ) );
+		auto const after = FileWatcher::Clock::now();
+
+		REQUIRE( watcher.take_changes( before + settle - milliseconds(1) ).empty() );
+		REQUIRE( 1 == watcher.pending() );
+
+		REQUIRE( watcher.take_changes( after + settle ) == std::vector<std::string>{ prefix + "old.txt" } );
+		REQUIRE( 0 == watcher.pending() );
+	}
+
+	SECTION("Only directories can be watched")
+	{
+		REQUIRE_THROWS( FileWatcher( prefix + "old.txt" ) );
+		REQUIRE_THROWS( FileWatcher( prefix + "missing" ) );
+	}
+}
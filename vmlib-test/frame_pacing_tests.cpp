@@ -0,0 +1,79 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <thread>
+
+#include "../main/frame_pacing.hpp"
+
+TEST_CASE("Frame pacing modes", "[pacing]")
+{
+	for( auto pacing : { FramePacing::vsync, FramePacing::uncapped, FramePacing::fixed, FramePacing::lowLatency } )
+		REQUIRE( parse_frame_pacing( frame_pacing_name( pacing ) ) == pacing );
+
+	REQUIRE_THROWS( parse_frame_pacing( "vsync2" ) );
+
+	REQUIRE( frame_pacing_vsync( FramePacing::lowLatency ) );
+	REQUIRE( !frame_pacing_vsync( FramePacing::fixed ) );
+
+	// Cycling visits every mode once
+	auto pacing = FramePacing::vsync;
+	for( int i = 0; i < 3; ++i )
+	{
+		pacing = next_frame_pacing( pacing );
+		REQUIRE( pacing != FramePacing::vsync );
+	}
+	REQUIRE( next_frame_pacing( pacing ) == FramePacing::vsync );
+}
+
+TEST_CASE("Frame limiter", "[pacing]")
+{
+	using namespace std::chrono;
+	using Clock = FrameLimiter::Clock;
+
+	// 200 Hz, i.e., 5 ms per frame
+	FrameLimiter limiter( 200.0, milliseconds(1) );
+	REQUIRE( limiter.period() == duration_cast<Clock::duration>( milliseconds(5) ) );
+
+	SECTION("Frames are spaced by the period")
+	{
+		REQUIRE( limiter.wait() == Clock::duration::zero() ); // starts the schedule
+
+		auto const begin = Clock::now();
+		for( int i = 0; i < 10; ++i )
+			limiter.wait();
+		auto const elapsed = Clock::now() - begin;
+
+		// Never early; generous upper bound for loaded test machines
+		REQUIRE( elapsed >= milliseconds(50) - microseconds(100) );
+		REQUIRE( elapsed < milliseconds(500) );
+	}
+
+	SECTION("A slightly late frame does not shift the schedule")
+	{
+		limiter.wait();
+		auto const start = Clock::now();
+
+		std::this_thread::sleep_for( milliseconds(7) ); // 2 ms into the next period
+		REQUIRE( limiter.wait() < milliseconds(1) );
+
+		limiter.wait(); // back on the original schedule: start + 10 ms
+		REQUIRE( Clock::now() - start >= milliseconds(10) - microseconds(100) );
+	}
+
+	SECTION("A frame late by more than a period restarts the schedule")
+	{
+		limiter.wait();
+		std::this_thread::sleep_for( milliseconds(20) );
+		REQUIRE( limiter.wait() == Clock::duration::zero() );
+
+		auto const restart = Clock::now();
+		limiter.wait();
+		REQUIRE( Clock::now() - restart >= milliseconds(4) );
+	}
+
+	SECTION("Reset")
+	{
+		limiter.wait();
+		limiter.reset();
+		REQUIRE( limiter.wait() == Clock::duration::zero() );
+	}
+}
@@ -0,0 +1,164 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <stdexcept>
+#include <condition_variable>
+
+#include <cstdint>
+
+#include "../main/frame_pipeline.hpp"
+
+namespace
+{
+	struct Frame_
+	{
+		// Input, set by the submitting thread
+		std::uint64_t index = 0;
+
+		// Output of the build stage
+		std::uint64_t square = 0;
+		std::vector<int> data;
+	};
+}
+
+TEST_CASE("Frame pipeline", "[frame_pipeline]")
+{
+	SECTION("Frames are built from their inputs, in order")
+	{
+		std::uint64_t built = 0;
+		bool inOrder = true;
+
+		FramePipeline<Frame_> pipeline( [&] (Frame_& aFrame) {
+			inOrder = inOrder && aFrame.index == built;
+			++built;
+
+			aFrame.square = aFrame.index * aFrame.index;
+			aFrame.data.assign( 16, int(aFrame.index) );
+		} );
+
+		pipeline.next().index = 0;
+		pipeline.kick();
+
+		std::size_t mismatches = 0;
+		for( std::uint64_t i = 0; i < 100; ++i )
+		{
+			pipeline.next().index = i + 1;
+			pipeline.kick();
+
+			auto const& frame = pipeline.acquire();
+			mismatches += (frame.index != i || frame.square != i*i || frame.data.size() != 16 || frame.data[15] != int(i)) ? 1 : 0;
+			pipeline.release();
+		}
+
+		REQUIRE( mismatches == 0 );
+		REQUIRE( pipeline.frames() == 101 );
+
+		// The last frame is still being built; the destructor waits for it.
+	}
+
+	SECTION("Building overlaps submitting")
+	{
+		// Building frame N+1 waits for a signal that is only given while
+		// frame N is being submitted. With a sequential pipeline, the wait
+		// would time out.
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::uint64_t submitting = ~std::uint64_t(0);
+		bool overlapped = true;
+
+		FramePipeline<Frame_> pipeline( [&] (Frame_& aFrame) {
+			if( 0 == aFrame.index )
+				return;
+
+			std::unique_lock<std::mutex> lock( mutex );
+			overlapped = overlapped && cv.wait_for( lock, std::chrono::seconds(5), [&] {
+				return submitting == aFrame.index - 1;
+			} );
+		} );
+
+		pipeline.next().index = 0;
+		pipeline.kick();
+
+		for( std::uint64_t i = 0; i < 4; ++i )
+		{
+			pipeline.next().index = i + 1;
+			pipeline.kick();
+
+			auto const& frame = pipeline.acquire();
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				submitting = frame.index;
+			}
+			cv.notify_all();
+			pipeline.release();
+		}
+
+		// Let the last frame finish
+		pipeline.acquire();
+		pipeline.release();
+
+		std::unique_lock<std::mutex> lock( mutex );
+		REQUIRE( overlapped );
+	}
+
+	SECTION("Frames can skip the lookahead")
+	{
+		FramePipeline<Frame_> pipeline( [&] (Frame_& aFrame) {
+			aFrame.square = aFrame.index * aFrame.index;
+		} );
+
+		// Pipelined: frame 0 in flight while frame 1 is kicked
+		pipeline.next().index = 0;
+		pipeline.kick();
+		pipeline.next().index = 1;
+		pipeline.kick();
+		REQUIRE( pipeline.in_flight() == 2 );
+		REQUIRE( pipeline.acquire().index == 0 );
+		pipeline.release();
+
+		// Switching to no lookahead: frame 1 is still in flight, and goes
+		// first; after it, each frame is kicked and acquired right away.
+		REQUIRE( pipeline.in_flight() == 1 );
+		REQUIRE( pipeline.acquire().index == 1 );
+		pipeline.release();
+
+		std::size_t wrong = 0;
+		for( std::uint64_t i = 2; i < 10; ++i )
+		{
+			REQUIRE( pipeline.in_flight() == 0 );
+			pipeline.next().index = i;
+			pipeline.kick();
+
+			auto const& frame = pipeline.acquire();
+			wrong += (frame.index == i && frame.square == i * i) ? 0 : 1;
+			pipeline.release();
+		}
+		REQUIRE( wrong == 0 );
+		REQUIRE( pipeline.in_flight() == 0 );
+	}
+
+	SECTION("Build errors surface in acquire()")
+	{
+		FramePipeline<Frame_> pipeline( [&] (Frame_& aFrame) {
+			if( 2 == aFrame.index )
+				throw std::runtime_error( "build failed" );
+			aFrame.square = aFrame.index * aFrame.index;
+		} );
+
+		for( std::uint64_t i = 0; i < 4; ++i )
+		{
+			pipeline.next().index = i;
+			pipeline.kick();
+
+			if( 2 == i )
+				REQUIRE_THROWS_AS( pipeline.acquire(), std::runtime_error );
+			else
+			{
+				REQUIRE( pipeline.acquire().square == i*i );
+				pipeline.release();
+			}
+		}
+	}
+}
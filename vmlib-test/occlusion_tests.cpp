@@ -0,0 +1,296 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+
+#include <cmath>
+
+#include "../vmlib/random.hpp"
+
+#include "../main/occlusion.hpp"
+#include "../main/worker_pool.hpp"
+
+#include "culling_helpers.hpp"
+
+namespace
+{
+	using culling_test::uniform;
+
+	// The default OcclusionBuffer is 256x128, i.e., 2:1
+	Mat44f camera_( Vec3f aPosition )
+	{
+		return culling_test::camera( aPosition, 0.f, 2.f );
+	}
+
+	// Two triangles spanning [-aHalf,aHalf]^2 in the plane z = aZ
+	std::vector<Vec3f> wall_( float aHalf, float aZ )
+	{
+		return {
+			{ -aHalf, -aHalf, aZ }, { aHalf, -aHalf, aZ }, { aHalf, aHalf, aZ },
+			{ -aHalf, -aHalf, aZ }, { aHalf, aHalf, aZ }, { -aHalf, aHalf, aZ }
+		};
+	}
+
+	// aN x aN quads spanning [-aHalf,aHalf]^2 in the plane z = aZ
+	std::vector<Vec3f> grid_( std::size_t aN, float aHalf, float aZ )
+	{
+		std::vector<Vec3f> positions;
+		auto const at = [&] (std::size_t aI, std::size_t aJ) {
+			return Vec3f{ -aHalf + 2.f * aHalf * float(aI) / float(aN), -aHalf + 2.f * aHalf * float(aJ) / float(aN), aZ };
+		};
+		for( std::size_t j = 0; j < aN; ++j )
+		{
+			for( std::size_t i = 0; i < aN; ++i )
+			{
+				positions.insert( positions.end(), { at( i, j ), at( i+1, j ), at( i+1, j+1 ) } );
+				positions.insert( positions.end(), { at( i, j ), at( i+1, j+1 ), at( i, j+1 ) } );
+			}
+		}
+		return positions;
+	}
+
+	Aabb box_( Vec3f aCenter, float aHalf )
+	{
+		return Aabb{ aCenter - Vec3f{ aHalf, aHalf, aHalf }, aCenter + Vec3f{ aHalf, aHalf, aHalf } };
+	}
+
+	// Random triangle soup in front of a camera at the origin
+	std::vector<Vec3f> random_triangles_( std::size_t aCount, std::uint64_t aSeed )
+	{
+		Xoshiro256Plus rng( aSeed );
+		std::vector<Vec3f> positions;
+		for( std::size_t i = 0; i < aCount; ++i )
+		{
+			Vec3f const c{ uniform( rng, -20.f, 20.f ), uniform( rng, -10.f, 10.f ), uniform( rng, -60.f, -5.f ) };
+			for( int j = 0; j < 3; ++j )
+				positions.emplace_back( c + Vec3f{ uniform( rng, -3.f, 3.f ), uniform( rng, -3.f, 3.f ), uniform( rng, -3.f, 3.f ) } );
+		}
+		return positions;
+	}
+}
+
+TEST_CASE("Occlusion buffer", "[occlusion]")
+{
+	WorkerPool pool( 2 );
+	OcclusionBuffer buffer;
+
+	REQUIRE( buffer.width() == 256 );
+	REQUIRE( buffer.height() == 128 );
+
+	SECTION("Empty buffer hides nothing")
+	{
+		buffer.begin( camera_( { 0.f, 0.f, 0.f } ) );
+		buffer.rasterize( pool );
+
+		REQUIRE( buffer.visible( box_( { 0.f, 0.f, -50.f }, 1.f ) ) );
+		REQUIRE( buffer.stats().occluded == 0 );
+	}
+
+	SECTION("Wall hides what is behind it")
+	{
+		auto const wall = wall_( 5.f, -10.f );
+
+		buffer.begin( camera_( { 0.f, 0.f, 0.f } ) );
+		buffer.add_occluder( wall.data(), wall.size(), kIdentity44f );
+		buffer.rasterize( pool );
+
+		REQUIRE( buffer.stats().occluderTriangles == 2 );
+
+		// Center pixel is covered, at the depth of the wall
+		auto const d = buffer.depth( buffer.width()/2, buffer.height()/2 );
+		REQUIRE( d < 1.f );
+		REQUIRE( d > 0.f );
+
+		REQUIRE( !buffer.visible( box_( { 0.f, 0.f, -20.f }, 1.f ) ) );  // behind
+		REQUIRE( buffer.visible( box_( { 0.f, 0.f, -5.f }, 1.f ) ) );    // in front
+		REQUIRE( buffer.visible( box_( { 0.f, 0.f, -11.f }, 2.f ) ) );   // intersects the wall
+		REQUIRE( buffer.visible( box_( { 14.f, 0.f, -20.f }, 2.f ) ) );  // off to the side
+		REQUIRE( buffer.visible( box_( { 0.f, 0.f, 5.f }, 1.f ) ) );     // behind the camera
+
+		REQUIRE( buffer.stats().tested == 5 );
+		REQUIRE( buffer.stats().occluded == 1 );
+		REQUIRE( buffer.stats().cull_rate() == Catch::Approx( 0.2f ) );
+	}
+
+	SECTION("Winding does not matter")
+	{
+		auto wall = wall_( 5.f, -10.f );
+		std::swap( wall[1], wall[2] );
+		std::swap( wall[4], wall[5] );
+
+		buffer.begin( camera_( { 0.f, 0.f, 0.f } ) );
+		buffer.add_occluder( wall.data(), wall.size(), kIdentity44f );
+		buffer.rasterize( pool );
+
+		REQUIRE( !buffer.visible( box_( { 0.f, 0.f, -20.f }, 1.f ) ) );
+	}
+
+	SECTION("Occluder transform")
+	{
+		auto const wall = wall_( 5.f, 0.f );
+
+		buffer.begin( camera_( { 0.f, 0.f, 0.f } ) );
+		buffer.add_occluder( wall.data(), wall.size(), make_translation( { 0.f, 0.f, -10.f } ) );
+		buffer.rasterize( pool );
+
+		REQUIRE( !buffer.visible( box_( { 0.f, 0.f, -20.f }, 1.f ) ) );
+		REQUIRE( buffer.visible( box_( { 0.f, 0.f, -5.f }, 1.f ) ) );
+	}
+
+	SECTION("Near plane clipping")
+	{
+		// Ground plane under the camera, extending far behind it
+		std::vector<Vec3f> const ground{
+			{ -100.f, 0.f, 100.f }, { 100.f, 0.f, 100.f }, { 100.f, 0.f, -100.f },
+			{ -100.f, 0.f, 100.f }, { 100.f, 0.f, -100.f }, { -100.f, 0.f, -100.f }
+		};
+
+		buffer.begin( camera_( { 0.f, 1.f, 0.f } ) );
+		buffer.add_occluder( ground.data(), ground.size(), kIdentity44f );
+		buffer.rasterize( pool );
+
+		// One triangle keeps a single vertex in front of the near plane, the
+		// other two, and becomes a quad.
+		REQUIRE( buffer.stats().occluderTriangles == 3 );
+
+		// Lower half is ground; upper half is sky
+		REQUIRE( buffer.depth( buffer.width()/2, 0 ) < 1.f );
+		REQUIRE( buffer.depth( buffer.width()/2, buffer.height()-1 ) == 1.f );
+
+		REQUIRE( !buffer.visible( box_( { 0.f, -3.f, -20.f }, 1.f ) ) );
+		REQUIRE( buffer.visible( box_( { 0.f, 2.f, -20.f }, 1.f ) ) );
+	}
+}
+
+TEST_CASE("Occluder simplification", "[occlusion]")
+{
+	SECTION("A fine grid keeps its shape with far fewer triangles")
+	{
+		auto const fine = grid_( 64, 5.f, -10.f );
+		auto const coarse = simplify_occluder( fine.data(), fine.size(), 8 );
+
+		REQUIRE( coarse.size() % 3 == 0 );
+		REQUIRE( coarse.size() > 0 );
+		REQUIRE( coarse.size() * 16 < fine.size() );
+
+		for( auto const& p : coarse )
+		{
+			REQUIRE( p.z == -10.f );
+			REQUIRE( std::abs( p.x ) <= 5.f );
+			REQUIRE( std::abs( p.y ) <= 5.f );
+		}
+
+		// Both hide the same things
+		WorkerPool pool( 2 );
+		OcclusionBuffer a, b;
+		auto const camera = camera_( { 0.f, 0.f, 0.f } );
+
+		a.begin( camera );
+		a.add_occluder( fine.data(), fine.size(), kIdentity44f );
+		a.rasterize( pool );
+
+		b.begin( camera );
+		b.add_occluder( coarse.data(), coarse.size(), kIdentity44f );
+		b.rasterize( pool );
+
+		REQUIRE( !a.visible( box_( { 0.f, 0.f, -20.f }, 1.f ) ) );
+		REQUIRE( !b.visible( box_( { 0.f, 0.f, -20.f }, 1.f ) ) );
+		REQUIRE( a.visible( box_( { 0.f, 0.f, -5.f }, 1.f ) ) );
+		REQUIRE( b.visible( box_( { 0.f, 0.f, -5.f }, 1.f ) ) );
+	}
+
+	SECTION("Collapsed and duplicate triangles are dropped")
+	{
+		// One large triangle, twice, plus one that fits in a single cell
+		std::vector<Vec3f> const positions{
+			{ 0.f, 0.f, 0.f }, { 8.f, 0.f, 0.f }, { 0.f, 8.f, 0.f },
+			{ 8.f, 0.f, 0.f }, { 0.f, 8.f, 0.f }, { 0.f, 0.f, 0.f },
+			{ 4.f, 4.f, 0.f }, { 4.1f, 4.f, 0.f }, { 4.f, 4.1f, 0.f }
+		};
+
+		auto const simplified = simplify_occluder( positions.data(), positions.size(), 4 );
+		REQUIRE( simplified.size() == 3 );
+	}
+
+	SECTION("Nothing in, nothing out")
+	{
+		REQUIRE( simplify_occluder( nullptr, 0, 8 ).empty() );
+	}
+}
+
+TEST_CASE("Occlusion buffer threading", "[occlusion]")
+{
+	auto const positions = random_triangles_( 3000, 5 );
+	auto const camera = camera_( { 0.f, 0.f, 0.f } );
+
+	WorkerPool serial( 1 ), parallel( 4 );
+	OcclusionBuffer a( 200, 100 ), b( 200, 100 );
+
+	REQUIRE( a.width() == 200 );
+	REQUIRE( a.height() == 104 );
+
+	a.begin( camera );
+	a.add_occluder( positions.data(), positions.size(), kIdentity44f );
+	a.rasterize( serial );
+
+	// Same triangles, split over several occluders
+	b.begin( camera );
+	b.add_occluder( positions.data(), 3 * 1000, kIdentity44f );
+	b.add_occluder( positions.data() + 3 * 1000, 3 * 1500, kIdentity44f );
+	b.add_occluder( positions.data() + 3 * 2500, 3 * 500, kIdentity44f );
+	b.rasterize( parallel );
+
+	REQUIRE( a.stats().occluderTriangles == b.stats().occluderTriangles );
+
+	std::size_t mismatches = 0, covered = 0;
+	for( std::size_t y = 0; y < a.height(); ++y )
+	{
+		for( std::size_t x = 0; x < a.width(); ++x )
+		{
+			mismatches += a.depth( x, y ) != b.depth( x, y ) ? 1 : 0;
+			covered += a.depth( x, y ) < 1.f ? 1 : 0;
+		}
+	}
+
+	REQUIRE( mismatches == 0 );
+	REQUIRE( covered > 0 );
+}
+
+TEST_CASE("Occlusion buffer throughput", "[.][benchmark][occlusion]")
+{
+	auto const positions = random_triangles_( 10000, 1 );
+	auto const camera = camera_( { 0.f, 0.f, 0.f } );
+
+	WorkerPool serial( 1 ), parallel;
+	OcclusionBuffer buffer;
+
+	BENCHMARK_ADVANCED("rasterize 10k triangles, 1 thread")(Catch::Benchmark::Chronometer meter)
+	{
+		meter.measure( [&] {
+			buffer.begin( camera );
+			buffer.add_occluder( positions.data(), positions.size(), kIdentity44f );
+			buffer.rasterize( serial );
+			return buffer.depth( 0, 0 );
+		} );
+	};
+
+	BENCHMARK_ADVANCED("rasterize 10k triangles, all threads")(Catch::Benchmark::Chronometer meter)
+	{
+		meter.measure( [&] {
+			buffer.begin( camera );
+			buffer.add_occluder( positions.data(), positions.size(), kIdentity44f );
+			buffer.rasterize( parallel );
+			return buffer.depth( 0, 0 );
+		} );
+	};
+
+	auto const boxes = random_triangles_( 1000, 2 );
+	BENCHMARK_ADVANCED("test 1k boxes")(Catch::Benchmark::Chronometer meter)
+	{
+		meter.measure( [&] {
+			std::size_t visible = 0;
+			for( std::size_t i = 0; i < boxes.size(); i += 3 )
+				visible += buffer.visible( box_( boxes[i], 1.f ) ) ? 1 : 0;
+			return visible;
+		} );
+	};
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+
+#include "../main/options.hpp"
+
+namespace
+{
+	RunOptions parse_( std::vector<char const*> aArgs )
+	{
+		aArgs.insert( aArgs.begin(), "main" );
+		return parse_run_options( int(aArgs.size()), aArgs.data() );
+	}
+}
+
+TEST_CASE("Run options", "[options]")
+{
+	SECTION("Defaults open a window until it is closed")
+	{
+		auto const opts = parse_( {} );
+
+		REQUIRE( !opts.headless );
+		REQUIRE( !opts.help );
+		REQUIRE( opts.width == 1280 );
+		REQUIRE( opts.height == 720 );
+		REQUIRE( opts.frames == 0 );
+		REQUIRE( opts.dumpDirectory.empty() );
+		REQUIRE( opts.tracePath.empty() );
+		REQUIRE( opts.shaderCacheDirectory == "shader-cache" );
+		REQUIRE( opts.hud );
+		REQUIRE( opts.watchShaders );
+	}
+
+	SECTION("Headless runs are finite")
+	{
+		auto const opts = parse_( { "--headless" } );
+
+		REQUIRE( opts.headless );
+		REQUIRE( opts.frames == kDefaultHeadlessFrames );
+		REQUIRE_THROWS( parse_( { "--headless", "--frames", "0" } ) );
+	}
+
+	SECTION("The overlay is only shown in interactive runs by default")
+	{
+		REQUIRE( !parse_( { "--headless" } ).hud );
+		REQUIRE( !parse_( { "--benchmark" } ).hud );
+		REQUIRE( parse_( { "--headless", "--hud" } ).hud );
+		REQUIRE( !parse_( { "--no-hud" } ).hud );
+	}
+
+	SECTION("Shaders are only watched in interactive runs by default")
+	{
+		REQUIRE( !parse_( { "--headless" } ).watchShaders );
+		REQUIRE( !parse_( { "--benchmark" } ).watchShaders );
+		REQUIRE( parse_( { "--headless", "--watch-shaders" } ).watchShaders );
+		REQUIRE( !parse_( { "--no-watch-shaders" } ).watchShaders );
+	}
+
+	SECTION("Values")
+	{
+		auto const opts = parse_( { "--headless", "--size", "640x360", "--frames", "42", "--dump", "out", "--dump-every", "10", "--trace", "t.json", "--shader-cache", "cache" } );
+
+		REQUIRE( opts.width == 640 );
+		REQUIRE( opts.height == 360 );
+		REQUIRE( opts.frames == 42 );
+		REQUIRE( opts.dumpDirectory == "out" );
+		REQUIRE( opts.dumpEvery == 10 );
+		REQUIRE( opts.tracePath == "t.json" );
+		REQUIRE( opts.shaderCacheDirectory == "cache" );
+		REQUIRE( parse_( { "--no-shader-cache" } ).shaderCacheDirectory.empty() );
+	}
+
+	SECTION("Frame pacing is V-Sync in a window and uncapped otherwise")
+	{
+		REQUIRE( parse_( {} ).pacing == FramePacing::vsync );
+		REQUIRE( parse_( { "--headless" } ).pacing == FramePacing::uncapped );
+		REQUIRE( parse_( { "--benchmark" } ).pacing == FramePacing::uncapped );
+		REQUIRE( parse_( { "--benchmark", "--pacing", "latency" } ).pacing == FramePacing::lowLatency );
+
+		auto const fixed = parse_( { "--fps", "144" } );
+		REQUIRE( fixed.pacing == FramePacing::fixed );
+		REQUIRE( fixed.targetFps == 144 );
+		REQUIRE( parse_( { "--pacing", "fixed" } ).targetFps == kDefaultTargetFps );
+	}
+
+	SECTION("Benchmarks measure a fixed number of frames after a warm-up")
+	{
+		auto const opts = parse_( { "--benchmark" } );
+
+		REQUIRE( opts.benchmark );
+		REQUIRE( opts.frames == kDefaultBenchmarkFrames );
+		REQUIRE( opts.warmupFrames == kDefaultBenchmarkWarmup );
+
+		auto const custom = parse_( { "--benchmark", "--headless", "--frames", "100", "--warmup", "0", "--script", "a.txt", "--report", "b.json" } );
+		REQUIRE( custom.frames == 100 );
+		REQUIRE( custom.warmupFrames == 0 );
+		REQUIRE( custom.scriptPath == "a.txt" );
+		REQUIRE( custom.reportPath == "b.json" );
+
+		REQUIRE_THROWS( parse_( { "--report", "b.json" } ) ); // needs --benchmark
+		REQUIRE_THROWS( parse_( { "--benchmark", "--frames", "0" } ) );
+	}
+
+	SECTION("Culling is only validated in headless runs")
+	{
+		REQUIRE( !parse_( {} ).validateCulling );
+		REQUIRE( !parse_( { "--headless" } ).validateCulling );
+		REQUIRE( parse_( { "--headless", "--validate-culling" } ).validateCulling );
+		REQUIRE_THROWS( parse_( { "--validate-culling" } ) );
+	}
+
+	SECTION("Invalid arguments are rejected")
+	{
+		REQUIRE_THROWS( parse_( { "--fullscreen" } ) );
+		REQUIRE_THROWS( parse_( { "--size" } ) );
+		REQUIRE_THROWS( parse_( { "--size", "640" } ) );
+		REQUIRE_THROWS( parse_( { "--size", "640x0" } ) );
+		REQUIRE_THROWS( parse_( { "--size", "640x360x2" } ) );
+		REQUIRE_THROWS( parse_( { "--frames", "-1" } ) );
+		REQUIRE_THROWS( parse_( { "--frames", "ten" } ) );
+		REQUIRE_THROWS( parse_( { "--headless", "--dump-every", "0" } ) );
+		REQUIRE_THROWS( parse_( { "--dump", "out" } ) ); // needs --headless
+		REQUIRE_THROWS( parse_( { "--trace", "" } ) );
+		REQUIRE_THROWS( parse_( { "--shader-cache", "" } ) );
+		REQUIRE_THROWS( parse_( { "--pacing", "adaptive" } ) );
+		REQUIRE_THROWS( parse_( { "--fps", "0" } ) );
+		REQUIRE_THROWS( parse_( { "--pacing", "vsync", "--fps", "30" } ) );
+	}
+}
@@ -0,0 +1,202 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "../main/particles.hpp"
+#include "../main/worker_pool.hpp"
+
+TEST_CASE("Particle pool spawn and expiry", "[particles]")
+{
+	static constexpr float kEps_ = 1e-6f;
+
+	using namespace Catch::Matchers;
+
+	SECTION("Spawn appends and update integrates")
+	{
+		ParticlePool pool( 4 );
+		pool.spawn( Vec3f{ 1.f, 2.f, 3.f }, Vec3f{ 1.f, 0.f, -2.f }, 1.f );
+
+		REQUIRE( pool.size() == 1 );
+
+		pool.update( 0.25f );
+
+		REQUIRE( pool.size() == 1 );
+		REQUIRE_THAT( pool.position(0).x, WithinAbs( 1.25f, kEps_ ) );
+		REQUIRE_THAT( pool.position(0).y, WithinAbs( 2.f, kEps_ ) );
+		REQUIRE_THAT( pool.position(0).z, WithinAbs( 2.5f, kEps_ ) );
+		REQUIRE_THAT( pool.lifespan(0), WithinAbs( 0.75f, kEps_ ) );
+	}
+
+	SECTION("Expired particles are swap-removed")
+	{
+		ParticlePool pool( 8 );
+		pool.spawn( Vec3f{ 0.f, 0.f, 0.f }, Vec3f{}, 0.1f ); // dies
+		pool.spawn( Vec3f{ 1.f, 0.f, 0.f }, Vec3f{}, 1.0f );
+		pool.spawn( Vec3f{ 2.f, 0.f, 0.f }, Vec3f{}, 0.1f ); // dies
+		pool.spawn( Vec3f{ 3.f, 0.f, 0.f }, Vec3f{}, 1.0f );
+
+		pool.update( 0.5f );
+
+		REQUIRE( pool.size() == 2 );
+
+		std::vector<float> pos( 3 * pool.size() );
+		pool.copy_positions( pos.data() );
+
+		// Order is unspecified; the survivors are x=1 and x=3.
+		REQUIRE_THAT( pos[0] + pos[3], WithinAbs( 4.f, kEps_ ) );
+		REQUIRE_THAT( pos[0] * pos[3], WithinAbs( 3.f, kEps_ ) );
+	}
+
+	SECTION("Full pool recycles slots instead of growing")
+	{
+		ParticlePool pool( 3 );
+		for( int i = 0; i < 5; ++i )
+			pool.spawn( Vec3f{ float(i), 0.f, 0.f }, Vec3f{}, 1.f );
+
+		REQUIRE( pool.size() == 3 );
+		REQUIRE( pool.capacity() == 3 );
+
+		// Slots 0 and 1 were overwritten by particles 3 and 4.
+		REQUIRE_THAT( pool.position(0).x, WithinAbs( 3.f, kEps_ ) );
+		REQUIRE_THAT( pool.position(1).x, WithinAbs( 4.f, kEps_ ) );
+		REQUIRE_THAT( pool.position(2).x, WithinAbs( 2.f, kEps_ ) );
+	}
+
+	SECTION("Zero-capacity pool ignores spawns")
+	{
+		ParticlePool pool;
+		pool.spawn( Vec3f{}, Vec3f{}, 1.f );
+		pool.update( 1.f );
+		REQUIRE( pool.empty() );
+	}
+}
+
+TEST_CASE("Parallel particle update matches serial update", "[particles]")
+{
+	static constexpr std::size_t kParticles_ = 200000;
+	static constexpr float kEps_ = 1e-5f;
+
+	using namespace Catch::Matchers;
+
+	ParticlePool serial( kParticles_ ), parallel( kParticles_ );
+	for( std::size_t i = 0; i < kParticles_; ++i )
+	{
+		// Every third particle expires in the first step
+		float const life = (i % 3 == 0) ? 0.05f : 1.f;
+		Vec3f const pos{ float(i), 0.f, 0.f };
+		Vec3f const vel{ 0.f, 1.f, -1.f };
+		serial.spawn( pos, vel, life );
+		parallel.spawn( pos, vel, life );
+	}
+
+	WorkerPool workers( 4 );
+
+	serial.update( 0.1f );
+	parallel.update( 0.1f, workers );
+
+	REQUIRE( parallel.size() == serial.size() );
+	REQUIRE( parallel.size() == kParticles_ - (kParticles_+2)/3 );
+
+	// Both paths must keep the same survivors (order differs). Survivors are
+	// the particles with i % 3 != 0.
+	std::vector<float> serialX( serial.size() ), parallelX( parallel.size() );
+	for( std::size_t i = 0; i < parallel.size(); ++i )
+	{
+		serialX[i] = serial.position(i).x;
+		parallelX[i] = parallel.position(i).x;
+	}
+	std::sort( serialX.begin(), serialX.end() );
+	std::sort( parallelX.begin(), parallelX.end() );
+
+	REQUIRE( parallelX == serialX );
+
+	std::size_t wrong = 0;
+	for( auto x : parallelX )
+		wrong += (std::size_t(x) % 3 == 0) ? 1 : 0;
+	REQUIRE( wrong == 0 );
+
+	REQUIRE_THAT( parallel.position(0).y, WithinAbs( 0.1f, kEps_ ) );
+	REQUIRE_THAT( parallel.lifespan(0), WithinAbs( 0.9f, kEps_ ) );
+
+	// A step without deaths leaves the particles in place
+	auto const first = parallel.position(0).x;
+	parallel.update( 0.1f, workers );
+	REQUIRE( parallel.size() == serial.size() );
+	REQUIRE( parallel.position(0).x == first );
+}
+
+// Benchmarks are hidden from the default run. Use
+//   vmlib-test "[benchmark]"
+// to run them (preferably with a release build).
+TEST_CASE("Particle pool update throughput", "[.][benchmark][particles]")
+{
+	static constexpr std::size_t kParticles_ = 1000000;
+	static constexpr float kDt_ = 1.f / 60.f;
+
+	ParticlePool pool( kParticles_ );
+
+	auto const refill = [&] (float aLifespanBase) {
+		pool.clear();
+		for( std::size_t i = 0; i < kParticles_; ++i )
+		{
+			float const f = float(i % 1024) / 1024.f;
+			pool.spawn( Vec3f{ f, 0.f, -f }, Vec3f{ 0.f, 1.f, f }, aLifespanBase + f );
+		}
+	};
+
+	BENCHMARK_ADVANCED("update 1M, no expiry")(Catch::Benchmark::Chronometer meter)
+	{
+		refill( 1e6f );
+		meter.measure( [&] { pool.update( kDt_ ); } );
+	};
+
+	BENCHMARK_ADVANCED("update 1M, ~2% expiry per step")(Catch::Benchmark::Chronometer meter)
+	{
+		// Lifespans spread over [0.5, 1.5) s: at 60 Hz, around 1/60th of the
+		// particles reach their end of life every step once the first one
+		// expires.
+		refill( 0.5f );
+		for( int i = 0; i < 30; ++i )
+			pool.update( kDt_ );
+		meter.measure( [&] { pool.update( kDt_ ); } );
+	};
+
+	std::vector<float> positions( 3 * kParticles_ );
+	BENCHMARK_ADVANCED("copy_positions 1M")(Catch::Benchmark::Chronometer meter)
+	{
+		refill( 1e6f );
+		meter.measure( [&] { pool.copy_positions( positions.data() ); } );
+	};
+}
+
+TEST_CASE("Parallel particle update scaling", "[.][benchmark][particles]")
+{
+	static constexpr std::size_t kParticles_ = 1000000;
+	static constexpr float kDt_ = 1.f / 60.f;
+
+	ParticlePool pool( kParticles_ );
+
+	auto const refill = [&] {
+		pool.clear();
+		for( std::size_t i = 0; i < kParticles_; ++i )
+		{
+			float const f = float(i % 1024) / 1024.f;
+			pool.spawn( Vec3f{ f, 0.f, -f }, Vec3f{ 0.f, 1.f, f }, 0.5f + f );
+		}
+		for( int i = 0; i < 30; ++i )
+			pool.update( kDt_ );
+	};
+
+	for( std::size_t threads : { 1u, 2u, 4u, 8u, 16u } )
+	{
+		WorkerPool workers( threads );
+
+		BENCHMARK_ADVANCED("update 1M with churn, threads=" + std::to_string( threads ))(Catch::Benchmark::Chronometer meter)
+		{
+			refill();
+			meter.measure( [&] { pool.update( kDt_, workers ); } );
+		};
+	}
+}
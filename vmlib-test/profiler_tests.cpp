@@ -0,0 +1,101 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <thread>
+
+#include <cstdio>
+
+#include "../support/profiler.hpp"
+
+namespace
+{
+	std::string read_file_( char const* aPath )
+	{
+		std::string ret;
+		if( std::FILE* f = std::fopen( aPath, "rb" ) )
+		{
+			char buffer[1024];
+			while( auto const n = std::fread( buffer, 1, sizeof(buffer), f ) )
+				ret.append( buffer, n );
+			std::fclose( f );
+		}
+		return ret;
+	}
+
+	std::size_t count_( std::string const& aText, char const* aNeedle )
+	{
+		std::size_t ret = 0;
+		for( auto pos = aText.find( aNeedle ); std::string::npos != pos; pos = aText.find( aNeedle, pos+1 ) )
+			++ret;
+		return ret;
+	}
+}
+
+TEST_CASE("Scope profiler", "[profiler]")
+{
+	SECTION("Nothing is recorded outside of a capture")
+	{
+		profiler_start_capture();
+		profiler_stop_capture();
+
+		{
+			ProfileScope scope( "ignored" );
+		}
+		profiler_record_gpu( "ignored", 1, 2 );
+
+		REQUIRE( profiler_stats().events == 0 );
+	}
+
+	SECTION("Scopes of several threads end up in one trace")
+	{
+		profiler_start_capture();
+
+		{
+			ProfileScope outer( "outer" );
+			{
+				ProfileScope inner( "inner" );
+			}
+		}
+
+		std::thread other( [] {
+			profiler_set_thread_name( "other \"thread\"" );
+			ProfileScope scope( "elsewhere" );
+		} );
+		other.join();
+
+		auto const now = profiler_now();
+		profiler_record_gpu( "gpu work", now, now + 1000 );
+
+		profiler_stop_capture();
+
+		auto const stats = profiler_stats();
+		REQUIRE( stats.events == 4 );
+		REQUIRE( stats.threads == 3 ); // this one, the other one, GPU
+		REQUIRE( stats.dropped == 0 );
+
+		char const* path = "profiler_test_trace.json";
+		profiler_write_chrome_trace( path );
+
+		auto const json = read_file_( path );
+		std::remove( path );
+
+		REQUIRE( count_( json, "\"ph\":\"X\"" ) == 4 );
+		REQUIRE( count_( json, "\"cat\":\"gpu\"" ) == 1 );
+		REQUIRE( json.find( "{\"name\":\"inner\"" ) != std::string::npos );
+		REQUIRE( json.find( "\"args\":{\"name\":\"other \\\"thread\\\"\"}" ) != std::string::npos );
+		REQUIRE( json.find( "\"args\":{\"name\":\"GPU\"}" ) != std::string::npos );
+		REQUIRE( json.find( "\"dur\":1.000}" ) != std::string::npos );
+	}
+
+	SECTION("A new capture starts empty")
+	{
+		profiler_start_capture();
+		{
+			ProfileScope scope( "first" );
+		}
+		profiler_start_capture();
+		profiler_stop_capture();
+
+		REQUIRE( profiler_stats().events == 0 );
+	}
+}
@@ -0,0 +1,185 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include "../support/program_cache.hpp"
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	struct TempDir_
+	{
+		TempDir_()
+			: path( fs::temp_directory_path() / ("program_cache_tests_" + std::to_string( std::hash<std::thread::id>()( std::this_thread::get_id() ) )) )
+		{
+			fs::remove_all( path );
+			fs::create_directories( path );
+		}
+		~TempDir_()
+		{
+			std::error_code ec;
+			fs::remove_all( path, ec );
+		}
+
+		fs::path path;
+	};
+
+	// GL_VERTEX_SHADER, GL_FRAGMENT_SHADER
+	constexpr std::uint32_t kVertex_ = 0x8B31, kFragment_ = 0x8B30;
+
+	std::uint64_t key_( std::string_view aRenderer, std::string_view aFragment = "void main() {}\n" )
+	{
+		return program_binary_key(
+			{ "Vendor", aRenderer, "4.3 Driver 1.0" },
+			{ { kVertex_, "void main() { gl_Position = vec4(0.0); }\n" }, { kFragment_, aFragment } }
+		);
+	}
+
+	ProgramBinary binary_()
+	{
+		ProgramBinary ret;
+		ret.format = 0x1234;
+		ret.compileMilliseconds = 12.5;
+		for( int i = 0; i < 1000; ++i )
+			ret.data.emplace_back( char(i * 7) );
+		return ret;
+	}
+}
+
+TEST_CASE("Program binary keys", "[program-cache]")
+{
+	auto const key = key_( "Renderer A" );
+	REQUIRE( key == key_( "Renderer A" ) );
+
+	SECTION("Driver strings")
+	{
+		REQUIRE( key != key_( "Renderer B" ) );
+		REQUIRE( key != program_binary_key( { "Vendor", "Renderer A" }, { { kVertex_, "" } } ) );
+
+		// Strings are not simply concatenated
+		REQUIRE( program_binary_key( { "ab", "c" }, {} ) != program_binary_key( { "a", "bc" }, {} ) );
+	}
+
+	SECTION("Shaders")
+	{
+		REQUIRE( key != key_( "Renderer A", "void main() { }\n" ) );
+
+		// Types matter, and so does the order
+		REQUIRE( program_binary_key( {}, { { kVertex_, "x" } } ) != program_binary_key( {}, { { kFragment_, "x" } } ) );
+		REQUIRE( program_binary_key( {}, { { kVertex_, "a" }, { kFragment_, "b" } } ) != program_binary_key( {}, { { kFragment_, "b" }, { kVertex_, "a" } } ) );
+		REQUIRE( program_binary_key( {}, { { kVertex_, "ab" }, { kVertex_, "" } } ) != program_binary_key( {}, { { kVertex_, "a" }, { kVertex_, "b" } } ) );
+	}
+}
+
+TEST_CASE("Program binary files", "[program-cache]")
+{
+	TempDir_ dir;
+
+	auto const key = key_( "Renderer A" );
+	auto const path = program_binary_path( dir.path.string(), key );
+	auto const original = binary_();
+
+	REQUIRE( write_program_binary( path, key, original ) );
+
+	SECTION("Round trip")
+	{
+		ProgramBinary binary;
+		REQUIRE( ProgramBinaryStatus::loaded == read_program_binary( path, key, binary ) );
+		REQUIRE( binary.format == original.format );
+		REQUIRE( binary.data == original.data );
+		REQUIRE( binary.compileMilliseconds == original.compileMilliseconds );
+	}
+
+	SECTION("Missing file")
+	{
+		ProgramBinary binary;
+		REQUIRE( ProgramBinaryStatus::missing == read_program_binary( program_binary_path( dir.path.string(), key + 1 ), key + 1, binary ) );
+	}
+
+	SECTION("Truncated file")
+	{
+		auto const size = fs::file_size( path );
+
+		// Within the binary, and within the header
+		for( auto const keep : { size - 1, size / 2, std::uintmax_t(16), std::uintmax_t(0) } )
+		{
+			fs::resize_file( path, keep );
+
+			ProgramBinary binary;
+			REQUIRE( ProgramBinaryStatus::invalid == read_program_binary( path, key, binary ) );
+		}
+	}
+
+	SECTION("Different driver")
+	{
+		// A driver update changes the key; a file copied to the new key's
+		// name must still be refused
+		auto const newKey = key_( "Renderer B" );
+		auto const newPath = program_binary_path( dir.path.string(), newKey );
+		REQUIRE( newPath != path );
+
+		ProgramBinary binary;
+		REQUIRE( ProgramBinaryStatus::missing == read_program_binary( newPath, newKey, binary ) );
+
+		fs::copy_file( path, newPath );
+		REQUIRE( ProgramBinaryStatus::invalid == read_program_binary( newPath, newKey, binary ) );
+	}
+
+	SECTION("Different key")
+	{
+		ProgramBinary binary;
+		REQUIRE( ProgramBinaryStatus::invalid == read_program_binary( path, key_( "Renderer A", "void main() { discard; }\n" ), binary ) );
+		REQUIRE( ProgramBinaryStatus::invalid == read_program_binary( path, key ^ 1, binary ) );
+	}
+
+	SECTION("Not a cache file")
+	{
+		std::ofstream( path, std::ios::binary | std::ios::trunc ) << std::string( 4096, 'x' );
+
+		ProgramBinary binary;
+		REQUIRE( ProgramBinaryStatus::invalid == read_program_binary( path, key, binary ) );
+	}
+
+	SECTION("Rewriting")
+	{
+		// Concurrent writers of the same entry. Each rename replaces a
+		// complete file, and no temporary files are left behind.
+		auto other = original;
+		other.data.assign( 500, 'z' );
+
+		std::atomic<int> failed{ 0 };
+		std::vector<std::thread> writers;
+		for( int i = 0; i < 4; ++i )
+		{
+			writers.emplace_back( [&] {
+				for( int j = 0; j < 25; ++j )
+				{
+					if( !write_program_binary( path, key, (j % 2) ? other : original ) )
+						++failed;
+				}
+			} );
+		}
+		for( auto& writer : writers )
+			writer.join();
+
+		REQUIRE( 0 == failed );
+
+		ProgramBinary binary;
+		REQUIRE( ProgramBinaryStatus::loaded == read_program_binary( path, key, binary ) );
+		REQUIRE( (binary.data == original.data || binary.data == other.data) );
+
+		std::size_t files = 0;
+		for( auto const& entry : fs::directory_iterator( dir.path ) )
+		{
+			REQUIRE( entry.path().extension() == ".bin" );
+			++files;
+		}
+		REQUIRE( files == 1 );
+	}
+}
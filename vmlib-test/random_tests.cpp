@@ -0,0 +1,164 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <random>
+#include <vector>
+
+#include <cmath>
+
+#include "../vmlib/random.hpp"
+
+TEST_CASE("Xoshiro256+ streams", "[random]")
+{
+	SECTION("Same seed and stream reproduce the sequence")
+	{
+		Xoshiro256Plus a( 42 ), b( 42 ), c( 42, 1 ), d( 43 );
+
+		bool same = true, differsStream = false, differsSeed = false;
+		for( int i = 0; i < 100; ++i )
+		{
+			auto const x = a.next();
+			same = same && (x == b.next());
+			differsStream = differsStream || (x != c.next());
+			differsSeed = differsSeed || (x != d.next());
+		}
+
+		REQUIRE( same );
+		REQUIRE( differsStream );
+		REQUIRE( differsSeed );
+	}
+
+	SECTION("Packet lane 0 matches the scalar generator")
+	{
+		Xoshiro256Plus scalar( 7, 3 );
+		Xoshiro256PlusPacket packet( 7, 3 );
+
+		// Lane 1 is the scalar sequence jumped ahead once
+		Xoshiro256Plus jumped( 7, 3 );
+		jumped.jump();
+
+		std::size_t mismatches = 0;
+		for( int i = 0; i < 100; ++i )
+		{
+			std::uint64_t lanes[kRandomLanes];
+			packet.next( lanes );
+			mismatches += (lanes[0] != scalar.next()) ? 1 : 0;
+			mismatches += (lanes[1] != jumped.next()) ? 1 : 0;
+		}
+
+		REQUIRE( mismatches == 0 );
+	}
+}
+
+TEST_CASE("Batch random samplers", "[random]")
+{
+	static constexpr std::size_t kCount_ = 10001; // not a multiple of the lanes
+
+	using namespace Catch::Matchers;
+
+	Xoshiro256PlusPacket rng( 1234 );
+	std::vector<float> x( kCount_ ), y( kCount_ ), z( kCount_ );
+
+	SECTION("uniform_float stays in range")
+	{
+		uniform_float( rng, x.data(), kCount_, -2.f, 3.f );
+
+		std::size_t outside = 0;
+		double sum = 0.0;
+		for( auto v : x )
+		{
+			outside += (v < -2.f || v >= 3.f) ? 1 : 0;
+			sum += v;
+		}
+
+		REQUIRE( outside == 0 );
+		REQUIRE_THAT( sum / kCount_, WithinAbs( 0.5, 0.05 ) );
+	}
+
+	SECTION("unit_sphere produces unit vectors without bias")
+	{
+		unit_sphere( rng, x.data(), y.data(), z.data(), kCount_ );
+
+		std::size_t notUnit = 0;
+		Vec3f mean{ 0.f, 0.f, 0.f };
+		for( std::size_t i = 0; i < kCount_; ++i )
+		{
+			Vec3f const v{ x[i], y[i], z[i] };
+			notUnit += std::abs( length( v ) - 1.f ) > 1e-5f ? 1 : 0;
+			mean += v;
+		}
+		mean /= float(kCount_);
+
+		REQUIRE( notUnit == 0 );
+		REQUIRE( length( mean ) < 0.05f );
+	}
+
+	SECTION("cone_direction stays within the cone")
+	{
+		Vec3f const axis = normalize( Vec3f{ 1.f, -2.f, 0.5f } );
+		float const halfAngle = 0.4f;
+
+		cone_direction( rng, axis * 3.f, halfAngle, x.data(), y.data(), z.data(), kCount_ );
+
+		std::size_t notUnit = 0, outside = 0;
+		Vec3f mean{ 0.f, 0.f, 0.f };
+		for( std::size_t i = 0; i < kCount_; ++i )
+		{
+			Vec3f const v{ x[i], y[i], z[i] };
+			notUnit += std::abs( length( v ) - 1.f ) > 1e-5f ? 1 : 0;
+			outside += dot( v, axis ) < std::cos( halfAngle ) - 1e-5f ? 1 : 0;
+			mean += v;
+		}
+
+		REQUIRE( notUnit == 0 );
+		REQUIRE( outside == 0 );
+		REQUIRE( dot( normalize( mean ), axis ) > 0.999f );
+	}
+
+	SECTION("Same seed gives the same batch")
+	{
+		Xoshiro256PlusPacket other( 1234 );
+		std::vector<float> x2( kCount_ ), y2( kCount_ ), z2( kCount_ );
+
+		cone_direction( rng, Vec3f{ 0.f, 0.f, -1.f }, 1.f, x.data(), y.data(), z.data(), kCount_ );
+		cone_direction( other, Vec3f{ 0.f, 0.f, -1.f }, 1.f, x2.data(), y2.data(), z2.data(), kCount_ );
+
+		REQUIRE( x == x2 );
+		REQUIRE( y == y2 );
+		REQUIRE( z == z2 );
+	}
+}
+
+TEST_CASE("Batch random sampler throughput", "[.][benchmark][random]")
+{
+	static constexpr std::size_t kCount_ = 100000;
+
+	std::vector<float> x( kCount_ ), y( kCount_ ), z( kCount_ );
+
+	BENCHMARK_ADVANCED("cone_direction 100k")(Catch::Benchmark::Chronometer meter)
+	{
+		Xoshiro256PlusPacket rng( 1 );
+		meter.measure( [&] {
+			cone_direction( rng, Vec3f{ 0.f, 1.f, 0.f }, 0.5f, x.data(), y.data(), z.data(), kCount_ );
+			return x[0];
+		} );
+	};
+
+	// Reference: one sample at a time through std::mt19937 and
+	// std::uniform_real_distribution<double>, as the emitter used to do.
+	BENCHMARK_ADVANCED("mt19937 cone 100k (reference)")(Catch::Benchmark::Chronometer meter)
+	{
+		std::mt19937 gen( 1 );
+		std::uniform_real_distribution<> dis( 0, 1 );
+		meter.measure( [&] {
+			for( std::size_t i = 0; i < kCount_; ++i )
+			{
+				float const theta = 2.f * 3.1415926f * float(dis( gen ));
+				float const phi = std::acos( 1.f - float(dis( gen )) * (1.f - std::cos( 0.5f )) );
+				x[i] = std::sin( phi ) * std::cos( theta );
+				y[i] = std::sin( phi ) * std::sin( theta );
+				z[i] = std::cos( phi );
+			}
+			return x[0];
+		} );
+	};
+}
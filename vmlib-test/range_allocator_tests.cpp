@@ -0,0 +1,99 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include "../vmlib/random.hpp"
+
+#include "../main/range_allocator.hpp"
+
+TEST_CASE("Range allocator", "[geometry_heap]")
+{
+	RangeAllocator alloc( 100 );
+
+	SECTION("Allocates front to back until full")
+	{
+		REQUIRE( alloc.allocate( 40 ) == 0 );
+		REQUIRE( alloc.allocate( 40 ) == 40 );
+		REQUIRE( alloc.allocate( 30 ) == RangeAllocator::kInvalid );
+		REQUIRE( alloc.allocate( 20 ) == 80 );
+		REQUIRE( alloc.free_space() == 0 );
+		REQUIRE( alloc.free_range_count() == 0 );
+	}
+
+	SECTION("Released neighbours are merged")
+	{
+		auto const a = alloc.allocate( 10 );
+		auto const b = alloc.allocate( 10 );
+		auto const c = alloc.allocate( 10 );
+
+		alloc.release( a, 10 );
+		alloc.release( c, 10 ); // merges with the tail
+		REQUIRE( alloc.free_range_count() == 2 );
+
+		alloc.release( b, 10 ); // merges with both sides
+		REQUIRE( alloc.free_range_count() == 1 );
+		REQUIRE( alloc.largest_free_range() == 100 );
+		REQUIRE( alloc.free_space() == 100 );
+	}
+
+	SECTION("Best fit")
+	{
+		auto const a = alloc.allocate( 30 );
+		alloc.allocate( 10 );
+		auto const c = alloc.allocate( 15 );
+		alloc.allocate( 10 );
+
+		alloc.release( a, 30 );
+		alloc.release( c, 15 );
+
+		// Free: [0,30), [40,55), [65,100). 12 fits best into the 15-gap.
+		REQUIRE( alloc.allocate( 12 ) == 40 );
+		REQUIRE( alloc.allocate( 31 ) == 65 );
+		REQUIRE( alloc.allocate( 30 ) == 0 );
+		REQUIRE( alloc.largest_free_range() == 4 );
+	}
+
+	SECTION("Random allocations never overlap")
+	{
+		RangeAllocator big( 10000 );
+		struct Range { std::size_t offset, size; };
+		std::vector<Range> live;
+
+		Xoshiro256Plus rng( 7 );
+		bool overlap = false;
+		for( int i = 0; i < 2000; ++i )
+		{
+			auto const r = rng.next();
+			if( !live.empty() && (r & 3) == 0 )
+			{
+				auto const idx = std::size_t((r >> 8) % live.size());
+				big.release( live[idx].offset, live[idx].size );
+				live[idx] = live.back();
+				live.pop_back();
+				continue;
+			}
+
+			auto const size = std::size_t(1 + (r >> 16) % 200);
+			auto const offset = big.allocate( size );
+			if( RangeAllocator::kInvalid == offset )
+				continue;
+
+			for( auto const& l : live )
+				overlap = overlap || (offset < l.offset + l.size && l.offset < offset + size);
+			live.emplace_back( Range{ offset, size } );
+		}
+
+		REQUIRE( !overlap );
+
+		std::size_t used = 0;
+		for( auto const& l : live )
+			used += l.size;
+		REQUIRE( big.free_space() == big.capacity() - used );
+
+		for( auto const& l : live )
+			big.release( l.offset, l.size );
+		REQUIRE( big.free_range_count() == 1 );
+		REQUIRE( big.largest_free_range() == big.capacity() );
+	}
+}
@@ -0,0 +1,57 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <cmath>
+
+#include "../main/rolling_stats.hpp"
+
+TEST_CASE("Rolling statistics", "[metrics]")
+{
+	RollingStats stats( 4 );
+
+	SECTION("Empty")
+	{
+		REQUIRE( stats.size() == 0 );
+		REQUIRE( stats.mean() == 0.0 );
+		REQUIRE( stats.min() == 0.0 );
+		REQUIRE( stats.max() == 0.0 );
+		REQUIRE( stats.stddev() == 0.0 );
+	}
+
+	SECTION("Partially filled window")
+	{
+		stats.add( 3.0 );
+		stats.add( 1.0 );
+
+		REQUIRE( stats.size() == 2 );
+		REQUIRE( stats.last() == 1.0 );
+		REQUIRE( stats.mean() == Catch::Approx( 2.0 ) );
+		REQUIRE( stats.min() == 1.0 );
+		REQUIRE( stats.max() == 3.0 );
+		REQUIRE( stats.stddev() == Catch::Approx( 1.0 ) );
+	}
+
+	SECTION("Old samples drop out of the window")
+	{
+		for( int i = 1; i <= 10; ++i )
+			stats.add( double(i) );
+
+		REQUIRE( stats.size() == 4 );
+		REQUIRE( stats.total() == 10 );
+		REQUIRE( stats.mean() == Catch::Approx( 8.5 ) ); // 7, 8, 9, 10
+		REQUIRE( stats.min() == 7.0 );
+		REQUIRE( stats.max() == 10.0 );
+		REQUIRE( stats.stddev() == Catch::Approx( std::sqrt( 1.25 ) ) );
+	}
+
+	SECTION("Clear")
+	{
+		stats.add( 5.0 );
+		stats.clear();
+		stats.add( 1.0 );
+
+		REQUIRE( stats.size() == 1 );
+		REQUIRE( stats.total() == 1 );
+		REQUIRE( stats.mean() == 1.0 );
+		REQUIRE( stats.max() == 1.0 );
+	}
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <map>
+#include <string>
+
+#include "../support/error.hpp"
+#include "../support/shader_source.hpp"
+
+namespace
+{
+	// In-memory files for preprocess_shader()
+	struct Files_
+	{
+		std::string operator() (std::string const& aPath) const
+		{
+			auto const it = files.find( aPath );
+			if( files.end() == it )
+				throw Error( "no file '%s'", aPath.c_str() );
+			return it->second;
+		}
+
+		std::map<std::string,std::string> files;
+	};
+}
+
+TEST_CASE("Shader preprocessing", "[shader]")
+{
+	Files_ fs;
+
+	SECTION("Defines go after #version")
+	{
+		fs.files["a.frag"] = "#version 430\nvoid main() {}\n";
+
+		auto const out = preprocess_shader( "a.frag", { "HAS_TEXTURE", "MAX_LIGHTS 4" }, fs );
+		REQUIRE( out.text == "#version 430\n#define HAS_TEXTURE\n#define MAX_LIGHTS 4\n#line 2 0\nvoid main() {}\n" );
+		REQUIRE( out.files == std::vector<std::string>{ "a.frag" } );
+	}
+
+	SECTION("Defines without #version")
+	{
+		fs.files["a.frag"] = "void main() {}";
+
+		REQUIRE( preprocess_shader( "a.frag", { "X" }, fs ).text == "#define X\n#line 1 0\nvoid main() {}\n" );
+		REQUIRE( preprocess_shader( "a.frag", {}, fs ).text == "void main() {}\n" );
+	}
+
+	SECTION("Includes are relative to the including file")
+	{
+		fs.files["assets/a.frag"] = "#version 430\n#include \"lib/b.glsl\"\nvoid main() {}\n";
+		fs.files["assets/lib/b.glsl"] = "// b\n  #  include \"c.glsl\"\n";
+		fs.files["assets/lib/c.glsl"] = "float c;\r\n";
+
+		auto const out = preprocess_shader( "assets/a.frag", {}, fs );
+		REQUIRE( out.text ==
+			"#version 430\n"
+			"#line 1 1\n"
+			"// b\n"
+			"#line 1 2\n"
+			"float c;\n"
+			"#line 3 1\n"
+			"#line 3 0\n"
+			"void main() {}\n"
+		);
+		REQUIRE( out.files == std::vector<std::string>{ "assets/a.frag", "assets/lib/b.glsl", "assets/lib/c.glsl" } );
+	}
+
+	SECTION("Files are included once")
+	{
+		fs.files["a.frag"] = "#include \"b.glsl\"\n#include \"b.glsl\"\nx\n";
+		fs.files["b.glsl"] = "#include \"a.frag\"\nb\n"; // cycle
+
+		auto const out = preprocess_shader( "a.frag", {}, fs );
+		REQUIRE( out.text == "#line 1 1\n\nb\n#line 2 0\n\nx\n" );
+		REQUIRE( out.files.size() == 2 );
+	}
+
+	SECTION("Errors")
+	{
+		fs.files["a.frag"] = "#include <b.glsl>\n";
+		REQUIRE_THROWS( preprocess_shader( "a.frag", {}, fs ) );
+
+		fs.files["a.frag"] = "#include \"b.glsl\" x\n";
+		REQUIRE_THROWS( preprocess_shader( "a.frag", {}, fs ) );
+
+		fs.files["a.frag"] = "#include \"missing.glsl\"\n";
+		REQUIRE_THROWS_WITH( preprocess_shader( "a.frag", {}, fs ), Catch::Matchers::ContainsSubstring( "included from a.frag:1" ) );
+
+		// Not an #include
+		fs.files["a.frag"] = "#includes \"b.glsl\"\n";
+		REQUIRE( preprocess_shader( "a.frag", {}, fs ).files.size() == 1 );
+	}
+}
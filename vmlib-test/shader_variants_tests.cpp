@@ -0,0 +1,160 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "../support/error.hpp"
+#include "../support/feature_variants.hpp"
+
+namespace
+{
+	using Defines_ = std::vector<std::string>;
+
+	// Stands in for ShaderProgram: records how it was built
+	struct Variant_
+	{
+		Variant_( int& aBuilds, std::string aSource, Defines_ aDefines )
+			: source( std::move(aSource) )
+			, defines( std::move(aDefines) )
+		{
+			++aBuilds;
+		}
+
+		Variant_( Variant_ const& ) = delete;
+		Variant_& operator= (Variant_ const&) = delete;
+
+		std::string source;
+		Defines_ defines;
+	};
+
+	// Fails to build the first aFailures times
+	struct Flaky_
+	{
+		Flaky_( int& aFailures, Defines_ )
+		{
+			if( aFailures > 0 )
+			{
+				--aFailures;
+				throw Error( "build failed" );
+			}
+		}
+	};
+}
+
+TEST_CASE("Shader variant defines", "[shader]")
+{
+	FeatureVariants<Variant_> variants( { "HAS_TEXTURE", "HAS_VERTEX_COLOR", "MAX_LIGHTS 4" } );
+
+	SECTION("Mask to defines")
+	{
+		REQUIRE( variants.defines( 0 ).empty() );
+		REQUIRE( variants.defines( 0b001 ) == Defines_{ "HAS_TEXTURE" } );
+		REQUIRE( variants.defines( 0b010 ) == Defines_{ "HAS_VERTEX_COLOR" } );
+		REQUIRE( variants.defines( 0b100 ) == Defines_{ "MAX_LIGHTS 4" } );
+		REQUIRE( variants.defines( 0b101 ) == Defines_{ "HAS_TEXTURE", "MAX_LIGHTS 4" } );
+	}
+
+	SECTION("Defines follow the feature order")
+	{
+		REQUIRE( variants.defines( 0b111 ) == Defines_{ "HAS_TEXTURE", "HAS_VERTEX_COLOR", "MAX_LIGHTS 4" } );
+
+		FeatureVariants<Variant_> reversed( { "MAX_LIGHTS 4", "HAS_VERTEX_COLOR", "HAS_TEXTURE" } );
+		REQUIRE( reversed.defines( 0b111 ) == Defines_{ "MAX_LIGHTS 4", "HAS_VERTEX_COLOR", "HAS_TEXTURE" } );
+		REQUIRE( reversed.defines( 0b101 ) == Defines_{ "MAX_LIGHTS 4", "HAS_TEXTURE" } );
+	}
+
+	SECTION("Unknown features")
+	{
+		REQUIRE_THROWS_AS( variants.defines( 0b1000 ), Error );
+		REQUIRE_THROWS_AS( variants.defines( 0x80000001u ), Error );
+
+		int builds = 0;
+		REQUIRE_THROWS_AS( variants.get( 0b1001, builds, "a" ), Error );
+		REQUIRE( 0 == builds );
+		REQUIRE( 0 == variants.size() );
+	}
+
+	SECTION("32 features")
+	{
+		std::vector<std::string> features;
+		for( int i = 0; i < 32; ++i )
+			features.emplace_back( "F" + std::to_string( i ) );
+
+		FeatureVariants<Variant_> all( features );
+		REQUIRE( all.defines( 0x80000000u ) == Defines_{ "F31" } );
+		REQUIRE( all.defines( ~std::uint32_t(0) ) == features );
+
+		features.emplace_back( "F32" );
+		REQUIRE_THROWS_AS( FeatureVariants<Variant_>( features ), Error );
+	}
+}
+
+TEST_CASE("Shader variant cache", "[shader]")
+{
+	FeatureVariants<Variant_> variants( { "HAS_TEXTURE", "HAS_VERTEX_COLOR" } );
+	int builds = 0;
+
+	SECTION("Cache hits")
+	{
+		auto& first = variants.get( 0b01, builds, "a" );
+		REQUIRE( 1 == builds );
+		REQUIRE( first.source == "a" );
+		REQUIRE( first.defines == Defines_{ "HAS_TEXTURE" } );
+
+		// Arguments are only used to build a missing variant
+		for( int i = 0; i < 5; ++i )
+		{
+			auto& again = variants.get( 0b01, builds, "b" );
+			REQUIRE( &again == &first );
+		}
+		REQUIRE( 1 == builds );
+		REQUIRE( 1 == variants.size() );
+		REQUIRE( first.source == "a" );
+	}
+
+	SECTION("Distinct masks")
+	{
+		std::vector<Variant_*> seen;
+		for( std::uint32_t mask = 0; mask < 4; ++mask )
+		{
+			auto& variant = variants.get( mask, builds, "a" );
+			REQUIRE( variant.defines == variants.defines( mask ) );
+
+			for( auto const* other : seen )
+				REQUIRE( other != &variant );
+			seen.emplace_back( &variant );
+		}
+		REQUIRE( 4 == builds );
+		REQUIRE( 4 == variants.size() );
+
+		// Variants do not move as others are added
+		for( std::uint32_t mask = 0; mask < 4; ++mask )
+			REQUIRE( &variants.get( mask, builds, "a" ) == seen[mask] );
+		REQUIRE( 4 == builds );
+
+		std::uint32_t expected = 0;
+		for( auto const& [mask, variant] : variants )
+		{
+			REQUIRE( mask == expected );
+			REQUIRE( &variant == seen[expected] );
+			++expected;
+		}
+		REQUIRE( 4 == expected );
+	}
+
+	SECTION("Failed builds are retried")
+	{
+		FeatureVariants<Flaky_> flaky( { "HAS_TEXTURE" } );
+
+		int failures = 2;
+		REQUIRE_THROWS_AS( flaky.get( 1, failures ), Error );
+		REQUIRE( 0 == flaky.size() );
+		REQUIRE_THROWS_AS( flaky.get( 1, failures ), Error );
+		REQUIRE( 0 == flaky.size() );
+
+		flaky.get( 1, failures );
+		REQUIRE( 1 == flaky.size() );
+		REQUIRE( 0 == failures );
+	}
+}
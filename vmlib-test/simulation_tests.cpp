@@ -0,0 +1,148 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../main/simulation.hpp"
+#include "../main/triple_buffer.hpp"
+#include "../main/worker_pool.hpp"
+
+TEST_CASE("Triple buffer hand-over", "[simulation]")
+{
+	SECTION("Reader sees only the latest published value")
+	{
+		TripleBuffer<int> buf;
+
+		REQUIRE( !buf.update() );
+
+		buf.back() = 1;
+		buf.publish();
+		buf.back() = 2;
+		buf.publish();
+
+		REQUIRE( buf.update() );
+		REQUIRE( buf.front() == 2 );
+		REQUIRE( !buf.update() );
+		REQUIRE( buf.front() == 2 );
+	}
+
+	SECTION("Concurrent writer and reader")
+	{
+		// Each value is written as two equal halves; a torn read would
+		// show different halves, a stale one a decreasing value.
+		struct Pair_ { long a = 0, b = 0; };
+		TripleBuffer<Pair_> buf;
+
+		constexpr long kCount_ = 200000;
+		std::thread writer( [&buf] {
+			for( long i = 1; i <= kCount_; ++i )
+			{
+				buf.back().a = i;
+				buf.back().b = i;
+				buf.publish();
+			}
+		} );
+
+		std::size_t torn = 0, backwards = 0;
+		long last = 0;
+		while( last != kCount_ )
+		{
+			buf.update();
+			auto const& v = buf.front();
+			torn += (v.a != v.b) ? 1 : 0;
+			backwards += (v.a < last) ? 1 : 0;
+			last = v.a;
+		}
+
+		writer.join();
+
+		REQUIRE( torn == 0 );
+		REQUIRE( backwards == 0 );
+	}
+}
+
+TEST_CASE("Fixed-step simulation", "[simulation]")
+{
+	static constexpr float kStep_ = 1.f / 60.f;
+	static constexpr std::size_t kParticles_ = 6000;
+
+	WorkerPool workers( 1 );
+
+	SECTION("Same commands at the same steps give identical results")
+	{
+		Simulation a( kStep_, kParticles_, workers ), b( kStep_, kParticles_, workers );
+
+		auto const run = [] (Simulation& aSim) {
+			for( int i = 0; i < 30; ++i )
+			{
+				if( 5 == i )
+					aSim.launch();
+				aSim.step();
+			}
+		};
+		run( a );
+		run( b );
+
+		auto const& sa = a.latest();
+		auto const& sb = b.latest();
+
+		REQUIRE( sa.step == 30 );
+		REQUIRE( sa.ship.launched );
+		REQUIRE( sa.ship.origin == sb.ship.origin );
+		REQUIRE( sa.ship.curve == sb.ship.curve );
+		REQUIRE( sa.particleCount > 0 );
+		REQUIRE( sa.particleCount == sb.particleCount );
+
+		bool same = true;
+		for( std::size_t i = 0; i < 3*sa.particleCount; ++i )
+			same = same && sa.particlePositions[i] == sb.particlePositions[i];
+		REQUIRE( same );
+	}
+
+	SECTION("Snapshots carry the previous ship state")
+	{
+		Simulation sim( kStep_, kParticles_, workers );
+		sim.launch();
+		sim.step();
+		sim.step();
+
+		auto const& snap = sim.latest();
+		REQUIRE( snap.previousShip.origin < snap.ship.origin );
+
+		auto const mid = interpolate( snap.previousShip, snap.ship, 0.5f );
+		REQUIRE( mid.origin > snap.previousShip.origin );
+		REQUIRE( mid.origin < snap.ship.origin );
+
+		sim.reset();
+		sim.step();
+		REQUIRE( !sim.latest().ship.launched );
+		REQUIRE( sim.latest().ship.origin == 0.f );
+	}
+
+	SECTION("GPU mode records spawns instead of simulating them")
+	{
+		Simulation sim( kStep_, kParticles_, workers );
+		sim.set_gpu_particles( true );
+		sim.launch();
+		sim.step();
+
+		std::vector<ParticleSpawn> spawns;
+		sim.take_gpu_spawns( spawns );
+
+		REQUIRE( spawns.size() == 40 );
+		REQUIRE( sim.latest().particleCount == 0 );
+	}
+
+	SECTION("Thread publishes steps in real time")
+	{
+		Simulation sim( kStep_, kParticles_, workers );
+		sim.start();
+		std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+		sim.stop();
+
+		auto const& snap = sim.latest();
+		REQUIRE( snap.step >= 3 );
+		REQUIRE( snap.time == Catch::Approx( snap.step * double(kStep_) ) );
+	}
+}
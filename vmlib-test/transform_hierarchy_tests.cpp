@@ -0,0 +1,144 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include "../main/simulation.hpp"
+#include "../main/transform_hierarchy.hpp"
+
+namespace
+{
+	bool near_( Mat44f const& aA, Mat44f const& aB )
+	{
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			if( aA.v[i] != Catch::Approx( aB.v[i] ).margin( 1e-5f ) )
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE("Transform hierarchy", "[transform_hierarchy]")
+{
+	TransformHierarchy h;
+
+	SECTION("World matrices compose parent and local TRS")
+	{
+		auto const root = h.add();
+		auto const child = h.add( root );
+
+		h.set_translation( root, { 1.f, 2.f, 3.f } );
+		h.set_rotation( root, { 0.f, 0.5f, 0.f } );
+		h.set_translation( child, { 0.f, 0.f, -4.f } );
+		h.set_rotation( child, { 0.25f, 0.f, 0.75f } );
+		h.set_scale( child, { 2.f, 3.f, 4.f } );
+
+		REQUIRE( h.update() == 2 );
+
+		auto const rootWorld = make_translation( { 1.f, 2.f, 3.f } ) * make_rotation_y( 0.5f );
+		auto const childLocal = make_translation( { 0.f, 0.f, -4.f } )
+			* make_rotation_z( 0.75f ) * make_rotation_x( 0.25f )
+			* make_scaling( 2.f, 3.f, 4.f );
+
+		REQUIRE( near_( h.world( root ), rootWorld ) );
+		REQUIRE( near_( h.world( child ), rootWorld * childLocal ) );
+	}
+
+	SECTION("Only dirty subtrees are updated")
+	{
+		auto const a = h.add();
+		auto const b = h.add();
+		auto const a1 = h.add( a );
+		auto const a11 = h.add( a1 );
+		auto const b1 = h.add( b );
+
+		REQUIRE( h.update() == 5 );
+		REQUIRE( h.update() == 0 );
+		REQUIRE( !h.world_changed( a ) );
+
+		h.set_translation( a1, { 1.f, 0.f, 0.f } );
+		REQUIRE( h.update() == 2 );
+		REQUIRE( h.world_changed( a1 ) );
+		REQUIRE( h.world_changed( a11 ) );
+		REQUIRE( !h.world_changed( a ) );
+		REQUIRE( !h.world_changed( b1 ) );
+
+		// Setting the same value again is not a change
+		h.set_translation( a1, { 1.f, 0.f, 0.f } );
+		REQUIRE( h.update() == 0 );
+		REQUIRE( !h.world_changed( a11 ) );
+
+		h.set_scale( b, { 2.f, 2.f, 2.f } );
+		REQUIRE( h.update() == 2 );
+		REQUIRE( h.world( b1 ).v[0] == 2.f );
+		REQUIRE( h.world( a11 ).v[3] == 1.f );
+	}
+
+	SECTION("Handles survive reordering")
+	{
+		// Children added before their parent's siblings still end up on a
+		// later level; handles must keep pointing at the same nodes.
+		auto const a = h.add();
+		auto const a1 = h.add( a );
+		auto const b = h.add();
+		auto const b1 = h.add( b );
+		auto const a11 = h.add( a1 );
+
+		REQUIRE( h.size() == 5 );
+		REQUIRE( h.parent( a ) == kNoTransformNode );
+		REQUIRE( h.parent( a1 ) == a );
+		REQUIRE( h.parent( b1 ) == b );
+		REQUIRE( h.parent( a11 ) == a1 );
+
+		h.set_translation( a, { 1.f, 0.f, 0.f } );
+		h.set_translation( a1, { 0.f, 1.f, 0.f } );
+		h.set_translation( a11, { 0.f, 0.f, 1.f } );
+		h.set_translation( b, { 5.f, 0.f, 0.f } );
+		h.update();
+
+		auto const& w = h.world( a11 );
+		REQUIRE( w( 0, 3 ) == 1.f );
+		REQUIRE( w( 1, 3 ) == 1.f );
+		REQUIRE( w( 2, 3 ) == 1.f );
+		REQUIRE( h.world( b1 )( 0, 3 ) == 5.f );
+	}
+
+	SECTION("Normal matrices follow the world matrix")
+	{
+		auto const n = h.add();
+		h.set_scale( n, { 2.f, 4.f, 1.f } );
+		h.update();
+
+		auto const& nm = h.normal_matrix( n );
+		REQUIRE( nm( 0, 0 ) == Catch::Approx( 0.5f ) );
+		REQUIRE( nm( 1, 1 ) == Catch::Approx( 0.25f ) );
+		REQUIRE( nm( 2, 2 ) == Catch::Approx( 1.f ) );
+
+		h.set_scale( n, { 1.f, 1.f, 1.f } );
+		h.update();
+		REQUIRE( h.normal_matrix( n )( 1, 1 ) == Catch::Approx( 1.f ) );
+	}
+}
+
+TEST_CASE("Ship pose in a transform hierarchy", "[transform_hierarchy]")
+{
+	// Ship node with the pose, model node with the pivot below it, as in
+	// main.cpp.
+	TransformHierarchy h;
+	auto const ship = h.add();
+	auto const model = h.add( ship );
+	h.set_translation( model, kShipPivot );
+
+	for( float t : { 0.f, 0.5f, 2.f } )
+	{
+		ShipState state;
+		state.launched = t > 0.f;
+		state.origin = 3.f * t;
+		state.curve = t * t;
+
+		auto const pose = ship_pose( state );
+		h.set_translation( ship, pose.translation );
+		h.set_rotation( ship, { pose.pitch, 0.f, 0.f } );
+		h.update();
+
+		REQUIRE( near_( h.world( model ), ship_model_to_world( state ) ) );
+	}
+}
@@ -0,0 +1,85 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "../main/worker_pool.hpp"
+
+TEST_CASE("Worker pool parallel_for", "[workers]")
+{
+	auto const threads = GENERATE( 1u, 2u, 4u );
+
+	WorkerPool pool( threads );
+	REQUIRE( pool.thread_count() == threads );
+
+	SECTION("Every item is visited exactly once")
+	{
+		std::vector<int> visits( 10007, 0 );
+		std::atomic<std::size_t> chunks{ 0 };
+
+		pool.parallel_for( visits.size(), 64, [&] (std::size_t aBegin, std::size_t aEnd, std::size_t) {
+			for( auto i = aBegin; i < aEnd; ++i )
+				++visits[i];
+			++chunks;
+		} );
+
+		REQUIRE( chunks == (10007 + 63) / 64 );
+		REQUIRE( std::count( visits.begin(), visits.end(), 1 ) == long(visits.size()) );
+	}
+
+	SECTION("Back-to-back jobs do not interfere")
+	{
+		std::vector<std::size_t> sums( 100, 0 );
+		for( std::size_t job = 0; job < sums.size(); ++job )
+		{
+			std::vector<std::size_t> partial( 16, 0 );
+			pool.parallel_for( 1000, 64, [&] (std::size_t aBegin, std::size_t aEnd, std::size_t aChunk) {
+				for( auto i = aBegin; i < aEnd; ++i )
+					partial[aChunk] += i + job;
+			} );
+
+			for( auto p : partial )
+				sums[job] += p;
+		}
+
+		std::size_t wrong = 0;
+		for( std::size_t job = 0; job < sums.size(); ++job )
+			wrong += (sums[job] == 999*1000/2 + 1000*job) ? 0 : 1;
+		REQUIRE( wrong == 0 );
+	}
+
+	SECTION("Jobs from several threads take turns")
+	{
+		std::vector<int> visits[3];
+		for( auto& v : visits )
+			v.assign( 5000, 0 );
+
+		auto run = [&] (std::vector<int>& aVisits) {
+			for( int rep = 0; rep < 20; ++rep )
+			{
+				pool.parallel_for( aVisits.size(), 64, [&] (std::size_t aBegin, std::size_t aEnd, std::size_t) {
+					for( auto i = aBegin; i < aEnd; ++i )
+						++aVisits[i];
+				} );
+			}
+		};
+
+		std::thread a( run, std::ref( visits[0] ) ), b( run, std::ref( visits[1] ) );
+		run( visits[2] );
+		a.join();
+		b.join();
+
+		for( auto const& v : visits )
+			REQUIRE( std::count( v.begin(), v.end(), 20 ) == long(v.size()) );
+	}
+
+	SECTION("Empty range is a no-op")
+	{
+		bool called = false;
+		pool.parallel_for( 0, 16, [&] (std::size_t, std::size_t, std::size_t) { called = true; } );
+		REQUIRE( !called );
+	}
+}
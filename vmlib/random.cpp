@@ -0,0 +1,226 @@
+#include "random.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+
+namespace
+{
+	constexpr float kTwoPi_ = 6.2831853f;
+
+	std::uint64_t splitmix64_( std::uint64_t& aState ) noexcept;
+
+	std::uint64_t rotl_( std::uint64_t aX, int aK ) noexcept
+	{
+		return (aX << aK) | (aX >> (64 - aK));
+	}
+
+	float to_unit_float_( std::uint64_t aX ) noexcept
+	{
+		// Upper 24 bits -> [0,1) with full float precision. Converting via
+		// int32 (rather than uint64) keeps the conversion vectorizable.
+		return float(std::int32_t(aX >> 40)) * (1.f / 16777216.f);
+	}
+
+	// sin(2 pi v) and cos(2 pi v) for v in [0,1). Plain polynomials without
+	// branches, so that loops calling this vectorize (std::sin/std::cos do
+	// not). Absolute error is below 1e-6.
+	void sincos_2pi_( float aV, float& aSin, float& aCos ) noexcept;
+}
+
+Xoshiro256Plus::Xoshiro256Plus( std::uint64_t aSeed, std::uint64_t aStream ) noexcept
+{
+	// Seed via SplitMix64, as recommended by the xoshiro authors. This
+	// guarantees a non-zero state for any seed.
+	std::uint64_t sm = aSeed ^ (aStream * 0xd1342543de82ef95ull);
+	for( auto& s : mState )
+		s = splitmix64_( sm );
+}
+
+std::uint64_t Xoshiro256Plus::next() noexcept
+{
+	auto const result = mState[0] + mState[3];
+	auto const t = mState[1] << 17;
+
+	mState[2] ^= mState[0];
+	mState[3] ^= mState[1];
+	mState[1] ^= mState[2];
+	mState[0] ^= mState[3];
+
+	mState[2] ^= t;
+	mState[3] = rotl_( mState[3], 45 );
+
+	return result;
+}
+
+float Xoshiro256Plus::uniform_float() noexcept
+{
+	return to_unit_float_( next() );
+}
+
+void Xoshiro256Plus::jump() noexcept
+{
+	static constexpr std::uint64_t kJump[] = {
+		0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+		0xa9582618e03fc9aaull, 0x39abdc4529b1661cull
+	};
+
+	std::uint64_t s[4] = { 0, 0, 0, 0 };
+	for( auto const jump : kJump )
+	{
+		for( int b = 0; b < 64; ++b )
+		{
+			if( jump & (std::uint64_t(1) << b) )
+			{
+				for( int i = 0; i < 4; ++i )
+					s[i] ^= mState[i];
+			}
+			next();
+		}
+	}
+
+	for( int i = 0; i < 4; ++i )
+		mState[i] = s[i];
+}
+
+
+Xoshiro256PlusPacket::Xoshiro256PlusPacket( std::uint64_t aSeed, std::uint64_t aStream ) noexcept
+{
+	Xoshiro256Plus gen( aSeed, aStream );
+	for( std::size_t lane = 0; lane < kRandomLanes; ++lane )
+	{
+		for( int i = 0; i < 4; ++i )
+			mState[i][lane] = gen.mState[i];
+
+		gen.jump();
+	}
+}
+
+void Xoshiro256PlusPacket::next( std::uint64_t (&aOut)[kRandomLanes] ) noexcept
+{
+	// Same as Xoshiro256Plus::next(), one lane per iteration. The results go
+	// to a local first: aOut might alias mState as far as the compiler knows,
+	// which would prevent vectorization.
+	std::uint64_t out[kRandomLanes];
+	for( std::size_t l = 0; l < kRandomLanes; ++l )
+	{
+		auto const s0 = mState[0][l], s1 = mState[1][l], s2 = mState[2][l], s3 = mState[3][l];
+
+		out[l] = s0 + s3;
+
+		auto const t2 = s2 ^ s0;
+		auto const t3 = s3 ^ s1;
+
+		mState[0][l] = s0 ^ t3;
+		mState[1][l] = s1 ^ t2;
+		mState[2][l] = t2 ^ (s1 << 17);
+		mState[3][l] = rotl_( t3, 45 );
+	}
+
+	for( std::size_t l = 0; l < kRandomLanes; ++l )
+		aOut[l] = out[l];
+}
+
+
+void uniform_float( Xoshiro256PlusPacket& aRng, float* aOut, std::size_t aCount, float aMin, float aMax ) noexcept
+{
+	float const scale = aMax - aMin;
+
+	std::uint64_t bits[kRandomLanes];
+
+	std::size_t i = 0;
+	for( ; i + kRandomLanes <= aCount; i += kRandomLanes )
+	{
+		aRng.next( bits );
+		for( std::size_t l = 0; l < kRandomLanes; ++l )
+			aOut[i+l] = aMin + scale * to_unit_float_( bits[l] );
+	}
+
+	if( i < aCount )
+	{
+		aRng.next( bits );
+		for( std::size_t l = 0; i + l < aCount; ++l )
+			aOut[i+l] = aMin + scale * to_unit_float_( bits[l] );
+	}
+}
+
+void unit_sphere( Xoshiro256PlusPacket& aRng, float* aX, float* aY, float* aZ, std::size_t aCount ) noexcept
+{
+	// Archimedes: z uniform in [-1,1] and a uniform azimuth give a uniform
+	// distribution on the sphere. The two uniforms are staged in aZ and aY.
+	uniform_float( aRng, aZ, aCount, -1.f, 1.f );
+	uniform_float( aRng, aY, aCount );
+
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		float const z = aZ[i];
+		float const r = std::sqrt( std::max( 0.f, 1.f - z*z ) );
+
+		float s, c;
+		sincos_2pi_( aY[i], s, c );
+
+		aX[i] = r * c;
+		aY[i] = r * s;
+	}
+}
+
+void cone_direction( Xoshiro256PlusPacket& aRng, Vec3f aAxis, float aHalfAngle, float* aX, float* aY, float* aZ, std::size_t aCount ) noexcept
+{
+	// Orthonormal basis (t, b, n) around the axis, see
+	//   Duff et al., "Building an Orthonormal Basis, Revisited", JCGT 2017
+	Vec3f const n = normalize( aAxis );
+	float const sign = std::copysign( 1.f, n.z );
+	float const a = -1.f / (sign + n.z);
+	float const b = n.x * n.y * a;
+	Vec3f const t{ 1.f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+	Vec3f const bt{ b, sign + n.y * n.y * a, -n.y };
+
+	// Same as unit_sphere(), but with cos(theta) in [cos(aHalfAngle),1]
+	float const cosMax = std::cos( aHalfAngle );
+	uniform_float( aRng, aZ, aCount, cosMax, 1.f );
+	uniform_float( aRng, aY, aCount );
+
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		float const cz = aZ[i];
+		float const r = std::sqrt( std::max( 0.f, 1.f - cz*cz ) );
+
+		float s, c;
+		sincos_2pi_( aY[i], s, c );
+
+		float const lx = r * c, ly = r * s;
+		aX[i] = t.x * lx + bt.x * ly + n.x * cz;
+		aY[i] = t.y * lx + bt.y * ly + n.y * cz;
+		aZ[i] = t.z * lx + bt.z * ly + n.z * cz;
+	}
+}
+
+namespace
+{
+	std::uint64_t splitmix64_( std::uint64_t& aState ) noexcept
+	{
+		std::uint64_t z = (aState += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	void sincos_2pi_( float aV, float& aSin, float& aCos ) noexcept
+	{
+		// Shift to x in [-pi,pi) and use sin(x+pi) = -sin(x), cos(x+pi) =
+		// -cos(x). Taylor series up to x^15 and x^16 are accurate enough on
+		// that range.
+		float const x = (aV - 0.5f) * kTwoPi_;
+		float const x2 = x * x;
+
+		float const s = x * (1.f + x2 * (-1.f/6.f + x2 * (1.f/120.f + x2 * (-1.f/5040.f
+			+ x2 * (1.f/362880.f + x2 * (-1.f/39916800.f + x2 * (1.f/6227020800.f
+			+ x2 * (-1.f/1307674368000.f))))))));
+		float const c = 1.f + x2 * (-1.f/2.f + x2 * (1.f/24.f + x2 * (-1.f/720.f
+			+ x2 * (1.f/40320.f + x2 * (-1.f/3628800.f + x2 * (1.f/479001600.f
+			+ x2 * (-1.f/87178291200.f + x2 * (1.f/20922789888000.f))))))));
+
+		aSin = -s;
+		aCos = -c;
+	}
+}
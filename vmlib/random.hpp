@@ -0,0 +1,78 @@
+#ifndef RANDOM_HPP_C4E07A52_1F3B_4D96_A8E5_73B2D90F6E14
+#define RANDOM_HPP_C4E07A52_1F3B_4D96_A8E5_73B2D90F6E14
+
+#include <cstdint>
+#include <cstddef>
+
+#include "vec3.hpp"
+
+/** Random numbers for simulation (particles etc.)
+ *
+ * Xoshiro256Plus is the xoshiro256+ generator by Blackman and Vigna
+ * (https://prng.di.unimi.it/). It is small, fast and has good statistical
+ * quality in the upper bits, which are the ones we turn into floats. It is
+ * NOT suitable for cryptographic purposes.
+ *
+ * Xoshiro256PlusPacket runs kRandomLanes independent generators side by side,
+ * with the state stored lane-wise (SoA). Each step is a handful of adds,
+ * shifts and xors over all lanes, which the compiler turns into SIMD
+ * instructions. Lane 0 produces exactly the same sequence as a scalar
+ * Xoshiro256Plus constructed with the same arguments; the other lanes are
+ * jump()ed ahead by multiples of 2^128 steps, so they never overlap.
+ *
+ * Both are fully determined by (seed, stream). Different streams of the same
+ * seed are independent, which makes runs reproducible, e.g. for benchmarks.
+ *
+ * The batch samplers below fill SoA arrays from a packet generator:
+ *
+ *	Xoshiro256PlusPacket rng( 1234 );
+ *	float x[N], y[N], z[N];
+ *	cone_direction( rng, Vec3f{ 0.f, 1.f, 0.f }, 0.3f, x, y, z, N );
+ */
+constexpr std::size_t kRandomLanes = 8;
+
+class Xoshiro256Plus final
+{
+	public:
+		explicit Xoshiro256Plus( std::uint64_t aSeed, std::uint64_t aStream = 0 ) noexcept;
+
+	public:
+		std::uint64_t next() noexcept;
+
+		// Uniform in [0,1)
+		float uniform_float() noexcept;
+
+		// Advances by 2^128 steps
+		void jump() noexcept;
+
+	private:
+		friend class Xoshiro256PlusPacket;
+		std::uint64_t mState[4];
+};
+
+class Xoshiro256PlusPacket final
+{
+	public:
+		explicit Xoshiro256PlusPacket( std::uint64_t aSeed, std::uint64_t aStream = 0 ) noexcept;
+
+	public:
+		// Generates one value per lane
+		void next( std::uint64_t (&aOut)[kRandomLanes] ) noexcept;
+
+	private:
+		std::uint64_t mState[4][kRandomLanes];
+};
+
+// Fills aOut[0..aCount) with floats uniformly distributed in [aMin,aMax)
+void uniform_float( Xoshiro256PlusPacket&, float* aOut, std::size_t aCount, float aMin = 0.f, float aMax = 1.f ) noexcept;
+
+// Fills (aX,aY,aZ)[0..aCount) with directions uniformly distributed on the
+// unit sphere
+void unit_sphere( Xoshiro256PlusPacket&, float* aX, float* aY, float* aZ, std::size_t aCount ) noexcept;
+
+// Fills (aX,aY,aZ)[0..aCount) with unit directions uniformly distributed
+// over the spherical cap around aAxis with half-angle aHalfAngle (radians,
+// in [0,pi]). aAxis does not need to be normalized, but must be non-zero.
+void cone_direction( Xoshiro256PlusPacket&, Vec3f aAxis, float aHalfAngle, float* aX, float* aY, float* aZ, std::size_t aCount ) noexcept;
+
+#endif // RANDOM_HPP_C4E07A52_1F3B_4D96_A8E5_73B2D90F6E14